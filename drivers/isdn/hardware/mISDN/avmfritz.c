@@ -636,6 +636,7 @@ avm_fritz_interrupt(int intno, void *dev_id)
 	struct fritzcard *fc = dev_id;
 	u8 val;
 	u8 sval;
+	int cnt = 8;
 
 	spin_lock(&fc->lock);
 	sval = inb(fc->addr + 2);
@@ -647,12 +648,17 @@ avm_fritz_interrupt(int intno, void *dev_id)
 	}
 	fc->irqcnt++;
 
-	if (!(sval & AVM_STATUS0_IRQ_ISAC)) {
-		val = ReadISAC_V1(fc, ISAC_ISTA);
-		mISDNisac_irq(&fc->isac, val);
+	/* batch events which arrive while we service the previous ones */
+	while (((sval & AVM_STATUS0_IRQ_MASK) != AVM_STATUS0_IRQ_MASK) &&
+	       cnt--) {
+		if (!(sval & AVM_STATUS0_IRQ_ISAC)) {
+			val = ReadISAC_V1(fc, ISAC_ISTA);
+			mISDNisac_irq(&fc->isac, val);
+		}
+		if (!(sval & AVM_STATUS0_IRQ_HDLC))
+			HDLC_irq_main(fc);
+		sval = inb(fc->addr + 2);
 	}
-	if (!(sval & AVM_STATUS0_IRQ_HDLC))
-		HDLC_irq_main(fc);
 	spin_unlock(&fc->lock);
 	return IRQ_HANDLED;
 }
@@ -663,6 +669,7 @@ avm_fritzv2_interrupt(int intno, void *dev_id)
 	struct fritzcard *fc = dev_id;
 	u8 val;
 	u8 sval;
+	int cnt = 8;
 
 	spin_lock(&fc->lock);
 	sval = inb(fc->addr + 2);
@@ -674,17 +681,21 @@ avm_fritzv2_interrupt(int intno, void *dev_id)
 	}
 	fc->irqcnt++;
 
-	if (sval & AVM_STATUS0_IRQ_HDLC)
-		HDLC_irq_main(fc);
-	if (sval & AVM_STATUS0_IRQ_ISAC) {
-		val = ReadISAC_V2(fc, ISACX_ISTA);
-		mISDNisac_irq(&fc->isac, val);
-	}
-	if (sval & AVM_STATUS0_IRQ_TIMER) {
-		pr_debug("%s: timer irq\n", fc->name);
-		outb(fc->ctrlreg | AVM_STATUS0_RES_TIMER, fc->addr + 2);
-		udelay(1);
-		outb(fc->ctrlreg, fc->addr + 2);
+	/* batch events which arrive while we service the previous ones */
+	while ((sval & AVM_STATUS0_IRQ_MASK) && cnt--) {
+		if (sval & AVM_STATUS0_IRQ_HDLC)
+			HDLC_irq_main(fc);
+		if (sval & AVM_STATUS0_IRQ_ISAC) {
+			val = ReadISAC_V2(fc, ISACX_ISTA);
+			mISDNisac_irq(&fc->isac, val);
+		}
+		if (sval & AVM_STATUS0_IRQ_TIMER) {
+			pr_debug("%s: timer irq\n", fc->name);
+			outb(fc->ctrlreg | AVM_STATUS0_RES_TIMER, fc->addr + 2);
+			udelay(1);
+			outb(fc->ctrlreg, fc->addr + 2);
+		}
+		sval = inb(fc->addr + 2);
 	}
 	spin_unlock(&fc->lock);
 	return IRQ_HANDLED;
@@ -57,6 +57,9 @@ struct hfc_chan {
 					/* the FIFO 0=no, 1=yes, 2=splloop */
 	int		Zfill;	/* rx-fifo level on last hfcmulti_tx */
 	int		rx_off; /* set to turn fifo receive off */
+	u_char		*tone_data; /* tone sample loop (HFC_SPL_LOOP_ON) */
+	int		tone_len;
+	int		tone_idx; /* next pattern byte to feed the fifo */
 	int		coeff_count; /* curren coeff block */
 	s32		*coeff; /* memory pointer to 8 coeff blocks */
 };
@@ -75,6 +78,7 @@ struct hfcm_hw {
 	u_char	r_tx0, r_tx1;
 	u_char	a_st_ctrl0[8];
 	u_char	r_bert_wd_md;
+	u_char	r_ti_wd;
 	timer_t	timer;
 };
 
@@ -201,6 +205,8 @@ struct hfc_multi {
 	int		Flen;	/* F-buffer size */
 	int		Zlen;	/* Z-buffer size (must be int for calculation)*/
 	int		max_trans; /* maximum transparent fifo fill */
+	u_int		poll;	/* samples per timer tick of this card */
+	int		poll_timer; /* R_TI_WD value for hc->poll */
 	int		Zmin;	/* Z-buffer offset */
 	int		DTMFbase; /* base address of DTMF coefficients */
 
@@ -213,6 +219,9 @@ struct hfc_multi {
 	u_int		bmask[32]; /* bitmask of bchannels for port */
 	u_char		dnum[32]; /* array of used dchannel numbers for port */
 	u_char		created[32]; /* what port is created */
+	u_long		ch_map; /* channel slots with a d/b-channel, so
+				 * the irq handlers walk set bits instead
+				 * of all 32 slots */
 	u_int		activity_tx; /* if there is data TX / RX */
 	u_int		activity_rx; /* bitmask according to port number */
 				     /* (will be cleared after */
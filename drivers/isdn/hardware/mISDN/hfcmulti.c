@@ -89,6 +89,17 @@
  *	By default 128 is used. Decrease to reduce delay, increase to
  *	reduce cpu load. If unsure, don't mess with it!
  *	Valid is 8, 16, 32, 64, 128, 256.
+ *	This sets the default at load time; each card can be retuned
+ *	at runtime through its 'poll' sysfs attribute on the pci device
+ *	(not available with irqpoll, where one timer runs all cards).
+ *
+ * irqpoll:
+ *	NOTE: only one irqpoll value must be given for all cards
+ *	If set to 1, the interrupt outputs of all cards stay masked and
+ *	one high resolution timer services all cards at the poll period.
+ *	This trades a little added latency for one timer tick instead of
+ *	one interrupt per card and period, which helps with many cards.
+ *	By default (0), every card uses its own hardware interrupt.
  *
  * pcm:
  *	NOTE: only one pcm value must be given for every card.
@@ -165,7 +176,9 @@
 #define HFC_MULTI_VERSION	"2.03"
 
 #include <linux/interrupt.h>
+#include <linux/hrtimer.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
 #include <linux/slab.h>
 #include <linux/pci.h>
 #include <linux/delay.h>
@@ -190,6 +203,10 @@
 static LIST_HEAD(HFClist);
 static spinlock_t HFClock; /* global hfc list lock */
 
+/* with irqpoll, this timer services all cards instead of their irqs */
+static struct hrtimer hfc_poll_timer;
+static ktime_t hfc_poll_period;
+
 static void ph_state_change(struct dchannel *);
 
 static struct hfc_multi *syncmaster;
@@ -228,6 +245,7 @@ static uint	iomode[MAX_CARDS];
 static uint	port[MAX_PORTS];
 static uint	debug;
 static uint	poll;
+static uint	irqpoll;
 static int	clock;
 static uint	timer;
 static uint	clockdelay_te = CLKDEL_TE;
@@ -240,11 +258,21 @@ static uint	hwid = HWID_NONE;
 
 static int	HFC_cnt, E1_cnt, bmask_cnt, Port_cnt, PCM_cnt = 99;
 
+/* probes run concurrently (async pci probing); the mutex serializes
+ * card numbering and registration, and the full bring-up of PLXSD
+ * cards, whose PCM master election spans init_card(). The spinlock
+ * covers PCM bus id assignment, which happens under the card lock
+ * deep in init_chip() where the mutex cannot be taken.
+ */
+static DEFINE_MUTEX(HFC_probe_lock);
+static DEFINE_SPINLOCK(PCM_cnt_lock);
+
 MODULE_AUTHOR("Andreas Eversberg");
 MODULE_LICENSE("GPL");
 MODULE_VERSION(HFC_MULTI_VERSION);
 module_param(debug, uint, S_IRUGO | S_IWUSR);
 module_param(poll, uint, S_IRUGO | S_IWUSR);
+module_param(irqpoll, uint, S_IRUGO);
 module_param(clock, int, S_IRUGO | S_IWUSR);
 module_param(timer, uint, S_IRUGO | S_IWUSR);
 module_param(clockdelay_te, uint, S_IRUGO | S_IWUSR);
@@ -463,48 +491,44 @@ HFC_wait_debug(struct hfc_multi *hc, const char *function, int line)
 }
 #endif
 
-/* write fifo data (REGIO) */
+/* write fifo data (REGIO)
+ * string io moves the whole block with one instruction, so the bus can
+ * burst and the cpu does not pay the io port cost per word
+ */
 static void
 write_fifo_regio(struct hfc_multi *hc, u_char *data, int len)
 {
 	outb(A_FIFO_DATA0, (hc->pci_iobase) + 4);
-	while (len >> 2) {
-		outl(cpu_to_le32(*(u32 *)data), hc->pci_iobase);
-		data += 4;
-		len -= 4;
+	if (len >> 2) {
+		outsl(hc->pci_iobase, data, len >> 2);
+		data += len & ~3;
+		len &= 3;
 	}
-	while (len >> 1) {
+	if (len >> 1) {
 		outw(cpu_to_le16(*(u16 *)data), hc->pci_iobase);
 		data += 2;
 		len -= 2;
 	}
-	while (len) {
+	if (len)
 		outb(*data, hc->pci_iobase);
-		data++;
-		len--;
-	}
 }
 /* write fifo data (PCIMEM) */
 static void
 write_fifo_pcimem(struct hfc_multi *hc, u_char *data, int len)
 {
-	while (len >> 2) {
-		writel(cpu_to_le32(*(u32 *)data),
-		       hc->pci_membase + A_FIFO_DATA0);
-		data += 4;
-		len -= 4;
+	if (len >> 2) {
+		iowrite32_rep(hc->pci_membase + A_FIFO_DATA0, data, len >> 2);
+		data += len & ~3;
+		len &= 3;
 	}
-	while (len >> 1) {
+	if (len >> 1) {
 		writew(cpu_to_le16(*(u16 *)data),
 		       hc->pci_membase + A_FIFO_DATA0);
 		data += 2;
 		len -= 2;
 	}
-	while (len) {
+	if (len)
 		writeb(*data, hc->pci_membase + A_FIFO_DATA0);
-		data++;
-		len--;
-	}
 }
 
 /* read fifo data (REGIO) */
@@ -512,44 +536,37 @@ static void
 read_fifo_regio(struct hfc_multi *hc, u_char *data, int len)
 {
 	outb(A_FIFO_DATA0, (hc->pci_iobase) + 4);
-	while (len >> 2) {
-		*(u32 *)data = le32_to_cpu(inl(hc->pci_iobase));
-		data += 4;
-		len -= 4;
+	if (len >> 2) {
+		insl(hc->pci_iobase, data, len >> 2);
+		data += len & ~3;
+		len &= 3;
 	}
-	while (len >> 1) {
+	if (len >> 1) {
 		*(u16 *)data = le16_to_cpu(inw(hc->pci_iobase));
 		data += 2;
 		len -= 2;
 	}
-	while (len) {
+	if (len)
 		*data = inb(hc->pci_iobase);
-		data++;
-		len--;
-	}
 }
 
 /* read fifo data (PCIMEM) */
 static void
 read_fifo_pcimem(struct hfc_multi *hc, u_char *data, int len)
 {
-	while (len >> 2) {
-		*(u32 *)data =
-			le32_to_cpu(readl(hc->pci_membase + A_FIFO_DATA0));
-		data += 4;
-		len -= 4;
+	if (len >> 2) {
+		ioread32_rep(hc->pci_membase + A_FIFO_DATA0, data, len >> 2);
+		data += len & ~3;
+		len &= 3;
 	}
-	while (len >> 1) {
+	if (len >> 1) {
 		*(u16 *)data =
 			le16_to_cpu(readw(hc->pci_membase + A_FIFO_DATA0));
 		data += 2;
 		len -= 2;
 	}
-	while (len) {
+	if (len)
 		*data = readb(hc->pci_membase + A_FIFO_DATA0);
-		data++;
-		len--;
-	}
 }
 
 static void
@@ -1203,7 +1220,7 @@ init_chip(struct hfc_multi *hc)
 		hc->Zlen = 64;
 		hc->DTMFbase = 0x0;
 	}
-	hc->max_trans = poll << 1;
+	hc->max_trans = hc->poll << 1;
 	if (hc->max_trans > hc->Zlen)
 		hc->max_trans = hc->Zlen;
 
@@ -1480,17 +1497,20 @@ init_chip(struct hfc_multi *hc)
 		printk(KERN_INFO "controller has given PCM BUS ID %d\n",
 		       hc->pcm);
 	else {
+		spin_lock(&PCM_cnt_lock); /* irqs already off (hc->lock) */
 		if (test_bit(HFC_CHIP_PCM_MASTER, &hc->chip)
 		    || test_bit(HFC_CHIP_PLXSD, &hc->chip)) {
 			PCM_cnt++; /* SD has proprietary bridging */
 		}
 		hc->pcm = PCM_cnt;
+		spin_unlock(&PCM_cnt_lock);
 		printk(KERN_INFO "controller has PCM BUS ID %d "
 		       "(auto selected)\n", hc->pcm);
 	}
 
 	/* set up timer */
-	HFC_outb(hc, R_TI_WD, poll_timer);
+	hc->hw.r_ti_wd = hc->poll_timer;
+	HFC_outb(hc, R_TI_WD, hc->hw.r_ti_wd);
 	hc->hw.r_irqmsk_misc |= V_TI_IRQMSK;
 
 	/* set E1 state machine IRQ */
@@ -1652,9 +1672,9 @@ hfcmulti_leds(struct hfc_multi *hc)
 				led[2] = 1;
 				led[3] = 1;
 				if (!hc->flash[2] && hc->activity_tx)
-					hc->flash[2] = poll;
+					hc->flash[2] = hc->poll;
 				if (!hc->flash[3] && hc->activity_rx)
-					hc->flash[3] = poll;
+					hc->flash[3] = hc->poll;
 				if (hc->flash[2] && hc->flash[2] < 1024)
 					led[2] = 0;
 				if (hc->flash[3] && hc->flash[3] < 1024)
@@ -1664,9 +1684,9 @@ hfcmulti_leds(struct hfc_multi *hc)
 				if (hc->flash[3] >= 2048)
 					hc->flash[3] = 0;
 				if (hc->flash[2])
-					hc->flash[2] += poll;
+					hc->flash[2] += hc->poll;
 				if (hc->flash[3])
-					hc->flash[3] += poll;
+					hc->flash[3] += hc->poll;
 			}
 		}
 		leds = (led[0] | (led[1]<<2) | (led[2]<<1) | (led[3]<<3))^0xF;
@@ -1699,13 +1719,13 @@ hfcmulti_leds(struct hfc_multi *hc)
 					hc->activity_tx |= hc->activity_rx;
 					if (!hc->flash[i] &&
 						(hc->activity_tx & (1 << i)))
-							hc->flash[i] = poll;
+							hc->flash[i] = hc->poll;
 					if (hc->flash[i] && hc->flash[i] < 1024)
 						led[i] = 0; /* led off */
 					if (hc->flash[i] >= 2048)
 						hc->flash[i] = 0;
 					if (hc->flash[i])
-						hc->flash[i] += poll;
+						hc->flash[i] += hc->poll;
 				} else {
 					led[i] = 2; /* led red */
 					hc->flash[i] = 0;
@@ -1763,13 +1783,13 @@ hfcmulti_leds(struct hfc_multi *hc)
 					hc->activity_tx |= hc->activity_rx;
 					if (!hc->flash[i] &&
 						(hc->activity_tx & (1 << i)))
-							hc->flash[i] = poll;
+							hc->flash[i] = hc->poll;
 					if (hc->flash[i] < 1024)
 						led[i] = 0; /* led off */
 					if (hc->flash[i] >= 2048)
 						hc->flash[i] = 0;
 					if (hc->flash[i])
-						hc->flash[i] += poll;
+						hc->flash[i] += hc->poll;
 				} else {
 					led[i] = 2; /* led red */
 					hc->flash[i] = 0;
@@ -1810,13 +1830,13 @@ hfcmulti_leds(struct hfc_multi *hc)
 					hc->activity_tx |= hc->activity_rx;
 					if (!hc->flash[i] &&
 						(hc->activity_tx & (1 << i)))
-							hc->flash[i] = poll;
+							hc->flash[i] = hc->poll;
 					if (hc->flash[i] < 1024)
 						lled |= 1 << i; /* led off */
 					if (hc->flash[i] >= 2048)
 						hc->flash[i] = 0;
 					if (hc->flash[i])
-						hc->flash[i] += poll;
+						hc->flash[i] += hc->poll;
 				} else
 					hc->flash[i] = 0;
 			}
@@ -1944,6 +1964,67 @@ hfcmulti_dtmf(struct hfc_multi *hc)
 }
 
 
+/*
+ * switch the transmit source of an audio channel between its PCM
+ * slot (fifo idle) and the fifo (tx data or tone loop pending);
+ * expects the fifo of the channel to be selected
+ */
+static void
+hfcmulti_tx_source(struct hfc_multi *hc, int ch, int fifo)
+{
+	u_char	flow = fifo ? 0x80 : 0xc0;
+
+	if (hc->ctype == HFC_TYPE_XHFC)
+		HFC_outb(hc, A_CON_HDLC, flow
+			 | 0x07 << 2 | V_HDLC_TRP | V_IFF);
+	/* Enable FIFO, no interrupt */
+	else
+		HFC_outb(hc, A_CON_HDLC, flow | 0x00 |
+			 V_HDLC_TRP | V_IFF);
+	HFC_outb_nodebug(hc, R_FIFO, ch << 1 | 1);
+	HFC_wait_nodebug(hc);
+	if (hc->ctype == HFC_TYPE_XHFC)
+		HFC_outb(hc, A_CON_HDLC, flow
+			 | 0x07 << 2 | V_HDLC_TRP | V_IFF);
+	/* Enable FIFO, no interrupt */
+	else
+		HFC_outb(hc, A_CON_HDLC, flow | 0x00 |
+			 V_HDLC_TRP | V_IFF);
+	HFC_outb_nodebug(hc, R_FIFO, ch << 1);
+	HFC_wait_nodebug(hc);
+}
+
+/*
+ * set or clear the tone sample loop of a channel (HFC_SPL_LOOP_ON /
+ * HFC_SPL_LOOP_OFF). While a loop is set, hfcmulti_tx() feeds the
+ * fifo from the pattern whenever no real tx data is pending, so
+ * call progress tones cost nothing in the dsp sample tick. Called
+ * with hc->lock held.
+ */
+static int
+hfcmulti_spl_loop(struct hfc_multi *hc, int ch, u_char *data, int len)
+{
+	u_char	*old = hc->chan[ch].tone_data;
+
+	hc->chan[ch].tone_data = NULL;
+	hc->chan[ch].tone_len = 0;
+	hc->chan[ch].tone_idx = 0;
+	if (old) {
+		/* let the drained fifo repeat silence, not a tone sample */
+		HFC_outb_nodebug(hc, R_FIFO, ch << 1);
+		HFC_wait_nodebug(hc);
+		HFC_outb_nodebug(hc, A_FIFO_DATA0_NOINC, hc->silence);
+		kfree(old);
+	}
+	if (!len)
+		return 0;
+	hc->chan[ch].tone_data = kmemdup(data, len, GFP_ATOMIC);
+	if (!hc->chan[ch].tone_data)
+		return -ENOMEM;
+	hc->chan[ch].tone_len = len;
+	return 0;
+}
+
 /*
  * fill fifo as much as possible
  */
@@ -1982,7 +2063,7 @@ hfcmulti_tx(struct hfc_multi *hc, int ch)
 	if (*sp)
 		len = (*sp)->len;
 
-	if ((!len) && *txpending != 1)
+	if ((!len) && *txpending != 1 && !hc->chan[ch].tone_len)
 		return; /* no data */
 
 	if (test_bit(HFC_CHIP_B410P, &hc->chip) &&
@@ -2057,6 +2138,41 @@ next_frame:
 	if (Zspace <= 0) /* no space of 4 bytes */
 		return;
 
+	/* tone sample loop: when no real tx data is pending, feed the
+	 * fifo from the pattern. Topping it up to two poll intervals
+	 * happens in the tick we spend on this fifo anyway; the dsp
+	 * layer only runs its cadence timer.
+	 */
+	if (!len && bch && hc->chan[ch].tone_len &&
+	    !test_bit(FLG_HDLC, &bch->Flags)) {
+		if (!*txpending && slot_tx >= 0) {
+			/* the fifo feeds the line now, not the PCM slot */
+			if (debug & DEBUG_HFCMULTI_MODE)
+				printk(KERN_DEBUG
+				       "%s: disconnecting PCM due to tone "
+				       "loop: channel %d slot_tx %d\n",
+				       __func__, ch, slot_tx);
+			hfcmulti_tx_source(hc, ch, 1);
+		}
+		*txpending = 1;
+		temp = (hc->poll << 1) - hc->chan[ch].Zfill;
+		if (temp > Zspace)
+			temp = Zspace;
+		while (temp > 0) {
+			ii = hc->chan[ch].tone_len - hc->chan[ch].tone_idx;
+			if (ii > temp)
+				ii = temp;
+			hc->write_fifo(hc, hc->chan[ch].tone_data +
+				       hc->chan[ch].tone_idx, ii);
+			hc->chan[ch].tone_idx += ii;
+			if (hc->chan[ch].tone_idx >= hc->chan[ch].tone_len)
+				hc->chan[ch].tone_idx = 0;
+			hc->chan[ch].Zfill += ii;
+			temp -= ii;
+		}
+		return;
+	}
+
 	/* if no data */
 	if (!len) {
 		if (z1 == z2) { /* empty */
@@ -2070,24 +2186,7 @@ next_frame:
 					       "slot_tx %d\n",
 					       __func__, ch, slot_tx);
 				/* connect slot */
-				if (hc->ctype == HFC_TYPE_XHFC)
-					HFC_outb(hc, A_CON_HDLC, 0xc0
-						 | 0x07 << 2 | V_HDLC_TRP | V_IFF);
-				/* Enable FIFO, no interrupt */
-				else
-					HFC_outb(hc, A_CON_HDLC, 0xc0 | 0x00 |
-						 V_HDLC_TRP | V_IFF);
-				HFC_outb_nodebug(hc, R_FIFO, ch << 1 | 1);
-				HFC_wait_nodebug(hc);
-				if (hc->ctype == HFC_TYPE_XHFC)
-					HFC_outb(hc, A_CON_HDLC, 0xc0
-						 | 0x07 << 2 | V_HDLC_TRP | V_IFF);
-				/* Enable FIFO, no interrupt */
-				else
-					HFC_outb(hc, A_CON_HDLC, 0xc0 | 0x00 |
-						 V_HDLC_TRP | V_IFF);
-				HFC_outb_nodebug(hc, R_FIFO, ch << 1);
-				HFC_wait_nodebug(hc);
+				hfcmulti_tx_source(hc, ch, 0);
 			}
 			*txpending = 0;
 		}
@@ -2101,8 +2200,8 @@ next_frame:
 			printk(KERN_DEBUG "%s: buffer empty, so we have "
 			       "underrun\n", __func__);
 		/* fill buffer, to prevent future underrun */
-		hc->write_fifo(hc, hc->silence_data, poll >> 1);
-		Zspace -= (poll >> 1);
+		hc->write_fifo(hc, hc->silence_data, hc->poll >> 1);
+		Zspace -= (hc->poll >> 1);
 	}
 
 	/* if audio data and connected slot */
@@ -2113,24 +2212,7 @@ next_frame:
 			       "FIFO data: channel %d slot_tx %d\n",
 			       __func__, ch, slot_tx);
 		/* disconnect slot */
-		if (hc->ctype == HFC_TYPE_XHFC)
-			HFC_outb(hc, A_CON_HDLC, 0x80
-				 | 0x07 << 2 | V_HDLC_TRP | V_IFF);
-		/* Enable FIFO, no interrupt */
-		else
-			HFC_outb(hc, A_CON_HDLC, 0x80 | 0x00 |
-				 V_HDLC_TRP | V_IFF);
-		HFC_outb_nodebug(hc, R_FIFO, ch << 1 | 1);
-		HFC_wait_nodebug(hc);
-		if (hc->ctype == HFC_TYPE_XHFC)
-			HFC_outb(hc, A_CON_HDLC, 0x80
-				 | 0x07 << 2 | V_HDLC_TRP | V_IFF);
-		/* Enable FIFO, no interrupt */
-		else
-			HFC_outb(hc, A_CON_HDLC, 0x80 | 0x00 |
-				 V_HDLC_TRP | V_IFF);
-		HFC_outb_nodebug(hc, R_FIFO, ch << 1);
-		HFC_wait_nodebug(hc);
+		hfcmulti_tx_source(hc, ch, 1);
 	}
 	*txpending = 1;
 
@@ -2232,7 +2314,7 @@ next_frame:
 	/* ignore if rx is off BUT change fifo (above) to start pending TX */
 	if (hc->chan[ch].rx_off) {
 		if (bch)
-			bch->dropcnt += poll; /* not exact but fair enough */
+			bch->dropcnt += hc->poll; /* not exact but fair enough */
 		return;
 	}
 
@@ -2440,7 +2522,9 @@ handle_timer_irq(struct hfc_multi *hc)
 	}
 
 	if (hc->ctype != HFC_TYPE_E1 || hc->e1_state == 1)
-		for (ch = 0; ch <= 31; ch++) {
+		/* only slots with an attached channel have work; unused
+		 * slots of a mostly idle span are never looked at */
+		for_each_set_bit(ch, &hc->ch_map, 32) {
 			if (hc->created[hc->chan[ch].port]) {
 				hfcmulti_tx(hc, ch);
 				/* fifo is started when switching to rx-fifo */
@@ -2646,94 +2730,65 @@ ph_state_irq(struct hfc_multi *hc, u_char r_irq_statech)
 }
 
 static void
-fifo_irq(struct hfc_multi *hc, int block)
+fifo_irq(struct hfc_multi *hc, u_char r_irq_oview)
 {
-	int	ch, j;
+	int	ch, bit;
 	struct dchannel	*dch;
 	struct bchannel	*bch;
-	u_char r_irq_fifo_bl;
-
-	r_irq_fifo_bl = HFC_inb_nodebug(hc, R_IRQ_FIFO_BL0 + block);
-	j = 0;
-	while (j < 8) {
-		ch = (block << 2) + (j >> 1);
+	u_long	pend[BITS_TO_LONGS(64)] = { 0 };
+
+	/* collect the eight block registers into one bitmap; even bits
+	 * are tx fifos, odd bits the rx fifo of the same channel.  The
+	 * walk below then touches only fifos that really raised an irq
+	 * instead of scanning all configured slots */
+	for (bit = 0; bit < 8; bit++)
+		if (r_irq_oview & (1 << bit))
+			pend[(bit << 3) / BITS_PER_LONG] |=
+				(u_long)HFC_inb_nodebug(hc,
+					R_IRQ_FIFO_BL0 + bit)
+				<< ((bit << 3) % BITS_PER_LONG);
+
+	for_each_set_bit(bit, pend, 64) {
+		ch = bit >> 1;
 		dch = hc->chan[ch].dch;
 		bch = hc->chan[ch].bch;
-		if (((!dch) && (!bch)) || (!hc->created[hc->chan[ch].port])) {
-			j += 2;
+		if ((!dch && !bch) || !hc->created[hc->chan[ch].port])
 			continue;
+		if ((dch && test_bit(FLG_ACTIVE, &dch->Flags)) ||
+		    (bch && test_bit(FLG_ACTIVE, &bch->Flags))) {
+			if (bit & 1)
+				hfcmulti_rx(hc, ch);
+			else {
+				hfcmulti_tx(hc, ch);
+				/* start fifo */
+				HFC_outb_nodebug(hc, R_FIFO, 0);
+				HFC_wait_nodebug(hc);
+			}
 		}
-		if (dch && (r_irq_fifo_bl & (1 << j)) &&
-		    test_bit(FLG_ACTIVE, &dch->Flags)) {
-			hfcmulti_tx(hc, ch);
-			/* start fifo */
-			HFC_outb_nodebug(hc, R_FIFO, 0);
-			HFC_wait_nodebug(hc);
-		}
-		if (bch && (r_irq_fifo_bl & (1 << j)) &&
-		    test_bit(FLG_ACTIVE, &bch->Flags)) {
-			hfcmulti_tx(hc, ch);
-			/* start fifo */
-			HFC_outb_nodebug(hc, R_FIFO, 0);
-			HFC_wait_nodebug(hc);
-		}
-		j++;
-		if (dch && (r_irq_fifo_bl & (1 << j)) &&
-		    test_bit(FLG_ACTIVE, &dch->Flags)) {
-			hfcmulti_rx(hc, ch);
-		}
-		if (bch && (r_irq_fifo_bl & (1 << j)) &&
-		    test_bit(FLG_ACTIVE, &bch->Flags)) {
-			hfcmulti_rx(hc, ch);
-		}
-		j++;
 	}
 }
 
 #ifdef IRQ_DEBUG
 int irqsem;
 #endif
+
+/*
+ * service all pending events of a card; called with hc->lock held,
+ * either from the interrupt handler or from the irqpoll timer. The
+ * event status registers latch even while the interrupt output is
+ * masked, so the same code serves both modes.
+ */
 static irqreturn_t
-hfcmulti_interrupt(int intno, void *dev_id)
+hfcmulti_service(struct hfc_multi *hc)
 {
 #ifdef IRQCOUNT_DEBUG
 	static int iq1 = 0, iq2 = 0, iq3 = 0, iq4 = 0,
 		iq5 = 0, iq6 = 0, iqcnt = 0;
 #endif
-	struct hfc_multi	*hc = dev_id;
 	struct dchannel		*dch;
 	u_char			r_irq_statech, status, r_irq_misc, r_irq_oview;
 	int			i;
-	void __iomem		*plx_acc;
-	u_short			wval;
 	u_char			e1_syncsta, temp, temp2;
-	u_long			flags;
-
-	if (!hc) {
-		printk(KERN_ERR "HFC-multi: Spurious interrupt!\n");
-		return IRQ_NONE;
-	}
-
-	spin_lock(&hc->lock);
-
-#ifdef IRQ_DEBUG
-	if (irqsem)
-		printk(KERN_ERR "irq for card %d during irq from "
-		       "card %d, this is no bug.\n", hc->id + 1, irqsem);
-	irqsem = hc->id + 1;
-#endif
-#ifdef CONFIG_MISDN_HFCMULTI_8xx
-	if (hc->immap->im_cpm.cp_pbdat & hc->pb_irqmsk)
-		goto irq_notforus;
-#endif
-	if (test_bit(HFC_CHIP_PLXSD, &hc->chip)) {
-		spin_lock_irqsave(&plx_lock, flags);
-		plx_acc = hc->plx_membase + PLX_INTCSR;
-		wval = readw(plx_acc);
-		spin_unlock_irqrestore(&plx_lock, flags);
-		if (!(wval & PLX_INTCSR_LINTI1_STATUS))
-			goto irq_notforus;
-	}
 
 	status = HFC_inb_nodebug(hc, R_STATUS);
 	r_irq_statech = HFC_inb_nodebug(hc, R_IRQ_STATECH);
@@ -2760,8 +2815,8 @@ hfcmulti_interrupt(int intno, void *dev_id)
 	if (!r_irq_statech &&
 	    !(status & (V_DTMF_STA | V_LOST_STA | V_EXT_IRQSTA |
 			V_MISC_IRQSTA | V_FR_IRQSTA))) {
-		/* irq is not for us */
-		goto irq_notforus;
+		/* nothing pending */
+		return IRQ_NONE;
 	}
 	hc->irqcnt++;
 	if (r_irq_statech) {
@@ -2817,7 +2872,7 @@ hfcmulti_interrupt(int intno, void *dev_id)
 		}
 		if (r_irq_misc & V_TI_IRQ) {
 			if (hc->iclock_on)
-				mISDN_clock_update(hc->iclock, poll, NULL);
+				mISDN_clock_update(hc->iclock, hc->poll, NULL);
 			handle_timer_irq(hc);
 		}
 
@@ -2835,17 +2890,54 @@ hfcmulti_interrupt(int intno, void *dev_id)
 	if (status & V_FR_IRQSTA) {
 		/* FIFO IRQ */
 		r_irq_oview = HFC_inb_nodebug(hc, R_IRQ_OVIEW);
-		for (i = 0; i < 8; i++) {
-			if (r_irq_oview & (1 << i))
-				fifo_irq(hc, i);
-		}
+		if (r_irq_oview)
+			fifo_irq(hc, r_irq_oview);
 	}
+	return IRQ_HANDLED;
+}
+
+static irqreturn_t
+hfcmulti_interrupt(int intno, void *dev_id)
+{
+	struct hfc_multi	*hc = dev_id;
+	irqreturn_t		ret;
+	void __iomem		*plx_acc;
+	u_short			wval;
+	u_long			flags;
+
+	if (!hc) {
+		printk(KERN_ERR "HFC-multi: Spurious interrupt!\n");
+		return IRQ_NONE;
+	}
+
+	spin_lock(&hc->lock);
+
+#ifdef IRQ_DEBUG
+	if (irqsem)
+		printk(KERN_ERR "irq for card %d during irq from "
+		       "card %d, this is no bug.\n", hc->id + 1, irqsem);
+	irqsem = hc->id + 1;
+#endif
+#ifdef CONFIG_MISDN_HFCMULTI_8xx
+	if (hc->immap->im_cpm.cp_pbdat & hc->pb_irqmsk)
+		goto irq_notforus;
+#endif
+	if (test_bit(HFC_CHIP_PLXSD, &hc->chip)) {
+		spin_lock_irqsave(&plx_lock, flags);
+		plx_acc = hc->plx_membase + PLX_INTCSR;
+		wval = readw(plx_acc);
+		spin_unlock_irqrestore(&plx_lock, flags);
+		if (!(wval & PLX_INTCSR_LINTI1_STATUS))
+			goto irq_notforus;
+	}
+
+	ret = hfcmulti_service(hc);
 
 #ifdef IRQ_DEBUG
 	irqsem = 0;
 #endif
 	spin_unlock(&hc->lock);
-	return IRQ_HANDLED;
+	return ret;
 
 irq_notforus:
 #ifdef IRQ_DEBUG
@@ -2855,6 +2947,27 @@ irq_notforus:
 	return IRQ_NONE;
 }
 
+/*
+ * with irqpoll, all cards are serviced from this timer in one pass.
+ * HFClist may only change while the timer is stopped, so it is walked
+ * without HFClock here; taking HFClock inside hc->lock would invert
+ * the order used by plxsd_checksync().
+ */
+static enum hrtimer_restart
+hfcmulti_poll(struct hrtimer *t)
+{
+	struct hfc_multi *hc;
+
+	list_for_each_entry(hc, &HFClist, list) {
+		spin_lock(&hc->lock);
+		hfcmulti_service(hc);
+		spin_unlock(&hc->lock);
+	}
+
+	hrtimer_forward_now(t, hfc_poll_period);
+	return HRTIMER_RESTART;
+}
+
 
 /*
  * timer callback for D-chan busy resolution. Currently no function
@@ -3466,6 +3579,7 @@ deactivate_bchannel(struct bchannel *bch)
 	hc->chan[bch->slot].coeff_count = 0;
 	hc->chan[bch->slot].rx_off = 0;
 	hc->chan[bch->slot].conf = -1;
+	hfcmulti_spl_loop(hc, bch->slot, NULL, 0);
 	mode_hfcmulti(hc, bch->slot, ISDN_P_NONE, -1, 0, -1, 0);
 	spin_unlock_irqrestore(&hc->lock, flags);
 }
@@ -3536,12 +3650,14 @@ handle_bmsg(struct mISDNchannel *ch, struct sk_buff *skb)
 				printk(KERN_DEBUG
 				       "%s: HFC_SPL_LOOP_ON (len = %d)\n",
 				       __func__, skb->len);
-			ret = 0;
+			ret = hfcmulti_spl_loop(hc, bch->slot, skb->data,
+						skb->len);
 			break;
 		case HFC_SPL_LOOP_OFF: /* set silence */
 			if (debug & DEBUG_HFCMULTI_MSG)
 				printk(KERN_DEBUG "%s: HFC_SPL_LOOP_OFF\n",
 				       __func__);
+			hfcmulti_spl_loop(hc, bch->slot, NULL, 0);
 			ret = 0;
 			break;
 		default:
@@ -3614,7 +3730,7 @@ channel_bctrl(struct bchannel *bch, struct mISDN_ctrl_req *cq)
 			features->hfc_dtmf = 1;
 		if (test_bit(HFC_CHIP_CONF, &hc->chip))
 			features->hfc_conf = 1;
-		features->hfc_loops = 0;
+		features->hfc_loops = 1;
 		if (test_bit(HFC_CHIP_B410P, &hc->chip)) {
 			features->hfc_echocanhw = 1;
 		} else {
@@ -3690,6 +3806,28 @@ channel_bctrl(struct bchannel *bch, struct mISDN_ctrl_req *cq)
 		else
 			ret = -EINVAL;
 		break;
+	case MISDN_CTRL_HFC_ECHOCAN_MASK_ON:
+	case MISDN_CTRL_HFC_ECHOCAN_MASK_OFF:
+		/* configure all masked channels of this card in one pass,
+		 * instead of one control round-trip per channel */
+		if (debug & DEBUG_HFCMULTI_MSG)
+			printk(KERN_DEBUG "%s: HFC_ECHOCAN_MASK_%s "
+			       "mask 0x%x\n", __func__,
+			       (cq->op == MISDN_CTRL_HFC_ECHOCAN_MASK_ON) ?
+			       "ON" : "OFF", cq->p2);
+		if (!test_bit(HFC_CHIP_B410P, &hc->chip)) {
+			ret = -EINVAL;
+			break;
+		}
+		for (num = 0; num < 32; num++) {
+			if (!(cq->p2 & (1 << num)))
+				continue;
+			if (cq->op == MISDN_CTRL_HFC_ECHOCAN_MASK_ON)
+				vpm_echocan_on(hc, num, cq->p1);
+			else
+				vpm_echocan_off(hc, num);
+		}
+		break;
 	default:
 		ret = mISDN_ctrl_bchannel(bch, cq);
 		break;
@@ -4136,8 +4274,10 @@ static int
 channel_dctrl(struct dchannel *dch, struct mISDN_ctrl_req *cq)
 {
 	struct hfc_multi	*hc = dch->hw;
+	struct bchannel	*bch;
 	int	ret = 0;
 	int	wd_mode, wd_cnt;
+	int	ch, pt, done;
 
 	switch (cq->op) {
 	case MISDN_CTRL_GETOP:
@@ -4151,7 +4291,8 @@ channel_dctrl(struct dchannel *dch, struct mISDN_ctrl_req *cq)
 			       ", counter 0x%x\n", __func__,
 			       wd_mode ? "AUTO" : "MANUAL", wd_cnt);
 		/* set the watchdog timer */
-		HFC_outb(hc, R_TI_WD, poll_timer | (wd_cnt << 4));
+		hc->hw.r_ti_wd = hc->poll_timer | (wd_cnt << 4);
+		HFC_outb(hc, R_TI_WD, hc->hw.r_ti_wd);
 		hc->hw.r_bert_wd_md = (wd_mode ? V_AUTO_WD_RES : 0);
 		if (hc->ctype == HFC_TYPE_XHFC)
 			hc->hw.r_bert_wd_md |= 0x40 /* V_WD_EN */;
@@ -4174,6 +4315,71 @@ channel_dctrl(struct dchannel *dch, struct mISDN_ctrl_req *cq)
 	case MISDN_CTRL_L1_TIMER3:
 		ret = l1_event(dch->l1, HW_TIMER3_VALUE | (cq->p1 & 0xff));
 		break;
+	case MISDN_CTRL_HFC_SPAN_ACT:
+	case MISDN_CTRL_HFC_SPAN_DEACT:
+		/* switch all masked open B-channels of this port while
+		 * holding the lock once, instead of a stack round-trip
+		 * and mode setting pass per channel
+		 */
+		if (debug & DEBUG_HFCMULTI_MSG)
+			printk(KERN_DEBUG "%s: MISDN_CTRL_HFC_SPAN_%s "
+			       "mask 0x%x\n", __func__,
+			       (cq->op == MISDN_CTRL_HFC_SPAN_ACT) ?
+			       "ACT" : "DEACT", cq->p1);
+		pt = hc->chan[dch->slot].port;
+		done = 0;
+		for (ch = 0; ch <= 31; ch++) {
+			if (!(cq->p1 & (1 << ch)))
+				continue;
+			bch = hc->chan[ch].bch;
+			if (!bch || hc->chan[ch].port != pt)
+				continue;
+			if (cq->op == MISDN_CTRL_HFC_SPAN_ACT) {
+				if (bch->ch.protocol == ISDN_P_NONE)
+					continue; /* nobody opened it */
+				if (test_and_set_bit(FLG_ACTIVE,
+						     &bch->Flags))
+					continue;
+				hc->chan[ch].txpending = 0;
+				if (mode_hfcmulti(hc, ch, bch->ch.protocol,
+						  hc->chan[ch].slot_tx,
+						  hc->chan[ch].bank_tx,
+						  hc->chan[ch].slot_rx,
+						  hc->chan[ch].bank_rx)) {
+					clear_bit(FLG_ACTIVE, &bch->Flags);
+					continue;
+				}
+				if (bch->ch.protocol == ISDN_P_B_RAW &&
+				    !hc->dtmf &&
+				    test_bit(HFC_CHIP_DTMF, &hc->chip)) {
+					/* start decoder */
+					hc->dtmf = 1;
+					HFC_outb(hc, R_DTMF, hc->hw.r_dtmf |
+						 V_RST_DTMF);
+				}
+				_queue_data(&bch->ch, PH_ACTIVATE_IND,
+					    MISDN_ID_ANY, 0, NULL,
+					    GFP_ATOMIC);
+			} else {
+				if (!test_bit(FLG_ACTIVE, &bch->Flags))
+					continue;
+				/* as deactivate_bchannel(), lock held */
+				mISDN_clear_bchannel(bch);
+				hc->chan[ch].coeff_count = 0;
+				hc->chan[ch].rx_off = 0;
+				hc->chan[ch].conf = -1;
+				hfcmulti_spl_loop(hc, ch, NULL, 0);
+				mode_hfcmulti(hc, ch, ISDN_P_NONE,
+					      -1, 0, -1, 0);
+				_queue_data(&bch->ch, PH_DEACTIVATE_IND,
+					    MISDN_ID_ANY, 0, NULL,
+					    GFP_ATOMIC);
+			}
+			done |= 1 << ch;
+		}
+		/* one completion for the whole span */
+		cq->p2 = done;
+		break;
 	default:
 		printk(KERN_WARNING "%s: unknown Op %x\n",
 		       __func__, cq->op);
@@ -4277,7 +4483,10 @@ init_card(struct hfc_multi *hc)
 	disable_hwirq(hc);
 	spin_unlock_irqrestore(&hc->lock, flags);
 
-	if (request_irq(hc->irq, hfcmulti_interrupt, IRQF_SHARED,
+	if (irqpoll) {
+		/* no interrupt is wired, the poll timer services the card */
+		hc->irq = 0;
+	} else if (request_irq(hc->irq, hfcmulti_interrupt, IRQF_SHARED,
 			"HFC-multi", hc)) {
 		printk(KERN_WARNING "mISDN: Could not get interrupt %d.\n",
 		       hc->irq);
@@ -4299,6 +4508,12 @@ init_card(struct hfc_multi *hc)
 	err = init_chip(hc);
 	if (err)
 		goto error;
+	if (irqpoll) {
+		/* skip the interrupt test, the output stays masked */
+		if (debug & DEBUG_HFCMULTI_INIT)
+			printk(KERN_DEBUG "%s: done (polled)\n", __func__);
+		return 0;
+	}
 	/*
 	 * Finally enable IRQ output
 	 * this is only allowed, if an IRQ routine is already
@@ -4556,6 +4771,8 @@ release_port(struct hfc_multi *hc, struct dchannel *dch)
 		l1_event(dch->l1, CLOSE_CHANNEL);
 
 	hc->chan[ci].dch = NULL;
+	if (!hc->chan[ci].bch)
+		clear_bit(ci, &hc->ch_map);
 
 	if (hc->created[pt]) {
 		hc->created[pt] = 0;
@@ -4586,6 +4803,8 @@ release_port(struct hfc_multi *hc, struct dchannel *dch)
 					       __func__, hc->chan[i].port + 1, i);
 				pb = hc->chan[i].bch;
 				hc->chan[i].bch = NULL;
+				if (!hc->chan[i].dch)
+					clear_bit(i, &hc->ch_map);
 				spin_unlock_irqrestore(&hc->lock, flags);
 				mISDN_freebchannel(pb);
 				kfree(pb);
@@ -4609,6 +4828,8 @@ release_port(struct hfc_multi *hc, struct dchannel *dch)
 				       ci - 2);
 			pb = hc->chan[ci - 2].bch;
 			hc->chan[ci - 2].bch = NULL;
+			if (!hc->chan[ci - 2].dch)
+				clear_bit(ci - 2, &hc->ch_map);
 			spin_unlock_irqrestore(&hc->lock, flags);
 			mISDN_freebchannel(pb);
 			kfree(pb);
@@ -4623,6 +4844,8 @@ release_port(struct hfc_multi *hc, struct dchannel *dch)
 				       ci - 1);
 			pb = hc->chan[ci - 1].bch;
 			hc->chan[ci - 1].bch = NULL;
+			if (!hc->chan[ci - 1].dch)
+				clear_bit(ci - 1, &hc->ch_map);
 			spin_unlock_irqrestore(&hc->lock, flags);
 			mISDN_freebchannel(pb);
 			kfree(pb);
@@ -4653,6 +4876,10 @@ release_card(struct hfc_multi *hc)
 		printk(KERN_DEBUG "%s: release card (%d) entered\n",
 		       __func__, hc->id);
 
+	/* stop the poll timer, it walks the list we modify below */
+	if (irqpoll)
+		hrtimer_cancel(&hfc_poll_timer);
+
 	/* unregister clock source */
 	if (hc->iclock)
 		mISDN_unregister_clock(hc->iclock);
@@ -4697,6 +4924,9 @@ release_card(struct hfc_multi *hc)
 	if (hc == syncmaster)
 		syncmaster = NULL;
 	kfree(hc);
+	if (irqpoll && !list_empty(&HFClist))
+		hrtimer_start(&hfc_poll_timer, hfc_poll_period,
+			      HRTIMER_MODE_REL);
 	if (debug & DEBUG_HFCMULTI_INIT)
 		printk(KERN_DEBUG "%s: card successfully removed\n",
 		       __func__);
@@ -4833,6 +5063,7 @@ init_e1_port(struct hfc_multi *hc, struct hm_map *m, int pt)
 	dch->dev.D.ctrl = hfcm_dctrl;
 	dch->slot = hc->dnum[pt];
 	hc->chan[hc->dnum[pt]].dch = dch;
+	set_bit(hc->dnum[pt], &hc->ch_map);
 	hc->chan[hc->dnum[pt]].port = pt;
 	hc->chan[hc->dnum[pt]].nt_timer = -1;
 	for (ch = 1; ch <= 31; ch++) {
@@ -4856,13 +5087,14 @@ init_e1_port(struct hfc_multi *hc, struct hm_map *m, int pt)
 		bch->nr = ch;
 		bch->slot = ch;
 		bch->debug = debug;
-		mISDN_initbchannel(bch, MAX_DATA_MEM, poll >> 1);
+		mISDN_initbchannel(bch, MAX_DATA_MEM, hc->poll >> 1);
 		bch->hw = hc;
 		bch->ch.send = handle_bmsg;
 		bch->ch.ctrl = hfcm_bctrl;
 		bch->ch.nr = ch;
 		list_add(&bch->ch.list, &dch->dev.bchannels);
 		hc->chan[ch].bch = bch;
+		set_bit(ch, &hc->ch_map);
 		hc->chan[ch].port = pt;
 		set_channelmap(bch->nr, dch->dev.channelmap);
 		bcount++;
@@ -4908,6 +5140,7 @@ init_multi_port(struct hfc_multi *hc, int pt)
 	i = pt << 2;
 	dch->slot = i + 2;
 	hc->chan[i + 2].dch = dch;
+	set_bit(i + 2, &hc->ch_map);
 	hc->chan[i + 2].port = pt;
 	hc->chan[i + 2].nt_timer = -1;
 	for (ch = 0; ch < dch->dev.nrbchan; ch++) {
@@ -4929,13 +5162,14 @@ init_multi_port(struct hfc_multi *hc, int pt)
 		bch->nr = ch + 1;
 		bch->slot = i + ch;
 		bch->debug = debug;
-		mISDN_initbchannel(bch, MAX_DATA_MEM, poll >> 1);
+		mISDN_initbchannel(bch, MAX_DATA_MEM, hc->poll >> 1);
 		bch->hw = hc;
 		bch->ch.send = handle_bmsg;
 		bch->ch.ctrl = hfcm_bctrl;
 		bch->ch.nr = ch + 1;
 		list_add(&bch->ch.list, &dch->dev.bchannels);
 		hc->chan[i + ch].bch = bch;
+		set_bit(i + ch, &hc->ch_map);
 		hc->chan[i + ch].port = pt;
 		set_channelmap(bch->nr, dch->dev.channelmap);
 	}
@@ -5002,6 +5236,76 @@ free_chan:
 	return ret;
 }
 
+/*
+ * per-card poll interval, changeable at runtime via sysfs
+ */
+
+static ssize_t
+poll_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct hfc_multi *hc = dev_get_drvdata(dev);
+
+	if (!hc)
+		return -ENODEV;
+	return sprintf(buf, "%d\n", hc->poll);
+}
+
+static ssize_t
+poll_store(struct device *dev, struct device_attribute *attr,
+	   const char *buf, size_t count)
+{
+	struct hfc_multi *hc = dev_get_drvdata(dev);
+	u_long	flags;
+	u_int	val;
+	int	ti, i, err;
+
+	if (!hc)
+		return -ENODEV;
+	if (irqpoll)
+		return -EBUSY; /* one shared timer services all cards */
+	err = kstrtouint(buf, 0, &val);
+	if (err)
+		return err;
+	switch (val) {
+	case 8:
+		ti = 2;
+		break;
+	case 16:
+		ti = 3;
+		break;
+	case 32:
+		ti = 4;
+		break;
+	case 64:
+		ti = 5;
+		break;
+	case 128:
+		ti = 6;
+		break;
+	case 256:
+		ti = 7;
+		break;
+	default:
+		return -EINVAL;
+	}
+	/* the card lock quiesces the interrupt handler of this card only;
+	 * the new period takes effect on the next chip timer expiry
+	 */
+	spin_lock_irqsave(&hc->lock, flags);
+	hc->poll = val;
+	hc->poll_timer = ti;
+	hc->max_trans = val << 1;
+	if (hc->max_trans > hc->Zlen)
+		hc->max_trans = hc->Zlen;
+	for (i = 0; i < (val >> 1); i++)
+		hc->silence_data[i] = hc->silence;
+	hc->hw.r_ti_wd = (hc->hw.r_ti_wd & 0xf0) | hc->poll_timer;
+	HFC_outb(hc, R_TI_WD, hc->hw.r_ti_wd);
+	spin_unlock_irqrestore(&hc->lock, flags);
+	return count;
+}
+static DEVICE_ATTR_RW(poll);
+
 static int
 hfcmulti_init(struct hm_map *m, struct pci_dev *pdev,
 	      const struct pci_device_id *ent)
@@ -5014,9 +5318,11 @@ hfcmulti_init(struct hm_map *m, struct pci_dev *pdev,
 	int		i, ch;
 	u_int		maskcheck;
 
+	mutex_lock(&HFC_probe_lock);
 	if (HFC_cnt >= MAX_CARDS) {
 		printk(KERN_ERR "too many cards (max=%d).\n",
 		       MAX_CARDS);
+		mutex_unlock(&HFC_probe_lock);
 		return -EINVAL;
 	}
 	if ((type[HFC_cnt] & 0xff) && (type[HFC_cnt] & 0xff) != m->type) {
@@ -5026,6 +5332,7 @@ hfcmulti_init(struct hm_map *m, struct pci_dev *pdev,
 		       type[HFC_cnt] & 0xff);
 		printk(KERN_WARNING "HFC-MULTI: Load module without parameters "
 		       "first, to see cards and their types.");
+		mutex_unlock(&HFC_probe_lock);
 		return -EINVAL;
 	}
 	if (debug & DEBUG_HFCMULTI_INIT)
@@ -5037,6 +5344,7 @@ hfcmulti_init(struct hm_map *m, struct pci_dev *pdev,
 	hc = kzalloc(sizeof(struct hfc_multi), GFP_KERNEL);
 	if (!hc) {
 		printk(KERN_ERR "No kmem for HFC-Multi card\n");
+		mutex_unlock(&HFC_probe_lock);
 		return -ENOMEM;
 	}
 	spin_lock_init(&hc->lock);
@@ -5062,6 +5370,7 @@ hfcmulti_init(struct hm_map *m, struct pci_dev *pdev,
 				       "HFC-E1 #%d has overlapping B-channels on fragment #%d\n",
 				       E1_cnt + 1, pt);
 				kfree(hc);
+				mutex_unlock(&HFC_probe_lock);
 				return -EINVAL;
 			}
 			maskcheck |= hc->bmask[pt];
@@ -5086,13 +5395,19 @@ hfcmulti_init(struct hm_map *m, struct pci_dev *pdev,
 		hc->silence = 0xff; /* ulaw silence */
 	} else
 		hc->silence = 0x2a; /* alaw silence */
-	if ((poll >> 1) > sizeof(hc->silence_data)) {
+	/* cards start at the module default, but may be retuned per card
+	 * through the 'poll' sysfs attribute at runtime
+	 */
+	hc->poll = poll;
+	hc->poll_timer = poll_timer;
+	if ((hc->poll >> 1) > sizeof(hc->silence_data)) {
 		printk(KERN_ERR "HFCMULTI error: silence_data too small, "
 		       "please fix\n");
 		kfree(hc);
+		mutex_unlock(&HFC_probe_lock);
 		return -EINVAL;
 	}
-	for (i = 0; i < (poll >> 1); i++)
+	for (i = 0; i < (hc->poll >> 1); i++)
 		hc->silence_data[i] = hc->silence;
 
 	if (hc->ctype != HFC_TYPE_XHFC) {
@@ -5139,6 +5454,7 @@ hfcmulti_init(struct hm_map *m, struct pci_dev *pdev,
 		if (hc == syncmaster)
 			syncmaster = NULL;
 		kfree(hc);
+		mutex_unlock(&HFC_probe_lock);
 		return ret_err;
 	}
 
@@ -5244,7 +5560,9 @@ hfcmulti_init(struct hm_map *m, struct pci_dev *pdev,
 		break;
 	}
 
-	/* add to list */
+	/* add to list; the poll timer walks the list lockless */
+	if (irqpoll)
+		hrtimer_cancel(&hfc_poll_timer);
 	spin_lock_irqsave(&HFClock, flags);
 	list_add_tail(&hc->list, &HFClist);
 	spin_unlock_irqrestore(&HFClock, flags);
@@ -5253,16 +5571,38 @@ hfcmulti_init(struct hm_map *m, struct pci_dev *pdev,
 	if (clock == HFC_cnt + 1)
 		hc->iclock = mISDN_register_clock("HFCMulti", 0, clockctl, hc);
 
+	/* card slot is consumed; configuration above is done */
+	HFC_cnt++;
+
 	/* initialize hardware */
 	hc->irq = (m->irq) ? : hc->pci_dev->irq;
+	/* from here on the cards are independent, so concurrent probes
+	 * may overlap their delay-heavy reset sequences. Only the PLXSD
+	 * PCM master election spans init_card() and stays serialized.
+	 */
+	if (!test_bit(HFC_CHIP_PLXSD, &hc->chip))
+		mutex_unlock(&HFC_probe_lock);
 	ret_err = init_card(hc);
+	if (test_bit(HFC_CHIP_PLXSD, &hc->chip))
+		mutex_unlock(&HFC_probe_lock);
 	if (ret_err) {
 		printk(KERN_ERR "init card returns %d\n", ret_err);
 		release_card(hc);
 		return ret_err;
 	}
 
-	/* start IRQ and return */
+	/* runtime tuning knob; embedded devices have no pci node */
+	if (hc->pci_dev &&
+	    device_create_file(&hc->pci_dev->dev, &dev_attr_poll))
+		printk(KERN_WARNING
+		       "HFC-multi: cannot create poll attribute\n");
+
+	/* start IRQ or poll timer and return */
+	if (irqpoll) {
+		hrtimer_start(&hfc_poll_timer, hfc_poll_period,
+			      HRTIMER_MODE_REL);
+		return 0;
+	}
 	spin_lock_irqsave(&hc->lock, flags);
 	enable_hwirq(hc);
 	spin_unlock_irqrestore(&hc->lock, flags);
@@ -5273,6 +5613,7 @@ free_card:
 	if (hc == syncmaster)
 		syncmaster = NULL;
 	kfree(hc);
+	mutex_unlock(&HFC_probe_lock);
 	return ret_err;
 }
 
@@ -5288,6 +5629,7 @@ static void hfc_remove_pci(struct pci_dev *pdev)
 		       pdev->subsystem_vendor, pdev->subsystem_device);
 
 	if (card) {
+		device_remove_file(&pdev->dev, &dev_attr_poll);
 		spin_lock_irqsave(&HFClock, flags);
 		release_card(card);
 		spin_unlock_irqrestore(&HFClock, flags);
@@ -5466,7 +5808,6 @@ hfcmulti_probe(struct pci_dev *pdev, const struct pci_device_id *ent)
 	ret = hfcmulti_init(m, pdev, ent);
 	if (ret)
 		return ret;
-	HFC_cnt++;
 	printk(KERN_INFO "%d devices registered\n", HFC_cnt);
 	return 0;
 }
@@ -5476,6 +5817,10 @@ static struct pci_driver hfcmultipci_driver = {
 	.probe		= hfcmulti_probe,
 	.remove		= hfc_remove_pci,
 	.id_table	= hfmultipci_ids,
+	/* cards probe on separate threads; multi-card boxes overlap the
+	 * reset and interrupt-test delays instead of paying them serially
+	 */
+	.driver.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 };
 
 static void __exit
@@ -5539,6 +5884,11 @@ HFCmulti_init(void)
 
 	}
 
+	/* one poll period is 125us per sample */
+	hrtimer_init(&hfc_poll_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	hfc_poll_timer.function = hfcmulti_poll;
+	hfc_poll_period = ns_to_ktime((u64)poll * 125 * NSEC_PER_USEC);
+
 	if (!clock)
 		clock = 1;
 
@@ -5568,7 +5918,6 @@ HFCmulti_init(void)
 			       "%x\n", err);
 			return err;
 		}
-		HFC_cnt++;
 		printk(KERN_INFO "%d devices registered\n", HFC_cnt);
 	}
 
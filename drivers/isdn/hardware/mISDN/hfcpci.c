@@ -407,18 +407,20 @@ hfcpci_empty_bfifo(struct bchannel *bch, struct bzfifo *bz,
 		   u_char *bdata, int count)
 {
 	u_char		*ptr, *ptr1, new_f2;
-	int		maxlen, new_z2;
+	int		maxlen, new_z2, z1, z2;
 	struct zt	*zp;
 
 	if ((bch->debug & DEBUG_HW_BCHANNEL) && !(bch->debug & DEBUG_HW_BFIFO))
 		printk(KERN_DEBUG "hfcpci_empty_fifo\n");
 	zp = &bz->za[bz->f2];	/* point to Z-Regs */
-	new_z2 = le16_to_cpu(zp->z2) + count;	/* new position in fifo */
+	z1 = le16_to_cpu(zp->z1);	/* fetch the uncached regs once */
+	z2 = le16_to_cpu(zp->z2);
+	new_z2 = z2 + count;	/* new position in fifo */
 	if (new_z2 >= (B_FIFO_SIZE + B_SUB_VAL))
 		new_z2 -= B_FIFO_SIZE;	/* buffer wrap */
 	new_f2 = (bz->f2 + 1) & MAX_B_FRAMES;
 	if ((count > MAX_DATA_SIZE + 3) || (count < 4) ||
-	    (*(bdata + (le16_to_cpu(zp->z1) - B_SUB_VAL)))) {
+	    (*(bdata + (z1 - B_SUB_VAL)))) {
 		if (bch->debug & DEBUG_HW)
 			printk(KERN_DEBUG "hfcpci_empty_fifo: incoming packet "
 			       "invalid length %d or crc\n", count);
@@ -428,21 +430,24 @@ hfcpci_empty_bfifo(struct bchannel *bch, struct bzfifo *bz,
 		bz->za[new_f2].z2 = cpu_to_le16(new_z2);
 		bz->f2 = new_f2;	/* next buffer */
 	} else {
-		bch->rx_skb = mI_alloc_skb(count - 3, GFP_ATOMIC);
-		if (!bch->rx_skb) {
-			printk(KERN_WARNING "HFCPCI: receive out of memory\n");
+		maxlen = bchannel_get_rxbuf(bch, count - 3);
+		if (maxlen < 0) {
+			if (maxlen == -ENOMEM)
+				return;	/* retry on the next interrupt */
+			/* frame too big for the current protocol - drop */
+			bz->za[new_f2].z2 = cpu_to_le16(new_z2);
+			bz->f2 = new_f2;	/* next buffer */
 			return;
 		}
 		count -= 3;
 		ptr = skb_put(bch->rx_skb, count);
 
-		if (le16_to_cpu(zp->z2) + count <= B_FIFO_SIZE + B_SUB_VAL)
+		if (z2 + count <= B_FIFO_SIZE + B_SUB_VAL)
 			maxlen = count;		/* complete transfer */
 		else
-			maxlen = B_FIFO_SIZE + B_SUB_VAL -
-				le16_to_cpu(zp->z2);	/* maximum */
+			maxlen = B_FIFO_SIZE + B_SUB_VAL - z2; /* maximum */
 
-		ptr1 = bdata + (le16_to_cpu(zp->z2) - B_SUB_VAL);
+		ptr1 = bdata + (z2 - B_SUB_VAL);
 		/* start of data */
 		memcpy(ptr, ptr1, maxlen);	/* copy data */
 		count -= maxlen;
@@ -468,6 +473,7 @@ receive_dmsg(struct hfc_pci *hc)
 	int		maxlen;
 	int		rcnt, total;
 	int		count = 5;
+	int		z1, z2;
 	u_char		*ptr, *ptr1;
 	struct dfifo	*df;
 	struct zt	*zp;
@@ -475,33 +481,32 @@ receive_dmsg(struct hfc_pci *hc)
 	df = &((union fifo_area *)(hc->hw.fifos))->d_chan.d_rx;
 	while (((df->f1 & D_FREG_MASK) != (df->f2 & D_FREG_MASK)) && count--) {
 		zp = &df->za[df->f2 & D_FREG_MASK];
-		rcnt = le16_to_cpu(zp->z1) - le16_to_cpu(zp->z2);
+		z1 = le16_to_cpu(zp->z1);	/* fetch the regs only once */
+		z2 = le16_to_cpu(zp->z2);
+		rcnt = z1 - z2;
 		if (rcnt < 0)
 			rcnt += D_FIFO_SIZE;
 		rcnt++;
 		if (dch->debug & DEBUG_HW_DCHANNEL)
 			printk(KERN_DEBUG
 			       "hfcpci recd f1(%d) f2(%d) z1(%x) z2(%x) cnt(%d)\n",
-			       df->f1, df->f2,
-			       le16_to_cpu(zp->z1),
-			       le16_to_cpu(zp->z2),
-			       rcnt);
+			       df->f1, df->f2, z1, z2, rcnt);
 
 		if ((rcnt > MAX_DFRAME_LEN + 3) || (rcnt < 4) ||
-		    (df->data[le16_to_cpu(zp->z1)])) {
+		    (df->data[z1])) {
 			if (dch->debug & DEBUG_HW)
 				printk(KERN_DEBUG
 				       "empty_fifo hfcpci packet inv. len "
 				       "%d or crc %d\n",
 				       rcnt,
-				       df->data[le16_to_cpu(zp->z1)]);
+				       df->data[z1]);
 #ifdef ERROR_STATISTIC
 			cs->err_rx++;
 #endif
 			df->f2 = ((df->f2 + 1) & MAX_D_FRAMES) |
 				(MAX_D_FRAMES + 1);	/* next buffer */
 			df->za[df->f2 & D_FREG_MASK].z2 =
-				cpu_to_le16((le16_to_cpu(zp->z2) + rcnt) &
+				cpu_to_le16((z2 + rcnt) &
 					    (D_FIFO_SIZE - 1));
 		} else {
 			dch->rx_skb = mI_alloc_skb(rcnt - 3, GFP_ATOMIC);
@@ -514,13 +519,13 @@ receive_dmsg(struct hfc_pci *hc)
 			rcnt -= 3;
 			ptr = skb_put(dch->rx_skb, rcnt);
 
-			if (le16_to_cpu(zp->z2) + rcnt <= D_FIFO_SIZE)
+			if (z2 + rcnt <= D_FIFO_SIZE)
 				maxlen = rcnt;	/* complete transfer */
 			else
-				maxlen = D_FIFO_SIZE - le16_to_cpu(zp->z2);
+				maxlen = D_FIFO_SIZE - z2;
 			/* maximum */
 
-			ptr1 = df->data + le16_to_cpu(zp->z2);
+			ptr1 = df->data + z2;
 			/* start of data */
 			memcpy(ptr, ptr1, maxlen);	/* copy data */
 			rcnt -= maxlen;
@@ -532,8 +537,8 @@ receive_dmsg(struct hfc_pci *hc)
 			}
 			df->f2 = ((df->f2 + 1) & MAX_D_FRAMES) |
 				(MAX_D_FRAMES + 1);	/* next buffer */
-			df->za[df->f2 & D_FREG_MASK].z2 = cpu_to_le16((
-									      le16_to_cpu(zp->z2) + total) & (D_FIFO_SIZE - 1));
+			df->za[df->f2 & D_FREG_MASK].z2 =
+				cpu_to_le16((z2 + total) & (D_FIFO_SIZE - 1));
 			recv_Dchannel(dch);
 		}
 	}
@@ -548,7 +553,7 @@ hfcpci_empty_fifo_trans(struct bchannel *bch, struct bzfifo *rxbz,
 			struct bzfifo *txbz, u_char *bdata)
 {
 	__le16	*z1r, *z2r, *z1t, *z2t;
-	int	new_z2, fcnt_rx, fcnt_tx, maxlen;
+	int	new_z2, fcnt_rx, fcnt_tx, maxlen, z2;
 	u_char	*ptr, *ptr1;
 
 	z1r = &rxbz->za[MAX_B_FRAMES].z1;	/* pointer to z reg */
@@ -556,13 +561,14 @@ hfcpci_empty_fifo_trans(struct bchannel *bch, struct bzfifo *rxbz,
 	z1t = &txbz->za[MAX_B_FRAMES].z1;
 	z2t = z1t + 1;
 
-	fcnt_rx = le16_to_cpu(*z1r) - le16_to_cpu(*z2r);
+	z2 = le16_to_cpu(*z2r);		/* fetch the regs only once */
+	fcnt_rx = le16_to_cpu(*z1r) - z2;
 	if (!fcnt_rx)
 		return;	/* no data avail */
 
 	if (fcnt_rx <= 0)
 		fcnt_rx += B_FIFO_SIZE;	/* bytes actually buffered */
-	new_z2 = le16_to_cpu(*z2r) + fcnt_rx;	/* new position in fifo */
+	new_z2 = z2 + fcnt_rx;	/* new position in fifo */
 	if (new_z2 >= (B_FIFO_SIZE + B_SUB_VAL))
 		new_z2 -= B_FIFO_SIZE;	/* buffer wrap */
 
@@ -584,13 +590,13 @@ hfcpci_empty_fifo_trans(struct bchannel *bch, struct bzfifo *rxbz,
 			   bch->nr, fcnt_rx);
 	} else {
 		ptr = skb_put(bch->rx_skb, fcnt_rx);
-		if (le16_to_cpu(*z2r) + fcnt_rx <= B_FIFO_SIZE + B_SUB_VAL)
+		if (z2 + fcnt_rx <= B_FIFO_SIZE + B_SUB_VAL)
 			maxlen = fcnt_rx;	/* complete transfer */
 		else
-			maxlen = B_FIFO_SIZE + B_SUB_VAL - le16_to_cpu(*z2r);
+			maxlen = B_FIFO_SIZE + B_SUB_VAL - z2;
 		/* maximum */
 
-		ptr1 = bdata + (le16_to_cpu(*z2r) - B_SUB_VAL);
+		ptr1 = bdata + (z2 - B_SUB_VAL);
 		/* start of data */
 		memcpy(ptr, ptr1, maxlen);	/* copy data */
 		fcnt_rx -= maxlen;
@@ -677,7 +683,7 @@ hfcpci_fill_dfifo(struct hfc_pci *hc)
 {
 	struct dchannel	*dch = &hc->dch;
 	int		fcnt;
-	int		count, new_z1, maxlen;
+	int		count, new_z1, maxlen, z1;
 	struct dfifo	*df;
 	u_char		*src, *dst, new_f1;
 
@@ -691,10 +697,11 @@ hfcpci_fill_dfifo(struct hfc_pci *hc)
 		return;
 	df = &((union fifo_area *) (hc->hw.fifos))->d_chan.d_tx;
 
+	z1 = le16_to_cpu(df->za[df->f1 & D_FREG_MASK].z1);
+	/* fetch the reg only once */
 	if (dch->debug & DEBUG_HW_DFIFO)
 		printk(KERN_DEBUG "%s:f1(%d) f2(%d) z1(f1)(%x)\n", __func__,
-		       df->f1, df->f2,
-		       le16_to_cpu(df->za[df->f1 & D_FREG_MASK].z1));
+		       df->f1, df->f2, z1);
 	fcnt = df->f1 - df->f2;	/* frame count actually buffered */
 	if (fcnt < 0)
 		fcnt += (MAX_D_FRAMES + 1);	/* if wrap around */
@@ -708,8 +715,7 @@ hfcpci_fill_dfifo(struct hfc_pci *hc)
 		return;
 	}
 	/* now determine free bytes in FIFO buffer */
-	maxlen = le16_to_cpu(df->za[df->f2 & D_FREG_MASK].z2) -
-		le16_to_cpu(df->za[df->f1 & D_FREG_MASK].z1) - 1;
+	maxlen = le16_to_cpu(df->za[df->f2 & D_FREG_MASK].z2) - z1 - 1;
 	if (maxlen <= 0)
 		maxlen += D_FIFO_SIZE;	/* count now contains available bytes */
 
@@ -721,12 +727,11 @@ hfcpci_fill_dfifo(struct hfc_pci *hc)
 			printk(KERN_DEBUG "hfcpci_fill_Dfifo no fifo mem\n");
 		return;
 	}
-	new_z1 = (le16_to_cpu(df->za[df->f1 & D_FREG_MASK].z1) + count) &
-		(D_FIFO_SIZE - 1);
+	new_z1 = (z1 + count) & (D_FIFO_SIZE - 1);
 	new_f1 = ((df->f1 + 1) & D_FREG_MASK) | (D_FREG_MASK + 1);
 	src = dch->tx_skb->data + dch->tx_idx;	/* source pointer */
-	dst = df->data + le16_to_cpu(df->za[df->f1 & D_FREG_MASK].z1);
-	maxlen = D_FIFO_SIZE - le16_to_cpu(df->za[df->f1 & D_FREG_MASK].z1);
+	dst = df->data + z1;
+	maxlen = D_FIFO_SIZE - z1;
 	/* end fifo */
 	if (maxlen > count)
 		maxlen = count;	/* limit size */
@@ -754,7 +759,7 @@ hfcpci_fill_fifo(struct bchannel *bch)
 {
 	struct hfc_pci	*hc = bch->hw;
 	int		maxlen, fcnt;
-	int		count, new_z1;
+	int		count, new_z1, z1;
 	int		fillempty = 0;
 	struct bzfifo	*bz;
 	u_char		*bdata;
@@ -783,23 +788,24 @@ hfcpci_fill_fifo(struct bchannel *bch)
 	if (test_bit(FLG_TRANSPARENT, &bch->Flags)) {
 		z1t = &bz->za[MAX_B_FRAMES].z1;
 		z2t = z1t + 1;
+		z1 = le16_to_cpu(*z1t);	/* fetch the regs only once */
 		if (bch->debug & DEBUG_HW_BCHANNEL)
 			printk(KERN_DEBUG "hfcpci_fill_fifo_trans ch(%x) "
 			       "cnt(%d) z1(%x) z2(%x)\n", bch->nr, count,
-			       le16_to_cpu(*z1t), le16_to_cpu(*z2t));
-		fcnt = le16_to_cpu(*z2t) - le16_to_cpu(*z1t);
+			       z1, le16_to_cpu(*z2t));
+		fcnt = le16_to_cpu(*z2t) - z1;
 		if (fcnt <= 0)
 			fcnt += B_FIFO_SIZE;
 		if (fillempty) {
 			/* fcnt contains available bytes in fifo */
 			if (count > fcnt)
 				count = fcnt;
-			new_z1 = le16_to_cpu(*z1t) + count;
+			new_z1 = z1 + count;
 			/* new buffer Position */
 			if (new_z1 >= (B_FIFO_SIZE + B_SUB_VAL))
 				new_z1 -= B_FIFO_SIZE;	/* buffer wrap */
-			dst = bdata + (le16_to_cpu(*z1t) - B_SUB_VAL);
-			maxlen = (B_FIFO_SIZE + B_SUB_VAL) - le16_to_cpu(*z1t);
+			dst = bdata + (z1 - B_SUB_VAL);
+			maxlen = (B_FIFO_SIZE + B_SUB_VAL) - z1;
 			/* end of fifo */
 			if (bch->debug & DEBUG_HW_BFIFO)
 				printk(KERN_DEBUG "hfcpci_FFt fillempty "
@@ -820,29 +826,27 @@ hfcpci_fill_fifo(struct bchannel *bch)
 		fcnt = B_FIFO_SIZE - fcnt;
 		/* remaining bytes to send (bytes in fifo) */
 
-	next_t_frame:
-		count = bch->tx_skb->len - bch->tx_idx;
-		/* maximum fill shall be poll*2 */
-		if (count > (poll << 1) - fcnt)
-			count = (poll << 1) - fcnt;
+		/* maximum fill shall be poll*2; the elastic helper
+		 * resamples by single samples when the sender drifts
+		 * against the S0 clock
+		 */
+		count = (poll << 1) - fcnt;
 		if (count <= 0)
 			return;
-		/* data is suitable for fifo */
-		new_z1 = le16_to_cpu(*z1t) + count;
+		src = bchannel_tx_chunk(bch, count, &count);
+		if (!src)
+			return;
+		new_z1 = z1 + count;
 		/* new buffer Position */
 		if (new_z1 >= (B_FIFO_SIZE + B_SUB_VAL))
 			new_z1 -= B_FIFO_SIZE;	/* buffer wrap */
-		src = bch->tx_skb->data + bch->tx_idx;
-		/* source pointer */
-		dst = bdata + (le16_to_cpu(*z1t) - B_SUB_VAL);
-		maxlen = (B_FIFO_SIZE + B_SUB_VAL) - le16_to_cpu(*z1t);
+		dst = bdata + (z1 - B_SUB_VAL);
+		maxlen = (B_FIFO_SIZE + B_SUB_VAL) - z1;
 		/* end of fifo */
 		if (bch->debug & DEBUG_HW_BFIFO)
 			printk(KERN_DEBUG "hfcpci_FFt fcnt(%d) "
 			       "maxl(%d) nz1(%x) dst(%p)\n",
 			       fcnt, maxlen, new_z1, dst);
-		fcnt += count;
-		bch->tx_idx += count;
 		if (maxlen > count)
 			maxlen = count;		/* limit size */
 		memcpy(dst, src, maxlen);	/* first copy */
@@ -853,18 +857,13 @@ hfcpci_fill_fifo(struct bchannel *bch)
 			memcpy(dst, src, count);
 		}
 		*z1t = cpu_to_le16(new_z1);	/* now send data */
-		if (bch->tx_idx < bch->tx_skb->len)
-			return;
-		dev_kfree_skb(bch->tx_skb);
-		if (get_next_bframe(bch))
-			goto next_t_frame;
 		return;
 	}
+	z1 = le16_to_cpu(bz->za[bz->f1].z1);	/* fetch the reg only once */
 	if (bch->debug & DEBUG_HW_BCHANNEL)
 		printk(KERN_DEBUG
 		       "%s: ch(%x) f1(%d) f2(%d) z1(f1)(%x)\n",
-		       __func__, bch->nr, bz->f1, bz->f2,
-		       bz->za[bz->f1].z1);
+		       __func__, bch->nr, bz->f1, bz->f2, z1);
 	fcnt = bz->f1 - bz->f2;	/* frame count actually buffered */
 	if (fcnt < 0)
 		fcnt += (MAX_B_FRAMES + 1);	/* if wrap around */
@@ -875,8 +874,7 @@ hfcpci_fill_fifo(struct bchannel *bch)
 		return;
 	}
 	/* now determine free bytes in FIFO buffer */
-	maxlen = le16_to_cpu(bz->za[bz->f2].z2) -
-		le16_to_cpu(bz->za[bz->f1].z1) - 1;
+	maxlen = le16_to_cpu(bz->za[bz->f2].z2) - z1 - 1;
 	if (maxlen <= 0)
 		maxlen += B_FIFO_SIZE;	/* count now contains available bytes */
 
@@ -889,15 +887,15 @@ hfcpci_fill_fifo(struct bchannel *bch)
 			printk(KERN_DEBUG "hfcpci_fill_fifo no fifo mem\n");
 		return;
 	}
-	new_z1 = le16_to_cpu(bz->za[bz->f1].z1) + count;
+	new_z1 = z1 + count;
 	/* new buffer Position */
 	if (new_z1 >= (B_FIFO_SIZE + B_SUB_VAL))
 		new_z1 -= B_FIFO_SIZE;	/* buffer wrap */
 
 	new_f1 = ((bz->f1 + 1) & MAX_B_FRAMES);
 	src = bch->tx_skb->data + bch->tx_idx;	/* source pointer */
-	dst = bdata + (le16_to_cpu(bz->za[bz->f1].z1) - B_SUB_VAL);
-	maxlen = (B_FIFO_SIZE + B_SUB_VAL) - le16_to_cpu(bz->za[bz->f1].z1);
+	dst = bdata + (z1 - B_SUB_VAL);
+	maxlen = (B_FIFO_SIZE + B_SUB_VAL) - z1;
 	/* end fifo */
 	if (maxlen > count)
 		maxlen = count;	/* limit size */
@@ -35,6 +35,8 @@
 #include <linux/usb.h>
 #include <linux/mISDNhw.h>
 #include <linux/slab.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include "hfcsusb.h"
 
 static unsigned int debug;
@@ -1004,6 +1006,7 @@ rx_iso_complete(struct urb *urb)
 			       "urb->status %d, fifonum %d\n",
 			       hw->name, __func__,  status, fifon);
 
+		fifo->iso_xruns++;
 		/* clear status, so go on with ISO transfers */
 		status = 0;
 	}
@@ -1019,10 +1022,13 @@ rx_iso_complete(struct urb *urb)
 			buf = context_iso_urb->buffer + offset;
 			iso_status = urb->iso_frame_desc[k].status;
 
-			if (iso_status && (debug & DBG_HFC_FIFO_VERBOSE)) {
-				printk(KERN_DEBUG "%s: %s: "
-				       "ISO packet %i, status: %i\n",
-				       hw->name, __func__, k, iso_status);
+			if (iso_status) {
+				fifo->iso_xruns++;
+				if (debug & DBG_HFC_FIFO_VERBOSE)
+					printk(KERN_DEBUG "%s: %s: "
+					       "ISO packet %i, status: %i\n",
+					       hw->name, __func__, k,
+					       iso_status);
 			}
 
 			/* USB data log for every D ISO in */
@@ -1218,6 +1224,7 @@ tx_iso_complete(struct urb *urb)
 			       "-EXDEV (%i) fifon (%d)\n",
 			       hw->name, __func__, status, fifon);
 
+		fifo->iso_xruns++;
 		/* clear status, so go on with ISO transfers */
 		status = 0;
 	}
@@ -1242,13 +1249,13 @@ tx_iso_complete(struct urb *urb)
 
 		for (k = 0; k < num_isoc_packets; ++k) {
 			/* analyze tx success of previous ISO packets */
-			if (debug & DBG_HFC_URB_ERROR) {
-				errcode = urb->iso_frame_desc[k].status;
-				if (errcode) {
+			errcode = urb->iso_frame_desc[k].status;
+			if (errcode) {
+				fifo->iso_xruns++;
+				if (debug & DBG_HFC_URB_ERROR)
 					printk(KERN_DEBUG "%s: %s: "
 					       "ISO packet %i, status: %i\n",
 					       hw->name, __func__, k, errcode);
-				}
 			}
 
 			/* Generate next ISO Packets */
@@ -1383,8 +1390,8 @@ tx_iso_complete(struct urb *urb)
 }
 
 /*
- * allocs urbs and start isoc transfer with two pending urbs to avoid
- * gaps in the transfer chain
+ * allocs urbs and start isoc transfer with several pending urbs to
+ * avoid gaps in the transfer chain
  */
 static int
 start_isoc_chain(struct usb_fifo *fifo, int num_packets_per_urb,
@@ -1392,13 +1399,14 @@ start_isoc_chain(struct usb_fifo *fifo, int num_packets_per_urb,
 {
 	struct hfcsusb *hw = fifo->hw;
 	int i, k, errcode;
+	int num_urbs = usb_pipein(fifo->pipe) ? ISO_URBS_RX : ISO_URBS_TX;
 
 	if (debug)
 		printk(KERN_DEBUG "%s: %s: fifo %i\n",
 		       hw->name, __func__, fifo->fifonum);
 
 	/* allocate Memory for Iso out Urbs */
-	for (i = 0; i < 2; i++) {
+	for (i = 0; i < num_urbs; i++) {
 		if (!(fifo->iso[i].urb)) {
 			fifo->iso[i].urb =
 				usb_alloc_urb(num_packets_per_urb, GFP_KERNEL);
@@ -1458,8 +1466,9 @@ stop_iso_gracefull(struct usb_fifo *fifo)
 	struct hfcsusb *hw = fifo->hw;
 	int i, timeout;
 	u_long flags;
+	int num_urbs = usb_pipein(fifo->pipe) ? ISO_URBS_RX : ISO_URBS_TX;
 
-	for (i = 0; i < 2; i++) {
+	for (i = 0; i < num_urbs; i++) {
 		spin_lock_irqsave(&hw->lock, flags);
 		if (debug)
 			printk(KERN_DEBUG "%s: %s for fifo %i.%i\n",
@@ -1468,7 +1477,7 @@ stop_iso_gracefull(struct usb_fifo *fifo)
 		spin_unlock_irqrestore(&hw->lock, flags);
 	}
 
-	for (i = 0; i < 2; i++) {
+	for (i = 0; i < num_urbs; i++) {
 		timeout = 3;
 		while (fifo->stop_gracefull && timeout--)
 			schedule_timeout_interruptible((HZ / 1000) * 16);
@@ -1842,6 +1851,39 @@ hfc_bctrl(struct mISDNchannel *ch, u_int cmd, void *arg)
 	return ret;
 }
 
+/* per-fifo iso error counters, "stats" file in our debugfs directory */
+static int
+hfcsusb_stats_show(struct seq_file *m, void *v)
+{
+	struct hfcsusb *hw = m->private;
+	struct usb_fifo *fifo;
+	int i;
+
+	for (i = 0; i < HFCUSB_NUM_FIFOS; i++) {
+		fifo = &hw->fifos[i];
+		if (!fifo->pipe || fifo->usb_transfer_mode != USB_ISOC)
+			continue;
+		seq_printf(m, "fifo %d (%s): xruns %u\n", i,
+			   usb_pipein(fifo->pipe) ? "rx" : "tx",
+			   fifo->iso_xruns);
+	}
+	return 0;
+}
+
+static int
+hfcsusb_stats_open(struct inode *ino, struct file *filep)
+{
+	return single_open(filep, hfcsusb_stats_show, ino->i_private);
+}
+
+static const struct file_operations hfcsusb_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= hfcsusb_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int
 setup_instance(struct hfcsusb *hw, struct device *parent)
 {
@@ -1906,6 +1948,10 @@ setup_instance(struct hfcsusb *hw, struct device *parent)
 	write_lock_irqsave(&HFClock, flags);
 	list_add_tail(&hw->list, &HFClist);
 	write_unlock_irqrestore(&HFClock, flags);
+
+	hw->dbg = debugfs_create_dir(hw->name, usb_debug_root);
+	debugfs_create_file("stats", 0444, hw->dbg, hw,
+			    &hfcsusb_stats_fops);
 	return 0;
 
 out:
@@ -2132,6 +2178,7 @@ hfcsusb_disconnect(struct usb_interface *intf)
 
 	printk(KERN_INFO "%s: device disconnected\n", hw->name);
 
+	debugfs_remove_recursive(hw->dbg);
 	handle_led(hw, LED_POWER_OFF);
 	release_hw(hw);
 
@@ -89,6 +89,13 @@
 #define ISOC_PACKETS_B	8
 #define ISO_BUFFER_SIZE	128
 
+/*
+ * iso urbs kept in flight per endpoint. rx uses a deeper chain to ride
+ * out host scheduling gaps, tx stays shallow to bound the tx latency
+ */
+#define ISO_URBS_RX	4
+#define ISO_URBS_TX	2
+
 /* defines how much ISO packets are handled in one URB */
 static int iso_packets[8] =
 { ISOC_PACKETS_B, ISOC_PACKETS_B, ISOC_PACKETS_B, ISOC_PACKETS_B,
@@ -258,14 +265,15 @@ struct usb_fifo {
 	int bit_line;		/* how much bits are in the fifo? */
 
 	__u8 usb_transfer_mode; /* switched between ISO and INT */
-	struct iso_urb	iso[2]; /* two urbs to have one always
-				   one pending */
+	struct iso_urb	iso[ISO_URBS_RX]; /* urb chain, always at least
+					     one urb pending */
 
 	struct dchannel *dch;	/* link to hfcsusb_t->dch */
 	struct bchannel *bch;	/* link to hfcsusb_t->bch */
 	struct dchannel *ech;	/* link to hfcsusb_t->ech, TODO: E-CHANNEL */
 	int last_urblen;	/* remember length of last packet */
 	__u8 stop_gracefull;	/* stops URB retransmission */
+	unsigned int iso_xruns;	/* errored iso frames (dropouts) */
 };
 
 struct hfcsusb {
@@ -304,6 +312,7 @@ struct hfcsusb {
 	__u8			timers;
 	__u8			initdone;
 	char			name[MISDN_MAX_IDLEN];
+	struct dentry		*dbg;	/* debugfs directory */
 };
 
 /* private vendor specific data */
@@ -24,10 +24,23 @@
  *   debug=<n>, default=0, with n=0xHHHHGGGG
  *      H - l1 driver flags described in hfcs_usb.h
  *      G - common mISDN debug flags described at mISDNhw.h
+ *   poll=<n>, default 64
+ *      samples moved per B-channel and poll tick; the tick period is
+ *      n * 125us, the software stand-in for the fifo interrupt of
+ *      real hardware
+ *
+ * Besides being a minimal layer1 driver, this skeleton demonstrates
+ * the fast path idioms a new driver should start from: the send
+ * callback only queues TX data, all data movement happens batched in
+ * the periodic service routine, and receive buffers are taken from
+ * bchannel_get_rxbuf() so transparent audio runs allocation free out
+ * of the per channel pool. recv_Bchannel() just queues upstream, the
+ * channel workqueue delivers from process context.
  */
 
 #include <linux/module.h>
 #include <linux/delay.h>
+#include <linux/hrtimer.h>
 #include <linux/mISDNhw.h>
 #include "hwskel.h"
 
@@ -35,12 +48,16 @@ const char *hwskel_rev = "Revision: 0.1.3 (socket), 2008-11-04";
 
 static unsigned int debug = 0;
 static unsigned int interfaces = 1;
+static unsigned int poll = 64;
 
 static int hwskel_cnt;
 static LIST_HEAD(hwskel_list);
-static rwlock_t hwskel_lock = RW_LOCK_UNLOCKED;
+static DEFINE_RWLOCK(hwskel_lock);
 struct hwskel * hw;
 
+static struct hrtimer hwskel_poll_timer;
+static ktime_t hwskel_poll_period;
+
 #ifdef MODULE
 MODULE_AUTHOR("Martin Bachem");
 #ifdef MODULE_LICENSE
@@ -48,6 +65,7 @@ MODULE_LICENSE("GPL");
 #endif
 module_param(debug, uint, S_IRUGO | S_IWUSR);
 module_param(interfaces, uint, 0);
+module_param(poll, uint, S_IRUGO);
 #endif
 
 
@@ -190,6 +208,82 @@ deactivate_bchannel(struct bchannel *bch)
 	hwskel_setup_bch(bch, ISDN_P_NONE);
 }
 
+/*
+ * service one B-channel from the poll tick: loop pending TX data back
+ * into the receive side of the same channel.  This is the place where
+ * a real driver talks to its fifo or DMA ring, and it shows the fast
+ * idiom for both directions: TX is consumed from bch->tx_skb in chunks
+ * without extra copies, RX goes through bchannel_get_rxbuf() so
+ * transparent channels reuse buffers from the per channel pool.
+ * Transparent channels move one poll sized chunk per tick like a
+ * sample clocked fifo, HDLC channels a whole frame.
+ */
+static void
+hwskel_bch_service(struct bchannel *bch)
+{
+	int len;
+	u8 *dst;
+
+	if (!test_bit(FLG_ACTIVE, &bch->Flags))
+		return;
+	if (!bch->tx_skb) {
+		if (!test_bit(FLG_TRANSPARENT, &bch->Flags) ||
+		    !test_bit(FLG_FILLEMPTY, &bch->Flags))
+			return;
+		/* no data pending - keep the line clocked with fill
+		 * pattern, as real hardware would */
+		if (bchannel_get_rxbuf(bch, poll) < 0)
+			return;
+		dst = skb_put(bch->rx_skb, poll);
+		memset(dst, bch->fill[0], poll);
+		recv_Bchannel(bch, MISDN_ID_ANY, false);
+		return;
+	}
+	len = bch->tx_skb->len - bch->tx_idx;
+	if (len > 0) {
+		if (test_bit(FLG_TRANSPARENT, &bch->Flags) &&
+		    len > (int)poll)
+			len = poll;
+		if (bchannel_get_rxbuf(bch, len) < 0)
+			return; /* out of rx buffers - retry next tick */
+		dst = skb_put(bch->rx_skb, len);
+		memcpy(dst, bch->tx_skb->data + bch->tx_idx, len);
+		bch->tx_idx += len;
+		recv_Bchannel(bch, MISDN_ID_ANY, false);
+	}
+	if (bch->tx_idx >= bch->tx_skb->len) {
+		dev_kfree_skb(bch->tx_skb);
+		bch->tx_skb = NULL;
+		bch->tx_idx = 0;
+		get_next_bframe(bch);
+	}
+}
+
+/*
+ * periodic tick, period poll * 125us - the software stand-in for the
+ * fifo interrupt of real hardware.  All channels of all ports are
+ * serviced batched in one pass, only the data movement runs under the
+ * port lock; delivery upstream is deferred to the channel workqueues
+ * by recv_Bchannel()
+ */
+static enum hrtimer_restart
+hwskel_poll(struct hrtimer *t)
+{
+	struct port *p;
+	u_long flags;
+	int i, j;
+
+	for (i = 0; i < interfaces; i++) {
+		p = hw->ports + i;
+		spin_lock_irqsave(&p->lock, flags);
+		for (j = 0; j < 2; j++)
+			hwskel_bch_service(&p->bch[j]);
+		spin_unlock_irqrestore(&p->lock, flags);
+	}
+	hrtimer_forward_now(t, hwskel_poll_period);
+	return HRTIMER_RESTART;
+}
+
 /*
  * Layer2 -> Layer 1 Bchannel data
  */
@@ -206,28 +300,13 @@ hwskel_l2l1B(struct mISDNchannel *ch, struct sk_buff *skb) {
 
 	switch (hh->prim) {
 		case PH_DATA_REQ:
+			/* only queue here - the poll tick moves the
+			 * data, exactly like a fifo driven driver */
 			spin_lock_irqsave(&p->lock, flags);
 			ret = bchannel_senddata(bch, skb);
 			spin_unlock_irqrestore(&p->lock, flags);
-			if (ret > 0) {
+			if (ret > 0)
 				ret = 0;
-				queue_ch_frame(ch, PH_DATA_CNF, hh->id, NULL);
-
-				// l1 virtual bchannel loop
-				bch->rx_skb = skb_copy(skb, GFP_ATOMIC);
-				if (bch->rx_skb) {
-					recv_Bchannel(bch, MISDN_ID_ANY);
-				} else {
-					if (debug & DEBUG_HW)
-						printk (KERN_ERR
-							"%s: %s: mI_alloc_skb "
-							"failed \n",
-							p->name, __func__);
-				}
-				dev_kfree_skb(skb);
-				skb = NULL;
-				get_next_bframe(bch);
-			}
 			return ret;
 		case PH_ACTIVATE_REQ:
 			if (!test_and_set_bit(FLG_ACTIVE, &bch->Flags)) {
@@ -764,29 +843,44 @@ release_instance(struct hwskel *hw) {
 static int __init
 hwskel_init(void)
 {
+	int err;
+
 	if (interfaces <= 0)
 		interfaces = 1;
 	if (interfaces > 64)
 		interfaces = 64;
+	if (poll < 8)
+		poll = 8;
+	if (poll > 256)
+		poll = 256;
 
 	printk(KERN_INFO DRIVER_NAME " driver Rev. %s "
-		"debug(0x%x) interfaces(%i)\n",
-		hwskel_rev, debug, interfaces);
+		"debug(0x%x) interfaces(%i) poll(%i)\n",
+		hwskel_rev, debug, interfaces, poll);
 
 	if (!(hw = kzalloc(sizeof(struct hwskel), GFP_KERNEL))) {
 		printk(KERN_ERR "%s: %s: no kmem for hw\n",
-		       DRIVER_NAME, __FUNCTION__);
+		       DRIVER_NAME, __func__);
 		return -ENOMEM;
 	}
 
 	if (!(hw->ports = kzalloc(sizeof(struct port)*interfaces, GFP_KERNEL))) {
 		printk(KERN_ERR "%s: %s: no kmem for interfaces\n",
-		       DRIVER_NAME, __FUNCTION__);
+		       DRIVER_NAME, __func__);
 		kfree(hw);
 		return -ENOMEM;
 	}
 
-	return (setup_instance(hw));
+	err = setup_instance(hw);
+	if (err)
+		return err;
+
+	hwskel_poll_period = ns_to_ktime((u64)poll * 125 * NSEC_PER_USEC);
+	hrtimer_init(&hwskel_poll_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	hwskel_poll_timer.function = hwskel_poll;
+	hrtimer_start(&hwskel_poll_timer, hwskel_poll_period,
+		      HRTIMER_MODE_REL);
+	return 0;
 }
 
 static void __exit
@@ -795,6 +889,7 @@ hwskel_cleanup(void)
 	if (debug)
 		printk(KERN_INFO DRIVER_NAME ": %s\n", __func__);
 
+	hrtimer_cancel(&hwskel_poll_timer);
 	release_instance(hw);
 }
 
@@ -86,13 +86,11 @@ typedef	u8	(read_reg_func)(void *hwp, u8 offset);
 	}								\
 	static void ReadFiFo##name##_MIO(void *p, u8 off, u8 *dp, int size) { \
 		struct hws *hw = p;					\
-		while (size--)						\
-			*dp++ = readb(((typ *)hw->adr) + off);		\
+		ioread8_rep(((typ *)hw->adr) + off, dp, size);		\
 	}								\
 	static void WriteFiFo##name##_MIO(void *p, u8 off, u8 *dp, int size) { \
 		struct hws *hw = p;					\
-		while (size--)						\
-			writeb(*dp++, ((typ *)hw->adr) + off);		\
+		iowrite8_rep(((typ *)hw->adr) + off, dp, size);		\
 	}
 
 #define ASSIGN_FUNC(typ, name, dest)	do {			\
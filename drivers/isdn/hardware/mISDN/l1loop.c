@@ -41,6 +41,18 @@
  * - debug=<n>, default=0, with n=0xHHHHGGGG
  *      H - l1 driver flags described in hfcs_usb.h
  *      G - common mISDN debug flags described at mISDNhw.h
+ * - gen=<n>, n=[0,1] default 0
+ *      1: feed pattern data into every active transparent bchannel, as
+ *         if it was received from the line, and report the generated
+ *         throughput every 10 seconds
+ * - genrate=<n>, default 8000
+ *      bytes per second generated on each active bchannel
+ * - genpattern=<n>, default 0
+ *      0: fill frames with an incrementing counter
+ *      else: fill frames with this byte value
+ * - genchurn=<n>, default 0 (off)
+ *      cycle layer 1 of all opened ports through activate/deactivate
+ *      every n seconds, to load the stack's activation paths
  *
  */
 
@@ -64,6 +76,10 @@ static unsigned int vline = 1;
 static unsigned int nchannel[32] = {2};
 static unsigned int pri;
 static unsigned int debug;
+static unsigned int gen;
+static unsigned int genrate = 8000;
+static unsigned int genpattern;
+static unsigned int genchurn;
 
 MODULE_AUTHOR("Martin Bachem");
 MODULE_LICENSE("GPL");
@@ -72,6 +88,10 @@ module_param(vline, uint, S_IRUGO | S_IWUSR);
 module_param_array(nchannel, uint, NULL, S_IRUGO | S_IWUSR);
 module_param(pri, uint, S_IRUGO | S_IWUSR);
 module_param(debug, uint, S_IRUGO | S_IWUSR);
+module_param(gen, uint, S_IRUGO | S_IWUSR);
+module_param(genrate, uint, S_IRUGO | S_IWUSR);
+module_param(genpattern, uint, S_IRUGO | S_IWUSR);
+module_param(genchurn, uint, S_IRUGO | S_IWUSR);
 
 /*
  * send full D/B channel status information
@@ -153,7 +173,7 @@ deactivate_bchannel(struct bchannel *bch)
 		printk(KERN_DEBUG "%s: %s: bch->nr(%i)\n",
 		       p->name, __func__, bch->nr);
 
-	spin_lock(&p->lock);
+	spin_lock_bh(&p->lock);
 	if (test_and_clear_bit(FLG_TX_NEXT, &bch->Flags)) {
 		dev_kfree_skb(bch->next_skb);
 		bch->next_skb = NULL;
@@ -169,7 +189,7 @@ deactivate_bchannel(struct bchannel *bch)
 	}
 	clear_bit(FLG_ACTIVE, &bch->Flags);
 	clear_bit(FLG_TX_BUSY, &bch->Flags);
-	spin_unlock(&p->lock);
+	spin_unlock_bh(&p->lock);
 
 	l1loop_setup_bch(bch, ISDN_P_NONE);
 }
@@ -181,13 +201,17 @@ static void bch_vline_loop(struct bchannel *bch, struct sk_buff *skb)
 {
 	struct port *p = bch->hw;
 
-	bch->rx_skb = skb_copy(skb, GFP_KERNEL);
-	if (bch->rx_skb)
-		recv_Bchannel(bch, MISDN_ID_ANY, false);
-	else
-		if (debug & DEBUG_HW)
-			printk(KERN_ERR "%s: %s: mI_alloc_skb failed\n",
-				p->name, __func__);
+	spin_lock_bh(&p->lock);
+	if (!bch->rx_skb) {
+		bch->rx_skb = skb_copy(skb, GFP_ATOMIC);
+		if (bch->rx_skb)
+			recv_Bchannel(bch, MISDN_ID_ANY, false);
+		else
+			if (debug & DEBUG_HW)
+				printk(KERN_ERR "%s: %s: mI_alloc_skb failed\n",
+					p->name, __func__);
+	}
+	spin_unlock_bh(&p->lock);
 	dev_kfree_skb(skb);
 	get_next_bframe(bch);
 }
@@ -208,9 +232,14 @@ static void bch_vbus(struct bchannel *bch, struct sk_buff *skb)
 		target = &party->bch[b];
 		if ((me != party) && test_bit(FLG_ACTIVE, &target->Flags)) {
 			/* immediately queue data to bch's RX queue */
-			target->rx_skb = skb_copy(skb, GFP_KERNEL);
-			if (target->rx_skb)
-				recv_Bchannel(target, MISDN_ID_ANY, false);
+			spin_lock_bh(&party->lock);
+			if (!target->rx_skb) {
+				target->rx_skb = skb_copy(skb, GFP_ATOMIC);
+				if (target->rx_skb)
+					recv_Bchannel(target, MISDN_ID_ANY,
+						false);
+			}
+			spin_unlock_bh(&party->lock);
 		}
 	}
 
@@ -232,9 +261,13 @@ static void bch_vlink(struct bchannel *bch, struct sk_buff *skb)
 	target = &party->bch[b];
 	if (test_bit(FLG_ACTIVE, &target->Flags)) {
 		/* immediately queue data to bch's RX queue */
-		target->rx_skb = skb_copy(skb, GFP_KERNEL);
-		if (target->rx_skb)
-			recv_Bchannel(target, MISDN_ID_ANY, false);
+		spin_lock_bh(&party->lock);
+		if (!target->rx_skb) {
+			target->rx_skb = skb_copy(skb, GFP_ATOMIC);
+			if (target->rx_skb)
+				recv_Bchannel(target, MISDN_ID_ANY, false);
+		}
+		spin_unlock_bh(&party->lock);
 	}
 
 	dev_kfree_skb(skb);
@@ -253,9 +286,9 @@ l1loop_l2l1B(struct mISDNchannel *ch, struct sk_buff *skb) {
 
 	switch (hh->prim) {
 	case PH_DATA_REQ:
-		spin_lock(&p->lock);
+		spin_lock_bh(&p->lock);
 		ret = bchannel_senddata(bch, skb);
-		spin_unlock(&p->lock);
+		spin_unlock_bh(&p->lock);
 		if (ret > 0) {
 			ret = 0;
 			switch (vline) {
@@ -604,9 +637,9 @@ l1loop_l2l1D(struct mISDNchannel *ch, struct sk_buff *skb) {
 
 	switch (hh->prim) {
 	case PH_DATA_REQ:
-		spin_lock(&p->lock);
+		spin_lock_bh(&p->lock);
 		ret = dchannel_senddata(dch, skb);
-		spin_unlock(&p->lock);
+		spin_unlock_bh(&p->lock);
 		if (ret > 0) {
 			ret = 0;
 			queue_ch_frame(ch, PH_DATA_CNF, hh->id, NULL);
@@ -659,7 +692,7 @@ l1loop_l2l1D(struct mISDNchannel *ch, struct sk_buff *skb) {
 		if (IS_ISDN_P_NT(p->protocol))
 			ph_command(p, L1_DEACTIVATE_NT);
 
-		spin_lock(&p->lock);
+		spin_lock_bh(&p->lock);
 		skb_queue_purge(&dch->squeue);
 		if (dch->tx_skb) {
 			dev_kfree_skb(dch->tx_skb);
@@ -670,7 +703,7 @@ l1loop_l2l1D(struct mISDNchannel *ch, struct sk_buff *skb) {
 			dev_kfree_skb(dch->rx_skb);
 			dch->rx_skb = NULL;
 		}
-		spin_unlock(&p->lock);
+		spin_unlock_bh(&p->lock);
 		ret = 0;
 		break;
 	case MPH_INFORMATION_REQ:
@@ -912,6 +945,108 @@ l1loop_dctrl(struct mISDNchannel *ch, u_int cmd, void *arg) {
 	return err;
 }
 
+/*
+ * traffic generator (gen=1)
+ *
+ * Pattern data is fed into every active transparent bchannel as if it
+ * was received from the line, so stack and dsp processing can be
+ * loaded without any hardware. The report rate is computed from a
+ * monotonic clock, not from the tick count, so it stays accurate when
+ * ticks are delayed.
+ */
+#define GEN_TICK	(HZ / 100 + 1)	/* generator interval */
+#define GEN_REPORT	(10 * HZ)	/* throughput report interval */
+
+static struct timer_list gen_tl;
+static struct timer_list churn_tl;
+static ktime_t gen_start;
+static u64 gen_bytes;
+static u64 gen_frames;
+static unsigned long gen_report_to;
+static u8 gen_fill;
+
+static void
+l1loop_gen_tick(struct timer_list *t)
+{
+	struct port *p;
+	struct bchannel *bch;
+	struct sk_buff *skb;
+	u8 *d;
+	int i, b, j, len;
+
+	/* bytes each channel gets this tick at the configured rate */
+	len = genrate * GEN_TICK / HZ;
+	if (len < 1)
+		len = 1;
+	if (len > MAX_DATA_MEM)
+		len = MAX_DATA_MEM;
+
+	for (i = 0; i < interfaces; i++) {
+		p = hw->ports + i;
+		spin_lock(&p->lock);
+		for (b = 0; b < p->nrbchan; b++) {
+			bch = &p->bch[b];
+			if (!test_bit(FLG_ACTIVE, &bch->Flags) ||
+			    !test_bit(FLG_TRANSPARENT, &bch->Flags))
+				continue;
+			/* a pending rx_skb belongs to another delivery
+			 * path, leave it alone
+			 */
+			if (bch->rx_skb)
+				continue;
+			skb = mI_alloc_skb(len, GFP_ATOMIC);
+			if (!skb)
+				continue;
+			d = skb_put(skb, len);
+			if (genpattern)
+				memset(d, genpattern & 0xff, len);
+			else
+				for (j = 0; j < len; j++)
+					d[j] = gen_fill++;
+			bch->rx_skb = skb;
+			recv_Bchannel(bch, MISDN_ID_ANY, false);
+			gen_bytes += len;
+			gen_frames++;
+		}
+		spin_unlock(&p->lock);
+	}
+
+	if (time_after_eq(jiffies, gen_report_to)) {
+		s64 ns = ktime_to_ns(ktime_sub(ktime_get(), gen_start));
+
+		if (ns > 0)
+			printk(KERN_INFO "%s: generated %llu frames, %llu "
+				"bytes (%llu kbit/s)\n", DRIVER_NAME,
+				gen_frames, gen_bytes,
+				div64_u64(gen_bytes * 8 * USEC_PER_SEC, ns));
+		gen_report_to = jiffies + GEN_REPORT;
+	}
+
+	mod_timer(&gen_tl, jiffies + GEN_TICK);
+}
+
+/*
+ * cycle layer 1 of all opened ports through activate/deactivate, using
+ * the driver's own state change path (genchurn=<seconds>)
+ */
+static void
+l1loop_churn_tick(struct timer_list *t)
+{
+	struct port *p;
+	int i;
+
+	for (i = 0; i < interfaces; i++) {
+		p = hw->ports + i;
+		if (!test_bit(FLG_OPEN, &p->dch.Flags))
+			continue;
+		p->dch.state = test_bit(FLG_ACTIVE, &p->dch.Flags) ?
+			VBUS_INACTIVE : VBUS_ACTIVE;
+		schedule_event(&p->dch, FLG_PHCHANGE);
+	}
+
+	mod_timer(&churn_tl, jiffies + genchurn * HZ);
+}
+
 static int
 setup_instance(struct l1loop *hw) {
 	struct port *p;
@@ -1016,7 +1151,7 @@ release_instance(struct l1loop *hw) {
 static int __init
 l1loop_init(void)
 {
-	int i;
+	int i, err;
 
 	if (vline == 3 && (interfaces & 1)) {
 		printk(KERN_ERR "%s: %s: an even number of interfaces are "
@@ -1057,7 +1192,21 @@ l1loop_init(void)
 		return -ENOMEM;
 	}
 
-	return setup_instance(hw);
+	err = setup_instance(hw);
+	if (err)
+		return err;
+
+	timer_setup(&gen_tl, l1loop_gen_tick, 0);
+	timer_setup(&churn_tl, l1loop_churn_tick, 0);
+	if (gen) {
+		gen_start = ktime_get();
+		gen_report_to = jiffies + GEN_REPORT;
+		mod_timer(&gen_tl, jiffies + GEN_TICK);
+	}
+	if (genchurn)
+		mod_timer(&churn_tl, jiffies + genchurn * HZ);
+
+	return 0;
 }
 
 static void __exit
@@ -1066,6 +1215,9 @@ l1loop_cleanup(void)
 	if (debug)
 		printk(KERN_DEBUG DRIVER_NAME ": %s\n", __func__);
 
+	del_timer_sync(&gen_tl);
+	del_timer_sync(&churn_tl);
+
 	release_instance(hw);
 }
 
@@ -282,12 +282,11 @@ diva_irq(int intno, void *dev_id)
 	struct inf_hw *hw = dev_id;
 	u8 val;
 
-	spin_lock(&hw->lock);
+	/* fast dismiss without the card lock */
 	val = inb((u32)hw->cfg.start + DIVA_PCI_CTRL);
-	if (!(val & DIVA_IRQ_BIT)) { /* for us or shared ? */
-		spin_unlock(&hw->lock);
+	if (!(val & DIVA_IRQ_BIT)) /* for us or shared ? */
 		return IRQ_NONE; /* shared */
-	}
+	spin_lock(&hw->lock);
 	hw->irqcnt++;
 	mISDNipac_irq(&hw->ipac, irqloops);
 	spin_unlock(&hw->lock);
@@ -300,12 +299,11 @@ diva20x_irq(int intno, void *dev_id)
 	struct inf_hw *hw = dev_id;
 	u8 val;
 
-	spin_lock(&hw->lock);
+	/* fast dismiss without the card lock */
 	val = readb(hw->cfg.p);
-	if (!(val & PITA_INT0_STATUS)) { /* for us or shared ? */
-		spin_unlock(&hw->lock);
+	if (!(val & PITA_INT0_STATUS)) /* for us or shared ? */
 		return IRQ_NONE; /* shared */
-	}
+	spin_lock(&hw->lock);
 	hw->irqcnt++;
 	mISDNipac_irq(&hw->ipac, irqloops);
 	writeb(PITA_INT0_STATUS, hw->cfg.p); /* ACK PITA INT0 */
@@ -319,12 +317,11 @@ tiger_irq(int intno, void *dev_id)
 	struct inf_hw *hw = dev_id;
 	u8 val;
 
-	spin_lock(&hw->lock);
+	/* fast dismiss without the card lock */
 	val = inb((u32)hw->cfg.start + TIGER_AUX_STATUS);
-	if (val & TIGER_IRQ_BIT) { /* for us or shared ? */
-		spin_unlock(&hw->lock);
+	if (val & TIGER_IRQ_BIT) /* for us or shared ? */
 		return IRQ_NONE; /* shared */
-	}
+	spin_lock(&hw->lock);
 	hw->irqcnt++;
 	mISDNipac_irq(&hw->ipac, irqloops);
 	spin_unlock(&hw->lock);
@@ -337,12 +334,11 @@ elsa_irq(int intno, void *dev_id)
 	struct inf_hw *hw = dev_id;
 	u8 val;
 
-	spin_lock(&hw->lock);
+	/* fast dismiss without the card lock */
 	val = inb((u32)hw->cfg.start + ELSA_IRQ_ADDR);
-	if (!(val & ELSA_IRQ_MASK)) {
-		spin_unlock(&hw->lock);
+	if (!(val & ELSA_IRQ_MASK))
 		return IRQ_NONE; /* shared */
-	}
+	spin_lock(&hw->lock);
 	hw->irqcnt++;
 	mISDNipac_irq(&hw->ipac, irqloops);
 	spin_unlock(&hw->lock);
@@ -355,12 +351,11 @@ niccy_irq(int intno, void *dev_id)
 	struct inf_hw *hw = dev_id;
 	u32 val;
 
-	spin_lock(&hw->lock);
+	/* fast dismiss without the card lock */
 	val = inl((u32)hw->cfg.start + NICCY_IRQ_CTRL_REG);
-	if (!(val & NICCY_IRQ_BIT)) { /* for us or shared ? */
-		spin_unlock(&hw->lock);
+	if (!(val & NICCY_IRQ_BIT)) /* for us or shared ? */
 		return IRQ_NONE; /* shared */
-	}
+	spin_lock(&hw->lock);
 	outl(val, (u32)hw->cfg.start + NICCY_IRQ_CTRL_REG);
 	hw->irqcnt++;
 	mISDNipac_irq(&hw->ipac, irqloops);
@@ -373,8 +368,15 @@ gazel_irq(int intno, void *dev_id)
 {
 	struct inf_hw *hw = dev_id;
 	irqreturn_t ret;
+	u8 val;
 
+	/* fast dismiss without the card lock; the interrupt inputs of
+	 * the PLX bridge show their state in the INTCSR read back */
+	val = inb((u32)hw->cfg.start + GAZEL_INCSR);
+	if (!(val & (GAZEL_INT_ISAC | GAZEL_INT_HSCX)))
+		return IRQ_NONE; /* shared */
 	spin_lock(&hw->lock);
+	hw->irqcnt++;
 	ret = mISDNipac_irq(&hw->ipac, irqloops);
 	spin_unlock(&hw->lock);
 	return ret;
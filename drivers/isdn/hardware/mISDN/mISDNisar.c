@@ -186,7 +186,7 @@ static int
 load_firmware(struct isar_hw *isar, const u8 *buf, int size)
 {
 	u32	saved_debug = isar->ch[0].bch.debug;
-	int	ret, cnt;
+	int	ret, cnt, delay;
 	u8	nom, noc;
 	u16	left, val, *sp = (u16 *)buf;
 	u8	*mp;
@@ -293,9 +293,7 @@ load_firmware(struct isar_hw *isar, const u8 *buf, int size)
 	}
 	isar->ch[0].bch.debug = saved_debug;
 	/* 10ms delay */
-	cnt = 10;
-	while (cnt--)
-		mdelay(1);
+	msleep(10);
 	isar->buf[0] = 0xff;
 	isar->buf[1] = 0xfe;
 	isar->bstat = 0;
@@ -322,12 +320,16 @@ load_firmware(struct isar_hw *isar, const u8 *buf, int size)
 	/* Enable IRQs of ISAR */
 	isar->write_reg(isar->hw, ISAR_IRQBIT, ISAR_IRQSTA);
 	spin_unlock_irqrestore(isar->hwlock, flags);
-	cnt = 1000; /* max 1s */
-	while ((!isar->bstat) && cnt) {
-		mdelay(1);
-		cnt--;
+	/* poll with backoff, max 1s; we run in process context here */
+	delay = 100;
+	cnt = 1000000;
+	while ((!isar->bstat) && cnt > 0) {
+		usleep_range(delay, 2 * delay);
+		cnt -= delay;
+		if (delay < 10000)
+			delay <<= 1;
 	}
-	if (!cnt) {
+	if (cnt <= 0) {
 		pr_info("ISAR no general status event received\n");
 		ret = -ETIME;
 		goto reterrflg;
@@ -335,9 +337,7 @@ load_firmware(struct isar_hw *isar, const u8 *buf, int size)
 		pr_debug("%s: ISAR general status event %x\n",
 			 isar->name, isar->bstat);
 	/* 10ms delay */
-	cnt = 10;
-	while (cnt--)
-		mdelay(1);
+	msleep(10);
 	isar->iis = 0;
 	spin_lock_irqsave(isar->hwlock, flags);
 	if (!send_mbox(isar, ISAR_HIS_DIAG, ISAR_CTRL_STST, 0, NULL)) {
@@ -346,13 +346,17 @@ load_firmware(struct isar_hw *isar, const u8 *buf, int size)
 		goto reterror;
 	}
 	spin_unlock_irqrestore(isar->hwlock, flags);
-	cnt = 10000; /* max 100 ms */
-	while ((isar->iis != ISAR_IIS_DIAG) && cnt) {
-		udelay(10);
-		cnt--;
+	/* poll with backoff, max 100 ms */
+	delay = 50;
+	cnt = 100000;
+	while ((isar->iis != ISAR_IIS_DIAG) && cnt > 0) {
+		usleep_range(delay, 2 * delay);
+		cnt -= delay;
+		if (delay < 5000)
+			delay <<= 1;
 	}
 	mdelay(1);
-	if (!cnt) {
+	if (cnt <= 0) {
 		pr_info("ISAR no self tst response\n");
 		ret = -ETIME;
 		goto reterrflg;
@@ -374,13 +378,17 @@ load_firmware(struct isar_hw *isar, const u8 *buf, int size)
 		goto reterror;
 	}
 	spin_unlock_irqrestore(isar->hwlock, flags);
-	cnt = 30000; /* max 300 ms */
-	while ((isar->iis != ISAR_IIS_DIAG) && cnt) {
-		udelay(10);
-		cnt--;
+	/* poll with backoff, max 300 ms */
+	delay = 50;
+	cnt = 300000;
+	while ((isar->iis != ISAR_IIS_DIAG) && cnt > 0) {
+		usleep_range(delay, 2 * delay);
+		cnt -= delay;
+		if (delay < 5000)
+			delay <<= 1;
 	}
 	mdelay(1);
-	if (!cnt) {
+	if (cnt <= 0) {
 		pr_info("ISAR no SVN response\n");
 		ret = -ETIME;
 		goto reterrflg;
@@ -131,6 +131,12 @@ MODULE_LICENSE("GPL v2");
 MODULE_VERSION(NETJET_REV);
 module_param_call(debug, set_debug, param_get_uint, &debug, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(debug, "Netjet debug mask");
+static uint dmasize = NJ_DMA_TXSIZE;
+module_param(dmasize, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(dmasize, "DMA ring size in dwords per direction "
+		 "(32..512, default 128); small rings give low latency, "
+		 "large rings few interrupts. A new value is taken over "
+		 "per card when both B-channels are down");
 
 static void
 nj_disable_hwirq(struct tiger_hw *card)
@@ -207,6 +213,41 @@ fill_mem(struct tiger_ch *bc, u32 idx, u32 cnt, u32 fill)
 	}
 }
 
+/* clamp the dmasize parameter to a usable ring size */
+static size_t
+nj_ringsize(void)
+{
+	uint size = dmasize;
+
+	if (size < 32)
+		size = 32;
+	if (size > NJ_DMA_SIZE / 8)
+		size = NJ_DMA_SIZE / 8;
+	return size & ~3;
+}
+
+/*
+ * program ring end and half way interrupt watermark of both DMA
+ * directions; must only be called while the DMA engine is stopped
+ */
+static void
+nj_program_dma(struct tiger_hw *card, size_t size)
+{
+	card->send.size = size;
+	card->send.dmaend = card->send.dmastart + (4 * (size - 1));
+	card->send.dmairq = card->send.dmastart + (4 * ((size / 2) - 1));
+	outl(card->send.dmastart, card->base + NJ_DMA_READ_START);
+	outl(card->send.dmairq, card->base + NJ_DMA_READ_IRQ);
+	outl(card->send.dmaend, card->base + NJ_DMA_READ_END);
+
+	card->recv.size = size;
+	card->recv.dmaend = card->recv.dmastart + (4 * (size - 1));
+	card->recv.dmairq = card->recv.dmastart + (4 * ((size / 2) - 1));
+	outl(card->recv.dmastart, card->base + NJ_DMA_WRITE_START);
+	outl(card->recv.dmairq, card->base + NJ_DMA_WRITE_IRQ);
+	outl(card->recv.dmaend, card->base + NJ_DMA_WRITE_END);
+}
+
 static int
 mode_tiger(struct tiger_ch *bc, u32 protocol)
 {
@@ -226,6 +267,10 @@ mode_tiger(struct tiger_ch *bc, u32 protocol)
 			card->dmactrl = 0;
 			outb(card->dmactrl, card->base + NJ_DMACTRL);
 			outb(0, card->base + NJ_IRQMASK0);
+			/* engine is stopped; take over a changed ring
+			 * size for the next activation */
+			if (card->send.size != nj_ringsize())
+				nj_program_dma(card, nj_ringsize());
 		}
 		test_and_clear_bit(FLG_HDLC, &bc->bch.Flags);
 		test_and_clear_bit(FLG_TRANSPARENT, &bc->bch.Flags);
@@ -321,12 +366,14 @@ inittiger(struct tiger_hw *card)
 		return -ENOMEM;
 	}
 	for (i = 0; i < 2; i++) {
-		card->bc[i].hsbuf = kmalloc(NJ_DMA_TXSIZE, GFP_ATOMIC);
+		/* sized for the maximal ring so a ring size change
+		 * needs no reallocation */
+		card->bc[i].hsbuf = kmalloc(NJ_DMA_SIZE / 8, GFP_ATOMIC);
 		if (!card->bc[i].hsbuf) {
 			pr_info("%s: no B%d send buffer\n", card->name, i + 1);
 			return -ENOMEM;
 		}
-		card->bc[i].hrbuf = kmalloc(NJ_DMA_RXSIZE, GFP_ATOMIC);
+		card->bc[i].hrbuf = kmalloc(NJ_DMA_SIZE / 8, GFP_ATOMIC);
 		if (!card->bc[i].hrbuf) {
 			pr_info("%s: no B%d recv buffer\n", card->name, i + 1);
 			return -ENOMEM;
@@ -336,39 +383,20 @@ inittiger(struct tiger_hw *card)
 
 	card->send.start = card->dma_p;
 	card->send.dmastart = (u32)card->dma;
-	card->send.dmaend = card->send.dmastart +
-		(4 * (NJ_DMA_TXSIZE - 1));
-	card->send.dmairq = card->send.dmastart +
-		(4 * ((NJ_DMA_TXSIZE / 2) - 1));
-	card->send.size = NJ_DMA_TXSIZE;
+	card->recv.start = card->dma_p + (NJ_DMA_SIZE / 2);
+	card->recv.dmastart = (u32)card->dma  + (NJ_DMA_SIZE / 2);
+	nj_program_dma(card, nj_ringsize());
 
-	if (debug & DEBUG_HW)
+	if (debug & DEBUG_HW) {
 		pr_notice("%s: send buffer phy %#x - %#x - %#x  virt %p"
 			  " size %zu u32\n", card->name,
 			  card->send.dmastart, card->send.dmairq,
 			  card->send.dmaend, card->send.start, card->send.size);
-
-	outl(card->send.dmastart, card->base + NJ_DMA_READ_START);
-	outl(card->send.dmairq, card->base + NJ_DMA_READ_IRQ);
-	outl(card->send.dmaend, card->base + NJ_DMA_READ_END);
-
-	card->recv.start = card->dma_p + (NJ_DMA_SIZE / 2);
-	card->recv.dmastart = (u32)card->dma  + (NJ_DMA_SIZE / 2);
-	card->recv.dmaend = card->recv.dmastart +
-		(4 * (NJ_DMA_RXSIZE - 1));
-	card->recv.dmairq = card->recv.dmastart +
-		(4 * ((NJ_DMA_RXSIZE / 2) - 1));
-	card->recv.size = NJ_DMA_RXSIZE;
-
-	if (debug & DEBUG_HW)
 		pr_notice("%s: recv buffer phy %#x - %#x - %#x  virt %p"
 			  " size %zu u32\n", card->name,
 			  card->recv.dmastart, card->recv.dmairq,
 			  card->recv.dmaend, card->recv.start, card->recv.size);
-
-	outl(card->recv.dmastart, card->base + NJ_DMA_WRITE_START);
-	outl(card->recv.dmairq, card->base + NJ_DMA_WRITE_IRQ);
-	outl(card->recv.dmaend, card->base + NJ_DMA_WRITE_END);
+	}
 	return 0;
 }
 
@@ -509,6 +509,11 @@ static struct pci_driver sfaxpci_driver = {
 	.probe = sfaxpci_probe,
 	.remove = sfax_remove_pci,
 	.id_table = sfaxpci_ids,
+	/* the ISAR firmware download dominates probe time, so let
+	 * multiple cards load it in parallel */
+	.driver = {
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
+	},
 };
 
 static int __init
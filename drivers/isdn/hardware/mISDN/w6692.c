@@ -503,7 +503,7 @@ W6692_fill_Bfifo(struct w6692_ch *wch)
 {
 	struct w6692_hw *card = wch->bch.hw;
 	int count, fillempty = 0;
-	u8 *ptr, cmd = W_B_CMDR_RACT | W_B_CMDR_XMS;
+	u8 *ptr, star, cmd;
 
 	pr_debug("%s: fill Bfifo\n", card->name);
 	if (!wch->bch.tx_skb) {
@@ -512,7 +512,10 @@ W6692_fill_Bfifo(struct w6692_ch *wch)
 		ptr = wch->bch.fill;
 		count = W_B_FIFO_THRESH;
 		fillempty = 1;
-	} else {
+	}
+next_chunk:
+	cmd = W_B_CMDR_RACT | W_B_CMDR_XMS;
+	if (!fillempty) {
 		count = wch->bch.tx_skb->len - wch->bch.tx_idx;
 		if (count <= 0)
 			return;
@@ -540,6 +543,18 @@ W6692_fill_Bfifo(struct w6692_ch *wch)
 			 wch->bch.nr, card->name, count);
 		print_hex_dump_bytes(card->log, DUMP_PREFIX_OFFSET, ptr, count);
 	}
+	/*
+	 * the transmit fifo consists of two W_B_FIFO_THRESH sized halves;
+	 * if the chip has already accepted this chunk, stage the next one
+	 * into the other half now instead of waiting for its XFR interrupt,
+	 * so one interrupt latency worth of data is always prebuffered
+	 */
+	if (!fillempty && !(cmd & W_B_CMDR_XME) &&
+	    wch->bch.tx_idx < wch->bch.tx_skb->len) {
+		star = ReadW6692B(wch, W_B_STAR);
+		if (!(star & W_B_STAR_XBZ))
+			goto next_chunk;
+	}
 }
 
 #if 0
@@ -472,6 +472,48 @@ write_xhfcregptr(struct xhfc *xhfc, __u8 reg_addr)
 {
 }
 
+/*
+ * writes a fifo data block with DWORD PCI cycles. The bridge splits each
+ * 32 bit access into four 8 bit write cycles at the local bus (spaced by
+ * the pause_seq timing), so one PCI transaction moves four fifo bytes.
+ * A remainder of less than four bytes is written with single byte cycles.
+ */
+inline void
+xhfc_write_fifo_burst(struct xhfc *xhfc, __u8 *data, int len)
+{
+	volatile __u8 *port = (volatile __u8 *)
+	    (xhfc->pi->membase + PCI2PI_XHFC_OFFSETS[xhfc->chipidx] +
+	     (A_FIFO_DATA << 2));
+	int i = 0;
+
+	while ((len - i) >= 4) {
+		*((volatile __u32 *) port) = *((__u32 *) (data + i));
+		i += 4;
+	}
+	while (i < len)
+		*port = *(data + (i++));
+}
+
+/*
+ * reads a fifo data block with DWORD PCI cycles, the counterpart of
+ * xhfc_write_fifo_burst()
+ */
+inline void
+xhfc_read_fifo_burst(struct xhfc *xhfc, __u8 *data, int len)
+{
+	volatile __u8 *port = (volatile __u8 *)
+	    (xhfc->pi->membase + PCI2PI_XHFC_OFFSETS[xhfc->chipidx] +
+	     (A_FIFO_DATA << 2));
+	int i = 0;
+
+	while ((len - i) >= 4) {
+		*((__u32 *) (data + i)) = *((volatile __u32 *) port);
+		i += 4;
+	}
+	while (i < len)
+		*(data + (i++)) = *port;
+}
+
 #endif /* PI_MODE==PI_INTELMX || PI_MODE==PI_MOTMX */
 
 /*****************************************************************************/
@@ -603,6 +645,55 @@ write_xhfcregptr(struct xhfc *xhfc, __u8 reg_addr)
 	    reg_addr;
 }
 
+/*
+ * writes a fifo data block. The register address pointer is selected only
+ * once for the whole block, then the data moves with 32 bit PCI cycles
+ * which the bridge converts to four 8 bit write cycles each at the local
+ * bus. A remainder of less than four bytes is written with byte cycles.
+ * The whole block forms one non interruptible register access sequence.
+ */
+inline void
+xhfc_write_fifo_burst(struct xhfc *xhfc, __u8 *data, int len)
+{
+	volatile __u8 *port = (volatile __u8 *)
+	    (xhfc->pi->membase + PCI2PI_XHFC_OFFSETS[xhfc->chipidx]);
+	u_long flags;
+	int i = 0;
+
+	spin_lock_irqsave(&xhfc->pi->lock, flags);
+	*((volatile __u8 *) (port + 4)) = A_FIFO_DATA;
+	while ((len - i) >= 4) {
+		*((volatile __u32 *) port) = *((__u32 *) (data + i));
+		i += 4;
+	}
+	while (i < len)
+		*port = *(data + (i++));
+	spin_unlock_irqrestore(&xhfc->pi->lock, flags);
+}
+
+/*
+ * reads a fifo data block with a single register address select, the
+ * counterpart of xhfc_write_fifo_burst()
+ */
+inline void
+xhfc_read_fifo_burst(struct xhfc *xhfc, __u8 *data, int len)
+{
+	volatile __u8 *port = (volatile __u8 *)
+	    (xhfc->pi->membase + PCI2PI_XHFC_OFFSETS[xhfc->chipidx]);
+	u_long flags;
+	int i = 0;
+
+	spin_lock_irqsave(&xhfc->pi->lock, flags);
+	*((volatile __u8 *) (port + 4)) = A_FIFO_DATA;
+	while ((len - i) >= 4) {
+		*((__u32 *) (data + i)) = *((volatile __u32 *) port);
+		i += 4;
+	}
+	while (i < len)
+		*(data + (i++)) = *port;
+	spin_unlock_irqrestore(&xhfc->pi->lock, flags);
+}
+
 #endif /* PI_MODE==PI_INTELNOMX || PI_MODE==PI_MOT */
 
 
@@ -807,4 +898,102 @@ write_xhfcregptr(struct xhfc *xhfc, __u8 reg_addr)
 	spin_unlock_irqrestore(&xhfc->pi->lock, flags);
 }
 
+/*
+ * writes a fifo data block by using a SPI multiple write access. The
+ * address and command phases are clocked out only once, then the data
+ * bytes follow back to back in 32 clock transfers while SPISEL stays
+ * active. A remainder of less than four bytes uses 8 clock transfers.
+ */
+inline void
+xhfc_write_fifo_burst(struct xhfc *xhfc, __u8 *data, int len)
+{
+	u_long flags;
+	int i = 0;
+
+	spin_lock_irqsave(&xhfc->pi->lock, flags);
+
+	// wait until SPI master is idle
+	while (!(ReadPCI2PI_u32(xhfc->pi, PCI2PI_SPI_STATUS) & 1));
+	// initiate a 16 clock SPI master transfer
+	WritePCI2PI_u16(xhfc->pi, PCI2PI_SPI_MO_DATA,
+			((SPI_ADDR | SPI_WR | xhfc->
+			  chipidx) << 8) | A_FIFO_DATA);
+	// wait until SPI master is idle
+	while (!(ReadPCI2PI_u32(xhfc->pi, PCI2PI_SPI_STATUS) & 1));
+	// initiate a 8 clock SPI master transfer
+	WritePCI2PI_u8(xhfc->pi, PCI2PI_SPI_MO_DATA,
+		       (SPI_DATA | SPI_WR | SPI_MULTI));
+
+	while ((len - i) >= 4) {
+		// wait until SPI master is idle
+		while (!(ReadPCI2PI_u32(xhfc->pi, PCI2PI_SPI_STATUS) & 1));
+		// initiate a 32 clock SPI master transfer
+		WritePCI2PI_u32(xhfc->pi, PCI2PI_SPI_MO_DATA,
+				cpu_to_be32(*((__u32 *) (data + i))));
+		i += 4;
+	}
+	while (i < len) {
+		// wait until SPI master is idle
+		while (!(ReadPCI2PI_u32(xhfc->pi, PCI2PI_SPI_STATUS) & 1));
+		// initiate a 8 clock SPI master transfer
+		WritePCI2PI_u8(xhfc->pi, PCI2PI_SPI_MO_DATA,
+			       *(data + (i++)));
+	}
+
+	spin_unlock_irqrestore(&xhfc->pi->lock, flags);
+}
+
+/*
+ * reads a fifo data block by using a SPI multiple read access, the
+ * counterpart of xhfc_write_fifo_burst()
+ */
+inline void
+xhfc_read_fifo_burst(struct xhfc *xhfc, __u8 *data, int len)
+{
+	u_long flags;
+	int i = 0;
+
+	spin_lock_irqsave(&xhfc->pi->lock, flags);
+
+	// wait until SPI master is idle
+	while (!(ReadPCI2PI_u32(xhfc->pi, PCI2PI_SPI_STATUS) & 1));
+	// initiate a 16 clock SPI master transfer
+	WritePCI2PI_u16(xhfc->pi, PCI2PI_SPI_MO_DATA,
+			((SPI_ADDR | SPI_WR | xhfc->
+			  chipidx) << 8) | A_FIFO_DATA);
+	// wait until SPI master is idle
+	while (!(ReadPCI2PI_u32(xhfc->pi, PCI2PI_SPI_STATUS) & 1));
+	// initiate a 8 clock SPI master transfer
+	WritePCI2PI_u8(xhfc->pi, PCI2PI_SPI_MO_DATA,
+		       (SPI_DATA | SPI_RD | SPI_MULTI));
+
+	while ((len - i) >= 4) {
+		// wait until SPI master is idle
+		while (!(ReadPCI2PI_u32(xhfc->pi, PCI2PI_SPI_STATUS) & 1));
+		// initiate a 32 clock SPI master transfer
+		// output data is arbitrary
+		WritePCI2PI_u32(xhfc->pi, PCI2PI_SPI_MO_DATA, 0);
+		// wait until SPI master is idle
+		while (!(ReadPCI2PI_u32(xhfc->pi, PCI2PI_SPI_STATUS) & 1));
+		// read four bytes from the SPI data receive register
+		*((__u32 *) (data + i)) =
+		    be32_to_cpu(ReadPCI2PI_u32(xhfc->pi,
+					       PCI2PI_SPI_MI_DATA));
+		i += 4;
+	}
+	while (i < len) {
+		// wait until SPI master is idle
+		while (!(ReadPCI2PI_u32(xhfc->pi, PCI2PI_SPI_STATUS) & 1));
+		// initiate a 8 clock SPI master transfer
+		WritePCI2PI_u8(xhfc->pi, PCI2PI_SPI_MO_DATA, 0);
+		// wait until SPI master is idle
+		while (!(ReadPCI2PI_u32(xhfc->pi, PCI2PI_SPI_STATUS) & 1));
+		// read one byte from the SPI data receive register
+		*(data + (i++)) =
+		    ReadPCI2PI_u32(xhfc->pi, PCI2PI_SPI_MI_DATA) & 0xFF;
+	}
+
+	spin_unlock_irqrestore(&xhfc->pi->lock, flags);
+}
+
 #endif /* PI_MODE == PI_SPI */
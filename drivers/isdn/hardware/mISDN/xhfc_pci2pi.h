@@ -326,4 +326,8 @@ __u8 sread_xhfc(struct xhfc *, __u8 reg_addr);
 void write_xhfcregptr(struct xhfc *, __u8 reg_addr);
 __u8 read_xhfcregptr(struct xhfc *);
 
+/* prototypes: bulk fifo data transfers */
+void xhfc_write_fifo_burst(struct xhfc *, __u8 *data, int len);
+void xhfc_read_fifo_burst(struct xhfc *, __u8 *data, int len);
+
 #endif /* _XHFC_PCI2PI_H_ */
@@ -1486,22 +1486,7 @@ xhfc_write_fifo(struct xhfc *xhfc, __u8 channel)
 		}
 
 		/* write data to FIFO */
-		i = 0;
-		while (i < tcnt) {
-                        write_xhfc(xhfc, A_FIFO_DATA, *(data + i));
-                        i++;
-		        /*
-		        // optimized bulk writes
-			if ((tcnt - i) >= 4) {
-				write32_xhfc(xhfc, A_FIFO_DATA,
-					     *((__u32 *) (data + i)));
-				i += 4;
-			} else {
-				write_xhfc(xhfc, A_FIFO_DATA, *(data + i));
-				i++;
-			}
-			*/
-		}
+		xhfc_write_fifo_burst(xhfc, data, tcnt);
 
 		/* skb data complete */
 		if (*tx_idx == (*tx_skb)->len) {
@@ -1675,22 +1660,7 @@ xhfc_read_fifo(struct xhfc *xhfc, __u8 channel)
 		data = skb_put(*rx_skb, rcnt);
 
 		/* read data from FIFO */
-		i = 0;
-		while (i < rcnt) {
-		        *(data + i) = read_xhfc(xhfc, A_FIFO_DATA);
-		        i++;
-        		/*
-        		// optimized bulk reads:
-			if ((rcnt - i) >= 4) {
-				*((__u32 *) (data + i)) =
-				    read32_xhfc(xhfc, A_FIFO_DATA);
-				i += 4;
-			} else {
-				*(data + i) = read_xhfc(xhfc, A_FIFO_DATA);
-				i++;
-			}
-                        */
-		}
+		xhfc_read_fifo_burst(xhfc, data, rcnt);
 	} else {
 		spin_unlock(&port->lock);
 		return;
@@ -37,6 +37,7 @@
 #include <linux/types.h>
 #include <linux/stddef.h>
 #include <linux/spinlock.h>
+#include <linux/seqlock.h>
 #include <linux/ktime.h>
 #include <linux/mISDNif.h>
 #include <linux/export.h>
@@ -44,7 +45,12 @@
 
 static u_int *debug;
 static LIST_HEAD(iclock_list);
-static DEFINE_RWLOCK(iclock_lock);
+static DEFINE_RWLOCK(iclock_lock);	/* source list and selection */
+/* counter/timestamp pair published by the source, read all over:
+ * the 8kHz tick and every reader would serialize on iclock_lock,
+ * the seqlock lets readers run without ever touching a lock
+ */
+static DEFINE_SEQLOCK(iclock_seq);
 static u16 iclock_count;		/* counter of last clock */
 static ktime_t iclock_timestamp;	/* time stamp of last clock */
 static int iclock_timestamp_valid;	/* already received one timestamp */
@@ -87,7 +93,9 @@ select_iclock(void)
 	}
 	if (bestclock != iclock_current) {
 		/* no clock received yet */
+		write_seqlock(&iclock_seq);
 		iclock_timestamp_valid = 0;
+		write_sequnlock(&iclock_seq);
 	}
 	iclock_current = bestclock;
 }
@@ -146,16 +154,21 @@ mISDN_clock_update(struct mISDNclock *iclock, int samples, ktime_t *timestamp)
 	ktime_t		timestamp_now;
 	u16		delta;
 
-	write_lock_irqsave(&iclock_lock, flags);
+	/* The tick only reads the selection, so a shared lock is enough
+	 * to fence against unregistration; concurrent readers of the
+	 * counter pair no longer serialize with us at all.
+	 */
+	read_lock_irqsave(&iclock_lock, flags);
 	if (iclock_current != iclock) {
 		printk(KERN_ERR "%s: '%s' sends us clock updates, but we do "
 		       "listen to '%s'. This is a bug!\n", __func__,
 		       iclock->name,
 		       iclock_current ? iclock_current->name : "nothing");
 		iclock->ctl(iclock->priv, 0);
-		write_unlock_irqrestore(&iclock_lock, flags);
+		read_unlock_irqrestore(&iclock_lock, flags);
 		return;
 	}
+	write_seqlock(&iclock_seq);
 	if (iclock_timestamp_valid) {
 		/* increment sample counter by given samples */
 		iclock_count += samples;
@@ -181,26 +194,28 @@ mISDN_clock_update(struct mISDNclock *iclock, int samples, ktime_t *timestamp)
 			printk("Received first clock from source '%s'.\n",
 			       iclock_current ? iclock_current->name : "nothing");
 	}
-	write_unlock_irqrestore(&iclock_lock, flags);
+	write_sequnlock(&iclock_seq);
+	read_unlock_irqrestore(&iclock_lock, flags);
 }
 EXPORT_SYMBOL(mISDN_clock_update);
 
 unsigned short
 mISDN_clock_get(void)
 {
-	u_long		flags;
-	ktime_t		timestamp_now;
+	ktime_t		timestamp;
 	u16		delta;
 	u16		count;
+	unsigned int	seq;
 
-	read_lock_irqsave(&iclock_lock, flags);
-	/* calc elapsed time by system clock */
-	timestamp_now = ktime_get();
-	delta = ktime_divns(ktime_sub(timestamp_now, iclock_timestamp),
+	/* lockless snapshot of the counter pair; retry on a torn read */
+	do {
+		seq = read_seqbegin(&iclock_seq);
+		count = iclock_count;
+		timestamp = iclock_timestamp;
+	} while (read_seqretry(&iclock_seq, seq));
+	/* calc elapsed time by system clock and add to counter */
+	delta = ktime_divns(ktime_sub(ktime_get(), timestamp),
 			(NSEC_PER_SEC / 8000));
-	/* add elapsed time to counter */
-	count =	iclock_count + delta;
-	read_unlock_irqrestore(&iclock_lock, flags);
-	return count;
+	return count + delta;
 }
 EXPORT_SYMBOL(mISDN_clock_get);
@@ -16,7 +16,9 @@
 #include <linux/types.h>
 #include <linux/stddef.h>
 #include <linux/module.h>
+#include <linux/sched.h>
 #include <linux/spinlock.h>
+#include <linux/rcupdate.h>
 #include <linux/mISDNif.h>
 #include "core.h"
 
@@ -29,6 +31,13 @@ module_param(debug, uint, S_IRUGO | S_IWUSR);
 static u64		device_ids;
 #define MAX_DEVICE_ID	63
 
+/* id-indexed registry: every socket bind and IMGETDEVINFO looks a
+ * device up, so readers go through RCU and never contend with each
+ * other or with (un)registration. The id space is only 64 entries,
+ * a flat slot array replaces any tree.
+ */
+static struct mISDNdevice __rcu *mdevices[MAX_DEVICE_ID + 1];
+
 static LIST_HEAD(Bprotocols);
 static DEFINE_RWLOCK(bp_lock);
 
@@ -122,6 +131,74 @@ static ssize_t name_set(struct device *dev, struct device_attribute *attr,
 static DEVICE_ATTR_RW(name);
 #endif
 
+static ssize_t stack_batch_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct mISDNdevice *mdev = dev_to_mISDN(dev);
+
+	if (!mdev || !mdev->D.st)
+		return -ENODEV;
+	return sprintf(buf, "%d\n", mdev->D.st->batchlim);
+}
+
+static ssize_t stack_batch_store(struct device *dev,
+				 struct device_attribute *attr,
+				 const char *buf, size_t count)
+{
+	struct mISDNdevice *mdev = dev_to_mISDN(dev);
+	u_int val;
+	int err;
+
+	if (!mdev || !mdev->D.st)
+		return -ENODEV;
+	err = kstrtouint(buf, 0, &val);
+	if (err)
+		return err;
+	if (val < 1)
+		return -EINVAL;
+	mdev->D.st->batchlim = val;
+	return count;
+}
+static DEVICE_ATTR_RW(stack_batch);
+
+static ssize_t stack_cpus_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	struct mISDNdevice *mdev = dev_to_mISDN(dev);
+
+	if (!mdev || !mdev->D.st)
+		return -ENODEV;
+	return cpumap_print_to_pagebuf(true, buf, &mdev->D.st->threadmask);
+}
+
+static ssize_t stack_cpus_store(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t count)
+{
+	struct mISDNdevice *mdev = dev_to_mISDN(dev);
+	cpumask_var_t mask;
+	int err;
+
+	if (!mdev || !mdev->D.st || !mdev->D.st->thread)
+		return -ENODEV;
+	if (!alloc_cpumask_var(&mask, GFP_KERNEL))
+		return -ENOMEM;
+	err = cpulist_parse(buf, mask);
+	if (err)
+		goto out;
+	if (!cpumask_intersects(mask, cpu_online_mask)) {
+		err = -EINVAL;
+		goto out;
+	}
+	err = set_cpus_allowed_ptr(mdev->D.st->thread, mask);
+	if (!err)
+		cpumask_copy(&mdev->D.st->threadmask, mask);
+out:
+	free_cpumask_var(mask);
+	return err ? err : count;
+}
+static DEVICE_ATTR_RW(stack_cpus);
+
 static ssize_t channelmap_show(struct device *dev,
 			       struct device_attribute *attr, char *buf)
 {
@@ -144,6 +221,8 @@ static struct attribute *mISDN_attrs[] = {
 	&dev_attr_channelmap.attr,
 	&dev_attr_nrbchan.attr,
 	&dev_attr_name.attr,
+	&dev_attr_stack_batch.attr,
+	&dev_attr_stack_cpus.attr,
 	NULL,
 };
 ATTRIBUTE_GROUPS(mISDN);
@@ -175,38 +254,32 @@ static struct class mISDN_class = {
 	.class_release = mISDN_class_release,
 };
 
-static int
-_get_mdevice(struct device *dev, const void *id)
-{
-	struct mISDNdevice *mdev = dev_to_mISDN(dev);
-
-	if (!mdev)
-		return 0;
-	if (mdev->id != *(const u_int *)id)
-		return 0;
-	return 1;
-}
-
 struct mISDNdevice
 *get_mdevice(u_int id)
 {
-	return dev_to_mISDN(class_find_device(&mISDN_class, NULL, &id,
-					      _get_mdevice));
-}
+	struct mISDNdevice	*dev;
 
-static int
-_get_mdevice_count(struct device *dev, void *cnt)
-{
-	*(int *)cnt += 1;
-	return 0;
+	if (id > MAX_DEVICE_ID)
+		return NULL;
+	rcu_read_lock();
+	dev = rcu_dereference(mdevices[id]);
+	if (dev)
+		get_device(&dev->dev);
+	rcu_read_unlock();
+	return dev;
 }
 
 int
 get_mdevice_count(void)
 {
-	int cnt = 0;
+	int	cnt = 0;
+	u_int	i;
 
-	class_for_each_device(&mISDN_class, NULL, &cnt, _get_mdevice_count);
+	rcu_read_lock();
+	for (i = 0; i <= MAX_DEVICE_ID; i++)
+		if (rcu_access_pointer(mdevices[i]))
+			cnt++;
+	rcu_read_unlock();
 	return cnt;
 }
 
@@ -234,6 +307,15 @@ mISDN_register_device(struct mISDNdevice *dev,
 		goto error1;
 	dev->id = err;
 
+	/* all tx allocation helpers reserve the announced headroom, so
+	 * frames reach the hardware without reallocating for its headers
+	 */
+	if (dev->headroom > MISDN_MAX_HEADROOM) {
+		printk(KERN_WARNING "mISDN%d: headroom %d exceeds max %d\n",
+		       dev->id, dev->headroom, MISDN_MAX_HEADROOM);
+		dev->headroom = MISDN_MAX_HEADROOM;
+	}
+
 	device_initialize(&dev->dev);
 	if (name && name[0])
 		dev_set_name(&dev->dev, "%s", name);
@@ -254,6 +336,7 @@ mISDN_register_device(struct mISDNdevice *dev,
 	err = device_add(&dev->dev);
 	if (err)
 		goto error3;
+	rcu_assign_pointer(mdevices[dev->id], dev);
 	return 0;
 
 error3:
@@ -270,6 +353,11 @@ mISDN_unregister_device(struct mISDNdevice *dev) {
 	if (debug & DEBUG_CORE)
 		printk(KERN_DEBUG "mISDN_unregister %s %d\n",
 		       dev_name(&dev->dev), dev->id);
+	/* unpublish first: a lookup that still saw the old pointer has
+	 * grabbed its device reference before the grace period ends
+	 */
+	RCU_INIT_POINTER(mdevices[dev->id], NULL);
+	synchronize_rcu();
 	/* sysfs_remove_link(&dev->dev.kobj, "device"); */
 	device_del(&dev->dev);
 	dev_set_drvdata(&dev->dev, NULL);
@@ -419,6 +507,7 @@ static void mISDN_cleanup(void)
 	Isdnl2_cleanup();
 	l1_cleanup();
 	mISDN_timer_cleanup();
+	mISDN_stack_cleanup();
 	class_unregister(&mISDN_class);
 
 	printk(KERN_DEBUG "mISDNcore unloaded\n");
@@ -57,10 +57,13 @@ extern void	delete_teimanager(struct mISDNchannel *);
 extern void	delete_channel(struct mISDNchannel *);
 extern void	delete_stack(struct mISDNdevice *);
 extern void	mISDN_initstack(u_int *);
+extern void	mISDN_stack_cleanup(void);
 extern int      misdn_sock_init(u_int *);
 extern void     misdn_sock_cleanup(void);
+extern void	mISDN_base_event(u_int dev_id, u_int event, u_int data);
 extern void	add_layer2(struct mISDNchannel *, struct mISDNstack *);
 extern void	__add_layer2(struct mISDNchannel *, struct mISDNstack *);
+extern void	__remove_layer2(struct mISDNchannel *, struct mISDNstack *);
 
 extern u_int		get_all_Bprotocols(void);
 struct Bprotocol	*get_Bprotocol4mask(u_int);
@@ -35,7 +35,8 @@
 extern int dsp_options;
 extern int dsp_debug;
 extern int dsp_poll;
-extern int dsp_tics;
+extern int dsp_gate;
+extern ktime_t dsp_spl_period;
 extern spinlock_t dsp_lock;
 extern struct work_struct dsp_workq;
 extern u32 dsp_poll_diff; /* calculated fix-comma corrected poll value */
@@ -75,10 +76,8 @@ extern u8 dsp_silence;
    is reduced by that delay */
 #define MAX_SECONDS_JITTER_CHECK 5
 
-extern struct timer_list dsp_spl_tl;
-
-/* the datatype need to match jiffies datatype */
-extern unsigned long dsp_spl_jiffies;
+extern struct hrtimer dsp_spl_tl;
+extern enum hrtimer_restart dsp_cmx_send(struct hrtimer *t);
 
 /* the structure of conferences:
  *
@@ -93,18 +92,41 @@ struct dsp;
 struct dsp_conf_member {
 	struct list_head	list;
 	struct dsp		*dsp;
+	int			idle; /* contributed no audio this tick:
+				       * empty rx window, or held below the
+				       * energy gate */
+	int			hang; /* gate hangover, ticks the member
+				       * stays active after falling quiet */
+	struct rcu_head		rcu;
 };
 
 /* the list of all conferences */
 struct dsp_conf {
 	struct list_head	list;
+	struct hlist_node	hnode; /* ID index bucket (dsp_conf_idx) */
 	u32			id;
 	/* all cmx stacks with the same ID are
 	   connected */
 	struct list_head	mlist;
+	/* tap subscribers: dsps that receive clones of the summed
+	   frame but contribute no audio, same locking as mlist */
+	struct list_head	tlist;
+	spinlock_t		lock; /* protects mlist writers, readers
+					 walk it under rcu_read_lock() */
 	int			software; /* conf is processed by software */
 	int			hardware; /* conf is processed by hardware */
 	/* note: if both unset, has only one member */
+	struct work_struct	mixwork; /* parallel mixing of this conf */
+	u16			mix_len; /* arguments for the mix worker */
+	int			mix_members;
+	u8			*arena; /* packed member rx rings */
+	int			arena_slots;
+	u8			idle_frame[MAX_POLL + 100]; /* shared tx frame
+					of all members with silent rx */
+	int			idle_valid;
+	s32			mixbuffer[MAX_POLL + 100];
+	struct rcu_head		rcu; /* lookups run lockless, free after
+				      * the grace period */
 };
 
 
@@ -112,7 +134,7 @@ struct dsp_conf {
  * DTMF stuff *
  **************/
 
-#define DSP_DTMF_NPOINTS 102
+#include "dtmf_engine.h"
 
 #define ECHOCAN_BUFF_SIZE 0x400 /* must be 2**n */
 #define ECHOCAN_BUFF_MASK 0x3ff /* -1 */
@@ -122,11 +144,7 @@ struct dsp_dtmf {
 	int		treshold; /* above this is dtmf (square of) */
 	int		software; /* dtmf uses software decoding */
 	int		hardware; /* dtmf uses hardware decoding */
-	int		size; /* number of bytes in buffer */
-	signed short	buffer[DSP_DTMF_NPOINTS];
-	/* buffers one full dtmf frame */
-	u8		lastwhat, lastdigit;
-	int		count;
+	struct dtmf_engine eng; /* shared block detector */
 	u8		digits[16]; /* dtmf result */
 };
 
@@ -134,9 +152,14 @@ struct dsp_dtmf {
 /******************
  * pipeline stuff *
  ******************/
+
+/* one built generation of element instances, defined in dsp_pipeline.c;
+ * reconfiguration publishes a fresh generation and retires the old one
+ * behind the rcu readers, so frames never see a half built pipeline */
+struct dsp_pipeline_set;
+
 struct dsp_pipeline {
-	rwlock_t  lock;
-	struct list_head list;
+	struct dsp_pipeline_set __rcu *set;
 	int inuse;
 };
 
@@ -172,42 +195,55 @@ struct dsp {
 	struct mISDNchannel	ch;
 	struct mISDNchannel	*up;
 	unsigned char	name[64];
-	int		b_active;
-	struct dsp_echo	echo;
-	int		rx_disabled; /* what the user wants */
-	int		rx_is_off; /* what the card is */
-	int		tx_mix;
-	struct dsp_tone	tone;
-	struct dsp_dtmf	dtmf;
-	int		tx_volume, rx_volume;
 
-	/* queue for sending frames */
-	struct work_struct	workq;
-	struct sk_buff_head	sendq;
+	/* hot per interval state: dsp_cmx_send_member() and the receive
+	 * fast path touch only these members in the common case. The
+	 * span is guarded by the static_asserts below the struct, so a
+	 * new member put here by accident breaks the build instead of
+	 * silently growing the per-tick working set.
+	 */
+	int		b_active ____cacheline_aligned;
 	int		hdlc;	/* if mode is hdlc */
-	int		data_pending;	/* currently an unconfirmed frame */
-
-	/* conference stuff */
-	u32		conf_id;
+	int		tx_mix;
+	int		tx_data; /* enables tx-data of CMX to upper layer */
+	int		last_tx; /* if set, we transmitted last poll interval */
+	int		rx_disabled; /* what the user wants */
+	int		rx_passthru; /* no rx processing needed at all */
 	struct dsp_conf	*conf;
 	struct dsp_conf_member
 	*member;
-
-	/* buffer stuff */
+	u8		*rx_buff; /* points into the conf arena, if packed */
+	struct dsp_echo	echo;
+	spinlock_t	rx_lock; /* rx ring pointers: receive vs. timer */
+	u32		rx_energy; /* mean magnitude of last rx chunk */
 	int		rx_W; /* current write pos for data without timestamp */
 	int		rx_R; /* current read pos for transmit clock */
 	int		rx_init; /* if set, pointers will be adjusted first */
 	int		tx_W; /* current write pos for transmit data */
 	int		tx_R; /* current read pos for transmit clock */
-	int		rx_delay[MAX_SECONDS_JITTER_CHECK];
-	int		tx_delay[MAX_SECONDS_JITTER_CHECK];
-	u8		tx_buff[CMX_BUFF_SIZE];
-	u8		rx_buff[CMX_BUFF_SIZE];
-	int		last_tx; /* if set, we transmitted last poll interval */
+
+	/* cold configuration and bookkeeping */
+	int		rx_is_off; /* what the card is */
+	struct dsp_tone	tone;
+	struct dsp_dtmf	dtmf;
+	int		tx_volume, rx_volume;
+	int		data_pending;	/* currently an unconfirmed frame */
+	u32		conf_id;
+	u32		tap_id; /* conference we monitor (or 0) */
+	struct dsp_conf	*tap_conf;
+	struct dsp_conf_member	*tap_member;
 	int		cmx_delay; /* initial delay of buffers,
 				      or 0 for dynamic jitter buffer */
 	int		tx_dejitter; /* if set, dejitter tx buffer */
-	int		tx_data; /* enables tx-data of CMX to upper layer */
+	int		rx_delay[MAX_SECONDS_JITTER_CHECK];
+	int		tx_delay[MAX_SECONDS_JITTER_CHECK];
+
+	/* queue for sending frames */
+	struct work_struct	workq;
+	struct sk_buff_head	sendq;
+	/* deferred receive processing on the worker pool */
+	struct work_struct	rx_workq;
+	struct sk_buff_head	rxq;
 
 	/* hardware stuff */
 	struct dsp_features features;
@@ -234,20 +270,44 @@ struct dsp {
 
 	struct dsp_pipeline
 	pipeline;
+
+	/* the sample rings are streamed byte-wise; keeping each on its
+	 * own cachelines avoids false sharing with the state above */
+	u8		tx_buff[CMX_BUFF_SIZE] ____cacheline_aligned;
+	u8		rx_buff_mem[CMX_BUFF_SIZE] ____cacheline_aligned;
 };
 
+/* layout harness: the hot group must stay within two typical 64 byte
+ * cachelines (debug spinlock configs get the lock size as slack) and
+ * the sample rings must start on a cacheline
+ */
+static_assert(offsetofend(struct dsp, tx_R) -
+	      offsetof(struct dsp, b_active) <= 128 + sizeof(spinlock_t));
+static_assert(offsetof(struct dsp, tx_buff) % L1_CACHE_BYTES == 0);
+static_assert(offsetof(struct dsp, rx_buff_mem) % L1_CACHE_BYTES == 0);
+
 /* functions */
 
 extern void dsp_change_volume(struct sk_buff *skb, int volume);
+extern void dsp_audio_sum_law(s32 *sum, const u8 *src, int len);
+extern void dsp_audio_law_out(u8 *dst, const s32 *sum, int len);
+extern void dsp_audio_law_out_sub(u8 *dst, const s32 *sum, const u8 *sub,
+				  int len);
+extern void dsp_audio_law_out_subc(u8 *dst, const s32 *sum, s32 sub,
+				   int len);
+extern void dsp_audio_law_to_s16_buf(s16 *dst, const u8 *src, int len);
+extern void dsp_audio_s16_to_law_buf(u8 *dst, const s16 *src, int len);
 
 extern struct list_head dsp_ilist;
 extern struct list_head conf_ilist;
 extern void dsp_cmx_debug(struct dsp *dsp);
 extern void dsp_cmx_hardware(struct dsp_conf *conf, struct dsp *dsp);
 extern int dsp_cmx_conf(struct dsp *dsp, u32 conf_id);
+extern int dsp_cmx_tap(struct dsp *dsp, u32 tap_id);
 extern void dsp_cmx_receive(struct dsp *dsp, struct sk_buff *skb);
 extern void dsp_cmx_hdlc(struct dsp *dsp, struct sk_buff *skb);
-extern void dsp_cmx_send(void *arg);
+extern int dsp_cmx_module_init(void);
+extern void dsp_cmx_module_exit(void);
 extern void dsp_cmx_transmit(struct dsp *dsp, struct sk_buff *skb);
 extern int dsp_cmx_del_conf_member(struct dsp *dsp);
 extern int dsp_cmx_del_conf(struct dsp_conf *conf);
@@ -260,6 +320,8 @@ extern u8 *dsp_dtmf_goertzel_decode(struct dsp *dsp, u8 *data, int len,
 extern int dsp_tone(struct dsp *dsp, int tone);
 extern void dsp_tone_copy(struct dsp *dsp, u8 *data, int len);
 extern void dsp_tone_timeout(struct timer_list *t);
+extern void dsp_tone_generate_cache(void);
+extern void dsp_tone_free_cache(void);
 
 extern void dsp_bf_encrypt(struct dsp *dsp, u8 *data, int len);
 extern void dsp_bf_decrypt(struct dsp *dsp, u8 *data, int len);
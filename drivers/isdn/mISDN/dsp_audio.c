@@ -13,6 +13,7 @@
 #include <linux/mISDNif.h>
 #include <linux/mISDNdsp.h>
 #include <linux/export.h>
+#include <linux/bitops.h>
 #include <linux/bitrev.h>
 #include "core.h"
 #include "dsp.h"
@@ -48,9 +49,6 @@ static inline unsigned char linear2alaw(short int linear)
 	int mask;
 	int seg;
 	int pcm_val;
-	static int seg_end[8] = {
-		0xFF, 0x1FF, 0x3FF, 0x7FF, 0xFFF, 0x1FFF, 0x3FFF, 0x7FFF
-	};
 
 	pcm_val = linear;
 	if (pcm_val >= 0) {
@@ -63,10 +61,7 @@ static inline unsigned char linear2alaw(short int linear)
 	}
 
 	/* Convert the scaled magnitude to segment number. */
-	for (seg = 0; seg < 8; seg++) {
-		if (pcm_val <= seg_end[seg])
-			break;
-	}
+	seg = (pcm_val > 0xFF) ? fls(pcm_val) - 8 : 0;
 	/* Combine the sign, segment, and quantization bits. */
 	return  ((seg << 4) |
 		 ((pcm_val >> ((seg)  ?  (seg + 3)  :  4)) & 0x0F)) ^ mask;
@@ -103,25 +98,8 @@ static inline short int ulaw2linear(unsigned char ulaw)
 
 #define BIAS 0x84   /*!< define the add-in bias for 16 bit samples */
 
-static unsigned char linear2ulaw(short sample)
+static inline unsigned char linear2ulaw(short sample)
 {
-	static int exp_lut[256] = {
-		0, 0, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3,
-		4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-		5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
-		5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
-		6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
-		6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
-		6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
-		6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
-		7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
-		7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
-		7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
-		7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
-		7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
-		7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
-		7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
-		7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7};
 	int sign, exponent, mantissa;
 	unsigned char ulawbyte;
 
@@ -132,13 +110,29 @@ static unsigned char linear2ulaw(short sample)
 
 	/* Convert from 16 bit linear to ulaw. */
 	sample = sample + BIAS;
-	exponent = exp_lut[(sample >> 7) & 0xFF];
+	exponent = ((sample >> 7) & 0xFF) ? fls((sample >> 7) & 0xFF) - 1 : 0;
 	mantissa = (sample >> (exponent + 3)) & 0x0F;
 	ulawbyte = ~(sign | (exponent << 4) | mantissa);
 
 	return ulawbyte;
 }
 
+/* which law dsp_audio_s16_to_law_raw() must produce, set at module init */
+static int dsp_audio_encode_ulaw;
+
+/*
+ * computed equivalent of the dsp_audio_s16_to_law[] lookup: the fls()
+ * based segment search above makes the encoder cheap enough that the
+ * conversion loops do not have to walk the 64kB table (and evict the
+ * caller's working set from the cache) for every sample.
+ */
+static inline u8 dsp_audio_s16_to_law_raw(short sample)
+{
+	if (dsp_audio_encode_ulaw)
+		return bitrev8(linear2ulaw(sample));
+	return bitrev8(linear2alaw(sample));
+}
+
 void dsp_audio_generate_law_tables(void)
 {
 	int i;
@@ -161,6 +155,8 @@ dsp_audio_generate_s2law_table(void)
 {
 	int i;
 
+	dsp_audio_encode_ulaw = !!(dsp_options & DSP_OPT_ULAW);
+
 	if (dsp_options & DSP_OPT_ULAW) {
 		/* generating ulaw-table */
 		for (i = -32768; i < 32768; i++) {
@@ -381,6 +377,136 @@ dsp_audio_generate_volume_changes(void)
 }
 
 
+/*************************************************
+ * batched helpers for the conference mix loops  *
+ *************************************************/
+
+/*
+ * The cmx mixing pass runs in softirq context, where the FPU/SIMD unit
+ * is not usable without expensive state saving. Instead the callers
+ * split the ring buffer runs into linear segments and hand them to
+ * these unrolled block kernels, so the table lookups and saturation
+ * checks pipeline without per-sample masking of the ring pointers.
+ */
+
+static inline u8 dsp_audio_sat_law(s32 sample)
+{
+	if (sample < -32768)
+		sample = -32768;
+	else if (sample > 32767)
+		sample = 32767;
+	return dsp_audio_s16_to_law_raw(sample);
+}
+
+/* decode a linear run of law samples to signed 16-bit */
+void
+dsp_audio_law_to_s16_buf(s16 *dst, const u8 *src, int len)
+{
+	while (len >= 4) {
+		dst[0] = dsp_audio_law_to_s32[src[0]];
+		dst[1] = dsp_audio_law_to_s32[src[1]];
+		dst[2] = dsp_audio_law_to_s32[src[2]];
+		dst[3] = dsp_audio_law_to_s32[src[3]];
+		dst += 4;
+		src += 4;
+		len -= 4;
+	}
+	while (len--)
+		*dst++ = dsp_audio_law_to_s32[*src++];
+}
+
+/* encode a linear run of signed 16-bit samples to law */
+void
+dsp_audio_s16_to_law_buf(u8 *dst, const s16 *src, int len)
+{
+	while (len >= 4) {
+		dst[0] = dsp_audio_s16_to_law_raw(src[0]);
+		dst[1] = dsp_audio_s16_to_law_raw(src[1]);
+		dst[2] = dsp_audio_s16_to_law_raw(src[2]);
+		dst[3] = dsp_audio_s16_to_law_raw(src[3]);
+		dst += 4;
+		src += 4;
+		len -= 4;
+	}
+	while (len--)
+		*dst++ = dsp_audio_s16_to_law_raw(*src++);
+}
+
+/* add a linear run of law samples to the 32-bit sum buffer */
+void
+dsp_audio_sum_law(s32 *sum, const u8 *src, int len)
+{
+	while (len >= 4) {
+		sum[0] += dsp_audio_law_to_s32[src[0]];
+		sum[1] += dsp_audio_law_to_s32[src[1]];
+		sum[2] += dsp_audio_law_to_s32[src[2]];
+		sum[3] += dsp_audio_law_to_s32[src[3]];
+		sum += 4;
+		src += 4;
+		len -= 4;
+	}
+	while (len--)
+		*sum++ += dsp_audio_law_to_s32[*src++];
+}
+
+/* saturate a linear run of the sum buffer back to law samples */
+void
+dsp_audio_law_out(u8 *dst, const s32 *sum, int len)
+{
+	while (len >= 4) {
+		dst[0] = dsp_audio_sat_law(sum[0]);
+		dst[1] = dsp_audio_sat_law(sum[1]);
+		dst[2] = dsp_audio_sat_law(sum[2]);
+		dst[3] = dsp_audio_sat_law(sum[3]);
+		dst += 4;
+		sum += 4;
+		len -= 4;
+	}
+	while (len--)
+		*dst++ = dsp_audio_sat_law(*sum++);
+}
+
+/* like dsp_audio_law_out, but subtract a constant contribution first */
+void
+dsp_audio_law_out_subc(u8 *dst, const s32 *sum, s32 sub, int len)
+{
+	while (len >= 4) {
+		dst[0] = dsp_audio_sat_law(sum[0] - sub);
+		dst[1] = dsp_audio_sat_law(sum[1] - sub);
+		dst[2] = dsp_audio_sat_law(sum[2] - sub);
+		dst[3] = dsp_audio_sat_law(sum[3] - sub);
+		dst += 4;
+		sum += 4;
+		len -= 4;
+	}
+	while (len--)
+		*dst++ = dsp_audio_sat_law(*sum++ - sub);
+}
+
+/* like dsp_audio_law_out, but subtract the member's own rx run first */
+void
+dsp_audio_law_out_sub(u8 *dst, const s32 *sum, const u8 *sub, int len)
+{
+	while (len >= 4) {
+		dst[0] = dsp_audio_sat_law(sum[0]
+					   - dsp_audio_law_to_s32[sub[0]]);
+		dst[1] = dsp_audio_sat_law(sum[1]
+					   - dsp_audio_law_to_s32[sub[1]]);
+		dst[2] = dsp_audio_sat_law(sum[2]
+					   - dsp_audio_law_to_s32[sub[2]]);
+		dst[3] = dsp_audio_sat_law(sum[3]
+					   - dsp_audio_law_to_s32[sub[3]]);
+		dst += 4;
+		sum += 4;
+		sub += 4;
+		len -= 4;
+	}
+	while (len--)
+		*dst++ = dsp_audio_sat_law(*sum++
+					   - dsp_audio_law_to_s32[*sub++]);
+}
+
+
 /**************************************
  * change the volume of the given skb *
  **************************************/
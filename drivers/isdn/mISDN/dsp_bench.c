@@ -0,0 +1,318 @@
+/*
+ * dsp_bench.c: userspace benchmark for the mISDN DSP sample kernels
+ *
+ * Copyright 2008 by the mISDN maintainers
+ *
+ * This software may be used and distributed according to the terms
+ * of the GNU General Public License, incorporated herein by reference.
+ *
+ * Build with "make -f Makefile.standalone dspbench" from the top
+ * level. Unlike ec_bench, which compiles each canceller into its own
+ * binary, this links the real module sources - dsp_audio.c,
+ * dsp_dtmf.c, dtmf_engine.c, l1oip_codec.c and dsp_blowfish.c -
+ * against the stub kernel headers in standalone/bench/, so the loops
+ * measured here are byte for byte the loops the modules run.
+ *
+ * Each benchmark streams one simulated B-channel minute per
+ * iteration and reports ns/sample and, on x86, cycles/sample from
+ * the TSC. For profiling a single kernel under perf, pin it and give
+ * it a fixed iteration count, e.g.:
+ *
+ *	perf stat -e cycles,instructions ./dsp_bench -b mix -n 100
+ *
+ * usage: dsp_bench [-m] [-b name] [-n iterations]
+ *	  dsp_bench -l		list benchmark names
+ *
+ * -m prints one "name ns-per-sample" line per benchmark, the format
+ * scripts/bench_regress compares against its checked-in baseline.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <linux/mISDNif.h>
+#include <linux/mISDNdsp.h>
+#include "dsp.h"
+#include "l1oip.h"
+
+/* module globals the benchmarked sources expect */
+int dsp_options;
+int dsp_debug;
+
+#define RATE		8000
+#define CHUNK		128		/* samples per tick, like poll=128 */
+#define SECONDS		60		/* one B-channel minute */
+#define NSAMPLES	(RATE * SECONDS)
+#define MIX_MEMBERS	8		/* conference size for the mix loop */
+
+static struct dsp bdsp;			/* too big for the stack */
+static u8 law_tone[NSAMPLES];		/* alaw encoded dual tone */
+static u8 law_noise[MIX_MEMBERS][CHUNK];
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint64_t now_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+/* simple LCG, the same sequence for every run */
+static uint32_t rngstate = 1;
+
+static int16_t whitenoise(void)
+{
+	rngstate = rngstate * 1664525 + 1013904223;
+	return (int16_t)(rngstate >> 17);
+}
+
+static void generate_input(void)
+{
+	int i, j;
+	double s;
+
+	/* DTMF '1': 697 + 1209 Hz at -6 dB each */
+	for (i = 0; i < NSAMPLES; i++) {
+		s = 8192.0 * sin(2.0 * M_PI * 697.0 * i / RATE)
+		  + 8192.0 * sin(2.0 * M_PI * 1209.0 * i / RATE);
+		law_tone[i] = dsp_audio_s16_to_law[(int16_t)s & 0xffff];
+	}
+	for (j = 0; j < MIX_MEMBERS; j++)
+		for (i = 0; i < CHUNK; i++)
+			law_noise[j][i] =
+				dsp_audio_s16_to_law[whitenoise() & 0xffff];
+}
+
+/*
+ * the individual benchmarks; each processes NSAMPLES samples
+ */
+
+static s16 spl_buf[CHUNK];
+static s32 sum_buf[CHUNK];
+static u8 out_buf[CHUNK];
+
+static void bench_law2s16(void)
+{
+	int i;
+
+	for (i = 0; i < NSAMPLES; i += CHUNK)
+		dsp_audio_law_to_s16_buf(spl_buf, law_tone + i, CHUNK);
+}
+
+static void bench_s162law(void)
+{
+	int i;
+
+	for (i = 0; i < NSAMPLES; i += CHUNK)
+		dsp_audio_s16_to_law_buf(out_buf, spl_buf, CHUNK);
+}
+
+/* the dsp_cmx conference tick: sum all members, then write each
+ * member's frame with its own contribution subtracted
+ */
+static void bench_mix(void)
+{
+	int i, j;
+
+	for (i = 0; i < NSAMPLES; i += CHUNK) {
+		memset(sum_buf, 0, sizeof(sum_buf));
+		for (j = 0; j < MIX_MEMBERS; j++)
+			dsp_audio_sum_law(sum_buf, law_noise[j], CHUNK);
+		for (j = 0; j < MIX_MEMBERS; j++)
+			dsp_audio_law_out_sub(out_buf, sum_buf,
+					      law_noise[j], CHUNK);
+	}
+}
+
+static void bench_volume(void)
+{
+	static u8 volbuf[CHUNK];
+	struct sk_buff skb;
+	int i;
+
+	skb.data = volbuf;
+	skb.len = CHUNK;
+	for (i = 0; i < NSAMPLES; i += CHUNK) {
+		memcpy(volbuf, law_tone + i, CHUNK);
+		dsp_change_volume(&skb, 4);
+	}
+}
+
+static void bench_dtmf(void)
+{
+	u8 *digits;
+	int i, seen = 0;
+
+	bdsp.dtmf.enable = 1;
+	bdsp.dtmf.software = 1;
+	bdsp.dtmf.treshold = 200 * 10000;
+	dsp_dtmf_goertzel_init(&bdsp);
+	/* a continuous tone is confirmed exactly once (debounce) */
+	for (i = 0; i < NSAMPLES; i += CHUNK) {
+		digits = dsp_dtmf_goertzel_decode(&bdsp, law_tone + i,
+						  CHUNK, 0);
+		if (digits[0] == '1')
+			seen = 1;
+	}
+	if (!seen) {
+		fprintf(stderr, "dtmf: tone not detected, "
+			"engine is broken\n");
+		exit(1);
+	}
+}
+
+static void bench_l1oip(void)
+{
+	static u8 comp[CHUNK];
+	static u8 back[CHUNK];
+	u32 state = 0;
+	int i, clen;
+
+	for (i = 0; i < NSAMPLES; i += CHUNK) {
+		clen = l1oip_law_to_4bit(law_tone + i, CHUNK, comp, &state);
+		l1oip_4bit_to_law(comp, clen, back);
+	}
+}
+
+static void bench_crypt(void)
+{
+	static const u8 key[] = "benchmark key 16";
+	static u8 cbuf[CHUNK];
+	int i;
+
+	/* the key schedule runs once per iteration; against a minute of
+	 * samples its cost is noise
+	 */
+	if (dsp_bf_init(&bdsp, key, 16)) {
+		fprintf(stderr, "crypt: key rejected\n");
+		exit(1);
+	}
+	for (i = 0; i < NSAMPLES; i += CHUNK) {
+		memcpy(cbuf, law_tone + i, CHUNK);
+		dsp_bf_encrypt(&bdsp, cbuf, CHUNK);
+	}
+}
+
+struct benchmark {
+	const char	*name;
+	const char	*what;
+	void		(*func)(void);
+};
+
+static const struct benchmark benchmarks[] = {
+	{ "law2s16", "alaw/ulaw to linear conversion", bench_law2s16 },
+	{ "s162law", "linear to alaw/ulaw conversion", bench_s162law },
+	{ "mix", "8 member conference mix (dsp_cmx loops)", bench_mix },
+	{ "volume", "volume change via table lookup", bench_volume },
+	{ "dtmf", "software DTMF decoder (goertzel engine)", bench_dtmf },
+	{ "l1oip", "l1oip 4bit compress + expand", bench_l1oip },
+	{ "crypt", "blowfish sample stream encryption", bench_crypt },
+};
+
+static int machine;	/* -m: one "name ns/sample" line per benchmark */
+
+static void run(const struct benchmark *b, int iterations)
+{
+	uint64_t t0, t1, c0, c1;
+	double samples;
+	int i;
+
+	b->func();	/* warm up, also populates lazy tables */
+	t0 = now_ns();
+	c0 = now_cycles();
+	for (i = 0; i < iterations; i++)
+		b->func();
+	c1 = now_cycles();
+	t1 = now_ns();
+	samples = (double)NSAMPLES * iterations;
+	if (machine) {
+		printf("%s %.3f\n", b->name, (t1 - t0) / samples);
+		return;
+	}
+	printf("%-8s %8.2f ns/sample %8.2f cycles/sample  (%s)\n",
+	       b->name, (t1 - t0) / samples, (c1 - c0) / samples, b->what);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *only = NULL;
+	int iterations = 5;
+	unsigned int i;
+	int done = 0, c;
+
+	while ((c = getopt(argc, argv, "b:n:mlh")) != -1) {
+		switch (c) {
+		case 'b':
+			only = optarg;
+			break;
+		case 'm':
+			machine = 1;
+			break;
+		case 'n':
+			iterations = atoi(optarg);
+			if (iterations < 1)
+				iterations = 1;
+			break;
+		case 'l':
+			for (i = 0; i < ARRAY_SIZE(benchmarks); i++)
+				printf("%-8s %s\n", benchmarks[i].name,
+				       benchmarks[i].what);
+			return 0;
+		default:
+			fprintf(stderr, "usage: %s [-m] [-b name] "
+				"[-n iterations] | -l\n", argv[0]);
+			return 1;
+		}
+	}
+
+	/* same table setup sequence as dsp_init() in dsp_core.c */
+	dsp_audio_generate_law_tables();
+	dsp_silence = (dsp_options & DSP_OPT_ULAW) ? 0xff : 0x2a;
+	dsp_audio_law_to_s32 = (dsp_options & DSP_OPT_ULAW) ?
+		dsp_audio_ulaw_to_s32 : dsp_audio_alaw_to_s32;
+	dsp_audio_generate_s2law_table();
+	dsp_audio_generate_seven();
+	dsp_audio_generate_mix_table();
+	/* tone patterns (dsp_tones.c) are not benchmarked, so the ulaw
+	 * sample conversion is not needed here
+	 */
+	dsp_audio_generate_volume_changes();
+	if (l1oip_4bit_alloc(dsp_options & DSP_OPT_ULAW)) {
+		fprintf(stderr, "no memory for l1oip tables\n");
+		return 1;
+	}
+	generate_input();
+
+	if (!machine)
+		printf("%d iterations of %d samples each\n", iterations,
+		       NSAMPLES);
+	for (i = 0; i < ARRAY_SIZE(benchmarks); i++) {
+		if (only && strcmp(only, benchmarks[i].name))
+			continue;
+		run(&benchmarks[i], iterations);
+		done++;
+	}
+	if (!done) {
+		fprintf(stderr, "no such benchmark: %s (try -l)\n", only);
+		return 1;
+	}
+	l1oip_4bit_free();
+	return 0;
+}
@@ -360,6 +360,134 @@ static const u32 bf_sbox[256 * 4] = {
 #define EROUND(a, b, n)  do { b ^= P[n]; a ^= bf_F(b); } while (0)
 #define DROUND(a, b, n)  do { a ^= bf_F(b); b ^= P[n]; } while (0)
 
+/* one round on two independent blocks: the s-box loads of the second
+ * block overlap the add/xor latency of the first
+ */
+#define EROUND2(a, b, c, d, n)			\
+	do {					\
+		b ^= P[n];			\
+		d ^= P[n];			\
+		a ^= bf_F(b);			\
+		c ^= bf_F(d);			\
+	} while (0)
+
+/* transcode 9 samples xlaw to a 64 bit block */
+static inline void
+bf_pack_block(const u8 *spl, u32 *ylp, u32 *yrp)
+{
+	u32 yl, yr;
+	u8 nibble;
+
+	yl = dsp_audio_law2seven[spl[0]];
+	yl = (yl << 7) | dsp_audio_law2seven[spl[1]];
+	yl = (yl << 7) | dsp_audio_law2seven[spl[2]];
+	yl = (yl << 7) | dsp_audio_law2seven[spl[3]];
+	nibble = dsp_audio_law2seven[spl[4]];
+	yr = nibble;
+	yl = (yl << 4) | (nibble >> 3);
+	yr = (yr << 7) | dsp_audio_law2seven[spl[5]];
+	yr = (yr << 7) | dsp_audio_law2seven[spl[6]];
+	yr = (yr << 7) | dsp_audio_law2seven[spl[7]];
+	yr = (yr << 7) | dsp_audio_law2seven[spl[8]];
+	/* fill unused bit with random noise of audio input */
+	yr = (yr << 1) | (spl[0] & 1);
+
+	*ylp = yl;
+	*yrp = yr;
+}
+
+/* run the 16 feistel rounds on one block */
+static inline void
+bf_encrypt_block1(const u32 *P, const u32 *S, u32 *ylp, u32 *yrp)
+{
+	u32 yl = *ylp;
+	u32 yr = *yrp;
+
+	EROUND(yr, yl, 0);
+	EROUND(yl, yr, 1);
+	EROUND(yr, yl, 2);
+	EROUND(yl, yr, 3);
+	EROUND(yr, yl, 4);
+	EROUND(yl, yr, 5);
+	EROUND(yr, yl, 6);
+	EROUND(yl, yr, 7);
+	EROUND(yr, yl, 8);
+	EROUND(yl, yr, 9);
+	EROUND(yr, yl, 10);
+	EROUND(yl, yr, 11);
+	EROUND(yr, yl, 12);
+	EROUND(yl, yr, 13);
+	EROUND(yr, yl, 14);
+	EROUND(yl, yr, 15);
+	yl ^= P[16];
+	yr ^= P[17];
+
+	*ylp = yl;
+	*yrp = yr;
+}
+
+/* run the 16 feistel rounds on two independent blocks in lockstep */
+static inline void
+bf_encrypt_block2(const u32 *P, const u32 *S, u32 *ylp, u32 *yrp,
+		  u32 *ylp2, u32 *yrp2)
+{
+	u32 al = *ylp, ar = *yrp;
+	u32 bl = *ylp2, br = *yrp2;
+
+	EROUND2(ar, al, br, bl, 0);
+	EROUND2(al, ar, bl, br, 1);
+	EROUND2(ar, al, br, bl, 2);
+	EROUND2(al, ar, bl, br, 3);
+	EROUND2(ar, al, br, bl, 4);
+	EROUND2(al, ar, bl, br, 5);
+	EROUND2(ar, al, br, bl, 6);
+	EROUND2(al, ar, bl, br, 7);
+	EROUND2(ar, al, br, bl, 8);
+	EROUND2(al, ar, bl, br, 9);
+	EROUND2(ar, al, br, bl, 10);
+	EROUND2(al, ar, bl, br, 11);
+	EROUND2(ar, al, br, bl, 12);
+	EROUND2(al, ar, bl, br, 13);
+	EROUND2(ar, al, br, bl, 14);
+	EROUND2(al, ar, bl, br, 15);
+	al ^= P[16];
+	ar ^= P[17];
+	bl ^= P[16];
+	br ^= P[17];
+
+	*ylp = al;
+	*yrp = ar;
+	*ylp2 = bl;
+	*yrp2 = br;
+}
+
+/*
+ * transcode 8 crypted bytes to 9 data bytes with sync
+ * and checksum information
+ */
+static inline void
+bf_encode_block(u8 *out, u32 yl, u32 yr)
+{
+	u32 cs;
+
+	/* calculate 3-bit checksumme */
+	cs = yl ^ (yl >> 3) ^ (yl >> 6) ^ (yl >> 9) ^ (yl >> 12) ^ (yl >> 15)
+		^ (yl >> 18) ^ (yl >> 21) ^ (yl >> 24) ^ (yl >> 27) ^ (yl >> 30)
+		^ (yr << 2) ^ (yr >> 1) ^ (yr >> 4) ^ (yr >> 7) ^ (yr >> 10)
+		^ (yr >> 13) ^ (yr >> 16) ^ (yr >> 19) ^ (yr >> 22) ^ (yr >> 25)
+		^ (yr >> 28) ^ (yr >> 31);
+
+	out[0] = (yl >> 25) | 0x80;
+	out[1] = (yl >> 18) & 0x7f;
+	out[2] = (yl >> 11) & 0x7f;
+	out[3] = (yl >> 4) & 0x7f;
+	out[4] = ((yl << 3) & 0x78) | ((yr >> 29) & 0x07);
+	out[5] = ((yr >> 22) & 0x7f) | ((cs << 5) & 0x80);
+	out[6] = ((yr >> 15) & 0x7f) | ((cs << 6) & 0x80);
+	out[7] = ((yr >> 8) & 0x7f) | (cs << 7);
+	out[8] = yr;
+}
+
 
 /*
  * encrypt isdn data frame
@@ -373,11 +501,26 @@ dsp_bf_encrypt(struct dsp *dsp, u8 *data, int len)
 	u8 *bf_crypt_out = dsp->bf_crypt_out;
 	u32 *P = dsp->bf_p;
 	u32 *S = dsp->bf_s;
-	u32 yl, yr;
-	u32 cs;
-	u8 nibble;
+	u32 yl, yr, yl2, yr2;
 
 	while (i < len) {
+		/* block aligned with two full blocks left in the chunk:
+		 * encrypt them pairwise, the second block's rounds fill
+		 * the stalls of the first. output stays as in the scalar
+		 * path: each block's ciphertext replaces the samples of
+		 * the following block.
+		 */
+		if (j == 0 && len - i >= 18) {
+			bf_pack_block(data, &yl, &yr);
+			memcpy(data, bf_crypt_out, 9);
+			bf_pack_block(data + 9, &yl2, &yr2);
+			bf_encrypt_block2(P, S, &yl, &yr, &yl2, &yr2);
+			bf_encode_block(data + 9, yl, yr);
+			bf_encode_block(bf_crypt_out, yl2, yr2);
+			data += 18;
+			i += 18;
+			continue;
+		}
 		/* collect a block of 9 samples */
 		if (j < 9) {
 			bf_data_in[j] = *data;
@@ -386,62 +529,9 @@ dsp_bf_encrypt(struct dsp *dsp, u8 *data, int len)
 			continue;
 		}
 		j = 0;
-		/* transcode 9 samples xlaw to 8 bytes */
-		yl = dsp_audio_law2seven[bf_data_in[0]];
-		yl = (yl << 7) | dsp_audio_law2seven[bf_data_in[1]];
-		yl = (yl << 7) | dsp_audio_law2seven[bf_data_in[2]];
-		yl = (yl << 7) | dsp_audio_law2seven[bf_data_in[3]];
-		nibble = dsp_audio_law2seven[bf_data_in[4]];
-		yr = nibble;
-		yl = (yl << 4) | (nibble >> 3);
-		yr = (yr << 7) | dsp_audio_law2seven[bf_data_in[5]];
-		yr = (yr << 7) | dsp_audio_law2seven[bf_data_in[6]];
-		yr = (yr << 7) | dsp_audio_law2seven[bf_data_in[7]];
-		yr = (yr << 7) | dsp_audio_law2seven[bf_data_in[8]];
-		yr = (yr << 1) | (bf_data_in[0] & 1);
-
-		/* fill unused bit with random noise of audio input */
-		/* encrypt */
-
-		EROUND(yr, yl, 0);
-		EROUND(yl, yr, 1);
-		EROUND(yr, yl, 2);
-		EROUND(yl, yr, 3);
-		EROUND(yr, yl, 4);
-		EROUND(yl, yr, 5);
-		EROUND(yr, yl, 6);
-		EROUND(yl, yr, 7);
-		EROUND(yr, yl, 8);
-		EROUND(yl, yr, 9);
-		EROUND(yr, yl, 10);
-		EROUND(yl, yr, 11);
-		EROUND(yr, yl, 12);
-		EROUND(yl, yr, 13);
-		EROUND(yr, yl, 14);
-		EROUND(yl, yr, 15);
-		yl ^= P[16];
-		yr ^= P[17];
-
-		/* calculate 3-bit checksumme */
-		cs = yl ^ (yl >> 3) ^ (yl >> 6) ^ (yl >> 9) ^ (yl >> 12) ^ (yl >> 15)
-			^ (yl >> 18) ^ (yl >> 21) ^ (yl >> 24) ^ (yl >> 27) ^ (yl >> 30)
-			^ (yr << 2) ^ (yr >> 1) ^ (yr >> 4) ^ (yr >> 7) ^ (yr >> 10)
-			^ (yr >> 13) ^ (yr >> 16) ^ (yr >> 19) ^ (yr >> 22) ^ (yr >> 25)
-			^ (yr >> 28) ^ (yr >> 31);
-
-		/*
-		 * transcode 8 crypted bytes to 9 data bytes with sync
-		 * and checksum information
-		 */
-		bf_crypt_out[0] = (yl >> 25) | 0x80;
-		bf_crypt_out[1] = (yl >> 18) & 0x7f;
-		bf_crypt_out[2] = (yl >> 11) & 0x7f;
-		bf_crypt_out[3] = (yl >> 4) & 0x7f;
-		bf_crypt_out[4] = ((yl << 3) & 0x78) | ((yr >> 29) & 0x07);
-		bf_crypt_out[5] = ((yr >> 22) & 0x7f) | ((cs << 5) & 0x80);
-		bf_crypt_out[6] = ((yr >> 15) & 0x7f) | ((cs << 6) & 0x80);
-		bf_crypt_out[7] = ((yr >> 8) & 0x7f) | (cs << 7);
-		bf_crypt_out[8] = yr;
+		bf_pack_block(bf_data_in, &yl, &yr);
+		bf_encrypt_block1(P, S, &yl, &yr);
+		bf_encode_block(bf_crypt_out, yl, yr);
 	}
 
 	/* write current count */
@@ -56,7 +56,7 @@ struct ec_prv {
 };
 
 static inline void *
-dsp_cancel_new(int deftaps, int training)
+dsp_cancel_new(int deftaps, int training, int blockadapt, int shrink)
 {
 	struct ec_prv *p;
 
@@ -68,6 +68,18 @@ dsp_cancel_new(int deftaps, int training)
 	if (!p->ec)
 		goto err2;
 
+#ifdef EC_HAS_UPDATE_INTERVAL
+	/* block NLMS: adapt the taps once per blockadapt samples */
+	if (blockadapt > 0)
+		echo_can_update_interval(p->ec, blockadapt);
+#endif
+
+#ifdef EC_HAS_TAIL_SHRINK
+	/* trim the active tail while converged, regrow on divergence */
+	if (shrink)
+		echo_can_shrink_enable(p->ec, 1);
+#endif
+
 	p->echotimer = training ? training : 0;
 	p->echostate = training ? ECHO_STATE_PRETRAINING : ECHO_STATE_IDLE;
 	p->echolastupdate = 0;
@@ -125,7 +125,12 @@
 /* delay.h is required for hw_lock.h */
 
 #include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
 #include <linux/delay.h>
+#include <linux/rculist.h>
+#include <linux/hashtable.h>
 #include <linux/mISDNif.h>
 #include <linux/mISDNdsp.h>
 #include "core.h"
@@ -141,6 +146,34 @@
 /*#define CMX_DELAY_DEBUG * gives rx-buffer delay overview */
 /*#define CMX_TX_DEBUG * massive read/write on tx-buffer with content */
 
+/* ticks a conference member stays in the mix after its level dropped
+ * below the energy gate, so speech pauses do not chop the speaker */
+#define DSP_GATE_HOLD	8
+
+static void dsp_cmx_mix_work(struct work_struct *work);
+static void dsp_cmx_arena_work(struct work_struct *work);
+static void dsp_cmx_mix_done(void);
+static void dsp_cmx_tick_complete(u16 length, int jittercheck);
+
+/* workqueue for mixing independent conferences in parallel */
+static struct workqueue_struct *dsp_mix_wq;
+/* outstanding mixers of the current tick, plus one bias the last
+ * finisher releases after running the tick completion */
+static atomic_t dsp_mix_pending;
+/* tick parameters for the last finisher, written under dsp_lock */
+static u16 dsp_mix_length;
+static int dsp_mix_jittercheck;
+
+/* repacks the member rx rings of mixing conferences into arenas */
+static DECLARE_WORK(dsp_arena_work, dsp_cmx_arena_work);
+
+/* conferences given up in atomic context, freed by the arena worker */
+static LIST_HEAD(dsp_conf_garbage);
+
+/* conference ID index for constant-time lookup on join/leave; writers
+ * hold dsp_lock, lookups walk the bucket under rcu */
+static DEFINE_HASHTABLE(dsp_conf_idx, 6);
+
 static inline int
 count_list_member(struct list_head *head)
 {
@@ -187,6 +220,10 @@ dsp_cmx_debug(struct dsp *dsp)
 			       member->dsp->tx_data, member->dsp->rx_is_off,
 			       (member->dsp == dsp) ? " *this*" : "");
 		}
+		list_for_each_entry(member, &conf->tlist, list)
+			printk(KERN_DEBUG "  - tap = %s%s\n",
+			       member->dsp->name,
+			       (member->dsp == dsp) ? " *this*" : "");
 	}
 	printk(KERN_DEBUG "-----end\n");
 }
@@ -204,10 +241,14 @@ dsp_cmx_search_conf(u32 id)
 		return NULL;
 	}
 
-	/* search conference */
-	list_for_each_entry(conf, &conf_ilist, list)
-		if (conf->id == id)
+	/* bucket lookup instead of walking all conferences */
+	rcu_read_lock();
+	hash_for_each_possible_rcu(dsp_conf_idx, conf, hnode, id)
+		if (conf->id == id) {
+			rcu_read_unlock();
 			return conf;
+		}
+	rcu_read_unlock();
 
 	return NULL;
 }
@@ -244,16 +285,23 @@ dsp_cmx_add_conf_member(struct dsp *dsp, struct dsp_conf *conf)
 	}
 	member->dsp = dsp;
 	/* clear rx buffer */
-	memset(dsp->rx_buff, dsp_silence, sizeof(dsp->rx_buff));
+	spin_lock(&dsp->rx_lock);
+	memset(dsp->rx_buff, dsp_silence, CMX_BUFF_SIZE);
 	dsp->rx_init = 1; /* rx_W and rx_R will be adjusted on first frame */
 	dsp->rx_W = 0;
 	dsp->rx_R = 0;
+	spin_unlock(&dsp->rx_lock);
 
-	list_add_tail(&member->list, &conf->mlist);
+	spin_lock(&conf->lock);
+	list_add_tail_rcu(&member->list, &conf->mlist);
+	spin_unlock(&conf->lock);
 
 	dsp->conf = conf;
 	dsp->member = member;
 
+	/* repack the conference arena outside atomic context */
+	schedule_work(&dsp_arena_work);
+
 	return 0;
 }
 
@@ -287,10 +335,21 @@ dsp_cmx_del_conf_member(struct dsp *dsp)
 	/* find us in conf */
 	list_for_each_entry(member, &dsp->conf->mlist, list) {
 		if (member->dsp == dsp) {
-			list_del(&member->list);
+			spin_lock(&dsp->conf->lock);
+			list_del_rcu(&member->list);
+			spin_unlock(&dsp->conf->lock);
+			/* the arena slot stays with the conference */
+			spin_lock(&dsp->rx_lock);
+			if (dsp->rx_buff != dsp->rx_buff_mem) {
+				memcpy(dsp->rx_buff_mem, dsp->rx_buff,
+				       CMX_BUFF_SIZE);
+				dsp->rx_buff = dsp->rx_buff_mem;
+			}
+			spin_unlock(&dsp->rx_lock);
 			dsp->conf = NULL;
 			dsp->member = NULL;
-			kfree(member);
+			kfree_rcu(member, rcu);
+			schedule_work(&dsp_arena_work);
 			return 0;
 		}
 	}
@@ -322,9 +381,13 @@ static struct dsp_conf
 		return NULL;
 	}
 	INIT_LIST_HEAD(&conf->mlist);
+	INIT_LIST_HEAD(&conf->tlist);
+	spin_lock_init(&conf->lock);
+	INIT_WORK(&conf->mixwork, dsp_cmx_mix_work);
 	conf->id = id;
 
 	list_add_tail(&conf->list, &conf_ilist);
+	hash_add_rcu(dsp_conf_idx, &conf->hnode, conf->id);
 
 	return conf;
 }
@@ -347,13 +410,115 @@ dsp_cmx_del_conf(struct dsp_conf *conf)
 		       __func__);
 		return -EINVAL;
 	}
+
+	if (!list_empty(&conf->tlist)) {
+		printk(KERN_WARNING "%s: conf still has taps.\n",
+		       __func__);
+		return -EINVAL;
+	}
 	list_del(&conf->list);
-	kfree(conf);
+	hash_del_rcu(&conf->hnode);
+	/*
+	 * the arena cannot be freed in atomic context and the arena
+	 * worker may still reference the conference, so freeing is
+	 * always left to the worker
+	 */
+	list_add_tail(&conf->list, &dsp_conf_garbage);
+	schedule_work(&dsp_arena_work);
 
 	return 0;
 }
 
 
+/*
+ * (re)pack the member rx rings of all mixing conferences into one
+ * contiguous arena per conference, so the accumulation loop streams
+ * linearly through memory instead of chasing each member's embedded
+ * buffer. Runs in process context, because the arena cannot be
+ * allocated under dsp_lock; membership is rechecked after each
+ * allocation. Also frees conferences deleted in atomic context.
+ */
+static void
+dsp_cmx_arena_work(struct work_struct *work)
+{
+	struct dsp_conf *conf;
+	struct dsp_conf_member *member;
+	struct dsp *dsp;
+	u8 *arena, *old, *slot;
+	int members, want;
+	u_long flags;
+
+restart:
+	spin_lock_irqsave(&dsp_lock, flags);
+	list_for_each_entry(conf, &conf_ilist, list) {
+		members = count_list_member(&conf->mlist);
+		/* only mixing conferences benefit from packing */
+		want = (conf->software && members > 2) ? members : 0;
+		if (want == conf->arena_slots)
+			continue;
+		if (want) {
+			/*
+			 * conferences are never freed while we drop the
+			 * lock, they are parked on dsp_conf_garbage for us
+			 */
+			spin_unlock_irqrestore(&dsp_lock, flags);
+			arena = kvmalloc(array_size(want, CMX_BUFF_SIZE),
+					 GFP_KERNEL);
+			if (!arena)
+				return; /* members keep current buffers */
+			spin_lock_irqsave(&dsp_lock, flags);
+			/* membership may have changed while unlocked */
+			if (count_list_member(&conf->mlist) != members ||
+			    !conf->software) {
+				spin_unlock_irqrestore(&dsp_lock, flags);
+				kvfree(arena);
+				goto restart;
+			}
+		} else
+			arena = NULL;
+		old = conf->arena;
+		slot = arena;
+		list_for_each_entry(member, &conf->mlist, list) {
+			dsp = member->dsp;
+			spin_lock(&dsp->rx_lock);
+			if (arena) {
+				memcpy(slot, dsp->rx_buff, CMX_BUFF_SIZE);
+				dsp->rx_buff = slot;
+				slot += CMX_BUFF_SIZE;
+			} else if (dsp->rx_buff != dsp->rx_buff_mem) {
+				memcpy(dsp->rx_buff_mem, dsp->rx_buff,
+				       CMX_BUFF_SIZE);
+				dsp->rx_buff = dsp->rx_buff_mem;
+			}
+			spin_unlock(&dsp->rx_lock);
+		}
+		conf->arena = arena;
+		conf->arena_slots = want;
+		spin_unlock_irqrestore(&dsp_lock, flags);
+		kvfree(old);
+		goto restart;
+	}
+
+	/* free conferences that were deleted in atomic context */
+	while (!list_empty(&dsp_conf_garbage)) {
+		conf = list_first_entry(&dsp_conf_garbage,
+					struct dsp_conf, list);
+		list_del(&conf->list);
+		spin_unlock_irqrestore(&dsp_lock, flags);
+		/* a mixer from the conference's final tick may still be
+		 * queued and then owns one pending count
+		 */
+		if (cancel_work_sync(&conf->mixwork))
+			dsp_cmx_mix_done();
+		kvfree(conf->arena);
+		/* an ID lookup may still traverse the bucket entry */
+		kfree_rcu(conf, rcu);
+		spin_lock_irqsave(&dsp_lock, flags);
+	}
+	spin_unlock_irqrestore(&dsp_lock, flags);
+}
+
+
 /*
  * send HW message to hfc card
  */
@@ -511,6 +676,15 @@ dsp_cmx_hardware(struct dsp_conf *conf, struct dsp *dsp)
 		return;
 	}
 	member = list_entry(conf->mlist.next, struct dsp_conf_member, list);
+	/* check if the conference is monitored */
+	if (!list_empty(&conf->tlist)) {
+		if (dsp_debug & DEBUG_DSP_CMX)
+			printk(KERN_DEBUG
+			       "%s conference %d has tap subscribers, only "
+			       "software mixing produces the summed frame\n",
+			       __func__, conf->id);
+		goto conf_software;
+	}
 	same_hfc = member->dsp->features.hfc_id;
 	same_pcm = member->dsp->features.pcm_id;
 	/* check all members in our conference */
@@ -583,7 +757,9 @@ dsp_cmx_hardware(struct dsp_conf *conf, struct dsp *dsp)
 				       __func__, member->dsp->name);
 			goto conf_software;
 		}
-		/* check if member changes volume at an not suppoted level */
+		/* check if member changes tx volume, which scales what the
+		 * member hears - the chip generates that audio, so it can
+		 * only be applied in software */
 		if (member->dsp->tx_volume) {
 			if (dsp_debug & DEBUG_DSP_CMX)
 				printk(KERN_DEBUG
@@ -592,14 +768,14 @@ dsp_cmx_hardware(struct dsp_conf *conf, struct dsp *dsp)
 				       __func__, member->dsp->name);
 			goto conf_software;
 		}
-		if (member->dsp->rx_volume) {
-			if (dsp_debug & DEBUG_DSP_CMX)
-				printk(KERN_DEBUG
-				       "%s dsp %s cannot form a conf, because "
-				       "rx_volume is changed\n",
-				       __func__, member->dsp->name);
-			goto conf_software;
-		}
+		/*
+		 * rx_volume is NOT checked: like software dtmf detection it
+		 * only works on the receive copy that keeps flowing to the
+		 * host and is scaled in dsp_rx_data() before delivery, while
+		 * the chip routes the bridged audio untouched. This keeps
+		 * the common "bridged call plus rx feature" case off the
+		 * software mixer.
+		 */
 		/* check if tx-data turned on */
 		if (member->dsp->tx_data) {
 			if (dsp_debug & DEBUG_DSP_CMX)
@@ -726,6 +902,10 @@ dsp_cmx_hardware(struct dsp_conf *conf, struct dsp *dsp)
 			    member->dsp->pcm_slot_tx &&
 			    nextm->dsp->pcm_slot_tx ==
 			    member->dsp->pcm_slot_tx &&
+			    member->dsp->pcm_bank_tx ==
+			    nextm->dsp->pcm_bank_rx &&
+			    member->dsp->pcm_bank_rx ==
+			    nextm->dsp->pcm_bank_tx &&
 			    member->dsp->pcm_bank_tx !=
 			    member->dsp->pcm_bank_rx &&
 			    nextm->dsp->pcm_bank_tx !=
@@ -764,7 +944,10 @@ dsp_cmx_hardware(struct dsp_conf *conf, struct dsp *dsp)
 				}
 			}
 			i = 0;
+			/* cards on one bus may have different slot counts */
 			ii = member->dsp->features.pcm_slots;
+			if (nextm->dsp->features.pcm_slots < ii)
+				ii = nextm->dsp->features.pcm_slots;
 			while (i < ii) {
 				if (freeslots[i])
 					break;
@@ -856,7 +1039,10 @@ dsp_cmx_hardware(struct dsp_conf *conf, struct dsp *dsp)
 				}
 			}
 			i1 = 0;
+			/* cards on one bus may have different slot counts */
 			ii = member->dsp->features.pcm_slots;
+			if (nextm->dsp->features.pcm_slots < ii)
+				ii = nextm->dsp->features.pcm_slots;
 			while (i1 < ii) {
 				if (freeslots[i1])
 					break;
@@ -925,7 +1111,14 @@ dsp_cmx_hardware(struct dsp_conf *conf, struct dsp *dsp)
 	 * unit available on the chip. also all members must be on the same
 	 */
 
-	/* if not the same HFC chip */
+	/*
+	 * if not the same HFC chip
+	 *
+	 * NOTE: A conference cannot span chips, even on a shared PCM bus.
+	 * Conference members are routed in loop mode, so the sum is only
+	 * heard by the chip's own channels and never driven onto the bus.
+	 * Only two parties can be patched across cards (done above).
+	 */
 	if (same_hfc < 0) {
 		if (dsp_debug & DEBUG_DSP_CMX)
 			printk(KERN_DEBUG
@@ -1086,15 +1279,15 @@ dsp_cmx_conf(struct dsp *dsp, u32 conf_id)
 		/* update hardware */
 		dsp_cmx_hardware(NULL, dsp);
 
-		/* conf now empty? */
-		if (list_empty(&conf->mlist)) {
+		/* conf now empty? (tap subscribers keep it alive) */
+		if (list_empty(&conf->mlist) && list_empty(&conf->tlist)) {
 			if (dsp_debug & DEBUG_DSP_CMX)
 				printk(KERN_DEBUG
 				       "conference is empty, so we remove it.\n");
 			err = dsp_cmx_del_conf(conf);
 			if (err)
 				return err;
-		} else {
+		} else if (!list_empty(&conf->mlist)) {
 			/* update members left on conf */
 			dsp_cmx_hardware(conf, NULL);
 		}
@@ -1155,6 +1348,83 @@ dsp_cmx_conf(struct dsp *dsp, u32 conf_id)
 	return 0;
 }
 
+/*
+ * tap_id != 0: subscribe to the mixed output of a conference
+ * tap_id == 0: unsubscribe if not already
+ *
+ * A tap is not a member: it contributes no audio and adds no mixing
+ * work, it only gets clones of the summed frame (see
+ * dsp_cmx_send_taps). Subscribing before the conference exists is
+ * allowed; the empty conference waits for its members.
+ */
+int
+dsp_cmx_tap(struct dsp *dsp, u32 tap_id)
+{
+	struct dsp_conf *conf;
+	struct dsp_conf_member *tap;
+
+	/* if tap doesn't change */
+	if (dsp->tap_id == tap_id)
+		return 0;
+
+	/* first remove us from the current tap list */
+	if (dsp->tap_id) {
+		if (dsp_debug & DEBUG_DSP_CMX)
+			printk(KERN_DEBUG "removing tap from conference %d\n",
+			       dsp->tap_conf->id);
+		conf = dsp->tap_conf;
+		tap = dsp->tap_member;
+		spin_lock(&conf->lock);
+		list_del_rcu(&tap->list);
+		spin_unlock(&conf->lock);
+		dsp->tap_conf = NULL;
+		dsp->tap_member = NULL;
+		dsp->tap_id = 0;
+		kfree_rcu(tap, rcu);
+		/* conf now unused? */
+		if (list_empty(&conf->mlist) && list_empty(&conf->tlist))
+			dsp_cmx_del_conf(conf);
+		else if (!list_empty(&conf->mlist))
+			/* members may move back to hardware */
+			dsp_cmx_hardware(conf, NULL);
+	}
+
+	/* if split */
+	if (!tap_id)
+		return 0;
+
+	/* now subscribe */
+	conf = dsp_cmx_search_conf(tap_id);
+	if (!conf) {
+		if (dsp_debug & DEBUG_DSP_CMX)
+			printk(KERN_DEBUG
+			       "tapped conference doesn't exist yet, creating.\n");
+		conf = dsp_cmx_new_conf(tap_id);
+		if (!conf)
+			return -EINVAL;
+	}
+	tap = kzalloc(sizeof(struct dsp_conf_member), GFP_ATOMIC);
+	if (!tap) {
+		printk(KERN_ERR "kzalloc struct dsp_conf_member failed\n");
+		return -ENOMEM;
+	}
+	tap->dsp = dsp;
+	spin_lock(&conf->lock);
+	list_add_tail_rcu(&tap->list, &conf->tlist);
+	spin_unlock(&conf->lock);
+	dsp->tap_conf = conf;
+	dsp->tap_member = tap;
+	dsp->tap_id = tap_id;
+
+	/* a hardware conference has no software sum to clone, so force
+	 * the members back to software mixing
+	 */
+	if (!list_empty(&conf->mlist))
+		dsp_cmx_hardware(conf, NULL);
+
+	return 0;
+}
+
 #ifdef CMX_DELAY_DEBUG
 int delaycount;
 static void
@@ -1185,6 +1455,7 @@ dsp_cmx_receive(struct dsp *dsp, struct sk_buff *skb)
 	int len = skb->len;
 	struct mISDNhead *hh = mISDN_HEAD_P(skb);
 	int w, i, ii;
+	u_long flags;
 
 	/* check if we have sompen */
 	if (len < 1)
@@ -1199,6 +1470,9 @@ dsp_cmx_receive(struct dsp *dsp, struct sk_buff *skb)
 		return;
 	}
 
+	/* the ring pointers are ours alone against the sample timer */
+	spin_lock_irqsave(&dsp->rx_lock, flags);
+
 	/*
 	 * initialize pointers if not already -
 	 * also add delay if requested by PH_SIGNAL
@@ -1252,7 +1526,7 @@ dsp_cmx_receive(struct dsp *dsp, struct sk_buff *skb)
 			else
 				dsp->rx_W = dsp_poll >> 1;
 		}
-		memset(dsp->rx_buff, dsp_silence, sizeof(dsp->rx_buff));
+		memset(dsp->rx_buff, dsp_silence, CMX_BUFF_SIZE);
 	}
 	/* if we have reached double delay, jump back to middle */
 	if (dsp->cmx_delay)
@@ -1273,7 +1547,7 @@ dsp_cmx_receive(struct dsp *dsp, struct sk_buff *skb)
 				dsp->rx_R = 0;
 				dsp->rx_W = dsp->cmx_delay;
 			}
-			memset(dsp->rx_buff, dsp_silence, sizeof(dsp->rx_buff));
+			memset(dsp->rx_buff, dsp_silence, CMX_BUFF_SIZE);
 		}
 
 	/* show where to write */
@@ -1283,27 +1557,92 @@ dsp_cmx_receive(struct dsp *dsp, struct sk_buff *skb)
 	       (u_long)dsp, dsp->rx_R, dsp->rx_W, len, dsp->name);
 #endif
 
-	/* write data into rx_buffer */
+	/* write data into rx_buffer; with the energy gate enabled, the
+	 * mean magnitude of the chunk is collected in the same pass and
+	 * later tells the conference mixer whether we speak at all */
 	p = skb->data;
 	d = dsp->rx_buff;
 	w = dsp->rx_W;
 	i = 0;
 	ii = len;
-	while (i < ii) {
-		d[w++ & CMX_BUFF_MASK] = *p++;
-		i++;
-	}
+	if (dsp_gate) {
+		u32 energy = 0;
+
+		while (i < ii) {
+			energy += abs(dsp_audio_law_to_s32[*p]);
+			d[w++ & CMX_BUFF_MASK] = *p++;
+			i++;
+		}
+		dsp->rx_energy = energy / len;
+	} else
+		while (i < ii) {
+			d[w++ & CMX_BUFF_MASK] = *p++;
+			i++;
+		}
 
 	/* increase write-pointer */
 	dsp->rx_W = ((dsp->rx_W + len) & CMX_BUFF_MASK);
 #ifdef CMX_DELAY_DEBUG
 	showdelay(dsp, len, (dsp->rx_W-dsp->rx_R) & CMX_BUFF_MASK);
 #endif
+
+	spin_unlock_irqrestore(&dsp->rx_lock, flags);
 }
 
 
+/*
+ * preallocated pool of tx frames for the sample tick
+ *
+ * every tick sends one frame per active channel, all allocated with
+ * GFP_ATOMIC from timer (or mix worker) context; at a few hundred
+ * channels the allocator dominates the tick. The pool is refilled
+ * from process context and resized after each tick to twice the
+ * number of frames the tick consumed, so the steady state tick never
+ * calls into the allocator. Frames are consumed by the hardware
+ * drivers, recycling them on free is not possible (a destructor runs
+ * in the middle of kfree_skb and cannot keep the buffer), thus the
+ * pool works on the allocation side only.
+ */
+#define DSP_SPL_POOL_SKBSIZE	(MAX_POLL + 100)
+#define DSP_SPL_POOL_MAX	512
+
+static struct sk_buff_head	dsp_spl_pool;
+static atomic_t			dsp_spl_sends; /* frames of current tick */
+static int			dsp_spl_pool_want;
+static struct work_struct	dsp_spl_pool_work;
+
+static struct sk_buff *
+dsp_cmx_alloc_tx(int size)
+{
+	struct sk_buff *nskb = NULL;
+
+	atomic_inc(&dsp_spl_sends);
+	if (size <= DSP_SPL_POOL_SKBSIZE)
+		nskb = skb_dequeue(&dsp_spl_pool);
+	if (!nskb)
+		nskb = mI_alloc_skb(size, GFP_ATOMIC);
+	return nskb;
+}
+
+static void
+dsp_cmx_pool_refill(struct work_struct *ws)
+{
+	struct sk_buff *skb;
+
+	while (skb_queue_len(&dsp_spl_pool) < dsp_spl_pool_want) {
+		skb = mI_alloc_skb(DSP_SPL_POOL_SKBSIZE, GFP_KERNEL);
+		if (!skb)
+			break;
+		skb_queue_tail(&dsp_spl_pool, skb);
+	}
+}
+
 /*
  * send (mixed) audio data to card and control jitter
+ *
+ * rx buffer runs are read without dsp->rx_lock here; a concurrent
+ * flush in dsp_cmx_receive() can at worst yield one interval of
+ * stale samples
  */
 static void
 dsp_cmx_send_member(struct dsp *dsp, int len, s32 *c, int members)
@@ -1317,6 +1656,7 @@ dsp_cmx_send_member(struct dsp *dsp, int len, s32 *c, int members)
 	int preload = 0;
 	struct mISDNhead *hh, *thh;
 	int tx_data_only = 0;
+	int n;
 
 	/* don't process if: */
 	if (!dsp->b_active) { /* if not active */
@@ -1351,7 +1691,7 @@ dsp_cmx_send_member(struct dsp *dsp, int len, s32 *c, int members)
 	}
 
 	/* PREPARE RESULT */
-	nskb = mI_alloc_skb(len + preload, GFP_ATOMIC);
+	nskb = dsp_cmx_alloc_tx(len + preload);
 	if (!nskb) {
 		printk(KERN_ERR
 		       "FATAL ERROR in mISDN_dsp.o: cannot alloc %d bytes\n",
@@ -1479,8 +1819,12 @@ dsp_cmx_send_member(struct dsp *dsp, int len, s32 *c, int members)
 				o_r = (o_r + 1) & CMX_BUFF_MASK;
 			}
 			while (o_r != o_rr) {
-				*d++ = o_q[o_r];
-				o_r = (o_r + 1) & CMX_BUFF_MASK;
+				n = (o_rr - o_r) & CMX_BUFF_MASK;
+				if (o_r + n > CMX_BUFF_SIZE)
+					n = CMX_BUFF_SIZE - o_r;
+				memcpy(d, o_q + o_r, n);
+				d += n;
+				o_r = (o_r + n) & CMX_BUFF_MASK;
 			}
 			/* -> if echo is enabled */
 		} else {
@@ -1512,6 +1856,15 @@ dsp_cmx_send_member(struct dsp *dsp, int len, s32 *c, int members)
 		goto send_packet;
 	}
 	/* PROCESS DATA (three or more members) */
+	/*
+	 * -> if this member was silent this tick and has neither tx-data
+	 * nor echo, its result equals the shared idle frame of the conf
+	 */
+	if (!dsp->echo.software && t == tt && conf->idle_valid &&
+	    dsp->member && dsp->member->idle) {
+		memcpy(d, conf->idle_frame, len);
+		goto send_packet;
+	}
 	/* -> if echo is NOT enabled */
 	if (!dsp->echo.software) {
 		/*
@@ -1530,15 +1883,15 @@ dsp_cmx_send_member(struct dsp *dsp, int len, s32 *c, int members)
 			r = (r + 1) & CMX_BUFF_MASK;
 			t = (t + 1) & CMX_BUFF_MASK;
 		}
+		/* conf-rx: batch the rest, since tx-data is rarely pending */
 		while (r != rr) {
-			sample = *c++ - dsp_audio_law_to_s32[q[r]];
-			if (sample < -32768)
-				sample = -32768;
-			else if (sample > 32767)
-				sample = 32767;
-			*d++ = dsp_audio_s16_to_law[sample & 0xffff];
-			/* conf-rx */
-			r = (r + 1) & CMX_BUFF_MASK;
+			n = (rr - r) & CMX_BUFF_MASK;
+			if (r + n > CMX_BUFF_SIZE)
+				n = CMX_BUFF_SIZE - r;
+			dsp_audio_law_out_sub(d, c, q + r, n);
+			d += n;
+			c += n;
+			r = (r + n) & CMX_BUFF_MASK;
 		}
 		/* -> if echo is enabled */
 	} else {
@@ -1557,16 +1910,9 @@ dsp_cmx_send_member(struct dsp *dsp, int len, s32 *c, int members)
 			t = (t + 1) & CMX_BUFF_MASK;
 			r = (r + 1) & CMX_BUFF_MASK;
 		}
-		while (r != rr) {
-			sample = *c++;
-			if (sample < -32768)
-				sample = -32768;
-			else if (sample > 32767)
-				sample = 32767;
-			*d++ = dsp_audio_s16_to_law[sample & 0xffff];
-			/* conf(echo) */
-			r = (r + 1) & CMX_BUFF_MASK;
-		}
+		/* conf(echo): result and sum buffer are linear, one call */
+		if (r != rr)
+			dsp_audio_law_out(d, c, (rr - r) & CMX_BUFF_MASK);
 	}
 	dsp->tx_R = t;
 	goto send_packet;
@@ -1586,7 +1932,7 @@ send_packet:
 			/* exit because only tx_data is used */
 			return;
 		} else {
-			txskb = mI_alloc_skb(len, GFP_ATOMIC);
+			txskb = dsp_cmx_alloc_tx(len);
 			if (!txskb) {
 				printk(KERN_ERR
 				       "FATAL ERROR in mISDN_dsp.o: "
@@ -1618,24 +1964,310 @@ send_packet:
 	schedule_work(&dsp->workq);
 }
 
+/*
+ * fan the summed conference frame out to the tap subscribers: encode
+ * it once, then hand out reference counted clones, so 50 monitored
+ * conferences cost 50 encodes and otherwise only refcounts. Runs
+ * under rcu_read_lock of the caller.
+ */
+static void
+dsp_cmx_send_taps(struct dsp_conf *conf, u16 length)
+{
+	struct dsp_conf_member *tap;
+	struct sk_buff *nskb, *cskb;
+	struct mISDNhead *hh;
+
+	nskb = dsp_cmx_alloc_tx(length);
+	if (!nskb) {
+		printk(KERN_ERR
+		       "FATAL ERROR in mISDN_dsp.o: cannot alloc %d bytes\n",
+		       length);
+		return;
+	}
+	hh = mISDN_HEAD_P(nskb);
+	hh->prim = DL_DATA_REQ; /* routed up by dsp_send_bh() */
+	hh->id = 0;
+	dsp_audio_law_out(skb_put(nskb, length), conf->mixbuffer, length);
+	list_for_each_entry_rcu(tap, &conf->tlist, list) {
+		cskb = skb_clone(nskb, GFP_ATOMIC);
+		if (!cskb)
+			continue;
+		skb_queue_tail(&tap->dsp->sendq, cskb);
+		schedule_work(&tap->dsp->workq);
+	}
+	dev_kfree_skb(nskb);
+}
+
+/*
+ * mix and transmit one software conference. Called from the timer, or
+ * from the mix workqueue while the timer holds dsp_lock and waits; the
+ * workers never take the lock themselves.
+ */
+static void
+dsp_cmx_mix_conf(struct dsp_conf *conf, u16 length, int members)
+{
+	struct dsp_conf_member *member;
+	struct dsp *dsp;
+	s32 *c;
+	u8 *q;
+	int r, rr, i;
+	int idle = 0;
+	s32 sval = dsp_audio_law_to_s32[dsp_silence];
+	u_long flags;
+
+	/* mix all data */
+	memset(conf->mixbuffer, 0, length * sizeof(s32));
+	rcu_read_lock();
+	list_for_each_entry_rcu(member, &conf->mlist, list) {
+		dsp = member->dsp;
+		/* get range of data to mix */
+		c = conf->mixbuffer;
+		q = dsp->rx_buff;
+		spin_lock_irqsave(&dsp->rx_lock, flags);
+		/*
+		 * a member without pending rx-data has only silence in its
+		 * window (the maintenance pass wrote it), so its constant
+		 * contribution is folded in below without touching the ring
+		 */
+		member->idle = (dsp->rx_W == dsp->rx_R);
+		/*
+		 * energy gate: a member whose last chunk stayed below the
+		 * gate is treated like an idle one and skips the law
+		 * conversion and summing - in a large conference only the
+		 * few current speakers cost mixing work.  The hangover
+		 * keeps a speaker active over short pauses, the attack is
+		 * immediate because the energy is known before the mix
+		 */
+		if (dsp_gate && !member->idle) {
+			if (dsp->rx_energy >= dsp_gate)
+				member->hang = DSP_GATE_HOLD;
+			else if (member->hang)
+				member->hang--;
+			else
+				member->idle = 1;
+		}
+		if (member->idle) {
+			idle++;
+			spin_unlock_irqrestore(&dsp->rx_lock, flags);
+			continue;
+		}
+		r = dsp->rx_R;
+		rr = (r + length) & CMX_BUFF_MASK;
+		/* add member's data in linear runs */
+		while (r != rr) {
+			i = (rr - r) & CMX_BUFF_MASK;
+			if (r + i > CMX_BUFF_SIZE)
+				i = CMX_BUFF_SIZE - r;
+			dsp_audio_sum_law(c, q + r, i);
+			c += i;
+			r = (r + i) & CMX_BUFF_MASK;
+		}
+		spin_unlock_irqrestore(&dsp->rx_lock, flags);
+	}
+	conf->idle_valid = (idle > 0);
+	if (idle) {
+		c = conf->mixbuffer;
+		if (sval) {
+			for (i = 0; i < length; i++)
+				c[i] += idle * sval;
+		}
+		/* all idle members transmit the same mixed frame */
+		dsp_audio_law_out_subc(conf->idle_frame, c, sval, length);
+	}
+
+	/* the sum is complete here, feed the monitoring taps */
+	if (!list_empty(&conf->tlist))
+		dsp_cmx_send_taps(conf, length);
+
+	/* process each member */
+	list_for_each_entry_rcu(member, &conf->mlist, list) {
+		/* transmission */
+		dsp_cmx_send_member(member->dsp, length,
+				    conf->mixbuffer, members);
+	}
+	rcu_read_unlock();
+}
+
+static void
+dsp_cmx_mix_work(struct work_struct *work)
+{
+	struct dsp_conf *conf = container_of(work, struct dsp_conf, mixwork);
+
+	dsp_cmx_mix_conf(conf, conf->mix_len, conf->mix_members);
+	/* order the mixed results before the pending count */
+	smp_mb__before_atomic();
+	dsp_cmx_mix_done();
+}
+
+/*
+ * drop one outstanding mixer of the current tick; when only the tick's
+ * bias is left this was the last one, so run the buffer maintenance the
+ * timer handed over and release the bias, which re-arms parallel mixing
+ */
+static void
+dsp_cmx_mix_done(void)
+{
+	if (atomic_dec_return(&dsp_mix_pending) == 1) {
+		dsp_cmx_tick_complete(dsp_mix_length, dsp_mix_jittercheck);
+		atomic_dec(&dsp_mix_pending);
+	}
+}
+
+/*
+ * finish a tick once every conference is mixed: erase the rx-data the
+ * mixers consumed, advance the buffer pointers, run the jitter check
+ * and size the tx frame pool. Called by the timer when it mixed in
+ * place, else by the last parallel mixer off the workqueue.
+ */
+static void
+dsp_cmx_tick_complete(u16 length, int jittercheck)
+{
+	struct dsp *dsp;
+	u8 *p, *q;
+	int r, rr, delay, i;
+	u_long flags;
+
+	spin_lock_irqsave(&dsp_lock, flags);
+	/* delete rx-data, increment buffers, change pointers */
+	list_for_each_entry(dsp, &dsp_ilist, list) {
+		if (dsp->hdlc)
+			continue;
+		/* irqs are already off, receive spins meanwhile */
+		spin_lock(&dsp->rx_lock);
+		p = dsp->rx_buff;
+		q = dsp->tx_buff;
+		r = dsp->rx_R;
+		/* move receive pointer when receiving */
+		if (!dsp->rx_is_off) {
+			rr = (r + length) & CMX_BUFF_MASK;
+			/* delete rx-data */
+			while (r != rr) {
+				p[r] = dsp_silence;
+				r = (r + 1) & CMX_BUFF_MASK;
+			}
+			/* increment rx-buffer pointer */
+			dsp->rx_R = r; /* write incremented read pointer */
+		}
+
+		/* check current rx_delay */
+		delay = (dsp->rx_W-dsp->rx_R) & CMX_BUFF_MASK;
+		if (delay >= CMX_BUFF_HALF)
+			delay = 0; /* will be the delay before next write */
+		/* check for lower delay */
+		if (delay < dsp->rx_delay[0])
+			dsp->rx_delay[0] = delay;
+		/* check current tx_delay */
+		delay = (dsp->tx_W-dsp->tx_R) & CMX_BUFF_MASK;
+		if (delay >= CMX_BUFF_HALF)
+			delay = 0; /* will be the delay before next write */
+		/* check for lower delay */
+		if (delay < dsp->tx_delay[0])
+			dsp->tx_delay[0] = delay;
+		if (jittercheck) {
+			/* find the lowest of all rx_delays */
+			delay = dsp->rx_delay[0];
+			i = 1;
+			while (i < MAX_SECONDS_JITTER_CHECK) {
+				if (delay > dsp->rx_delay[i])
+					delay = dsp->rx_delay[i];
+				i++;
+			}
+			/*
+			 * remove rx_delay only if we have delay AND we
+			 * have not preset cmx_delay AND
+			 * the delay is greater dsp_poll
+			 */
+			if (delay > dsp_poll && !dsp->cmx_delay) {
+				if (dsp_debug & DEBUG_DSP_CLOCK)
+					printk(KERN_DEBUG
+					       "%s lowest rx_delay of %d bytes for"
+					       " dsp %s are now removed.\n",
+					       __func__, delay,
+					       dsp->name);
+				r = dsp->rx_R;
+				rr = (r + delay - (dsp_poll >> 1))
+					& CMX_BUFF_MASK;
+				/* delete rx-data */
+				while (r != rr) {
+					p[r] = dsp_silence;
+					r = (r + 1) & CMX_BUFF_MASK;
+				}
+				/* increment rx-buffer pointer */
+				dsp->rx_R = r;
+				/* write incremented read pointer */
+			}
+			/* find the lowest of all tx_delays */
+			delay = dsp->tx_delay[0];
+			i = 1;
+			while (i < MAX_SECONDS_JITTER_CHECK) {
+				if (delay > dsp->tx_delay[i])
+					delay = dsp->tx_delay[i];
+				i++;
+			}
+			/*
+			 * remove delay only if we have delay AND we
+			 * have enabled tx_dejitter
+			 */
+			if (delay > dsp_poll && dsp->tx_dejitter) {
+				if (dsp_debug & DEBUG_DSP_CLOCK)
+					printk(KERN_DEBUG
+					       "%s lowest tx_delay of %d bytes for"
+					       " dsp %s are now removed.\n",
+					       __func__, delay,
+					       dsp->name);
+				r = dsp->tx_R;
+				rr = (r + delay - (dsp_poll >> 1))
+					& CMX_BUFF_MASK;
+				/* delete tx-data */
+				while (r != rr) {
+					q[r] = dsp_silence;
+					r = (r + 1) & CMX_BUFF_MASK;
+				}
+				/* increment rx-buffer pointer */
+				dsp->tx_R = r;
+				/* write incremented read pointer */
+			}
+			/* scroll up delays */
+			i = MAX_SECONDS_JITTER_CHECK - 1;
+			while (i) {
+				dsp->rx_delay[i] = dsp->rx_delay[i - 1];
+				dsp->tx_delay[i] = dsp->tx_delay[i - 1];
+				i--;
+			}
+			dsp->tx_delay[0] = CMX_BUFF_HALF; /* (infinite) delay */
+			dsp->rx_delay[0] = CMX_BUFF_HALF; /* (infinite) delay */
+		}
+		spin_unlock(&dsp->rx_lock);
+	}
+	spin_unlock_irqrestore(&dsp_lock, flags);
+
+	/* size the tx frame pool to twice what this tick used and
+	 * let process context top it up
+	 */
+	i = atomic_xchg(&dsp_spl_sends, 0) * 2;
+	if (i > DSP_SPL_POOL_MAX)
+		i = DSP_SPL_POOL_MAX;
+	dsp_spl_pool_want = i;
+	if (skb_queue_len(&dsp_spl_pool) < i)
+		schedule_work(&dsp_spl_pool_work);
+}
+
 static u32	jittercount; /* counter for jitter check */
-struct timer_list dsp_spl_tl;
-unsigned long	dsp_spl_jiffies; /* calculate the next time to fire */
+struct hrtimer	dsp_spl_tl;
+ktime_t		dsp_spl_period; /* tick period, selected by "poll" */
 static u16	dsp_count; /* last sample count */
 static int	dsp_count_valid; /* if we have last sample count */
 
-void
-dsp_cmx_send(void *arg)
+enum hrtimer_restart
+dsp_cmx_send(struct hrtimer *t)
 {
 	struct dsp_conf *conf;
 	struct dsp_conf_member *member;
 	struct dsp *dsp;
 	int mustmix, members;
 	static s32 mixbuffer[MAX_POLL + 100];
-	s32 *c;
-	u8 *p, *q;
-	int r, rr;
-	int jittercheck = 0, delay, i;
+	int jittercheck = 0;
+	int parallel, queued = 0;
 	u_long flags;
 	u16 length, count;
 
@@ -1676,7 +2308,8 @@ dsp_cmx_send(void *arg)
 #ifdef CMX_CONF_DEBUG
 			if (conf->software && members > 1)
 #else
-				if (conf->software && members > 2)
+				if (conf->software && (members > 2 ||
+				    (members && !list_empty(&conf->tlist))))
 #endif
 					mustmix = 1;
 		}
@@ -1693,166 +2326,60 @@ dsp_cmx_send(void *arg)
 	}
 
 	/* loop all members that require conference mixing */
+	parallel = dsp_mix_wq && num_online_cpus() > 1 &&
+		   atomic_read(&dsp_mix_pending) == 0;
+	if (parallel) {
+		atomic_set(&dsp_mix_pending, 1); /* the tick's bias */
+		/* publish before the first mixer can finish and read them */
+		dsp_mix_length = length;
+		dsp_mix_jittercheck = jittercheck;
+	}
 	list_for_each_entry(conf, &conf_ilist, list) {
 		/* count members and check hardware */
 		members = count_list_member(&conf->mlist);
 #ifdef CMX_CONF_DEBUG
 		if (conf->software && members > 1) {
 #else
-			if (conf->software && members > 2) {
+			if (conf->software && (members > 2 ||
+			    (members && !list_empty(&conf->tlist)))) {
 #endif
 				/* check for hdlc conf */
 				member = list_entry(conf->mlist.next,
 						    struct dsp_conf_member, list);
 				if (member->dsp->hdlc)
 					continue;
-				/* mix all data */
-				memset(mixbuffer, 0, length * sizeof(s32));
-				list_for_each_entry(member, &conf->mlist, list) {
-					dsp = member->dsp;
-					/* get range of data to mix */
-					c = mixbuffer;
-					q = dsp->rx_buff;
-					r = dsp->rx_R;
-					rr = (r + length) & CMX_BUFF_MASK;
-					/* add member's data */
-					while (r != rr) {
-						*c++ += dsp_audio_law_to_s32[q[r]];
-						r = (r + 1) & CMX_BUFF_MASK;
-					}
-				}
-
-				/* process each member */
-				list_for_each_entry(member, &conf->mlist, list) {
-					/* transmission */
-					dsp_cmx_send_member(member->dsp, length,
-							    mixbuffer, members);
-				}
-			}
-		}
-
-		/* delete rx-data, increment buffers, change pointers */
-		list_for_each_entry(dsp, &dsp_ilist, list) {
-			if (dsp->hdlc)
-				continue;
-			p = dsp->rx_buff;
-			q = dsp->tx_buff;
-			r = dsp->rx_R;
-			/* move receive pointer when receiving */
-			if (!dsp->rx_is_off) {
-				rr = (r + length) & CMX_BUFF_MASK;
-				/* delete rx-data */
-				while (r != rr) {
-					p[r] = dsp_silence;
-					r = (r + 1) & CMX_BUFF_MASK;
-				}
-				/* increment rx-buffer pointer */
-				dsp->rx_R = r; /* write incremented read pointer */
-			}
-
-			/* check current rx_delay */
-			delay = (dsp->rx_W-dsp->rx_R) & CMX_BUFF_MASK;
-			if (delay >= CMX_BUFF_HALF)
-				delay = 0; /* will be the delay before next write */
-			/* check for lower delay */
-			if (delay < dsp->rx_delay[0])
-				dsp->rx_delay[0] = delay;
-			/* check current tx_delay */
-			delay = (dsp->tx_W-dsp->tx_R) & CMX_BUFF_MASK;
-			if (delay >= CMX_BUFF_HALF)
-				delay = 0; /* will be the delay before next write */
-			/* check for lower delay */
-			if (delay < dsp->tx_delay[0])
-				dsp->tx_delay[0] = delay;
-			if (jittercheck) {
-				/* find the lowest of all rx_delays */
-				delay = dsp->rx_delay[0];
-				i = 1;
-				while (i < MAX_SECONDS_JITTER_CHECK) {
-					if (delay > dsp->rx_delay[i])
-						delay = dsp->rx_delay[i];
-					i++;
-				}
-				/*
-				 * remove rx_delay only if we have delay AND we
-				 * have not preset cmx_delay AND
-				 * the delay is greater dsp_poll
-				 */
-				if (delay > dsp_poll && !dsp->cmx_delay) {
-					if (dsp_debug & DEBUG_DSP_CLOCK)
-						printk(KERN_DEBUG
-						       "%s lowest rx_delay of %d bytes for"
-						       " dsp %s are now removed.\n",
-						       __func__, delay,
-						       dsp->name);
-					r = dsp->rx_R;
-					rr = (r + delay - (dsp_poll >> 1))
-						& CMX_BUFF_MASK;
-					/* delete rx-data */
-					while (r != rr) {
-						p[r] = dsp_silence;
-						r = (r + 1) & CMX_BUFF_MASK;
-					}
-					/* increment rx-buffer pointer */
-					dsp->rx_R = r;
-					/* write incremented read pointer */
-				}
-				/* find the lowest of all tx_delays */
-				delay = dsp->tx_delay[0];
-				i = 1;
-				while (i < MAX_SECONDS_JITTER_CHECK) {
-					if (delay > dsp->tx_delay[i])
-						delay = dsp->tx_delay[i];
-					i++;
-				}
 				/*
-				 * remove delay only if we have delay AND we
-				 * have enabled tx_dejitter
+				 * independent conferences mix in parallel on
+				 * the workqueue; with a single online cpu, or
+				 * while the previous round is still out, mix
+				 * in place under the lock instead
 				 */
-				if (delay > dsp_poll && dsp->tx_dejitter) {
-					if (dsp_debug & DEBUG_DSP_CLOCK)
-						printk(KERN_DEBUG
-						       "%s lowest tx_delay of %d bytes for"
-						       " dsp %s are now removed.\n",
-						       __func__, delay,
-						       dsp->name);
-					r = dsp->tx_R;
-					rr = (r + delay - (dsp_poll >> 1))
-						& CMX_BUFF_MASK;
-					/* delete tx-data */
-					while (r != rr) {
-						q[r] = dsp_silence;
-						r = (r + 1) & CMX_BUFF_MASK;
-					}
-					/* increment rx-buffer pointer */
-					dsp->tx_R = r;
-					/* write incremented read pointer */
-				}
-				/* scroll up delays */
-				i = MAX_SECONDS_JITTER_CHECK - 1;
-				while (i) {
-					dsp->rx_delay[i] = dsp->rx_delay[i - 1];
-					dsp->tx_delay[i] = dsp->tx_delay[i - 1];
-					i--;
-				}
-				dsp->tx_delay[0] = CMX_BUFF_HALF; /* (infinite) delay */
-				dsp->rx_delay[0] = CMX_BUFF_HALF; /* (infinite) delay */
+				if (parallel) {
+					conf->mix_len = length;
+					conf->mix_members = members;
+					atomic_inc(&dsp_mix_pending);
+					queue_work(dsp_mix_wq, &conf->mixwork);
+					queued++;
+				} else
+					dsp_cmx_mix_conf(conf, length, members);
 			}
-		}
-
-		/* if next event would be in the past ... */
-		if ((s32)(dsp_spl_jiffies + dsp_tics-jiffies) <= 0)
-			dsp_spl_jiffies = jiffies + 1;
-		else
-			dsp_spl_jiffies += dsp_tics;
-
-		dsp_spl_tl.expires = dsp_spl_jiffies;
-		add_timer(&dsp_spl_tl);
+	}
 
-		/* unlock */
+	if (parallel && queued) {
+		/* the last mixer to finish runs dsp_cmx_tick_complete() */
 		spin_unlock_irqrestore(&dsp_lock, flags);
+	} else {
+		if (parallel)
+			atomic_set(&dsp_mix_pending, 0); /* nothing was queued */
+		spin_unlock_irqrestore(&dsp_lock, flags);
+		dsp_cmx_tick_complete(length, jittercheck);
 	}
 
+	/* the hrtimer core catches up if we are late */
+	hrtimer_forward_now(t, dsp_spl_period);
+	return HRTIMER_RESTART;
+}
+
 /*
  * audio data is transmitted from upper layer to the dsp
  */
@@ -1946,7 +2473,8 @@ dsp_cmx_send(void *arg)
 		/* in case of hardware conference */
 		if (dsp->conf->hardware)
 			return;
-		list_for_each_entry(member, &dsp->conf->mlist, list) {
+		rcu_read_lock();
+		list_for_each_entry_rcu(member, &dsp->conf->mlist, list) {
 			if (dsp->echo.software || member->dsp != dsp) {
 				nskb = skb_clone(skb, GFP_ATOMIC);
 				if (nskb) {
@@ -1958,4 +2486,30 @@ dsp_cmx_send(void *arg)
 				}
 			}
 		}
+		rcu_read_unlock();
 	}
+
+/*
+ * workqueue setup/teardown for parallel conference mixing
+ */
+int
+dsp_cmx_module_init(void)
+{
+	skb_queue_head_init(&dsp_spl_pool);
+	INIT_WORK(&dsp_spl_pool_work, dsp_cmx_pool_refill);
+	dsp_mix_wq = alloc_workqueue("mISDN_dsp_mix",
+				     WQ_UNBOUND | WQ_HIGHPRI, 0);
+	if (!dsp_mix_wq)
+		return -ENOMEM;
+	return 0;
+}
+
+void
+dsp_cmx_module_exit(void)
+{
+	/* free conferences still parked on the garbage list */
+	flush_work(&dsp_arena_work);
+	destroy_workqueue(dsp_mix_wq);
+	cancel_work_sync(&dsp_spl_pool_work);
+	skb_queue_purge(&dsp_spl_pool);
+}
@@ -155,6 +155,8 @@
 
 #include <linux/delay.h>
 #include <linux/gfp.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
 #include <linux/mISDNif.h>
 #include <linux/mISDNdsp.h>
 #include <linux/module.h>
@@ -168,12 +170,16 @@ static int debug;
 static int options;
 static int poll;
 static int dtmfthreshold = 100;
+static int workers;
+static int gate = 200;
 
 MODULE_AUTHOR("Andreas Eversberg");
 module_param(debug, uint, S_IRUGO | S_IWUSR);
 module_param(options, uint, S_IRUGO | S_IWUSR);
 module_param(poll, uint, S_IRUGO | S_IWUSR);
 module_param(dtmfthreshold, uint, S_IRUGO | S_IWUSR);
+module_param(workers, uint, S_IRUGO);
+module_param(gate, uint, S_IRUGO | S_IWUSR);
 MODULE_LICENSE("GPL");
 
 /*int spinnest = 0;*/
@@ -183,7 +189,11 @@ struct list_head dsp_ilist;
 struct list_head conf_ilist;
 int dsp_debug;
 int dsp_options;
-int dsp_poll, dsp_tics;
+int dsp_poll;
+int dsp_gate;
+
+/* worker pool for channels with expensive receive processing */
+static struct workqueue_struct *dsp_rx_wq;
 
 /* check if rx may be turned off or must be turned on */
 static void
@@ -233,22 +243,38 @@ dsp_rx_off_member(struct dsp *dsp)
 		printk(KERN_DEBUG "%s: %s set rx_off = %d\n",
 		       __func__, dsp->name, rx_off);
 }
+/* cache whether the receive path has any work besides handing the
+ * frame to the upper layer; dsp_function then tests one flag instead
+ * of walking the whole feature set for every transparent frame
+ */
+static void
+dsp_update_passthru(struct dsp *dsp)
+{
+	dsp->rx_passthru = !dsp->bf_enable && !dsp->pipeline.inuse &&
+		!dsp->rx_volume && !dsp->dtmf.software && !dsp->rx_disabled &&
+		!(dsp->conf && dsp->conf->software);
+}
+
 static void
 dsp_rx_off(struct dsp *dsp)
 {
 	struct dsp_conf_member	*member;
 
-	if (dsp_options & DSP_OPT_NOHARDWARE)
-		return;
-
-	/* no conf */
+	/* every reconfiguration funnels through here, so the cached
+	 * passthrough state is refreshed even without hardware features
+	 */
 	if (!dsp->conf) {
+		dsp_update_passthru(dsp);
+		if (dsp_options & DSP_OPT_NOHARDWARE)
+			return;
 		dsp_rx_off_member(dsp);
 		return;
 	}
 	/* check all members in conf */
 	list_for_each_entry(member, &dsp->conf->mlist, list) {
-		dsp_rx_off_member(member->dsp);
+		dsp_update_passthru(member->dsp);
+		if (!(dsp_options & DSP_OPT_NOHARDWARE))
+			dsp_rx_off_member(member->dsp);
 	}
 }
 
@@ -309,6 +335,11 @@ dsp_control_req(struct dsp *dsp, struct mISDNhead *hh, struct sk_buff *skb)
 				printk(KERN_NOTICE "changing DTMF Threshold "
 				       "to %d\n", *((int *)data));
 			dsp->dtmf.treshold = (*(int *)data) * 10000;
+		} else if (!dsp->dtmf.treshold) {
+			/* first use on this channel, take module default */
+			if (dtmfthreshold < 20 || dtmfthreshold > 500)
+				dtmfthreshold = 200;
+			dsp->dtmf.treshold = dtmfthreshold * 10000;
 		}
 		dsp->dtmf.enable = 1;
 		/* init goertzel */
@@ -351,6 +382,28 @@ dsp_control_req(struct dsp *dsp, struct mISDNhead *hh, struct sk_buff *skb)
 			dsp_cmx_debug(dsp);
 		dsp_rx_off(dsp);
 		break;
+	case DSP_TAP_JOIN: /* monitor the mixed output of a conference */
+		if (len < sizeof(int)) {
+			ret = -EINVAL;
+			break;
+		}
+		if (*((u32 *)data) == 0)
+			goto tap_split;
+		if (dsp_debug & DEBUG_DSP_CORE)
+			printk(KERN_DEBUG "%s: tap conference %d\n",
+			       __func__, *((u32 *)data));
+		ret = dsp_cmx_tap(dsp, *((u32 *)data));
+		if (dsp_debug & DEBUG_DSP_CMX)
+			dsp_cmx_debug(dsp);
+		break;
+	case DSP_TAP_SPLIT: /* remove tap from conference */
+	tap_split:
+		if (dsp_debug & DEBUG_DSP_CORE)
+			printk(KERN_DEBUG "%s: release tap\n", __func__);
+		ret = dsp_cmx_tap(dsp, 0);
+		if (dsp_debug & DEBUG_DSP_CMX)
+			dsp_cmx_debug(dsp);
+		break;
 	case DSP_TONE_PATT_ON: /* play tone */
 		if (dsp->hdlc) {
 			ret = -EINVAL;
@@ -662,6 +715,97 @@ get_features(struct mISDNchannel *ch)
 			       __func__, dsp->name);
 }
 
+/*
+ * process one received transparent audio frame and pass it up; runs
+ * inline from dsp_function, or deferred on the rx worker pool when
+ * heavy per-channel processing has been moved off the stack context.
+ * Consumes the skb.
+ */
+static void
+dsp_rx_data(struct dsp *dsp, struct sk_buff *skb)
+{
+	struct mISDNhead	*hh = mISDN_HEAD_P(skb);
+	u8			*digits = NULL;
+
+	/*
+	 * the receive path does not take the global lock anymore:
+	 * the rx ring is serialized against the sample timer by
+	 * dsp->rx_lock inside dsp_cmx_receive(), the pipeline swaps
+	 * its element set under rcu, and the remaining features are
+	 * reconfigured only by control messages of this channel
+	 */
+	rcu_read_lock();
+
+	/* decrypt if enabled */
+	if (dsp->bf_enable)
+		dsp_bf_decrypt(dsp, skb->data, skb->len);
+	/* pipeline */
+	if (dsp->pipeline.inuse)
+		dsp_pipeline_process_rx(&dsp->pipeline, skb->data,
+					skb->len, hh->id);
+	/* change volume if requested */
+	if (dsp->rx_volume)
+		dsp_change_volume(skb, dsp->rx_volume);
+	/* check if dtmf soft decoding is turned on */
+	if (dsp->dtmf.software) {
+		digits = dsp_dtmf_goertzel_decode(dsp, skb->data,
+						  skb->len, (dsp_options & DSP_OPT_ULAW) ? 1 : 0);
+	}
+	/* we need to process receive data if software */
+	if (dsp->conf && dsp->conf->software) {
+		/* process data from card at cmx */
+		dsp_cmx_receive(dsp, skb);
+	}
+
+	rcu_read_unlock();
+
+	/* send dtmf result, if any */
+	if (digits) {
+		while (*digits) {
+			int k;
+			struct sk_buff *nskb;
+			if (dsp_debug & DEBUG_DSP_DTMF)
+				printk(KERN_DEBUG "%s: digit"
+				       "(%c) to layer %s\n",
+				       __func__, *digits, dsp->name);
+			k = *digits | DTMF_TONE_VAL;
+			nskb = _alloc_mISDN_skb(PH_CONTROL_IND,
+						MISDN_ID_ANY, sizeof(int), &k,
+						GFP_ATOMIC);
+			if (nskb) {
+				if (dsp->up) {
+					if (dsp->up->send(
+						    dsp->up, nskb))
+						dev_kfree_skb(nskb);
+				} else
+					dev_kfree_skb(nskb);
+			}
+			digits++;
+		}
+	}
+	if (dsp->rx_disabled) {
+		/* if receive is not allowed */
+		dev_kfree_skb(skb);
+		return;
+	}
+	hh->prim = DL_DATA_IND;
+	if (dsp->up) {
+		if (dsp->up->send(dsp->up, skb))
+			dev_kfree_skb(skb);
+	} else
+		dev_kfree_skb(skb);
+}
+
+static void
+dsp_rx_bh(struct work_struct *work)
+{
+	struct dsp *dsp = container_of(work, struct dsp, rx_workq);
+	struct sk_buff *skb;
+
+	while ((skb = skb_dequeue(&dsp->rxq)))
+		dsp_rx_data(dsp, skb);
+}
+
 static int
 dsp_function(struct mISDNchannel *ch,  struct sk_buff *skb)
 {
@@ -690,6 +834,8 @@ dsp_function(struct mISDNchannel *ch,  struct sk_buff *skb)
 			ret = -EINVAL;
 			break;
 		}
+		if (mISDN_rx_trace)
+			mISDN_lat_sample(MISDN_LAT_DSP, skb);
 		if (dsp->rx_is_off) {
 			if (dsp_debug & DEBUG_DSP_CORE)
 				printk(KERN_DEBUG "%s: rx-data during rx_off"
@@ -697,10 +843,10 @@ dsp_function(struct mISDNchannel *ch,  struct sk_buff *skb)
 				       __func__, dsp->name);
 		}
 		if (dsp->hdlc) {
-			/* hdlc */
-			spin_lock_irqsave(&dsp_lock, flags);
+			/* hdlc, member list is walked under rcu */
+			rcu_read_lock();
 			dsp_cmx_hdlc(dsp, skb);
-			spin_unlock_irqrestore(&dsp_lock, flags);
+			rcu_read_unlock();
 			if (dsp->rx_disabled) {
 				/* if receive is not allowed */
 				break;
@@ -711,63 +857,27 @@ dsp_function(struct mISDNchannel *ch,  struct sk_buff *skb)
 			break;
 		}
 
-		spin_lock_irqsave(&dsp_lock, flags);
-
-		/* decrypt if enabled */
-		if (dsp->bf_enable)
-			dsp_bf_decrypt(dsp, skb->data, skb->len);
-		/* pipeline */
-		if (dsp->pipeline.inuse)
-			dsp_pipeline_process_rx(&dsp->pipeline, skb->data,
-						skb->len, hh->id);
-		/* change volume if requested */
-		if (dsp->rx_volume)
-			dsp_change_volume(skb, dsp->rx_volume);
-		/* check if dtmf soft decoding is turned on */
-		if (dsp->dtmf.software) {
-			digits = dsp_dtmf_goertzel_decode(dsp, skb->data,
-							  skb->len, (dsp_options & DSP_OPT_ULAW) ? 1 : 0);
-		}
-		/* we need to process receive data if software */
-		if (dsp->conf && dsp->conf->software) {
-			/* process data from card at cmx */
-			dsp_cmx_receive(dsp, skb);
+		if (dsp->rx_passthru) {
+			/* transparent end to end, nothing looks at the
+			 * samples; deliver without the feature cascade */
+			hh->prim = DL_DATA_IND;
+			if (dsp->up)
+				return dsp->up->send(dsp->up, skb);
+			break;
 		}
 
-		spin_unlock_irqrestore(&dsp_lock, flags);
-
-		/* send dtmf result, if any */
-		if (digits) {
-			while (*digits) {
-				int k;
-				struct sk_buff *nskb;
-				if (dsp_debug & DEBUG_DSP_DTMF)
-					printk(KERN_DEBUG "%s: digit"
-					       "(%c) to layer %s\n",
-					       __func__, *digits, dsp->name);
-				k = *digits | DTMF_TONE_VAL;
-				nskb = _alloc_mISDN_skb(PH_CONTROL_IND,
-							MISDN_ID_ANY, sizeof(int), &k,
-							GFP_ATOMIC);
-				if (nskb) {
-					if (dsp->up) {
-						if (dsp->up->send(
-							    dsp->up, nskb))
-							dev_kfree_skb(nskb);
-					} else
-						dev_kfree_skb(nskb);
-				}
-				digits++;
-			}
-		}
-		if (dsp->rx_disabled) {
-			/* if receive is not allowed */
-			break;
+		if (dsp_rx_wq && dsp->pipeline.inuse) {
+			/* channels with heavy per-sample processing (e.g.
+			 * echo cancellation) go to the worker pool, so one
+			 * expensive channel cannot stall the whole stack;
+			 * the single work item per channel keeps frames in
+			 * order while different channels run in parallel */
+			skb_queue_tail(&dsp->rxq, skb);
+			queue_work(dsp_rx_wq, &dsp->rx_workq);
+			return 0;
 		}
-		hh->prim = DL_DATA_IND;
-		if (dsp->up)
-			return dsp->up->send(dsp->up, skb);
-		break;
+		dsp_rx_data(dsp, skb);
+		return 0;
 	case (PH_CONTROL_IND):
 		if (dsp_debug & DEBUG_DSP_DTMFCOEFF)
 			printk(KERN_DEBUG "%s: PH_CONTROL INDICATION "
@@ -841,7 +951,7 @@ dsp_function(struct mISDNchannel *ch,  struct sk_buff *skb)
 		/* rx_W and rx_R will be adjusted on first frame */
 		dsp->rx_W = 0;
 		dsp->rx_R = 0;
-		memset(dsp->rx_buff, 0, sizeof(dsp->rx_buff));
+		memset(dsp->rx_buff, 0, CMX_BUFF_SIZE);
 		dsp_cmx_hardware(dsp->conf, dsp);
 		dsp_dtmf_hardware(dsp);
 		dsp_rx_off(dsp);
@@ -933,6 +1043,8 @@ dsp_function(struct mISDNchannel *ch,  struct sk_buff *skb)
 		if (dsp->conf)
 			dsp_cmx_conf(dsp, 0); /* dsp_cmx_hardware will also be
 						 called here */
+		if (dsp->tap_id)
+			dsp_cmx_tap(dsp, 0);
 		skb_queue_purge(&dsp->sendq);
 		spin_unlock_irqrestore(&dsp_lock, flags);
 		hh->prim = PH_DEACTIVATE_REQ;
@@ -975,16 +1087,19 @@ dsp_ctrl(struct mISDNchannel *ch, u_int cmd, void *arg)
 		spin_unlock_irqrestore(&dsp_lock, flags);
 		/* MUST not be locked, because it waits until queue is done. */
 		cancel_work_sync(&dsp->workq);
+		cancel_work_sync(&dsp->rx_workq);
 		spin_lock_irqsave(&dsp_lock, flags);
 		if (timer_pending(&dsp->tone.tl))
 			del_timer(&dsp->tone.tl);
 		skb_queue_purge(&dsp->sendq);
+		skb_queue_purge(&dsp->rxq);
 		if (dsp_debug & DEBUG_DSP_CTRL)
 			printk(KERN_DEBUG "%s: releasing member %s\n",
 			       __func__, dsp->name);
 		dsp->b_active = 0;
 		dsp_cmx_conf(dsp, 0); /* dsp_cmx_hardware will also be called
 					 here */
+		dsp_cmx_tap(dsp, 0);
 		dsp_pipeline_destroy(&dsp->pipeline);
 
 		if (dsp_debug & DEBUG_DSP_CTRL)
@@ -1066,6 +1181,8 @@ dspcreate(struct channel_req *crq)
 	/* default enabled */
 	INIT_WORK(&ndsp->workq, (void *)dsp_send_bh);
 	skb_queue_head_init(&ndsp->sendq);
+	INIT_WORK(&ndsp->rx_workq, dsp_rx_bh);
+	skb_queue_head_init(&ndsp->rxq);
 	ndsp->ch.send = dsp_function;
 	ndsp->ch.ctrl = dsp_ctrl;
 	ndsp->up = crq->ch;
@@ -1091,15 +1208,14 @@ dspcreate(struct channel_req *crq)
 	ndsp->pcm_bank_rx = -1;
 	ndsp->pcm_bank_tx = -1;
 	ndsp->hfc_conf = -1; /* current conference number */
-	/* set tone timer */
-	timer_setup(&ndsp->tone.tl, dsp_tone_timeout, 0);
-
-	if (dtmfthreshold < 20 || dtmfthreshold > 500)
-		dtmfthreshold = 200;
-	ndsp->dtmf.treshold = dtmfthreshold * 10000;
+	/* tone timer and dtmf threshold are set up lazily on first use
+	 * through their control messages; the common trunk channel just
+	 * passes audio and never needs either */
 
 	/* init pipeline append to list */
 	spin_lock_irqsave(&dsp_lock, flags);
+	spin_lock_init(&ndsp->rx_lock);
+	ndsp->rx_buff = ndsp->rx_buff_mem;
 	dsp_pipeline_init(&ndsp->pipeline);
 	list_add_tail(&ndsp->list, &dsp_ilist);
 	spin_unlock_irqrestore(&dsp_lock, flags);
@@ -1118,14 +1234,17 @@ static struct Bprotocol DSP = {
 static int __init dsp_init(void)
 {
 	int err;
-	int tics;
 
 	printk(KERN_INFO "DSP module %s\n", mISDN_dsp_revision);
 
 	dsp_options = options;
 	dsp_debug = debug;
+	dsp_gate = gate;
 
-	/* set packet size */
+	/*
+	 * set packet size. the tick is an hrtimer now, so any period of
+	 * 8-256 samples works, independent of HZ; 8 samples equal 1 ms
+	 */
 	dsp_poll = poll;
 	if (dsp_poll) {
 		if (dsp_poll > MAX_POLL) {
@@ -1140,37 +1259,11 @@ static int __init dsp_init(void)
 			err = -EINVAL;
 			return err;
 		}
-		dsp_tics = poll * HZ / 8000;
-		if (dsp_tics * 8000 != poll * HZ) {
-			printk(KERN_INFO "mISDN_dsp: Cannot clock every %d "
-			       "samples (0,125 ms). It is not a multiple of "
-			       "%d HZ.\n", poll, HZ);
-			err = -EINVAL;
-			return err;
-		}
-	} else {
-		poll = 8;
-		while (poll <= MAX_POLL) {
-			tics = (poll * HZ) / 8000;
-			if (tics * 8000 == poll * HZ) {
-				dsp_tics = tics;
-				dsp_poll = poll;
-				if (poll >= 64)
-					break;
-			}
-			poll++;
-		}
-	}
-	if (dsp_poll == 0) {
-		printk(KERN_INFO "mISDN_dsp: There is no multiple of kernel "
-		       "clock that equals exactly the duration of 8-256 "
-		       "samples. (Choose kernel clock speed like 100, 250, "
-		       "300, 1000)\n");
-		err = -EINVAL;
-		return err;
-	}
+	} else
+		dsp_poll = 64; /* default of 8 ms */
+	dsp_spl_period = ns_to_ktime((u64)dsp_poll * (NSEC_PER_SEC / 8000));
 	printk(KERN_INFO "mISDN_dsp: DSP clocks every %d samples. This equals "
-	       "%d jiffies.\n", dsp_poll, dsp_tics);
+	       "%lld us.\n", dsp_poll, ktime_to_us(dsp_spl_period));
 
 	spin_lock_init(&dsp_lock);
 	INIT_LIST_HEAD(&dsp_ilist);
@@ -1187,6 +1280,7 @@ static int __init dsp_init(void)
 	if (dsp_options & DSP_OPT_ULAW)
 		dsp_audio_generate_ulaw_samples();
 	dsp_audio_generate_volume_changes();
+	dsp_tone_generate_cache();
 
 	err = dsp_pipeline_module_init();
 	if (err) {
@@ -1195,6 +1289,26 @@ static int __init dsp_init(void)
 		return err;
 	}
 
+	err = dsp_cmx_module_init();
+	if (err) {
+		printk(KERN_ERR "mISDN_dsp: Can't initialize cmx workqueue, "
+		       "error(%d)\n", err);
+		dsp_pipeline_module_exit();
+		return err;
+	}
+
+	/* optional worker pool; workers limits the per-node concurrency */
+	if (workers) {
+		dsp_rx_wq = alloc_workqueue("mISDN_dsp_rx", WQ_UNBOUND,
+					    workers);
+		if (!dsp_rx_wq)
+			printk(KERN_WARNING "mISDN_dsp: Can't allocate rx "
+			       "worker pool, processing stays inline.\n");
+		else
+			printk(KERN_INFO "mISDN_dsp: rx processing on up to "
+			       "%d workers.\n", workers);
+	}
+
 	err = mISDN_register_Bprotocol(&DSP);
 	if (err) {
 		printk(KERN_ERR "Can't register %s error(%d)\n", DSP.name, err);
@@ -1202,10 +1316,9 @@ static int __init dsp_init(void)
 	}
 
 	/* set sample timer */
-	timer_setup(&dsp_spl_tl, (void *)dsp_cmx_send, 0);
-	dsp_spl_tl.expires = jiffies + dsp_tics;
-	dsp_spl_jiffies = dsp_spl_tl.expires;
-	add_timer(&dsp_spl_tl);
+	hrtimer_init(&dsp_spl_tl, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	dsp_spl_tl.function = dsp_cmx_send;
+	hrtimer_start(&dsp_spl_tl, dsp_spl_period, HRTIMER_MODE_REL);
 
 	return 0;
 }
@@ -1215,7 +1328,12 @@ static void __exit dsp_cleanup(void)
 {
 	mISDN_unregister_Bprotocol(&DSP);
 
-	del_timer_sync(&dsp_spl_tl);
+	hrtimer_cancel(&dsp_spl_tl);
+
+	if (dsp_rx_wq)
+		destroy_workqueue(dsp_rx_wq);
+
+	dsp_cmx_module_exit();
 
 	if (!list_empty(&dsp_ilist)) {
 		printk(KERN_ERR "mISDN_dsp: Audio DSP object inst list not "
@@ -1226,6 +1344,7 @@ static void __exit dsp_cleanup(void)
 		       "all memory freed.\n");
 	}
 
+	dsp_tone_free_cache();
 	dsp_pipeline_module_exit();
 }
 
@@ -106,6 +106,56 @@ _do:
 	}
 }
 
+/*
+ * enable the hw echocanceller on a whole set of card channels with a
+ * single control operation; the hardware driver applies the mask in one
+ * pass. Any channel of the card may carry the request.
+ */
+void dsp_hwec_enable_mask(struct dsp *dsp, u32 mask, int deftaps)
+{
+	struct mISDN_ctrl_req	cq;
+
+	if (!dsp) {
+		printk(KERN_ERR "%s: failed to enable hwec: dsp is NULL\n",
+		       __func__);
+		return;
+	}
+
+	printk(KERN_DEBUG "%s: enabling hwec on mask 0x%x with deftaps=%d\n",
+	       __func__, mask, deftaps);
+	memset(&cq, 0, sizeof(cq));
+	cq.op = MISDN_CTRL_HFC_ECHOCAN_MASK_ON;
+	cq.p1 = deftaps;
+	cq.p2 = mask;
+	if (!dsp->ch.peer->ctrl(&dsp->ch, CONTROL_CHANNEL, &cq)) {
+		printk(KERN_DEBUG "%s: CONTROL_CHANNEL failed\n",
+		       __func__);
+		return;
+	}
+}
+
+void dsp_hwec_disable_mask(struct dsp *dsp, u32 mask)
+{
+	struct mISDN_ctrl_req	cq;
+
+	if (!dsp) {
+		printk(KERN_ERR "%s: failed to disable hwec: dsp is NULL\n",
+		       __func__);
+		return;
+	}
+
+	printk(KERN_DEBUG "%s: disabling hwec on mask 0x%x\n", __func__,
+	       mask);
+	memset(&cq, 0, sizeof(cq));
+	cq.op = MISDN_CTRL_HFC_ECHOCAN_MASK_OFF;
+	cq.p2 = mask;
+	if (!dsp->ch.peer->ctrl(&dsp->ch, CONTROL_CHANNEL, &cq)) {
+		printk(KERN_DEBUG "%s: CONTROL_CHANNEL failed\n",
+		       __func__);
+		return;
+	}
+}
+
 void dsp_hwec_disable(struct dsp *dsp)
 {
 	struct mISDN_ctrl_req	cq;
@@ -6,5 +6,7 @@
 extern struct mISDN_dsp_element *dsp_hwec;
 extern void dsp_hwec_enable(struct dsp *dsp, const char *arg);
 extern void dsp_hwec_disable(struct dsp *dsp);
+extern void dsp_hwec_enable_mask(struct dsp *dsp, u32 mask, int deftaps);
+extern void dsp_hwec_disable_mask(struct dsp *dsp, u32 mask);
 extern int  dsp_hwec_init(void);
 extern void dsp_hwec_exit(void);
@@ -63,6 +63,11 @@ struct echo_can_state {
 
 	int N_d;
 	int beta2_i;
+	/* samples between tap updates (block NLMS), at least DEFAULT_M */
+	int update_period;
+	/* adaptive tail shrinking */
+	int shrink;
+	int N_active;
 
 	/* declare accumulators for power computations */
 	int Ly_i;
@@ -126,6 +131,9 @@ init_cc(struct echo_can_state *ec, int N, int maxy, int maxu)
 	/* reset parameters */
 	ec->N_d = N;
 	ec->beta2_i = DEFAULT_BETA1_I;
+	ec->update_period = DEFAULT_M;
+	ec->shrink = 0;
+	ec->N_active = N;
 
 	/* allocate coefficient memory */
 	ec->a_i = ptr;
@@ -168,6 +176,39 @@ static inline void echo_can_free(struct echo_can_state *ec)
 	FREE(ec);
 }
 
+static inline void
+echo_can_shrink_tail(struct echo_can_state *ec)
+{
+	unsigned int total, blk;
+	int k, j, last;
+
+	/* residual crept back up - run the full tail again
+	   (Lu and Ly accumulate over the same window length) */
+	if (ec->Lu_i > (ec->Ly_i >> SHRINK_ERLE_SHIFT)) {
+		ec->N_active = ec->N_d;
+		return;
+	}
+
+	total = 0;
+	for (k = 0; k < ec->N_d; k++)
+		total += abs(ec->a_s[k]);
+
+	/* keep everything up to the last DEFAULT_M block of taps that
+	   still carries a real share of the filter energy */
+	last = SHRINK_MIN;
+	for (k = 0; k + DEFAULT_M <= ec->N_d; k += DEFAULT_M) {
+		blk = 0;
+		for (j = 0; j < DEFAULT_M; j++)
+			blk += abs(ec->a_s[k + j]);
+		if (blk > (total >> SHRINK_TAIL_SHIFT))
+			last = k + DEFAULT_M;
+	}
+	last += SHRINK_MARGIN;
+	if (last > ec->N_d)
+		last = ec->N_d;
+	ec->N_active = last;
+}
+
 static inline short
 echo_can_update(struct echo_can_state *ec, short iref, short isig)
 {
@@ -201,7 +242,7 @@ echo_can_update(struct echo_can_state *ec, short iref, short isig)
 	add_cc_s(&ec->y_s, iref);
 
 	/* eq. (2): compute r in fixed-point */
-	rs = CONVOLVE2(ec->a_s, ec->y_s.buf_d + ec->y_s.idx_d, ec->N_d);
+	rs = CONVOLVE2(ec->a_s, ec->y_s.buf_d + ec->y_s.idx_d, ec->N_active);
 	rs >>= 15;
 
 	/* eq. (3): compute the output value (see figure 3) and the error
@@ -305,10 +346,10 @@ echo_can_update(struct echo_can_state *ec, short iref, short isig)
   /* update coefficients if no near-end speech and we have enough signal
    * to bother trying to update.
   */
-	if (!ec->HCNTR_d && !(ec->i_d % DEFAULT_M) &&
+	if (!ec->HCNTR_d && !(ec->i_d % ec->update_period) &&
 		(ec->Lu_i > MIN_UPDATE_THRESH_I)) {
-		/* loop over all filter coefficients */
-		for (k = 0; k < ec->N_d; k++) {
+		/* loop over the active filter coefficients */
+		for (k = 0; k < ec->N_active; k++) {
 			/* eq. (7): compute an expectation over M_d samples */
 			int grad2;
 			grad2 = CONVOLVE2(ec->u_s.buf_d + ec->u_s.idx_d,
@@ -365,6 +406,11 @@ echo_can_update(struct echo_can_state *ec, short iref, short isig)
 
 	}
 	*/
+	/* once in a while, re-measure how much of the tail is live */
+	if (ec->shrink && !ec->HCNTR_d && ec->i_d &&
+		!(ec->i_d % SHRINK_PERIOD))
+		echo_can_shrink_tail(ec);
+
 	ec->i_d++;
 	return u;
 }
@@ -410,4 +456,29 @@ echo_can_traintap(struct echo_can_state *ec, int pos, short val)
 	return 0;
 }
 
+/* this canceller supports block NLMS tap updates */
+#define EC_HAS_UPDATE_INTERVAL
+
+static inline void
+echo_can_update_interval(struct echo_can_state *ec, int interval)
+{
+	/* the gradient expectation always runs over the last DEFAULT_M
+	   samples, so shorter intervals gain nothing; longer ones adapt
+	   the taps once per that many samples while still filtering
+	   every sample */
+	if (interval > DEFAULT_M)
+		ec->update_period = interval;
+}
+
+/* this canceller can shorten its active tail once converged */
+#define EC_HAS_TAIL_SHRINK
+
+static inline void
+echo_can_shrink_enable(struct echo_can_state *ec, int on)
+{
+	ec->shrink = on;
+	if (!on)
+		ec->N_active = ec->N_d;
+}
+
 #endif
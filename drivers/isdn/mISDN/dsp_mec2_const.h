@@ -21,6 +21,13 @@
 #define RES_SUPR_FACTOR -20
 #define AGGRESSIVE_HCNTR 160	/* 20ms */
 
+/* Adaptive tail shrinking */
+#define SHRINK_PERIOD 4096	/* samples between tail re-evaluations */
+#define SHRINK_MARGIN (2 * DEFAULT_M) /* taps kept past the last live block */
+#define SHRINK_MIN (4 * DEFAULT_M)	/* never shrink below this */
+#define SHRINK_TAIL_SHIFT 6	/* block is live above 1/64 of tap energy */
+#define SHRINK_ERLE_SHIFT 2	/* re-expand when Lu rises above Ly/4 */
+
 /* Only use agressive echo cancellation for this amount of time then
    go back to normal cancelation */
 /* #define AGGRESSIVE_TIMELIMIT 150000 */ /* 8 = 1ms */
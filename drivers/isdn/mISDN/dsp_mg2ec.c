@@ -36,6 +36,8 @@ static void *new(const char *arg)
 {
 	int deftaps = 128,
 		training = 0,
+		blockadapt = 0,
+		shrink = 0,
 		len;
 
 	if (!arg)
@@ -68,14 +70,21 @@ static void *new(const char *arg)
 			} else if (!strcmp(name, "training")) {
 				if (sscanf(val, "%d", &tmp) == 1)
 					training = tmp;
+			} else if (!strcmp(name, "blockadapt")) {
+				if (sscanf(val, "%d", &tmp) == 1)
+					blockadapt = tmp;
+			} else if (!strcmp(name, "shrink")) {
+				if (sscanf(val, "%d", &tmp) == 1)
+					shrink = tmp;
 			}
 		}
 	}
 
 _out:
-	printk(KERN_DEBUG "%s: creating %s with deftaps=%d and training=%d\n",
-		__func__, EC_TYPE, deftaps, training);
-	return dsp_cancel_new(deftaps, training);
+	printk(KERN_DEBUG "%s: creating %s with deftaps=%d, training=%d, "
+		"blockadapt=%d and shrink=%d\n",
+		__func__, EC_TYPE, deftaps, training, blockadapt, shrink);
+	return dsp_cancel_new(deftaps, training, blockadapt, shrink);
 }
 
 static void free(void *p)
@@ -96,6 +105,10 @@ static void process_rx(void *p, u8 *data, int len, unsigned int txlen)
 static struct mISDN_dsp_element_arg args[] = {
 	{ "deftaps", "128", "Set the number of taps of cancellation." },
 	{ "training", "0", "Enable echotraining (0: disabled, 1: enabled)." },
+	{ "blockadapt", "0", "Adapt taps once per this many samples "
+		"(block NLMS, 0: every 16th sample)." },
+	{ "shrink", "0", "Shrink the active tail once converged "
+		"(0: disabled, 1: enabled)." },
 };
 
 static struct mISDN_dsp_element dsp_mg2ec = {
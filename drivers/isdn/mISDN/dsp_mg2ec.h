@@ -113,6 +113,13 @@ struct echo_can_state {
 	int N_d;
 	/* Rate of adaptation of filter */
 	int beta2_i;
+	/* Samples between tap updates (block NLMS), at least DEFAULT_M */
+	int update_period;
+	/* Adaptive tail shrinking enabled? */
+	int shrink;
+	/* Number of filter coefficients currently convolved and adapted -
+	 * trimmed below N_d while the can performs well enough */
+	int N_active;
 
 	/* Accumulators for power computations */
 	/* ----------------------------------- */
@@ -223,6 +230,9 @@ static inline void init_cc(struct echo_can_state *ec, int N, int maxy, int maxu)
 	/* Reset parameters */
 	ec->N_d = N;
 	ec->beta2_i = DEFAULT_BETA1_I;
+	ec->update_period = DEFAULT_M;
+	ec->shrink = 0;
+	ec->N_active = N;
 
 	/* Allocate coefficient memory */
 	ec->a_i = ptr;
@@ -296,6 +306,45 @@ static inline short dc_removal(int *dc_estimate, short samp)
 }
 #endif
 
+static inline void
+echo_can_shrink_tail(struct echo_can_state *ec)
+{
+	unsigned int total, blk;
+	int k, j, last;
+
+	/* If the suppressed signal power has crept back up relative to the
+	 * reference - e.g. after an echo path change - then the trimmed
+	 * region is no longer covering the whole echo, so grow back to the
+	 * full configured tail. Lu and Ly accumulate over windows of the
+	 * same length, so they can be compared directly. */
+	if (ec->Lu_i > (ec->Ly_i >> SHRINK_ERLE_SHIFT)) {
+		ec->N_active = ec->N_d;
+		return;
+	}
+
+	total = 0;
+	for (k = 0; k < ec->N_d; k++)
+		total += abs(ec->a_s[k]);
+
+	/* Scan the coefficients in DEFAULT_M sized blocks and remember the
+	 * last block that still carries a real share of the overall filter
+	 * energy - everything beyond it (plus a safety margin) is noise and
+	 * need not be convolved or adapted. The trimmed coefficients keep
+	 * their converged values, so growing back is instantaneous. */
+	last = SHRINK_MIN;
+	for (k = 0; k + DEFAULT_M <= ec->N_d; k += DEFAULT_M) {
+		blk = 0;
+		for (j = 0; j < DEFAULT_M; j++)
+			blk += abs(ec->a_s[k + j]);
+		if (blk > (total >> SHRINK_TAIL_SHIFT))
+			last = k + DEFAULT_M;
+	}
+	last += SHRINK_MARGIN;
+	if (last > ec->N_d)
+		last = ec->N_d;
+	ec->N_active = last;
+}
+
 static inline short
 echo_can_update(struct echo_can_state *ec, short iref, short isig)
 {
@@ -343,7 +392,7 @@ echo_can_update(struct echo_can_state *ec, short iref, short isig)
 	/* eq. (2): compute r in fixed-point */
 	rs = CONVOLVE2(ec->a_s,
 			ec->y_s.buf_d + ec->y_s.idx_d,
-			ec->N_d);
+			ec->N_active);
 	rs >>= 15;
 
 	if (ec->lastsig == isig) {
@@ -515,7 +564,7 @@ echo_can_update(struct echo_can_state *ec, short iref, short isig)
 	 * --------------------------------------------------------
 	 */
 	if (!ec->HCNTR_d &&	/* no near-end speech present */
-		!(ec->i_d % DEFAULT_M)) {
+		!(ec->i_d % ec->update_period)) {
 			/* we only update on every DEFAULM_M'th sample
 			 * from the stream */
 		if (ec->Lu_i > MIN_UPDATE_THRESH_I) {
@@ -526,7 +575,7 @@ echo_can_update(struct echo_can_state *ec, short iref, short isig)
 			int max_coeffs[USED_COEFFS];
 			int *pos;
 
-			if (ec->N_d > USED_COEFFS)
+			if (ec->N_active > USED_COEFFS)
 				memset(max_coeffs, 0, USED_COEFFS*sizeof(int));
 #endif
 #ifdef MEC2_STATS_DETAILED
@@ -537,7 +586,7 @@ echo_can_update(struct echo_can_state *ec, short iref, short isig)
 			ec->avg_Lu_i_ok = ec->avg_Lu_i_ok + ec->Lu_i;
 			++ec->cntr_coeff_updates;
 #endif
-			for (k = 0; k < ec->N_d; k++) {
+			for (k = 0; k < ec->N_active; k++) {
 				/* eq. (7): compute an expectation over M_d
 				 * samples */
 				int grad2;
@@ -573,8 +622,8 @@ echo_can_update(struct echo_can_state *ec, short iref, short isig)
 
 #ifdef USED_COEFFS
 			/* Filter out irrelevant coefficients */
-			if (ec->N_d > USED_COEFFS)
-				for (k = 0; k < ec->N_d; k++)
+			if (ec->N_active > USED_COEFFS)
+				for (k = 0; k < ec->N_active; k++)
 					if (abs(ec->a_i[k]) <
 						max_coeffs[USED_COEFFS-1]) {
 						ec->a_i[k] = 0;
@@ -694,6 +743,12 @@ echo_can_update(struct echo_can_state *ec, short iref, short isig)
 	}
 #endif
 
+	/* Periodically re-measure how much of the tail actually carries
+	 * echo energy, but never while near-end speech is suspected */
+	if (ec->shrink && !ec->HCNTR_d && ec->i_d &&
+	    !(ec->i_d % SHRINK_PERIOD))
+		echo_can_shrink_tail(ec);
+
 	/* Increment the sample index and return the corrected sample */
 	ec->i_d++;
 	return u;
@@ -753,4 +808,29 @@ echo_can_traintap(struct echo_can_state *ec, int pos, short val)
 	return 0;
 }
 
+/* This canceller supports block NLMS tap updates */
+#define EC_HAS_UPDATE_INTERVAL
+
+static inline void
+echo_can_update_interval(struct echo_can_state *ec, int interval)
+{
+	/* The gradient expectation always runs over the last DEFAULT_M
+	 * samples, so shorter intervals gain nothing; longer ones adapt
+	 * the taps once per that many samples while still filtering
+	 * every sample */
+	if (interval > DEFAULT_M)
+		ec->update_period = interval;
+}
+
+/* This canceller can shorten its active tail once converged */
+#define EC_HAS_TAIL_SHRINK
+
+static inline void
+echo_can_shrink_enable(struct echo_can_state *ec, int on)
+{
+	ec->shrink = on;
+	if (!on)
+		ec->N_active = ec->N_d;
+}
+
 #endif
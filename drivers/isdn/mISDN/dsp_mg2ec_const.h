@@ -74,6 +74,17 @@
 /* Backup coefficients every this number of samples */
 #define BACKUP 256
 
+/* Adaptive tail shrinking: while the can performs well, the active FIR
+ * region is trimmed to the part of the tail whose coefficients actually
+ * carry energy, and grown back to the full length when the residual
+ * creeps up again (e.g. after an echo path change).
+ */
+#define SHRINK_PERIOD 4096	/* samples between tail re-evaluations */
+#define SHRINK_MARGIN (2 * DEFAULT_M)	/* taps kept past the last live block */
+#define SHRINK_MIN (4 * DEFAULT_M)	/* lower bound for the active region */
+#define SHRINK_TAIL_SHIFT 6	/* a block is live above 1/64 of tap energy */
+#define SHRINK_ERLE_SHIFT 2	/* re-expand when Lu rises above Ly/4 */
+
 /***************************************************************/
 /* The following knobs are not implemented in the current code */
 
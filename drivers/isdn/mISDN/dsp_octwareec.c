@@ -75,7 +75,7 @@ static void *new(const char *arg)
 _out:
 	printk(KERN_DEBUG "%s: creating %s with deftaps=%d and training=%d\n",
 		__func__, EC_TYPE, deftaps, training);
-	return dsp_cancel_new(deftaps, training);
+	return dsp_cancel_new(deftaps, training, 0, 0);
 }
 
 static void free(void *p)
@@ -27,6 +27,8 @@
 #include <linux/kernel.h>
 #include <linux/slab.h>
 #include <linux/list.h>
+#include <linux/rculist.h>
+#include <linux/spinlock.h>
 #include <linux/string.h>
 #include <linux/mISDNif.h>
 #include <linux/mISDNdsp.h>
@@ -40,15 +42,43 @@
 struct dsp_pipeline_entry {
 	struct mISDN_dsp_element *elem;
 	void                *p;
+	char		    *args; /* creation args, compared on rebuild */
+	int		     moved; /* instance taken over by a rebuild */
 	struct list_head     list;
 };
+
+/* one generation of instantiated elements; the entry list is immutable
+   once the generation has been published, readers walk it under rcu */
+struct dsp_pipeline_set {
+	struct list_head     list;
+	struct rcu_head      rcu;
+};
 struct dsp_element_entry {
 	struct mISDN_dsp_element *elem;
 	struct device	     dev;
 	struct list_head     list;
 };
 
+/* precompiled pipeline template: one config string, parsed once */
+struct dsp_template_entry {
+	struct mISDN_dsp_element *elem;
+	char		    *args;
+	struct list_head     list;
+};
+struct dsp_template {
+	char		    *cfg;
+	struct list_head     entries;
+	struct list_head     list;
+	struct rcu_head      rcu;
+};
+
+/* the element registry is read under RCU (lookup during pipeline build),
+   dsp_elements_lock only serializes the writers */
 static LIST_HEAD(dsp_elements);
+static DEFINE_SPINLOCK(dsp_elements_lock);
+
+static LIST_HEAD(dsp_templates);
+static DEFINE_SPINLOCK(dsp_templates_lock);
 
 /* sysfs */
 static struct class *elements_class;
@@ -76,12 +106,43 @@ static struct device_attribute element_attributes[] = {
 	__ATTR(args, 0444, attr_show_args, NULL),
 };
 
+static void dsp_template_free(struct dsp_template *t)
+{
+	struct dsp_template_entry *entry, *n;
+
+	list_for_each_entry_safe(entry, n, &t->entries, list) {
+		list_del(&entry->list);
+		kfree(entry->args);
+		kfree(entry);
+	}
+	kfree(t->cfg);
+	kfree(t);
+}
+
+static void dsp_template_free_rcu(struct rcu_head *rcu)
+{
+	dsp_template_free(container_of(rcu, struct dsp_template, rcu));
+}
+
+/* drop all cached templates; necessary whenever an element goes away, as
+   the templates keep bare element pointers */
+static void dsp_templates_flush(void)
+{
+	struct dsp_template *t, *n;
+
+	spin_lock(&dsp_templates_lock);
+	list_for_each_entry_safe(t, n, &dsp_templates, list) {
+		list_del_rcu(&t->list);
+		call_rcu(&t->rcu, dsp_template_free_rcu);
+	}
+	spin_unlock(&dsp_templates_lock);
+}
+
 static void
 mISDN_dsp_dev_release(struct device *dev)
 {
 	struct dsp_element_entry *entry =
 		container_of(dev, struct dsp_element_entry, dev);
-	list_del(&entry->list);
 	kfree(entry);
 }
 
@@ -109,7 +170,9 @@ int mISDN_dsp_element_register(struct mISDN_dsp_element *elem)
 		       __func__, elem->name);
 		goto err1;
 	}
-	list_add_tail(&entry->list, &dsp_elements);
+	spin_lock(&dsp_elements_lock);
+	list_add_tail_rcu(&entry->list, &dsp_elements);
+	spin_unlock(&dsp_elements_lock);
 
 	for (i = 0; i < ARRAY_SIZE(element_attributes); ++i) {
 		ret = device_create_file(&entry->dev,
@@ -128,6 +191,10 @@ int mISDN_dsp_element_register(struct mISDN_dsp_element *elem)
 	return 0;
 
 err2:
+	spin_lock(&dsp_elements_lock);
+	list_del_rcu(&entry->list);
+	spin_unlock(&dsp_elements_lock);
+	synchronize_rcu();
 	device_unregister(&entry->dev);
 	return ret;
 err1:
@@ -143,8 +210,14 @@ void mISDN_dsp_element_unregister(struct mISDN_dsp_element *elem)
 	if (!elem)
 		return;
 
+	spin_lock(&dsp_elements_lock);
 	list_for_each_entry_safe(entry, n, &dsp_elements, list)
 		if (entry->elem == elem) {
+			list_del_rcu(&entry->list);
+			spin_unlock(&dsp_elements_lock);
+			/* cached templates may refer to this element */
+			dsp_templates_flush();
+			synchronize_rcu();
 			device_unregister(&entry->dev);
 #ifdef PIPELINE_DEBUG
 			printk(KERN_DEBUG "%s: %s unregistered\n",
@@ -152,6 +225,7 @@ void mISDN_dsp_element_unregister(struct mISDN_dsp_element *elem)
 #endif
 			return;
 		}
+	spin_unlock(&dsp_elements_lock);
 	printk(KERN_ERR "%s: element %s not in list.\n", __func__, elem->name);
 }
 EXPORT_SYMBOL(mISDN_dsp_element_unregister);
@@ -179,6 +253,9 @@ void dsp_pipeline_module_exit(void)
 
 	class_destroy(elements_class);
 
+	dsp_templates_flush();
+	rcu_barrier();
+
 	list_for_each_entry_safe(entry, n, &dsp_elements, list) {
 		list_del(&entry->list);
 		printk(KERN_WARNING "%s: element was still registered: %s\n",
@@ -196,7 +273,8 @@ int dsp_pipeline_init(struct dsp_pipeline *pipeline)
 	if (!pipeline)
 		return -EINVAL;
 
-	INIT_LIST_HEAD(&pipeline->list);
+	RCU_INIT_POINTER(pipeline->set, NULL);
+	pipeline->inuse = 0;
 
 #ifdef PIPELINE_DEBUG
 	printk(KERN_DEBUG "%s: dsp pipeline ready\n", __func__);
@@ -205,52 +283,80 @@ int dsp_pipeline_init(struct dsp_pipeline *pipeline)
 	return 0;
 }
 
-static inline void _dsp_pipeline_destroy(struct dsp_pipeline *pipeline)
+static void dsp_pipeline_set_free_rcu(struct rcu_head *rcu)
 {
+	struct dsp_pipeline_set *set =
+		container_of(rcu, struct dsp_pipeline_set, rcu);
 	struct dsp_pipeline_entry *entry, *n;
 
-	list_for_each_entry_safe(entry, n, &pipeline->list, list) {
+	list_for_each_entry_safe(entry, n, &set->list, list) {
 		list_del(&entry->list);
-		if (entry->elem == dsp_hwec)
-			dsp_hwec_disable(container_of(pipeline, struct dsp,
-						      pipeline));
-		else
+		if (!entry->moved && entry->elem != dsp_hwec)
 			entry->elem->free(entry->p);
+		kfree(entry->args);
 		kfree(entry);
 	}
+	kfree(set);
+}
+
+/* take an unpublished generation out of service: the hardware echo
+   canceler is switched off right away (unless its successor took it
+   over), instance memory goes away once the readers are done with it */
+static void dsp_pipeline_set_retire(struct dsp_pipeline *pipeline,
+				    struct dsp_pipeline_set *set)
+{
+	struct dsp_pipeline_entry *entry;
+
+	if (!set)
+		return;
+
+	list_for_each_entry(entry, &set->list, list)
+		if (entry->elem == dsp_hwec && !entry->moved)
+			dsp_hwec_disable(container_of(pipeline, struct dsp,
+						      pipeline));
+	call_rcu(&set->rcu, dsp_pipeline_set_free_rcu);
 }
 
 void dsp_pipeline_destroy(struct dsp_pipeline *pipeline)
 {
+	struct dsp_pipeline_set *set;
 
 	if (!pipeline)
 		return;
 
-	_dsp_pipeline_destroy(pipeline);
+	set = rcu_dereference_protected(pipeline->set, 1);
+	RCU_INIT_POINTER(pipeline->set, NULL);
+	pipeline->inuse = 0;
+	dsp_pipeline_set_retire(pipeline, set);
 
 #ifdef PIPELINE_DEBUG
 	printk(KERN_DEBUG "%s: dsp pipeline destroyed\n", __func__);
 #endif
 }
 
-int dsp_pipeline_build(struct dsp_pipeline *pipeline, const char *cfg)
+/* parse a config string into a template; element lookup runs under RCU,
+   so registration/unregistration never blocks a build */
+static struct dsp_template *dsp_template_parse(const char *cfg)
 {
-	int incomplete = 0, found = 0;
-	char *dup, *tok, *name, *args;
-	struct dsp_element_entry *entry, *n;
-	struct dsp_pipeline_entry *pipeline_entry;
-	struct mISDN_dsp_element *elem;
-
-	if (!pipeline)
-		return -EINVAL;
-
-	if (!list_empty(&pipeline->list))
-		_dsp_pipeline_destroy(pipeline);
+	char *dup, *next, *tok, *name, *args;
+	struct dsp_element_entry *entry;
+	struct dsp_template_entry *t_entry;
+	struct dsp_template *t;
+	int found;
+
+	t = kzalloc(sizeof(struct dsp_template), GFP_ATOMIC);
+	if (!t)
+		return NULL;
+	INIT_LIST_HEAD(&t->entries);
+	t->cfg = kstrdup(cfg, GFP_ATOMIC);
+	if (!t->cfg)
+		goto err;
 
 	dup = kstrdup(cfg, GFP_ATOMIC);
 	if (!dup)
-		return 0;
-	while ((tok = strsep(&dup, "|"))) {
+		goto err;
+	next = dup;
+	while ((tok = strsep(&next, "|"))) {
 		if (!strlen(tok))
 			continue;
 		name = strsep(&tok, "(");
@@ -258,97 +364,257 @@ int dsp_pipeline_build(struct dsp_pipeline *pipeline, const char *cfg)
 		if (args && !*args)
 			args = NULL;
 
-		list_for_each_entry_safe(entry, n, &dsp_elements, list)
+		found = 0;
+		rcu_read_lock();
+		list_for_each_entry_rcu(entry, &dsp_elements, list)
 			if (!strcmp(entry->elem->name, name)) {
-				elem = entry->elem;
-
-				pipeline_entry = kmalloc(sizeof(struct
-								dsp_pipeline_entry), GFP_ATOMIC);
-				if (!pipeline_entry) {
-					printk(KERN_ERR "%s: failed to add "
-					       "entry to pipeline: %s (out of "
-					       "memory)\n", __func__, elem->name);
-					incomplete = 1;
-					goto _out;
-				}
-				pipeline_entry->elem = elem;
-
-				if (elem == dsp_hwec) {
-					/* This is a hack to make the hwec
-					   available as a pipeline module */
-					dsp_hwec_enable(container_of(pipeline,
-								     struct dsp, pipeline), args);
-					list_add_tail(&pipeline_entry->list,
-						      &pipeline->list);
-				} else {
-					pipeline_entry->p = elem->new(args);
-					if (pipeline_entry->p) {
-						list_add_tail(&pipeline_entry->
-							      list, &pipeline->list);
-#ifdef PIPELINE_DEBUG
-						printk(KERN_DEBUG "%s: created "
-						       "instance of %s%s%s\n",
-						       __func__, name, args ?
-						       " with args " : "", args ?
-						       args : "");
-#endif
-					} else {
-						printk(KERN_ERR "%s: failed "
-						       "to add entry to pipeline: "
-						       "%s (new() returned NULL)\n",
-						       __func__, elem->name);
-						kfree(pipeline_entry);
-						incomplete = 1;
-					}
+				t_entry = kzalloc(sizeof(struct
+						dsp_template_entry), GFP_ATOMIC);
+				if (t_entry) {
+					t_entry->elem = entry->elem;
+					if (args)
+						t_entry->args =
+							kstrdup(args,
+								GFP_ATOMIC);
+					list_add_tail(&t_entry->list,
+						      &t->entries);
 				}
 				found = 1;
 				break;
 			}
+		rcu_read_unlock();
 
-		if (found)
-			found = 0;
-		else {
+		if (!found)
 			printk(KERN_ERR "%s: element not found, skipping: "
 			       "%s\n", __func__, name);
-			incomplete = 1;
+	}
+	kfree(dup);
+	return t;
+
+err:
+	kfree(t->cfg);
+	kfree(t);
+	return NULL;
+}
+
+static int dsp_pipeline_args_equal(const char *a, const char *b)
+{
+	return !strcmp(a ? a : "", b ? b : "");
+}
+
+/* find a stage of the previous generation that the new one can take
+   over as-is; each instance is handed on at most once */
+static struct dsp_pipeline_entry *
+dsp_pipeline_find_warm(struct dsp_pipeline_set *old,
+		       struct mISDN_dsp_element *elem, const char *args)
+{
+	struct dsp_pipeline_entry *entry;
+
+	if (!old)
+		return NULL;
+
+	list_for_each_entry(entry, &old->list, list)
+		if (entry->elem == elem && !entry->moved &&
+		    dsp_pipeline_args_equal(entry->args, args))
+			return entry;
+	return NULL;
+}
+
+/* instantiate a new pipeline generation from a precompiled template;
+   stages that appear unchanged in the previous generation donate their
+   instance, so state like echo canceler adaption survives the rebuild */
+static void
+dsp_pipeline_instantiate(struct dsp_pipeline *pipeline,
+			 struct dsp_pipeline_set *set,
+			 struct dsp_pipeline_set *old, struct dsp_template *t)
+{
+	struct dsp_template_entry *t_entry;
+	struct dsp_pipeline_entry *pipeline_entry, *warm;
+	struct mISDN_dsp_element *elem;
+
+	list_for_each_entry(t_entry, &t->entries, list) {
+		elem = t_entry->elem;
+
+		pipeline_entry = kzalloc(sizeof(struct dsp_pipeline_entry),
+					 GFP_ATOMIC);
+		if (!pipeline_entry) {
+			printk(KERN_ERR "%s: failed to add entry to pipeline: "
+			       "%s (out of memory)\n", __func__, elem->name);
+			return;
+		}
+		pipeline_entry->elem = elem;
+		if (t_entry->args) {
+			pipeline_entry->args = kstrdup(t_entry->args,
+						       GFP_ATOMIC);
+			if (!pipeline_entry->args) {
+				kfree(pipeline_entry);
+				printk(KERN_ERR "%s: failed to add entry to "
+				       "pipeline: %s (out of memory)\n",
+				       __func__, elem->name);
+				return;
+			}
+		}
+
+		if (elem == dsp_hwec) {
+			/* This is a hack to make the hwec
+			   available as a pipeline module; the canceler
+			   is only reprogrammed if its args changed, an
+			   unchanged stage keeps running undisturbed */
+			warm = dsp_pipeline_find_warm(old, elem,
+						      t_entry->args);
+			if (!warm && old) {
+				struct dsp_pipeline_entry *e;
+
+				/* args changed: still take the stage
+				   over, just reprogram it below */
+				list_for_each_entry(e, &old->list, list)
+					if (e->elem == elem && !e->moved) {
+						warm = e;
+						break;
+					}
+			}
+			if (!warm || !dsp_pipeline_args_equal(warm->args,
+							      t_entry->args))
+				dsp_hwec_enable(container_of(pipeline,
+							     struct dsp,
+							     pipeline),
+						t_entry->args);
+			if (warm)
+				warm->moved = 1;
+			list_add_tail(&pipeline_entry->list, &set->list);
+		} else {
+			warm = dsp_pipeline_find_warm(old, elem,
+						      t_entry->args);
+			if (warm) {
+				pipeline_entry->p = warm->p;
+				warm->moved = 1;
+				list_add_tail(&pipeline_entry->list,
+					      &set->list);
+#ifdef PIPELINE_DEBUG
+				printk(KERN_DEBUG "%s: kept instance "
+				       "of %s%s%s\n", __func__, elem->name,
+				       t_entry->args ? " with args " : "",
+				       t_entry->args ? t_entry->args : "");
+#endif
+				continue;
+			}
+			pipeline_entry->p = elem->new(t_entry->args);
+			if (pipeline_entry->p) {
+				list_add_tail(&pipeline_entry->list,
+					      &set->list);
+#ifdef PIPELINE_DEBUG
+				printk(KERN_DEBUG "%s: created instance "
+				       "of %s%s%s\n", __func__, elem->name,
+				       t_entry->args ? " with args " : "",
+				       t_entry->args ? t_entry->args : "");
+#endif
+			} else {
+				printk(KERN_ERR "%s: failed to add entry "
+				       "to pipeline: %s (new() returned "
+				       "NULL)\n", __func__, elem->name);
+				kfree(pipeline_entry->args);
+				kfree(pipeline_entry);
+			}
 		}
 	}
+}
+
+int dsp_pipeline_build(struct dsp_pipeline *pipeline, const char *cfg)
+{
+	struct dsp_template *t, *t2;
+	struct dsp_pipeline_set *set = NULL, *old;
+
+	if (!pipeline)
+		return -EINVAL;
+
+	/* the previous generation keeps processing frames while the new
+	   one is built next to it; a NULL cfg just tears the pipe down */
+	old = rcu_dereference_protected(pipeline->set, 1);
+
+	if (!cfg)
+		goto swap;
 
-_out:
-	if (!list_empty(&pipeline->list))
-		pipeline->inuse = 1;
-	else
-		pipeline->inuse = 0;
+	set = kzalloc(sizeof(struct dsp_pipeline_set), GFP_ATOMIC);
+	if (!set)
+		return -ENOMEM;
+	INIT_LIST_HEAD(&set->list);
+
+	/* fast path: this config has been parsed before */
+	rcu_read_lock();
+	list_for_each_entry_rcu(t, &dsp_templates, list)
+		if (!strcmp(t->cfg, cfg)) {
+			dsp_pipeline_instantiate(pipeline, set, old, t);
+			rcu_read_unlock();
+			goto swap;
+		}
+	rcu_read_unlock();
+
+	t = dsp_template_parse(cfg);
+	if (!t)
+		goto swap;
+	dsp_pipeline_instantiate(pipeline, set, old, t);
+
+	/* cache the template, unless someone else parsed it meanwhile */
+	spin_lock(&dsp_templates_lock);
+	list_for_each_entry(t2, &dsp_templates, list)
+		if (!strcmp(t2->cfg, cfg)) {
+			spin_unlock(&dsp_templates_lock);
+			dsp_template_free(t);
+			goto swap;
+		}
+	list_add_tail_rcu(&t->list, &dsp_templates);
+	spin_unlock(&dsp_templates_lock);
+
+swap:
+	if (set && list_empty(&set->list)) {
+		kfree(set);
+		set = NULL;
+	}
+	/* one store switches over; frames running right now finish on
+	   the old generation, the next frame takes the new one */
+	rcu_assign_pointer(pipeline->set, set);
+	pipeline->inuse = set ? 1 : 0;
+	dsp_pipeline_set_retire(pipeline, old);
 
 #ifdef PIPELINE_DEBUG
-	printk(KERN_DEBUG "%s: dsp pipeline built%s: %s\n",
-	       __func__, incomplete ? " incomplete" : "", cfg);
+	printk(KERN_DEBUG "%s: dsp pipeline built: %s\n", __func__,
+	       cfg ? cfg : "(none)");
 #endif
-	kfree(dup);
 	return 0;
 }
 
 void dsp_pipeline_process_tx(struct dsp_pipeline *pipeline, u8 *data, int len)
 {
 	struct dsp_pipeline_entry *entry;
+	struct dsp_pipeline_set *set;
 
 	if (!pipeline)
 		return;
 
-	list_for_each_entry(entry, &pipeline->list, list)
-		if (entry->elem->process_tx)
-			entry->elem->process_tx(entry->p, data, len);
+	rcu_read_lock();
+	set = rcu_dereference(pipeline->set);
+	if (set)
+		list_for_each_entry(entry, &set->list, list)
+			if (entry->elem->process_tx)
+				entry->elem->process_tx(entry->p, data, len);
+	rcu_read_unlock();
 }
 
 void dsp_pipeline_process_rx(struct dsp_pipeline *pipeline, u8 *data, int len,
 			     unsigned int txlen)
 {
 	struct dsp_pipeline_entry *entry;
+	struct dsp_pipeline_set *set;
 
 	if (!pipeline)
 		return;
 
-	list_for_each_entry_reverse(entry, &pipeline->list, list)
-		if (entry->elem->process_rx)
-			entry->elem->process_rx(entry->p, data, len, txlen);
+	rcu_read_lock();
+	set = rcu_dereference(pipeline->set);
+	if (set)
+		list_for_each_entry_reverse(entry, &set->list, list)
+			if (entry->elem->process_rx)
+				entry->elem->process_rx(entry->p, data, len,
+							txlen);
+	rcu_read_unlock();
 }
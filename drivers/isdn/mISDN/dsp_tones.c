@@ -9,6 +9,7 @@
  */
 
 #include <linux/gfp.h>
+#include <linux/vmalloc.h>
 #include <linux/mISDNif.h>
 #include <linux/mISDNdsp.h>
 #include "core.h"
@@ -237,6 +238,8 @@ static struct pattern {
 	u8 *data[10];
 	u32 *siz[10];
 	u32 seq[10];
+	u8 *cache;	/* one full precomputed period, shared r/o */
+	u32 period;	/* length of the cache in samples */
 } pattern[] = {
 	{TONE_GERMAN_DIALTONE,
 	 {DATA_GA, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL},
@@ -372,23 +375,14 @@ static struct pattern {
  *
  * if tones has finished (e.g. knocking tone), dsp->tones is turned off
  */
-void dsp_tone_copy(struct dsp *dsp, u8 *data, int len)
+/* stitch tone data together from the sample loops of the pattern */
+static void
+dsp_tone_stitch(struct pattern *pat, int *index_p, int *count_p,
+		u8 *data, int len)
 {
-	int index, count, start, num;
-	struct pattern *pat;
-	struct dsp_tone *tone = &dsp->tone;
-
-	/* if we have no tone, we copy silence */
-	if (!tone->tone) {
-		memset(data, dsp_silence, len);
-		return;
-	}
-
-	/* process pattern */
-	pat = (struct pattern *)tone->pattern;
-	/* points to the current pattern */
-	index = tone->index; /* gives current sequence index */
-	count = tone->count; /* gives current sample */
+	int index = *index_p; /* gives current sequence index */
+	int count = *count_p; /* gives current sample */
+	int start, num;
 
 	/* copy sample */
 	while (len) {
@@ -422,11 +416,92 @@ void dsp_tone_copy(struct dsp *dsp, u8 *data, int len)
 		count += num;
 		len -= num;
 	}
-	tone->index = index;
-	tone->count = count;
+	*index_p = index;
+	*count_p = count;
+}
+
+void dsp_tone_copy(struct dsp *dsp, u8 *data, int len)
+{
+	int count, num;
+	struct pattern *pat;
+	struct dsp_tone *tone = &dsp->tone;
+
+	/* if we have no tone, we copy silence */
+	if (!tone->tone) {
+		memset(data, dsp_silence, len);
+		return;
+	}
 
-	/* return sk_buff */
-	return;
+	/* process pattern */
+	pat = (struct pattern *)tone->pattern;
+	/* points to the current pattern */
+
+	if (pat->cache) {
+		/* all channels playing this tone share the precomputed
+		 * period, each channel only keeps its phase in count */
+		count = tone->count;
+		while (len) {
+			num = pat->period - count;
+			if (num > len)
+				num = len;
+			memcpy(data, pat->cache + count, num);
+			data += num;
+			count += num;
+			len -= num;
+			if (count == pat->period)
+				count = 0;
+		}
+		tone->count = count;
+		return;
+	}
+
+	dsp_tone_stitch(pat, &tone->index, &tone->count, data, len);
+}
+
+
+/*********************************************
+ * precompute one full period of each pattern *
+ *********************************************/
+
+/* must run after the samples have been converted to the configured law.
+ * if an allocation fails, the pattern is stitched per call as before.
+ */
+void
+dsp_tone_generate_cache(void)
+{
+	struct pattern *pat;
+	u8 *buf;
+	u32 period;
+	int i, index, count;
+
+	for (i = 0; pattern[i].tone; i++) {
+		pat = &pattern[i];
+		period = 0;
+		for (index = 0; index < 10 && pat->seq[index]; index++)
+			period += pat->seq[index];
+		if (!period)
+			continue;
+		buf = vmalloc(period);
+		if (!buf)
+			continue;
+		index = 0;
+		count = 0;
+		dsp_tone_stitch(pat, &index, &count, buf, period);
+		pat->cache = buf;
+		pat->period = period;
+	}
+}
+
+void
+dsp_tone_free_cache(void)
+{
+	int i;
+
+	for (i = 0; pattern[i].tone; i++) {
+		vfree(pattern[i].cache);
+		pattern[i].cache = NULL;
+		pattern[i].period = 0;
+	}
 }
 
 
@@ -535,6 +610,9 @@ dsp_tone(struct dsp *dsp, int tone)
 
 	if (dsp->features.hfc_loops) {
 		tonet->hardware = 1;
+		/* first hardware tone on this channel sets up the timer */
+		if (!tonet->tl.function)
+			timer_setup(&tonet->tl, dsp_tone_timeout, 0);
 		/* set first tone */
 		dsp_tone_hw_message(dsp, pat->data[0], *(pat->siz[0]));
 		/* set timer */
@@ -24,8 +24,9 @@
 #include <linux/module.h>
 #include <linux/mISDNif.h>
 #include "core.h"
+#include "dtmf_engine.h"
 
-#define DTMF_VERSION	"2.0"
+#define DTMF_VERSION	"2.1"
 
 static u_int debug;
 
@@ -37,20 +38,17 @@ MODULE_LICENSE("GPL");
 #define	FLG_DTMF_ULAW	1
 #define FLG_DTMF_ACTIV	2
 
-#define DTMF_NPOINTS 205        /* Number of samples for DTMF recognition */
+/* squared detection level, same scale as the dsp module's dtmfthreshold */
+#define DTMF_TRESHOLD	2000000
 
 #define DEBUG_DTMF_CTRL		0x001
 #define DEBUG_DTMF_TONE		0x010
-#define DEBUG_DTMF_DETECT	0x100
-#define DEBUG_DTMF_KOEFF	0x200
 
 struct dtmf {
 	struct mISDNchannel	ch;
 	struct mISDNchannel	*up;
 	u_long 			Flags;
-	char			last;
-	int			idx;
-	int			buf[DTMF_NPOINTS];
+	struct dtmf_engine	eng;
 };
 
 
@@ -132,178 +130,57 @@ static short isdn_audio_alaw_to_s16[] =
 	0x0cbc, 0xf344, 0x0094, 0xff6c, 0x327c, 0xcd84, 0x032c, 0xfcd4
 };
 
-#define NCOEFF            8     /* number of frequencies to be analyzed       */
-#define DTMF_TRESH     4000     /* above this is dtmf                         */
-#define SILENCE_TRESH   200     /* below this is silence                      */
-#define AMP_BITS          9     /* bits per sample, reduced to avoid overflow */
-#define LOGRP             0
-#define HIGRP             1
-
-/* For DTMF recognition:
- * 2 * cos(2 * PI * k / N) precalculated for all k
- */
-static int cos2pik[NCOEFF] =
-{
-	55813, 53604, 51193, 48591, 38114, 33057, 25889, 18332
-};
-
-static char dtmf_matrix[4][4] =
-{
-	{'1', '2', '3', 'A'},
-	{'4', '5', '6', 'B'},
-	{'7', '8', '9', 'C'},
-	{'*', '0', '#', 'D'}
-};
-
-/*
- * Goertzel algorithm.
- * See http://ptolemy.eecs.berkeley.edu/~pino/Ptolemy/papers/96/dtmf_ict/
- * for more info.
- */
-
+/* send one confirmed digit as PH_CONTROL_IND to the upper layer */
 static void
-isdn_audio_goertzel(struct dtmf *dtmf)
+dtmf_send_tone(struct dtmf *dtmf, u8 digit)
 {
-	int		sk[NCOEFF], sk1[NCOEFF], sk2[NCOEFF];
-	register int	sample;
-	int		k, n;
-	int		thresh, silence;
-	int		lgrp, hgrp;
-	char		what;
-
-	memset(sk, 0, NCOEFF*sizeof(int));
-	memset(sk1, 0, NCOEFF*sizeof(int));
-	memset(sk2, 0, NCOEFF*sizeof(int));
-	for (n = 0; n < DTMF_NPOINTS; n++) {
-		sample = dtmf->buf[n];
-		for (k = 0; k < NCOEFF; k++)
-			sk[k] = sample + ((cos2pik[k] * sk1[k]) >> 15) - sk2[k];
-		memcpy(sk2, sk1, NCOEFF*sizeof(int));
-		memcpy(sk1, sk, NCOEFF*sizeof(int));
-	}
-	thresh = 0;
-	silence = 0;
-	lgrp = -1;
-	hgrp = -1;
-	for (k = 0; k < NCOEFF; k++) {
-		sk[k] >>= 1;
-		sk2[k] >>= 1;
-		/* compute |X(k)|**2 */
-		/* report overflows. This should not happen. */
-		/* Comment this out if desired */
-		if (sk[k] < -32768 || sk[k] > 32767)
-			printk(KERN_DEBUG
-			    "dtmf goertzel overflow, sk[%d]=%d\n", k, sk[k]);
-		if (sk2[k] < -32768 || sk2[k] > 32767)
-			printk(KERN_DEBUG
-			    "isdn_audio: dtmf goertzel overflow, sk2[%d]=%d\n",
-			    k, sk2[k]);
-		sk1[k] = ((sk[k] * sk[k]) >> AMP_BITS) -
-			((((cos2pik[k] * sk[k]) >> 15) * sk2[k]) >> AMP_BITS) +
-			((sk2[k] * sk2[k]) >> AMP_BITS);
-		if (sk1[k] > DTMF_TRESH) {
-			if (sk1[k] > thresh)
-				thresh = sk1[k];
-		} else if (sk1[k] < SILENCE_TRESH)
-			silence++;
-	}
-	if (debug & DEBUG_DTMF_KOEFF)
-		printk(KERN_DEBUG
-			"DTMF koeff(%d,%d,%d,%d,%d,%d,%d,%d) range(%d-%d)\n",
-			sk1[0], sk1[1], sk1[2], sk1[3], sk1[4], sk1[5],
-			sk1[6], sk1[7], SILENCE_TRESH, DTMF_TRESH);
-	if (silence == NCOEFF)
-		what = ' ';
-	else {
-		if (thresh > 0)	{
-			/* touchtones must match within 12 dB */
-			thresh = thresh >> 4;
-			for (k = 0; k < NCOEFF; k++) {
-				if (sk1[k] < thresh)
-					continue;  /* ignore */
-				/* good level found. This is allowed
-				   only one time per group */
-				if (k < NCOEFF / 2) {
-					/* lowgroup */
-					if (lgrp >= 0) {
-						/* Bad. Another tone found. */
-						lgrp = -1;
-						break;
-					} else
-						lgrp = k;
-				} else { /* higroup */
-					if (hgrp >= 0) {
-						/* Bad. Another tone found. */
-						hgrp = -1;
-						break;
-					} else
-						hgrp = k - NCOEFF/2;
-				}
-			}
-			if ((lgrp >= 0) && (hgrp >= 0)) {
-				what = dtmf_matrix[lgrp][hgrp];
-				if (dtmf->last != ' ' && dtmf->last != '.')
-					/* min. 1 non-DTMF between DTMF */
-					dtmf->last = what;
-			} else
-					what = '.';
-		} else
-			what = '.';
-	}
-	if (debug & DEBUG_DTMF_DETECT)
-		printk(KERN_DEBUG "DTMF: last(%c) what(%c)\n",
-			dtmf->last, what);
-	if ((what != dtmf->last) && (what != ' ') && (what != '.')) {
-		struct sk_buff *skb;
-
-		if (debug & DEBUG_DTMF_TONE)
-			printk(KERN_DEBUG "DTMF: tone='%c'\n", what);
-		k = what | DTMF_TONE_VAL;
-		skb = _alloc_mISDN_skb(PH_CONTROL_IND, MISDN_ID_ANY,
-		    sizeof(int), &k, GFP_ATOMIC);
-		if (skb) {
-			if (dtmf->up) {
-				n = dtmf->up->send(dtmf->up, skb);
-				if (n)
-					dev_kfree_skb(skb);
-			}
-		}
-	}
-	dtmf->last = what;
+	struct sk_buff	*skb;
+	int		val, ret;
+
+	if (debug & DEBUG_DTMF_TONE)
+		printk(KERN_DEBUG "DTMF: tone='%c'\n", digit);
+	val = digit | DTMF_TONE_VAL;
+	skb = _alloc_mISDN_skb(PH_CONTROL_IND, MISDN_ID_ANY,
+	    sizeof(int), &val, GFP_ATOMIC);
+	if (!skb)
+		return;
+	if (dtmf->up) {
+		ret = dtmf->up->send(dtmf->up, skb);
+		if (ret)
+			dev_kfree_skb(skb);
+	} else
+		dev_kfree_skb(skb);
 }
 
 /*
- * Decode audio stream into signed u16
- * start detection if enough data was sampled
+ * Decode audio stream into signed 16-bit and feed the shared engine.
+ * The Goertzel math and the digit debounce live in dtmf_engine.c and
+ * are the same code the dsp module uses, so enabling detection here
+ * does not duplicate the per-sample work.
  */
 static void
 isdn_audio_calc_dtmf(struct dtmf *dtmf, struct sk_buff *skb)
 {
-	int len = skb->len;
+	int	len = skb->len;
 	u_char	*p = skb->data;
-	int i;
-	int c;
+	s16	spl[64];
+	u8	digits[8];
+	int	i, c, cnt;
 
 	while (len) {
-		c = DTMF_NPOINTS - dtmf->idx;
-		if (c > len)
-			c = len;
-		if (c <= 0)
-			break;
+		c = len;
+		if (c > (int)ARRAY_SIZE(spl))
+			c = ARRAY_SIZE(spl);
 		for (i = 0; i < c; i++) {
 			if (test_bit(FLG_DTMF_ULAW, &dtmf->Flags))
-				dtmf->buf[dtmf->idx++] =
-				    isdn_audio_ulaw_to_s16[*p++] >>
-				    (15 - AMP_BITS);
+				spl[i] = isdn_audio_ulaw_to_s16[*p++];
 			else
-				dtmf->buf[dtmf->idx++] =
-				    isdn_audio_alaw_to_s16[*p++] >>
-				    (15 - AMP_BITS);
-		}
-		if (dtmf->idx == DTMF_NPOINTS) {
-			isdn_audio_goertzel(dtmf);
-			dtmf->idx = 0;
+				spl[i] = isdn_audio_alaw_to_s16[*p++];
 		}
+		cnt = mISDN_dtmf_engine_feed(&dtmf->eng, spl, c,
+		    digits, sizeof(digits));
+		for (i = 0; i < cnt; i++)
+			dtmf_send_tone(dtmf, digits[i]);
 		len -= c;
 	}
 }
@@ -311,8 +188,7 @@ isdn_audio_calc_dtmf(struct dtmf *dtmf, struct sk_buff *skb)
 static void
 dtmf_reset(struct dtmf *dtmf)
 {
-	dtmf->last = ' ';
-	dtmf->idx = 0;
+	mISDN_dtmf_engine_init(&dtmf->eng, DTMF_TRESHOLD);
 }
 
 static int
@@ -0,0 +1,213 @@
+/*
+ * Shared block based DTMF detection engine
+ *
+ * The Goertzel math used to exist twice, once in the dsp module and
+ * once in the legacy dtmf layer module, each with its own tables and
+ * its own debounce rules. Both consumers now feed this engine, so a
+ * channel that enables detection on several paths pays the per-sample
+ * work only here. All eight filters advance in lockstep over a full
+ * block, which streams the samples through the cache once and leaves
+ * the inner loop open for the compiler's vectorizer.
+ *
+ * Copyright 2008  by Karsten Keil <kkeil@novell.com>
+ * based on the decoder by Andreas Eversberg (jolly@eversberg.eu)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/mISDNif.h>
+#include "core.h"
+#include "dtmf_engine.h"
+
+/* For DTMF recognition:
+ * 2 * cos(2 * PI * k / N) precalculated for all k
+ */
+static const u64 cos2pik[DTMF_ENG_NCOEFF] =
+{
+	/* k << 15 (source: hfc-4s/8s documentation (www.colognechip.de)) */
+	55960, 53912, 51402, 48438, 38146, 32650, 26170, 18630
+};
+
+/* digit matrix */
+static const char dtmf_matrix[4][4] =
+{
+	{'1', '2', '3', 'A'},
+	{'4', '5', '6', 'B'},
+	{'7', '8', '9', 'C'},
+	{'*', '0', '#', 'D'}
+};
+
+void
+mISDN_dtmf_engine_init(struct dtmf_engine *de, s32 treshold)
+{
+	de->treshold = treshold;
+	de->size = 0;
+	de->lastwhat = '\0';
+	de->lastdigit = '\0';
+	de->count = 0;
+}
+EXPORT_SYMBOL(mISDN_dtmf_engine_init);
+
+/* classify one block of squared coefficients and run the debounce.
+ * The coefficients may come from the sample path below or directly
+ * from a hardware decoder (HFC chips deliver them readily computed).
+ * A digit is returned only once, after it was seen in three blocks
+ * in a row; 0 means no new confirmed digit.
+ */
+u8
+mISDN_dtmf_engine_result(struct dtmf_engine *de, s32 *result)
+{
+	s32	tresh, treshl;
+	int	lowgroup, highgroup;
+	int	i;
+	u8	what, digit = 0;
+
+	tresh = 0;
+	for (i = 0; i < DTMF_ENG_NCOEFF; i++) {
+		if (result[i] < 0)
+			result[i] = 0;
+		if (result[i] > de->treshold) {
+			if (result[i] > tresh)
+				tresh = result[i];
+		}
+	}
+
+	if (tresh == 0) {
+		what = 0;
+		goto storedigit;
+	}
+
+	/* calc digit (lowgroup/highgroup) */
+	lowgroup = -1;
+	highgroup = -1;
+	treshl = tresh >> 3;  /* tones which are not on, must be below 9 dB */
+	tresh = tresh >> 2;  /* touchtones must match within 6 dB */
+	for (i = 0; i < DTMF_ENG_NCOEFF; i++) {
+		if (result[i] < treshl)
+			continue;  /* ignore */
+		if (result[i] < tresh) {
+			lowgroup = -1;
+			highgroup = -1;
+			break;  /* noise in between */
+		}
+		/* good level found. This is allowed only one time per group */
+		if (i < DTMF_ENG_NCOEFF / 2) {
+			/* lowgroup */
+			if (lowgroup >= 0) {
+				/* Bad. Another tone found. */
+				lowgroup = -1;
+				break;
+			} else
+				lowgroup = i;
+		} else {
+			/* higroup */
+			if (highgroup >= 0) {
+				/* Bad. Another tone found. */
+				highgroup = -1;
+				break;
+			} else
+				highgroup = i - (DTMF_ENG_NCOEFF / 2);
+		}
+	}
+
+	/* get digit or null */
+	what = 0;
+	if (lowgroup >= 0 && highgroup >= 0)
+		what = dtmf_matrix[lowgroup][highgroup];
+
+storedigit:
+	if (de->lastwhat != what)
+		de->count = 0;
+
+	/* the tone (or no tone) must remain 3 times without change */
+	if (de->count == 2) {
+		if (de->lastdigit != what) {
+			de->lastdigit = what;
+			digit = what;
+		}
+	} else
+		de->count++;
+
+	de->lastwhat = what;
+	return digit;
+}
+EXPORT_SYMBOL(mISDN_dtmf_engine_result);
+
+/* run the Goertzel filters over one complete block */
+static void
+dtmf_engine_block(struct dtmf_engine *de, s32 *result)
+{
+	s32	sk, sk2, spl;
+	s32	sk1v[DTMF_ENG_NCOEFF], sk2v[DTMF_ENG_NCOEFF];
+	s64	cos2pik_;
+	s16	*buf;
+	int	k, n;
+
+	for (k = 0; k < DTMF_ENG_NCOEFF; k++) {
+		sk1v[k] = 0;
+		sk2v[k] = 0;
+	}
+	buf = de->buffer;
+	for (n = 0; n < DTMF_ENG_NPOINTS; n++) {
+		spl = *buf++;
+		for (k = 0; k < DTMF_ENG_NCOEFF; k++) {
+			cos2pik_ = cos2pik[k];
+			sk = ((cos2pik_ * sk1v[k]) >> 15) - sk2v[k] + spl;
+			sk2v[k] = sk1v[k];
+			sk1v[k] = sk;
+		}
+	}
+	for (k = 0; k < DTMF_ENG_NCOEFF; k++) {
+		sk = sk1v[k] >> 8;
+		sk2 = sk2v[k] >> 8;
+		if (sk > 32767 || sk < -32767 || sk2 > 32767 || sk2 < -32767)
+			printk(KERN_WARNING "DTMF-Detection overflow\n");
+		/* compute |X(k)|**2 */
+		result[k] =
+			(sk * sk) -
+			(((cos2pik[k] * sk) >> 15) * sk2) +
+			(sk2 * sk2);
+	}
+}
+
+/* feed signed 16-bit samples into the engine. Whenever a full block is
+ * collected it is decoded; confirmed digits are stored into digits[],
+ * at most space of them. Returns the number of digits stored.
+ */
+int
+mISDN_dtmf_engine_feed(struct dtmf_engine *de, const s16 *spl, int len,
+		       u8 *digits, int space)
+{
+	s32	result[DTMF_ENG_NCOEFF];
+	int	n, cnt = 0;
+	u8	digit;
+
+	while (len) {
+		n = DTMF_ENG_NPOINTS - de->size;
+		if (n > len)
+			n = len;
+		memcpy(de->buffer + de->size, spl, n * sizeof(*spl));
+		de->size += n;
+		spl += n;
+		len -= n;
+		if (de->size < DTMF_ENG_NPOINTS)
+			break;
+		de->size = 0;
+		dtmf_engine_block(de, result);
+		digit = mISDN_dtmf_engine_result(de, result);
+		if (digit && cnt < space)
+			digits[cnt++] = digit;
+	}
+	return cnt;
+}
+EXPORT_SYMBOL(mISDN_dtmf_engine_feed);
@@ -0,0 +1,37 @@
+/*
+ * Shared block based DTMF detection engine
+ *
+ * Copyright 2008  by Karsten Keil <kkeil@novell.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef _MISDN_DTMF_ENGINE_H
+#define _MISDN_DTMF_ENGINE_H
+
+#define DTMF_ENG_NPOINTS	102	/* samples per detection block */
+#define DTMF_ENG_NCOEFF		8	/* analyzed frequencies */
+
+struct dtmf_engine {
+	s32	treshold;	/* squared level, above this is a tone */
+	int	size;		/* samples pending in buffer */
+	s16	buffer[DTMF_ENG_NPOINTS];
+	u8	lastwhat;	/* result of the previous block */
+	u8	lastdigit;	/* last confirmed digit (0 = none) */
+	int	count;		/* blocks the current result persisted */
+};
+
+extern void	mISDN_dtmf_engine_init(struct dtmf_engine *, s32);
+extern u8	mISDN_dtmf_engine_result(struct dtmf_engine *, s32 *);
+extern int	mISDN_dtmf_engine_feed(struct dtmf_engine *, const s16 *,
+				       int, u8 *, int);
+
+#endif
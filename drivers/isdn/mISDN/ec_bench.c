@@ -0,0 +1,229 @@
+/*
+ * ec_bench.c: userspace benchmark for the software echo cancellers
+ *
+ * Copyright 2008 by the mISDN maintainers
+ *
+ * This software may be used and distributed according to the terms
+ * of the GNU General Public License, incorporated herein by reference.
+ *
+ * Build with "make -f Makefile.standalone ecbench" from the top level.
+ * Every canceller is compiled into its own binary (ec_bench_mec2,
+ * ec_bench_mg2, ec_bench_kb1, ec_bench_oslec), because they all define
+ * the same echo_can_* entry points used by dsp_cancel.h.
+ *
+ * The benchmark pushes white noise through an echo path - a built-in
+ * synthetic hybrid response, or a recorded one given as a raw file of
+ * 16 bit native endian Q15 taps - and reports, for 32/64/128 ms tails:
+ *
+ *	- the processing time per sample (multiply by your clock rate
+ *	  to get cycles/sample)
+ *	- the time until the canceller first reaches 18 dB ERLE
+ *	- the ERLE over the final second
+ *
+ * usage: ec_bench_<name> [-m] [-i echopath.s16] [-s seconds]
+ *
+ * -m prints one "name_tail ns-per-sample" line per tail length, the
+ * format scripts/bench_regress compares against its baseline.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+
+#if defined(ECBENCH_OSLEC)
+#include "oslec_echo.h"
+#define EC_STATE	struct echo_can_state_s
+#define EC_NAME		"oslec"
+#define EC_MODE		(ECHO_CAN_USE_ADAPTION | ECHO_CAN_USE_NLP \
+			| ECHO_CAN_USE_CLIP | ECHO_CAN_USE_TX_HPF \
+			| ECHO_CAN_USE_RX_HPF)
+#else
+static void *zmalloc(size_t len)
+{
+	return calloc(1, len);
+}
+#define ZMALLOC(a) zmalloc(a)
+
+#if defined(ECBENCH_MEC2)
+#include "dsp_mec2.h"
+#define EC_NAME		"mec2"
+#elif defined(ECBENCH_MG2)
+#include "dsp_mg2ec.h"
+#define EC_NAME		"mg2ec"
+#elif defined(ECBENCH_KB1)
+#include "dsp_kb1ec.h"
+#define EC_NAME		"kb1ec"
+#else
+#error select a canceller: -DECBENCH_MEC2, -DECBENCH_MG2, -DECBENCH_KB1 \
+	or -DECBENCH_OSLEC
+#endif
+#define EC_STATE	struct echo_can_state
+#define EC_MODE		0
+#endif
+
+#define RATE		8000
+#define MAX_PATH_TAPS	1024
+#define ERLE_TARGET	18.0	/* dB, counts as converged */
+
+static int16_t echopath[MAX_PATH_TAPS];
+
+/* simple LCG, the same sequence for every run and canceller */
+static uint32_t rngstate = 1;
+
+static int16_t whitenoise(void)
+{
+	rngstate = rngstate * 1664525 + 1013904223;
+	return (int16_t)(rngstate >> 17);
+}
+
+/* synthetic hybrid: 4 ms bulk delay, then a few decaying reflections */
+static void default_echopath(void)
+{
+	echopath[32] =  0x2000;
+	echopath[33] = -0x1600;
+	echopath[34] =  0x0800;
+	echopath[40] =  0x0b00;
+	echopath[48] = -0x0500;
+	echopath[64] =  0x0280;
+	echopath[96] = -0x0140;
+}
+
+static int load_echopath(const char *name)
+{
+	FILE *f;
+	int n;
+
+	f = fopen(name, "rb");
+	if (!f) {
+		perror(name);
+		return -1;
+	}
+	n = fread(echopath, sizeof(int16_t), MAX_PATH_TAPS, f);
+	fclose(f);
+	if (n <= 0) {
+		fprintf(stderr, "%s: no taps read\n", name);
+		return -1;
+	}
+	return 0;
+}
+
+static double elapsed_ns(const struct timespec *t0, const struct timespec *t1)
+{
+	return (t1->tv_sec - t0->tv_sec) * 1e9 + (t1->tv_nsec - t0->tv_nsec);
+}
+
+static int machine;	/* -m: one "name_tail ns/sample" line per tail */
+
+static void bench_tail(int taps, const int16_t *tx, const int16_t *rx,
+		       int nsamples)
+{
+	EC_STATE *ec;
+	struct timespec t0, t1;
+	const int win = RATE / 10; /* ERLE over 100 ms windows */
+	long long rxpow = 0, cleanpow = 0;
+	double erle = 0.0;
+	int i, w = 0, converged = -1;
+	int16_t clean;
+
+	ec = echo_can_create(taps, EC_MODE);
+	if (!ec) {
+		fprintf(stderr, "%s: create failed for %d taps\n",
+			EC_NAME, taps);
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < nsamples; i++) {
+		clean = echo_can_update(ec, tx[i], rx[i]);
+		rxpow += (long long)rx[i] * rx[i];
+		cleanpow += (long long)clean * clean;
+		if (++w == win) {
+			erle = 10.0 * log10((double)(rxpow + 1)
+					    / (double)(cleanpow + 1));
+			if (converged < 0 && erle >= ERLE_TARGET)
+				converged = i;
+			rxpow = 0;
+			cleanpow = 0;
+			w = 0;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	if (machine) {
+		printf("%s_%dms %.3f\n", EC_NAME, taps / 8,
+		       elapsed_ns(&t0, &t1) / nsamples);
+		echo_can_free(ec);
+		return;
+	}
+	printf("%-6s tail %3d ms (%4d taps): %7.1f ns/sample, ",
+	       EC_NAME, taps / 8, taps, elapsed_ns(&t0, &t1) / nsamples);
+	if (converged >= 0)
+		printf("%4d ms to %.0f dB ERLE, ", converged / 8,
+		       ERLE_TARGET);
+	else
+		printf("  not converged,      ");
+	printf("final ERLE %5.1f dB\n", erle);
+
+	echo_can_free(ec);
+}
+
+int main(int argc, char *argv[])
+{
+	static const int tails[] = { 256, 512, 1024 }; /* 32/64/128 ms */
+	int16_t *tx, *rx;
+	int seconds = 10;
+	int nsamples, i, k, c;
+	long long acc;
+
+	while ((c = getopt(argc, argv, "i:s:m")) != -1) {
+		switch (c) {
+		case 'i':
+			if (load_echopath(optarg))
+				return 1;
+			break;
+		case 's':
+			seconds = atoi(optarg);
+			break;
+		case 'm':
+			machine = 1;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-m] [-i echopath.s16] "
+				"[-s seconds]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (!echopath[32] && !echopath[0])
+		default_echopath();
+	if (seconds < 2)
+		seconds = 2;
+	nsamples = seconds * RATE;
+
+	tx = malloc(nsamples * sizeof(int16_t));
+	rx = malloc(nsamples * sizeof(int16_t));
+	if (!tx || !rx) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	/* precompute both signals, so only echo_can_update() is timed */
+	for (i = 0; i < nsamples; i++)
+		tx[i] = whitenoise() / 2;
+	for (i = 0; i < nsamples; i++) {
+		acc = 0;
+		for (k = 0; k < MAX_PATH_TAPS && k <= i; k++)
+			acc += (long long)echopath[k] * tx[i - k];
+		rx[i] = (int16_t)(acc >> 15);
+	}
+
+	for (i = 0; i < (int)(sizeof(tails) / sizeof(tails[0])); i++)
+		bench_tail(tails[i], tx, rx, nsamples);
+
+	free(tx);
+	free(rx);
+	return 0;
+}
@@ -22,41 +22,102 @@
 #include <linux/slab.h>
 #include <linux/module.h>
 #include <linux/string.h>
+#include <linux/atomic.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/sched/clock.h>
 #include "fsm.h"
 
 #define FSM_TIMER_DEBUG 0
 
-int
-mISDN_FsmNew(struct Fsm *fsm,
-	     struct FsmNode *fnlist, int fncount)
+/* Event trace ring: every dispatched event is logged here, regardless of
+ * the per instance debug flags, so signalling races can be reconstructed
+ * from a live system after the fact. Writers only pay an atomic increment
+ * and four stores, no lock, so this stays enabled in production.
+ */
+#define FSM_TRACE_SIZE	2048	/* must be a power of 2 */
+
+struct FsmTraceEnt {
+	u64			ts;	/* local_clock() at dispatch */
+	const struct FsmInst	*fi;	/* identity only, may be stale */
+	u32			state;
+	u32			event;
+};
+
+static struct FsmTraceEnt	fsm_trace_ring[FSM_TRACE_SIZE];
+static atomic_t			fsm_trace_pos;
+
+static inline void
+fsm_trace(struct FsmInst *fi, int event)
 {
-	int i;
+	struct FsmTraceEnt *te;
+	u_int i;
 
-	fsm->jumpmatrix =
-		kzalloc(array3_size(sizeof(FSMFNPTR), fsm->state_count,
-				    fsm->event_count),
-			GFP_KERNEL);
-	if (fsm->jumpmatrix == NULL)
-		return -ENOMEM;
+	i = (u_int)atomic_inc_return(&fsm_trace_pos) - 1;
+	te = &fsm_trace_ring[i & (FSM_TRACE_SIZE - 1)];
+	te->ts = local_clock();
+	te->fi = fi;
+	te->state = fi->state;
+	te->event = event;
+}
+
+static void
+mISDN_FsmFill(struct Fsm *fsm, struct FsmNode *fnlist, int fncount)
+{
+	int i;
 
 	for (i = 0; i < fncount; i++)
 		if ((fnlist[i].state >= fsm->state_count) ||
 		    (fnlist[i].event >= fsm->event_count)) {
 			printk(KERN_ERR
-			       "mISDN_FsmNew Error: %d st(%ld/%ld) ev(%ld/%ld)\n",
+			       "mISDN_FsmFill Error: %d st(%ld/%ld) ev(%ld/%ld)\n",
 			       i, (long)fnlist[i].state, (long)fsm->state_count,
 			       (long)fnlist[i].event, (long)fsm->event_count);
 		} else
 			fsm->jumpmatrix[fsm->state_count * fnlist[i].event +
 					fnlist[i].state] = (FSMFNPTR) fnlist[i].routine;
+}
+
+int
+mISDN_FsmNew(struct Fsm *fsm,
+	     struct FsmNode *fnlist, int fncount)
+{
+	fsm->jumpmatrix =
+		kzalloc(array3_size(sizeof(FSMFNPTR), fsm->state_count,
+				    fsm->event_count),
+			GFP_KERNEL);
+	if (fsm->jumpmatrix == NULL)
+		return -ENOMEM;
+
+	fsm->jm_static = 0;
+	mISDN_FsmFill(fsm, fnlist, fncount);
 	return 0;
 }
 EXPORT_SYMBOL(mISDN_FsmNew);
 
+/* Like mISDN_FsmNew, but the flattened table lives in caller provided
+ * static storage, so the core FSMs share one cache-resident read-mostly
+ * table across modprobes instead of rebuilding it into kmalloc'd memory.
+ */
+int
+mISDN_FsmStatic(struct Fsm *fsm, struct FsmNode *fnlist, int fncount,
+		FSMFNPTR *matrix)
+{
+	fsm->jumpmatrix = matrix;
+	fsm->jm_static = 1;
+	memset(matrix, 0, array3_size(sizeof(FSMFNPTR), fsm->state_count,
+				      fsm->event_count));
+	mISDN_FsmFill(fsm, fnlist, fncount);
+	return 0;
+}
+EXPORT_SYMBOL(mISDN_FsmStatic);
+
 void
 mISDN_FsmFree(struct Fsm *fsm)
 {
-	kfree((void *) fsm->jumpmatrix);
+	if (!fsm->jm_static)
+		kfree((void *) fsm->jumpmatrix);
+	fsm->jumpmatrix = NULL;
 }
 EXPORT_SYMBOL(mISDN_FsmFree);
 
@@ -65,14 +126,15 @@ mISDN_FsmEvent(struct FsmInst *fi, int event, void *arg)
 {
 	FSMFNPTR r;
 
-	if ((fi->state >= fi->fsm->state_count) ||
-	    (event >= fi->fsm->event_count)) {
+	if (unlikely((fi->state >= fi->fsm->state_count) ||
+		     (event >= fi->fsm->event_count))) {
 		printk(KERN_ERR
 		       "mISDN_FsmEvent Error st(%ld/%ld) ev(%d/%ld)\n",
 		       (long)fi->state, (long)fi->fsm->state_count, event,
 		       (long)fi->fsm->event_count);
 		return 1;
 	}
+	fsm_trace(fi, event);
 	r = fi->fsm->jumpmatrix[fi->fsm->state_count * event + fi->state];
 	if (r) {
 		if (fi->debug)
@@ -91,6 +153,46 @@ mISDN_FsmEvent(struct FsmInst *fi, int event, void *arg)
 }
 EXPORT_SYMBOL(mISDN_FsmEvent);
 
+static int
+fsm_trace_show(struct seq_file *m, void *v)
+{
+	struct FsmTraceEnt	te;
+	u_int			pos, i;
+
+	pos = (u_int)atomic_read(&fsm_trace_pos);
+	i = pos > FSM_TRACE_SIZE ? pos - FSM_TRACE_SIZE : 0;
+	/* the instance pointer is printed as an opaque identity only -
+	 * the FsmInst may have been freed since the entry was written,
+	 * so it must never be dereferenced here
+	 */
+	for (; i != pos; i++) {
+		te = fsm_trace_ring[i & (FSM_TRACE_SIZE - 1)];
+		seq_printf(m, "%llu %p %u %u\n", te.ts, te.fi,
+			   te.state, te.event);
+	}
+	return 0;
+}
+
+static int
+fsm_trace_open(struct inode *ino, struct file *filep)
+{
+	return single_open(filep, fsm_trace_show, NULL);
+}
+
+static const struct file_operations fsm_trace_fops = {
+	.owner		= THIS_MODULE,
+	.open		= fsm_trace_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+void
+mISDN_FsmTraceDebugfs(struct dentry *root)
+{
+	debugfs_create_file("fsm_trace", 0400, root, NULL, &fsm_trace_fops);
+}
+
 void
 mISDN_FsmChangeState(struct FsmInst *fi, int newstate)
 {
@@ -168,6 +270,8 @@ void
 mISDN_FsmRestartTimer(struct FsmTimer *ft,
 		      int millisec, int event, void *arg, int where)
 {
+	unsigned long	interval = (millisec * HZ) / 1000;
+	unsigned long	expires = jiffies + interval;
 
 #if FSM_TIMER_DEBUG
 	if (ft->fi->debug)
@@ -175,11 +279,18 @@ mISDN_FsmRestartTimer(struct FsmTimer *ft,
 				   (long) ft, millisec, where);
 #endif
 
-	if (timer_pending(&ft->tl))
-		del_timer(&ft->tl);
 	ft->event = event;
 	ft->arg = arg;
-	ft->tl.expires = jiffies + (millisec * HZ) / 1000;
-	add_timer(&ft->tl);
+	/* protocol timers like T200/T203 are restarted for nearly every
+	 * frame, but their precision requirement is loose; when the
+	 * running timer already expires within 1/16 of the interval of
+	 * the requested time, keep it and save the re-arm, so busy
+	 * signalling with many datalinks does not hammer the timer base
+	 */
+	if (timer_pending(&ft->tl) &&
+	    time_before_eq(ft->tl.expires, expires) &&
+	    time_after_eq(ft->tl.expires, expires - (interval >> 4)))
+		return;
+	mod_timer(&ft->tl, expires);
 }
 EXPORT_SYMBOL(mISDN_FsmRestartTimer);
@@ -25,6 +25,7 @@
 /* Statemachine */
 
 struct FsmInst;
+struct dentry;
 
 typedef void (*FSMFNPTR)(struct FsmInst *, int, void *);
 
@@ -32,6 +33,7 @@ struct Fsm {
 	FSMFNPTR *jumpmatrix;
 	int state_count, event_count;
 	char **strEvent, **strState;
+	int jm_static;		/* jumpmatrix is caller owned, not kfreed */
 };
 
 struct FsmInst {
@@ -56,8 +58,10 @@ struct FsmTimer {
 };
 
 extern int mISDN_FsmNew(struct Fsm *, struct FsmNode *, int);
+extern int mISDN_FsmStatic(struct Fsm *, struct FsmNode *, int, FSMFNPTR *);
 extern void mISDN_FsmFree(struct Fsm *);
 extern int mISDN_FsmEvent(struct FsmInst *, int , void *);
+extern void mISDN_FsmTraceDebugfs(struct dentry *);
 extern void mISDN_FsmChangeState(struct FsmInst *, int);
 extern void mISDN_FsmInitTimer(struct FsmInst *, struct FsmTimer *);
 extern int mISDN_FsmAddTimer(struct FsmTimer *, int, int, void *, int);
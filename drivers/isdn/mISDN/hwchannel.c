@@ -28,6 +28,8 @@ dchannel_bh(struct work_struct *ws)
 
 	if (test_and_clear_bit(FLG_RECVQUEUE, &dch->Flags)) {
 		while ((skb = skb_dequeue(&dch->rqueue))) {
+			if (mISDN_rx_trace)
+				mISDN_lat_sample(MISDN_LAT_WORKER, skb);
 			if (likely(dch->dev.D.peer)) {
 				err = dch->dev.D.recv(dch->dev.D.peer, skb);
 				if (err)
@@ -42,6 +44,30 @@ dchannel_bh(struct work_struct *ws)
 	}
 }
 
+/* Keep the preallocated receive pool of a transparent channel filled from
+ * process context, so bchannel_get_rxbuf() can run allocation free in the
+ * interrupt path.  A size change drops the stale preallocations.
+ */
+static void
+bchannel_refill_rxpool(struct bchannel *bch)
+{
+	struct sk_buff	*skb;
+	unsigned short	len = bch->maxlen;
+
+	if (!test_bit(FLG_TRANSPARENT, &bch->Flags))
+		return;
+	if (bch->poollen != len) {
+		skb_queue_purge(&bch->rxpool);
+		bch->poollen = len;
+	}
+	while (skb_queue_len(&bch->rxpool) < MISDN_BCH_POOL_SIZE) {
+		skb = mI_alloc_skb(len, GFP_KERNEL);
+		if (!skb)
+			break;
+		skb_queue_tail(&bch->rxpool, skb);
+	}
+}
+
 static void
 bchannel_bh(struct work_struct *ws)
 {
@@ -52,6 +78,8 @@ bchannel_bh(struct work_struct *ws)
 	if (test_and_clear_bit(FLG_RECVQUEUE, &bch->Flags)) {
 		while ((skb = skb_dequeue(&bch->rqueue))) {
 			bch->rcount--;
+			if (mISDN_rx_trace)
+				mISDN_lat_sample(MISDN_LAT_WORKER, skb);
 			if (likely(bch->ch.peer)) {
 				err = bch->ch.recv(bch->ch.peer, skb);
 				if (err)
@@ -60,6 +88,7 @@ bchannel_bh(struct work_struct *ws)
 				dev_kfree_skb(skb);
 		}
 	}
+	bchannel_refill_rxpool(bch);
 }
 
 int
@@ -95,7 +124,13 @@ mISDN_initbchannel(struct bchannel *ch, unsigned short maxlen,
 	ch->rx_skb = NULL;
 	ch->tx_skb = NULL;
 	ch->tx_idx = 0;
+	ch->tx_ebuf = NULL;
+	ch->tx_esize = 0;
+	ch->tx_edup = 0;
+	ch->tx_edrop = 0;
 	skb_queue_head_init(&ch->rqueue);
+	skb_queue_head_init(&ch->rxpool);
+	ch->poollen = 0;
 	ch->rcount = 0;
 	ch->next_skb = NULL;
 	INIT_WORK(&ch->workq, bchannel_bh);
@@ -137,6 +172,11 @@ mISDN_clear_bchannel(struct bchannel *ch)
 		dev_kfree_skb(ch->next_skb);
 		ch->next_skb = NULL;
 	}
+	kfree(ch->tx_ebuf);
+	ch->tx_ebuf = NULL;
+	ch->tx_esize = 0;
+	ch->tx_edup = 0;
+	ch->tx_edrop = 0;
 	test_and_clear_bit(FLG_TX_BUSY, &ch->Flags);
 	test_and_clear_bit(FLG_TX_NEXT, &ch->Flags);
 	test_and_clear_bit(FLG_ACTIVE, &ch->Flags);
@@ -150,6 +190,8 @@ mISDN_clear_bchannel(struct bchannel *ch)
 	ch->next_maxlen = ch->init_maxlen;
 	skb_queue_purge(&ch->rqueue);
 	ch->rcount = 0;
+	skb_queue_purge(&ch->rxpool);
+	ch->poollen = 0;
 }
 EXPORT_SYMBOL(mISDN_clear_bchannel);
 
@@ -169,7 +211,7 @@ mISDN_ctrl_bchannel(struct bchannel *bch, struct mISDN_ctrl_req *cq)
 	switch (cq->op) {
 	case MISDN_CTRL_GETOP:
 		cq->op = MISDN_CTRL_RX_BUFFER | MISDN_CTRL_FILL_EMPTY |
-			 MISDN_CTRL_RX_OFF;
+			 MISDN_CTRL_RX_OFF | MISDN_CTRL_TX_SLIP;
 		break;
 	case MISDN_CTRL_FILL_EMPTY:
 		if (cq->p1) {
@@ -188,6 +230,13 @@ mISDN_ctrl_bchannel(struct bchannel *bch, struct mISDN_ctrl_req *cq)
 			test_and_clear_bit(FLG_RX_OFF, &bch->Flags);
 		bch->dropcnt = 0;
 		break;
+	case MISDN_CTRL_TX_SLIP:
+		/* read back and restart the elastic slip counters */
+		cq->p1 = bch->tx_edup;
+		cq->p2 = bch->tx_edrop;
+		bch->tx_edup = 0;
+		bch->tx_edrop = 0;
+		break;
 	case MISDN_CTRL_RX_BUFFER:
 		if (cq->p2 > MISDN_CTRL_RX_SIZE_IGNORE)
 			bch->next_maxlen = cq->p2;
@@ -229,6 +278,9 @@ recv_Dchannel(struct dchannel *dch)
 	hh = mISDN_HEAD_P(dch->rx_skb);
 	hh->prim = PH_DATA_IND;
 	hh->id = get_sapi_tei(dch->rx_skb->data);
+	/* ingress point of the rx latency tracer (see mISDNif.h) */
+	if (mISDN_rx_trace)
+		MISDN_LAT_STAMP(dch->rx_skb) = ktime_get();
 	skb_queue_tail(&dch->rqueue, dch->rx_skb);
 	dch->rx_skb = NULL;
 	schedule_event(dch, FLG_RECVQUEUE);
@@ -248,6 +300,8 @@ recv_Echannel(struct dchannel *ech, struct dchannel *dch)
 	hh = mISDN_HEAD_P(ech->rx_skb);
 	hh->prim = PH_DATA_E_IND;
 	hh->id = get_sapi_tei(ech->rx_skb->data);
+	if (mISDN_rx_trace)
+		MISDN_LAT_STAMP(ech->rx_skb) = ktime_get();
 	skb_queue_tail(&dch->rqueue, ech->rx_skb);
 	ech->rx_skb = NULL;
 	schedule_event(dch, FLG_RECVQUEUE);
@@ -281,6 +335,8 @@ recv_Bchannel(struct bchannel *bch, unsigned int id, bool force)
 			       bch->nr);
 			skb_queue_purge(&bch->rqueue);
 		}
+		if (mISDN_rx_trace)
+			MISDN_LAT_STAMP(bch->rx_skb) = ktime_get();
 		bch->rcount++;
 		skb_queue_tail(&bch->rqueue, bch->rx_skb);
 		bch->rx_skb = NULL;
@@ -292,6 +348,8 @@ EXPORT_SYMBOL(recv_Bchannel);
 void
 recv_Dchannel_skb(struct dchannel *dch, struct sk_buff *skb)
 {
+	if (mISDN_rx_trace)
+		MISDN_LAT_STAMP(skb) = ktime_get();
 	skb_queue_tail(&dch->rqueue, skb);
 	schedule_event(dch, FLG_RECVQUEUE);
 }
@@ -306,6 +364,8 @@ recv_Bchannel_skb(struct bchannel *bch, struct sk_buff *skb)
 		skb_queue_purge(&bch->rqueue);
 		bch->rcount = 0;
 	}
+	if (mISDN_rx_trace)
+		MISDN_LAT_STAMP(skb) = ktime_get();
 	bch->rcount++;
 	skb_queue_tail(&bch->rqueue, skb);
 	schedule_event(bch, FLG_RECVQUEUE);
@@ -471,6 +531,114 @@ bchannel_senddata(struct bchannel *ch, struct sk_buff *skb)
 }
 EXPORT_SYMBOL(bchannel_senddata);
 
+/* Find the first pair of identical samples in a law coded chunk; that is
+ * the least audible place to stretch or shrink the stream by one sample.
+ * Returns n if the chunk has no such spot.
+ */
+static int
+tx_flat_spot(u8 *p, int n)
+{
+	int i;
+
+	for (i = 1; i < n; i++)
+		if (p[i - 1] == p[i])
+			return i;
+	return n;
+}
+
+/* Copy up to count bytes of queued transmit data to dst, advancing the
+ * skb chain (including the PH_DATA_CNF handling in get_next_bframe).
+ */
+static int
+tx_drain(struct bchannel *bch, u8 *dst, int count)
+{
+	int out = 0, n;
+
+	while (out < count && bch->tx_skb) {
+		n = bch->tx_skb->len - bch->tx_idx;
+		if (n > count - out)
+			n = count - out;
+		if (n > 0) {
+			memcpy(dst + out, bch->tx_skb->data + bch->tx_idx, n);
+			bch->tx_idx += n;
+			out += n;
+		}
+		if (bch->tx_idx >= bch->tx_skb->len) {
+			dev_kfree_skb(bch->tx_skb);
+			if (!get_next_bframe(bch))
+				break;
+		}
+	}
+	return out;
+}
+
+/* Elastic transparent transmit. The driver asks for the next <count> byte
+ * chunk for its fifo and gets a linear buffer plus the real length in
+ * <len>. The userspace media clock and the TDM clock always drift a
+ * little against each other, which used to end in silence insertion and
+ * later bulk discards (an audible slip). Here the stream is resampled by
+ * single samples instead: when the queue cannot fill the chunk, one
+ * sample is duplicated, and when more than two extra chunks have piled
+ * up, one sample is dropped - both at a flat spot of the waveform. That
+ * bounds the adjustment to one sample per pull, enough for crystal
+ * tolerances while staying inaudible.
+ *
+ * Returns NULL when no data is queued at all; idle and fill-empty
+ * handling stays with the driver. Must be called with the HW lock held,
+ * like get_next_bframe().
+ */
+u8 *
+bchannel_tx_chunk(struct bchannel *bch, int count, int *len)
+{
+	int out, pending, spot;
+	u8 *buf;
+
+	if (!test_bit(FLG_TRANSPARENT, &bch->Flags))
+		return NULL;
+	if (!bch->tx_skb)
+		return NULL;
+	pending = bch->tx_skb->len - bch->tx_idx;
+	if (bch->next_skb)
+		pending += bch->next_skb->len;
+	if (pending <= 0)
+		return NULL;
+	if (count > bch->tx_esize) {
+		kfree(bch->tx_ebuf);
+		bch->tx_ebuf = kmalloc(count, GFP_ATOMIC);
+		if (!bch->tx_ebuf) {
+			bch->tx_esize = 0;
+			return NULL;
+		}
+		bch->tx_esize = count;
+	}
+	buf = bch->tx_ebuf;
+	out = tx_drain(bch, buf, count);
+	if (!out)
+		return NULL;
+	if (out < count) {
+		/* short chunk: stretch by one duplicated sample */
+		spot = tx_flat_spot(buf, out);
+		if (spot < out)
+			memmove(buf + spot + 1, buf + spot, out - spot);
+		else
+			buf[out] = buf[out - 1];
+		out++;
+		bch->tx_edup++;
+	} else if (pending - out > 2 * count) {
+		/* big backlog: shrink by one dropped sample */
+		spot = tx_flat_spot(buf, out);
+		if (spot < out) {
+			memmove(buf + spot, buf + spot + 1, out - spot - 1);
+			if (tx_drain(bch, buf + out - 1, 1) != 1)
+				out--;
+			bch->tx_edrop++;
+		}
+	}
+	*len = out;
+	return buf;
+}
+EXPORT_SYMBOL(bchannel_tx_chunk);
+
 /* The function allocates a new receive skb on demand with a size for the
  * requirements of the current protocol. It returns the tailroom of the
  * receive skb or an error.
@@ -511,6 +679,12 @@ bchannel_get_rxbuf(struct bchannel *bch, int reqlen)
 			if (len > bch->maxlen)
 				len = bch->maxlen;
 		}
+		/* steady state audio is served from the recycling pool */
+		if (len <= bch->poollen) {
+			bch->rx_skb = skb_dequeue(&bch->rxpool);
+			if (bch->rx_skb)
+				return skb_tailroom(bch->rx_skb);
+		}
 	} else {
 		/* with HDLC we do not know the length yet */
 		len = bch->maxlen;
@@ -17,15 +17,42 @@
 /* frames */
 #define L1OIP_MAX_LEN		2048		/* max packet size form l2 */
 #define L1OIP_MAX_PERFRAME	1400		/* max data size in one frame */
+#define L1OIP_BUNDLE_HEADROOM	8		/* frame header before blocks */
 
 
 /* timers */
 #define L1OIP_KEEPALIVE		15
 #define L1OIP_TIMEOUT		65
+#define L1OIP_BUNDLE_DELAY	(HZ / 100 + 1)	/* wait for other channels */
+
+
+/* jitter buffer */
+#define L1OIP_JB_MAX		8		/* max depth in chunks */
+
+
+/* statistics */
+#define L1OIP_STAT_BUCKETS	8		/* log2 histogram buckets */
 
 
 /* socket */
 #define L1OIP_DEFAULTPORT	931
+#define L1OIP_MAX_SOCKETS	4	/* receive queues per interface */
+
+
+/* adaptive state of the G.726 coder, one per direction and channel */
+struct l1oip_g726_state {
+	int			yl;	/* locked scale factor */
+	int			yu;	/* unlocked scale factor */
+	int			dms;	/* short term average of f() */
+	int			dml;	/* long term average of f() */
+	int			ap;	/* scale factor speed control */
+	int			a[2];	/* pole predictor coefficients */
+	int			b[6];	/* zero predictor coefficients */
+	int			pk[2];	/* signs of last two dqsez */
+	int			dq[6];	/* last differences (float format) */
+	int			sr[2];	/* last reconstructed (float format) */
+	int			td;	/* tone detected */
+};
 
 
 /* channel structure */
@@ -35,6 +62,21 @@ struct l1oip_chan {
 	u32			tx_counter;	/* counts xmit bytes/packets */
 	u32			rx_counter;	/* counts recv bytes/packets */
 	u32			codecstate;	/* used by codec to save data */
+	struct l1oip_g726_state	g726_tx;	/* G.726 encoder state */
+	struct l1oip_g726_state	g726_rx;	/* G.726 decoder state */
+	struct sk_buff_head	jb_q;		/* buffered receive chunks */
+	u32			jb_jitter;	/* interarrival jitter (us) */
+	u32			jb_target;	/* chunks to hold back */
+	u32			jb_maxdepth;	/* deepest the buffer got */
+	u32			jb_lasttb;	/* time base of last chunk */
+	ktime_t			jb_lastrx;	/* arrival of last chunk */
+	/* counters below are written by the receiving socket thread only */
+	u32			rx_chunks;	/* chunks received */
+	u32			rx_lost;	/* chunks missing in gaps */
+	u32			rx_loss_events;	/* number of gaps */
+	u32			rx_reorder;	/* chunks behind schedule */
+	u32			loss_hist[L1OIP_STAT_BUCKETS];
+	u32			reorder_hist[L1OIP_STAT_BUCKETS];
 #ifdef REORDER_DEBUG
 	int			disorder_flag;
 	struct sk_buff		*disorder_skb;
@@ -43,6 +85,24 @@ struct l1oip_chan {
 };
 
 
+/* one socket with its own receive thread; channels are hashed across
+ * the sockets of a card, so the network stack spreads their traffic
+ * over multiple cores
+ */
+struct l1oip_socket {
+	struct l1oip		*hc;		/* back pointer to card */
+	int			idx;		/* index within the card */
+	struct socket		*socket;	/* if set, socket is created */
+	struct completion	socket_complete;/* completion of sock thread */
+	struct task_struct	*socket_thread;
+	spinlock_t		socket_lock;	/* access sock outside thread */
+	struct sockaddr_in	sin_local;	/* local socket name */
+	struct sockaddr_in	sin_remote;	/* remote socket name */
+	struct msghdr		sendmsg;	/* ip message to send */
+	struct kvec		sendiov[2];	/* iov for header and data */
+};
+
+
 /* card structure */
 struct l1oip {
 	struct list_head        list;
@@ -61,23 +121,30 @@ struct l1oip {
 	int			limit;		/* limit number of bchannels */
 
 	/* timer */
-	struct timer_list	keep_tl;
-	struct timer_list	timeout_tl;
+	unsigned long		keep_to;	/* when to send keepalive */
+	unsigned long		timeout_to;	/* when remote is assumed gone */
 	int			timeout_on;
 	struct work_struct	workq;
 
 	/* socket */
-	struct socket		*socket;	/* if set, socket is created */
-	struct completion	socket_complete;/* completion of sock thread */
-	struct task_struct	*socket_thread;
-	spinlock_t		socket_lock;	/* access sock outside thread */
+	int			num_sockets;	/* sockets/threads in use */
+	struct l1oip_socket	sock[L1OIP_MAX_SOCKETS];
 	u32			remoteip;	/* if all set, ip is assigned */
 	u16			localport;	/* must always be set */
 	u16			remoteport;	/* must always be set */
-	struct sockaddr_in	sin_local;	/* local socket name */
-	struct sockaddr_in	sin_remote;	/* remote socket name */
-	struct msghdr		sendmsg;	/* ip message to send */
-	struct kvec		sendiov;	/* iov for message */
+
+	/* bundling of all channels' chunks into one datagram */
+	spinlock_t		bundle_lock;	/* protects bundle buffer */
+	u8			*bundle_buf;	/* collected channel blocks */
+	u8			*bundle_tx;	/* frame under transmission */
+	int			bundle_len;	/* bytes collected so far */
+	int			bundle_last;	/* offset of last block */
+	DECLARE_BITMAP(bundle_map, 128);	/* channels already queued */
+	struct timer_list	bundle_tl;	/* flushes partial bundles */
+	struct work_struct	bundle_work;	/* flush in process context */
+
+	/* statistics */
+	struct dentry		*dbg;		/* debugfs directory */
 
 	/* frame */
 	struct l1oip_chan	chan[128];	/* channel instances */
@@ -85,7 +152,14 @@ struct l1oip {
 
 extern int l1oip_law_to_4bit(u8 *data, int len, u8 *result, u32 *state);
 extern int l1oip_4bit_to_law(u8 *data, int len, u8 *result);
+extern int l1oip_law_to_g726(u8 *data, int len, u8 *result,
+			     struct l1oip_g726_state *st);
+extern int l1oip_g726_to_law(u8 *data, int len, u8 *result,
+			     struct l1oip_g726_state *st);
+extern void l1oip_g726_init(struct l1oip_g726_state *st);
 extern int l1oip_alaw_to_ulaw(u8 *data, int len, u8 *result);
 extern int l1oip_ulaw_to_alaw(u8 *data, int len, u8 *result);
 extern void l1oip_4bit_free(void);
 extern int l1oip_4bit_alloc(int ulaw);
+extern void l1oip_g726_free(void);
+extern int l1oip_g726_alloc(int ulaw);
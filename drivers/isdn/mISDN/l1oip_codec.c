@@ -4,8 +4,10 @@
  *  -> conversion from a-Law to u-Law
  *  -> conversion from u-Law to a-Law
  *  -> compression by reducing the number of sample resolution to 4
+ *  -> G.726 32kbit/s ADPCM compression
  *
- * NOTE: It is not compatible with any standard codec like ADPCM.
+ * NOTE: The 4 bit compander is not compatible with any standard codec
+ * like ADPCM; the G.726 codec is, see the note at its implementation.
  *
  * Author	Andreas Eversberg (jolly@eversberg.eu)
  *
@@ -39,9 +41,12 @@
 
   To speed up compression and decompression, two lookup tables are formed:
 
-  - 16 bits index for two samples (law encoded) with 8 bit compressed result.
+  - 8 bits index for one sample (law encoded) with 4 bit compressed result.
   - 8 bits index for one compressed data with 16 bits decompressed result.
 
+  Both tables fit into the first level cache, so the loops can consume
+  16 samples per turn without thrashing it.
+
   NOTE: The bytes are handled as they are law-encoded.
 
 */
@@ -54,8 +59,10 @@
 
 /* definitions of codec. don't use calculations, code may run slower. */
 
-static u8 *table_com;
+static u8 table_com[256];
 static u16 *table_dec;
+static s16 *table_lin;	/* law -> 16 bit linear, for the G.726 codec */
+static int g726_ulaw;	/* law used on the G.726 linear -> law side */
 
 
 /* alaw -> ulaw */
@@ -232,15 +239,34 @@ l1oip_law_to_4bit(u8 *data, int len, u8 *result, u32 *state)
 
 	/* send saved byte and first input byte */
 	if (*state) {
-		*result++ = table_com[(((*state) << 8) & 0xff00) | (*data++)];
+		*result++ = (table_com[(*state) & 0xff] << 4)
+			| table_com[*data++];
 		len--;
 		o++;
 	}
 
 	ii = len >> 1;
 
+	/* 16 samples per turn; the table is small enough to stay in the
+	 * first level cache for all of them
+	 */
+	while (i + 8 <= ii) {
+		result[0] = (table_com[data[0]] << 4) | table_com[data[1]];
+		result[1] = (table_com[data[2]] << 4) | table_com[data[3]];
+		result[2] = (table_com[data[4]] << 4) | table_com[data[5]];
+		result[3] = (table_com[data[6]] << 4) | table_com[data[7]];
+		result[4] = (table_com[data[8]] << 4) | table_com[data[9]];
+		result[5] = (table_com[data[10]] << 4) | table_com[data[11]];
+		result[6] = (table_com[data[12]] << 4) | table_com[data[13]];
+		result[7] = (table_com[data[14]] << 4) | table_com[data[15]];
+		data += 16;
+		result += 8;
+		i += 8;
+		o += 8;
+	}
+
 	while (i < ii) {
-		*result++ = table_com[(data[0]<<8) | (data[1])];
+		*result++ = (table_com[data[0]] << 4) | table_com[data[1]];
 		data += 2;
 		i++;
 		o++;
@@ -265,6 +291,37 @@ l1oip_4bit_to_law(u8 *data, int len, u8 *result)
 	int i = 0;
 	u16 r;
 
+	/* 16 samples (8 input bytes) per turn */
+	while (i + 8 <= len) {
+		r = table_dec[data[0]];
+		result[0] = r >> 8;
+		result[1] = r;
+		r = table_dec[data[1]];
+		result[2] = r >> 8;
+		result[3] = r;
+		r = table_dec[data[2]];
+		result[4] = r >> 8;
+		result[5] = r;
+		r = table_dec[data[3]];
+		result[6] = r >> 8;
+		result[7] = r;
+		r = table_dec[data[4]];
+		result[8] = r >> 8;
+		result[9] = r;
+		r = table_dec[data[5]];
+		result[10] = r >> 8;
+		result[11] = r;
+		r = table_dec[data[6]];
+		result[12] = r >> 8;
+		result[13] = r;
+		r = table_dec[data[7]];
+		result[14] = r >> 8;
+		result[15] = r;
+		data += 8;
+		result += 16;
+		i += 8;
+	}
+
 	while (i < len) {
 		r = table_dec[*data++];
 		*result++ = r >> 8;
@@ -276,6 +333,452 @@ l1oip_4bit_to_law(u8 *data, int len, u8 *result)
 }
 
 
+/*
+ * G.726 32kbit/s ADPCM codec (G.721)
+ *
+ * Quantizer, predictor and scale factor adaption follow the ITU
+ * specification, so the stream is compatible with any standard
+ * implementation. The adaptive state is carried per channel and
+ * direction across chunks (struct l1oip_g726_state). A lost packet
+ * desynchronizes the state between both ends, but all adaption is
+ * leaky, so the decoder reconverges within a few chunks on its own -
+ * just like any other G.726 endpoint behind a lossy transport.
+ */
+
+/* quantizer decision levels, relative to the scale factor */
+static s16 g726_qtab[7] = {
+	-124, 80, 178, 246, 300, 349, 400
+};
+
+/* log of the reconstructed difference per code */
+static s16 g726_dqlntab[16] = {
+	-2048, 4, 135, 213, 273, 323, 373, 425,
+	425, 373, 323, 273, 213, 135, 4, -2048
+};
+
+/* scale factor multipliers per code */
+static s16 g726_witab[16] = {
+	-12, 18, 41, 64, 112, 198, 355, 1122,
+	1122, 355, 198, 112, 64, 41, 18, -12
+};
+
+/* output levels of f() per code, for the speed control */
+static s16 g726_fitab[16] = {
+	0, 0, 0, 0x200, 0x200, 0x200, 0x600, 0xe00,
+	0xe00, 0x600, 0x200, 0x200, 0x200, 0, 0, 0
+};
+
+static s16 g726_power2[15] = {
+	1, 2, 4, 8, 0x10, 0x20, 0x40, 0x80,
+	0x100, 0x200, 0x400, 0x800, 0x1000, 0x2000, 0x4000
+};
+
+/* index of the first table entry not below val */
+static int
+g726_quan(int val, s16 *table, int size)
+{
+	int i;
+
+	for (i = 0; i < size; i++)
+		if (val < *table++)
+			break;
+	return i;
+}
+
+/* multiply a predictor coefficient with a value in floating point format */
+static int
+g726_fmult(int an, int srn)
+{
+	int anmag, anexp, anmant;
+	int wanexp, wanmant;
+	int retval;
+
+	anmag = (an > 0) ? an : ((-an) & 0x1fff);
+	anexp = g726_quan(anmag, g726_power2, 15) - 6;
+	anmant = (anmag == 0) ? 32 :
+		(anexp >= 0) ? (anmag >> anexp) : (anmag << -anexp);
+	wanexp = anexp + ((srn >> 6) & 0xf) - 13;
+
+	wanmant = (anmant * (srn & 0x3f) + 0x30) >> 4;
+	retval = (wanexp >= 0) ? ((wanmant << wanexp) & 0x7fff) :
+		(wanmant >> -wanexp);
+
+	return ((an ^ srn) < 0) ? -retval : retval;
+}
+
+/* reset the adaptive state to the defined initial values */
+void
+l1oip_g726_init(struct l1oip_g726_state *st)
+{
+	int i;
+
+	st->yl = 34816;
+	st->yu = 544;
+	st->dms = 0;
+	st->dml = 0;
+	st->ap = 0;
+	for (i = 0; i < 2; i++) {
+		st->a[i] = 0;
+		st->pk[i] = 0;
+		st->sr[i] = 32;
+	}
+	for (i = 0; i < 6; i++) {
+		st->b[i] = 0;
+		st->dq[i] = 32;
+	}
+	st->td = 0;
+}
+
+static int
+g726_predictor_zero(struct l1oip_g726_state *st)
+{
+	int i, sezi;
+
+	sezi = g726_fmult(st->b[0] >> 2, st->dq[0]);
+	for (i = 1; i < 6; i++)
+		sezi += g726_fmult(st->b[i] >> 2, st->dq[i]);
+	return sezi;
+}
+
+static int
+g726_predictor_pole(struct l1oip_g726_state *st)
+{
+	return g726_fmult(st->a[1] >> 2, st->sr[1]) +
+		g726_fmult(st->a[0] >> 2, st->sr[0]);
+}
+
+static int
+g726_step_size(struct l1oip_g726_state *st)
+{
+	int y, dif, al;
+
+	if (st->ap >= 256)
+		return st->yu;
+	y = st->yl >> 6;
+	dif = st->yu - y;
+	al = st->ap >> 2;
+	if (dif > 0)
+		y += (dif * al) >> 6;
+	else if (dif < 0)
+		y += (dif * al + 0x3f) >> 6;
+	return y;
+}
+
+/* quantize the difference against the current scale factor */
+static int
+g726_quantize(int d, int y)
+{
+	int dqm, exp, mant, dln;
+	int i;
+
+	dqm = (d < 0) ? -d : d;
+	exp = g726_quan(dqm >> 1, g726_power2, 15);
+	mant = ((dqm << 7) >> exp) & 0x7f;
+	dln = ((exp << 7) + mant) - (y >> 2);
+
+	i = g726_quan(dln, g726_qtab, 7);
+	if (d < 0)
+		i = 15 - i;
+	else if (i == 0)
+		i = 15;
+	return i;
+}
+
+/* reconstruct the difference from a code and the scale factor */
+static int
+g726_reconstruct(int sign, int dqln, int y)
+{
+	int dql, dex, dqt, dq;
+
+	dql = dqln + (y >> 2);
+	if (dql < 0)
+		return sign ? -0x8000 : 0;
+	dex = (dql >> 7) & 15;
+	dqt = 128 + (dql & 127);
+	dq = (dqt << 7) >> (14 - dex);
+	return sign ? (dq - 0x8000) : dq;
+}
+
+/* update predictor and scale factor state with the result of a code */
+static void
+g726_update(int y, int wi, int fi, int dq, int sr, int dqsez,
+	    struct l1oip_g726_state *st)
+{
+	int i;
+	int mag, exp, a2p = 0, a1ul, pks1, fa1, pk0, tr;
+	int ylint, ylfrac, thr1, thr2, dqthr, dif;
+
+	pk0 = (dqsez < 0) ? 1 : 0;
+	mag = dq & 0x7fff;
+
+	/* transition from tone detection */
+	ylint = st->yl >> 15;
+	ylfrac = (st->yl >> 10) & 0x1f;
+	thr1 = (32 + ylfrac) << ylint;
+	thr2 = (ylint > 9) ? (31 << 10) : thr1;
+	dqthr = (thr2 + (thr2 >> 1)) >> 1;
+	if (st->td == 0 || mag <= dqthr)
+		tr = 0;
+	else
+		tr = 1;
+
+	/* scale factor adaption */
+	st->yu = y + ((wi - y) >> 5);
+	if (st->yu < 544)
+		st->yu = 544;
+	else if (st->yu > 5120)
+		st->yu = 5120;
+	st->yl += st->yu + ((-st->yl) >> 6);
+
+	if (tr == 1) {
+		/* reset predictor on a detected transition */
+		st->a[0] = 0;
+		st->a[1] = 0;
+		for (i = 0; i < 6; i++)
+			st->b[i] = 0;
+	} else {
+		/* pole predictor adaption */
+		pks1 = pk0 ^ st->pk[0];
+		a2p = st->a[1] - (st->a[1] >> 7);
+		if (dqsez != 0) {
+			fa1 = pks1 ? st->a[0] : -st->a[0];
+			if (fa1 < -8191)
+				a2p -= 0x100;
+			else if (fa1 > 8191)
+				a2p += 0xff;
+			else
+				a2p += fa1 >> 5;
+
+			if (pk0 ^ st->pk[1]) {
+				if (a2p <= -12160)
+					a2p = -12288;
+				else if (a2p >= 12416)
+					a2p = 12288;
+				else
+					a2p -= 0x80;
+			} else if (a2p <= -12416)
+				a2p = -12288;
+			else if (a2p >= 12160)
+				a2p = 12288;
+			else
+				a2p += 0x80;
+		}
+		st->a[1] = a2p;
+
+		st->a[0] -= st->a[0] >> 8;
+		if (dqsez != 0) {
+			if (pks1 == 0)
+				st->a[0] += 192;
+			else
+				st->a[0] -= 192;
+		}
+		a1ul = 15360 - a2p;
+		if (st->a[0] < -a1ul)
+			st->a[0] = -a1ul;
+		else if (st->a[0] > a1ul)
+			st->a[0] = a1ul;
+
+		/* zero predictor adaption */
+		for (i = 0; i < 6; i++) {
+			st->b[i] -= st->b[i] >> 8;
+			if (mag) {
+				if ((dq ^ st->dq[i]) >= 0)
+					st->b[i] += 128;
+				else
+					st->b[i] -= 128;
+			}
+		}
+	}
+
+	/* shift in the new difference, floating point format */
+	for (i = 5; i > 0; i--)
+		st->dq[i] = st->dq[i - 1];
+	if (mag == 0)
+		st->dq[0] = (dq >= 0) ? 0x20 : (0x20 - 0x400);
+	else {
+		exp = g726_quan(mag, g726_power2, 15);
+		st->dq[0] = (dq >= 0) ?
+			(exp << 6) + ((mag << 6) >> exp) :
+			(exp << 6) + ((mag << 6) >> exp) - 0x400;
+	}
+
+	/* shift in the new reconstructed value, floating point format */
+	st->sr[1] = st->sr[0];
+	if (sr == 0)
+		st->sr[0] = 0x20;
+	else if (sr > 0) {
+		exp = g726_quan(sr, g726_power2, 15);
+		st->sr[0] = (exp << 6) + ((sr << 6) >> exp);
+	} else if (sr > -32768) {
+		mag = -sr;
+		exp = g726_quan(mag, g726_power2, 15);
+		st->sr[0] = (exp << 6) + ((mag << 6) >> exp) - 0x400;
+	} else
+		st->sr[0] = 0x20 - 0x400;
+
+	st->pk[1] = st->pk[0];
+	st->pk[0] = pk0;
+
+	/* tone detection */
+	if (tr == 1)
+		st->td = 0;
+	else if (a2p < -11776)
+		st->td = 1;
+	else
+		st->td = 0;
+
+	/* scale factor speed control */
+	st->dms += (fi - st->dms) >> 5;
+	st->dml += (((fi << 2) - st->dml) >> 7);
+
+	dif = (st->dms << 2) - st->dml;
+	if (dif < 0)
+		dif = -dif;
+	if (tr == 1)
+		st->ap = 256;
+	else if (y < 1536 || st->td == 1 || dif >= (st->dml >> 3))
+		st->ap += (0x200 - st->ap) >> 4;
+	else
+		st->ap += (-st->ap) >> 4;
+}
+
+/* encode one 16 bit linear sample to a 4 bit code */
+static int
+g726_encode(int sl, struct l1oip_g726_state *st)
+{
+	int sezi, se, sez, y, i, dq, sr, dqsez;
+
+	sl >>= 2; /* 14 bit dynamic range */
+
+	sezi = g726_predictor_zero(st);
+	sez = sezi >> 1;
+	se = (sezi + g726_predictor_pole(st)) >> 1;
+
+	y = g726_step_size(st);
+	i = g726_quantize(sl - se, y);
+	dq = g726_reconstruct(i & 8, g726_dqlntab[i], y);
+	sr = (dq < 0) ? se - (dq & 0x3fff) : se + dq;
+	dqsez = sr + sez - se;
+
+	g726_update(y, g726_witab[i] << 5, g726_fitab[i], dq, sr, dqsez, st);
+
+	return i;
+}
+
+/* decode one 4 bit code to a 16 bit linear sample */
+static int
+g726_decode(int i, struct l1oip_g726_state *st)
+{
+	int sezi, se, sez, y, dq, sr, dqsez;
+
+	i &= 0x0f;
+	sezi = g726_predictor_zero(st);
+	sez = sezi >> 1;
+	se = (sezi + g726_predictor_pole(st)) >> 1;
+
+	y = g726_step_size(st);
+	dq = g726_reconstruct(i & 8, g726_dqlntab[i], y);
+	sr = (dq < 0) ? se - (dq & 0x3fff) : se + dq;
+	dqsez = sr - se + sez;
+
+	g726_update(y, g726_witab[i] << 5, g726_fitab[i], dq, sr, dqsez, st);
+
+	return sr << 2; /* back to 16 bit dynamic range */
+}
+
+/* 16 bit linear to law, standard G.711 segment search */
+static u8
+g726_lin_to_law(int pcm)
+{
+	static s16 seg_aend[8] = {
+		0x1f, 0x3f, 0x7f, 0xff, 0x1ff, 0x3ff, 0x7ff, 0xfff
+	};
+	static s16 seg_uend[8] = {
+		0x3f, 0x7f, 0xff, 0x1ff, 0x3ff, 0x7ff, 0xfff, 0x1fff
+	};
+	int mask, seg;
+
+	if (g726_ulaw) {
+		if (pcm < 0) {
+			pcm = -pcm;
+			mask = 0x7f;
+		} else
+			mask = 0xff;
+		pcm >>= 2;
+		if (pcm > 8159)
+			pcm = 8159;
+		pcm += 0x21; /* bias */
+
+		/* segment ends are included, unlike the quantizer levels */
+		for (seg = 0; seg < 8; seg++)
+			if (pcm <= seg_uend[seg])
+				break;
+		if (seg >= 8)
+			return 0x7f ^ mask;
+		return ((seg << 4) | ((pcm >> (seg + 1)) & 0x0f)) ^ mask;
+	}
+
+	pcm >>= 3;
+	if (pcm >= 0)
+		mask = 0xd5;
+	else {
+		mask = 0x55;
+		pcm = -pcm - 1;
+	}
+	for (seg = 0; seg < 8; seg++)
+		if (pcm <= seg_aend[seg])
+			break;
+	if (seg >= 8)
+		return 0x7f ^ mask;
+	if (seg < 2)
+		return ((seg << 4) | ((pcm >> 1) & 0x0f)) ^ mask;
+	return ((seg << 4) | ((pcm >> seg) & 0x0f)) ^ mask;
+}
+
+/*
+ * Compresses data to the result buffer
+ * The result size must be at least half of the input buffer.
+ * The number of samples also must be even!
+ */
+int
+l1oip_law_to_g726(u8 *data, int len, u8 *result,
+		  struct l1oip_g726_state *st)
+{
+	int i = 0, o = 0;
+	u8 byte = 0;
+
+	while (i < len) {
+		if (i & 1)
+			result[o++] = byte | g726_encode(table_lin[*data++],
+							 st);
+		else
+			byte = g726_encode(table_lin[*data++], st) << 4;
+		i++;
+	}
+
+	return o;
+}
+
+/* Decompress data to the result buffer
+ * The result size must be the number of sample in packet. (2 * input data)
+ * The number of samples in the result are even!
+ */
+int
+l1oip_g726_to_law(u8 *data, int len, u8 *result,
+		  struct l1oip_g726_state *st)
+{
+	int i = 0;
+
+	while (i < len) {
+		*result++ = g726_lin_to_law(g726_decode(*data >> 4, st));
+		*result++ = g726_lin_to_law(g726_decode(*data++, st));
+		i++;
+	}
+
+	return len << 1;
+}
+
+
 /*
  * law conversion
  */
@@ -313,42 +816,28 @@ void
 l1oip_4bit_free(void)
 {
 	vfree(table_dec);
-	vfree(table_com);
-	table_com = NULL;
 	table_dec = NULL;
 }
 
 int
 l1oip_4bit_alloc(int ulaw)
 {
-	int i1, i2, c, sample;
+	int i1, i2, sample;
 
 	/* in case, it is called again */
 	if (table_dec)
 		return 0;
 
-	/* alloc conversion tables */
-	table_com = vzalloc(65536);
+	/* alloc conversion table */
 	table_dec = vzalloc(512);
-	if (!table_com || !table_dec) {
-		l1oip_4bit_free();
+	if (!table_dec)
 		return -ENOMEM;
-	}
-	/* generate compression table */
-	i1 = 0;
-	while (i1 < 256) {
-		if (ulaw)
-			c = ulaw_to_4bit[i1];
-		else
-			c = alaw_to_4bit[i1];
-		i2 = 0;
-		while (i2 < 256) {
-			table_com[(i1 << 8) | i2] |= (c << 4);
-			table_com[(i2 << 8) | i1] |= c;
-			i2++;
-		}
-		i1++;
-	}
+
+	/* select compression table */
+	if (ulaw)
+		memcpy(table_com, ulaw_to_4bit, sizeof(table_com));
+	else
+		memcpy(table_com, alaw_to_4bit, sizeof(table_com));
 
 	/* generate decompression table */
 	i1 = 0;
@@ -368,3 +857,58 @@ l1oip_4bit_alloc(int ulaw)
 
 	return 0;
 }
+
+
+/*
+ * generate/free law to linear table for the G.726 codec
+ */
+void
+l1oip_g726_free(void)
+{
+	vfree(table_lin);
+	table_lin = NULL;
+}
+
+int
+l1oip_g726_alloc(int ulaw)
+{
+	int i, v, t;
+
+	/* in case, it is called again */
+	if (table_lin)
+		return 0;
+
+	/* alloc conversion table */
+	table_lin = vzalloc(512);
+	if (!table_lin)
+		return -ENOMEM;
+
+	g726_ulaw = ulaw;
+
+	/* generate law -> 16 bit linear table (standard G.711 expansion) */
+	for (i = 0; i < 256; i++) {
+		if (ulaw) {
+			v = ~i & 0xff;
+			t = ((v & 0x0f) << 3) + 0x84;
+			t <<= (v & 0x70) >> 4;
+			table_lin[i] = (v & 0x80) ? (0x84 - t) : (t - 0x84);
+		} else {
+			v = i ^ 0x55;
+			t = (v & 0x0f) << 4;
+			switch ((v & 0x70) >> 4) {
+			case 0:
+				t += 8;
+				break;
+			case 1:
+				t += 0x108;
+				break;
+			default:
+				t += 0x108;
+				t <<= ((v & 0x70) >> 4) - 1;
+			}
+			table_lin[i] = (v & 0x80) ? t : -t;
+		}
+	}
+
+	return 0;
+}
@@ -37,6 +37,7 @@
  Value 1 = transfer ALAW
  Value 2 = transfer ULAW
  Value 3 = transfer generic 4 bit compression.
+ Value 4 = transfer G.726 32kbit/s ADPCM.
 
  * ulaw:
  0 = we use a-Law (default)
@@ -75,6 +76,13 @@
  optional value to identify frames. This value must be equal on both
  peers and should be random. If omitted or 0, no ID is transmitted.
 
+ * sockets:
+ number of sockets (with own receive threads) per interface (1..4)
+ Channels are hashed across them, so receive processing of a busy
+ trunk spreads over multiple cores. Socket n binds to port + n; both
+ peers must use the same number of sockets.
+ If not given or 0, one socket is used.
+
  * debug:
  NOTE: only one debug value must be given for all cards
  enable debugging (see l1oip.h for debug options)
@@ -157,6 +165,8 @@
  Must be 0 for no transcoding. Also for D-channel and other HDLC frames.
  1 and 2 are reserved for explicitly use of a-LAW or u-LAW codec.
  3 is used for generic table compressor.
+ 4 is used for G.726 32kbit/s ADPCM. The adaptive state runs across
+ frames; after packet loss it reconverges by its leaky adaption.
 
  - M = More channels to come. If this flag is 1, the following byte contains
  the length of the channel data. After the data block, the next channel will
@@ -233,6 +243,8 @@
 #include <linux/inet.h>
 #include <linux/workqueue.h>
 #include <linux/kthread.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/sched/signal.h>
 
@@ -255,6 +267,7 @@ static u_int remoteport[MAX_CARDS];
 static u_int ondemand[MAX_CARDS];
 static u_int limit[MAX_CARDS];
 static u_int id[MAX_CARDS];
+static u_int sockets[MAX_CARDS];
 static int debug;
 static int ulaw;
 
@@ -268,9 +281,238 @@ module_param_array(remoteport, uint, NULL, S_IRUGO | S_IWUSR);
 module_param_array(ondemand, uint, NULL, S_IRUGO | S_IWUSR);
 module_param_array(limit, uint, NULL, S_IRUGO | S_IWUSR);
 module_param_array(id, uint, NULL, S_IRUGO | S_IWUSR);
+module_param_array(sockets, uint, NULL, S_IRUGO | S_IWUSR);
 module_param(ulaw, uint, S_IRUGO | S_IWUSR);
 module_param(debug, uint, S_IRUGO | S_IWUSR);
 
+
+/*
+ * statistics
+ */
+static struct dentry *l1oip_dbg_root;
+
+static int
+l1oip_stats_show(struct seq_file *m, void *v)
+{
+	struct l1oip		*hc = m->private;
+	struct l1oip_chan	*ch;
+	int			i, b;
+
+	for (i = 1; i < 128; i++) {
+		ch = &hc->chan[i];
+		if (!ch->bch || !ch->rx_chunks)
+			continue;
+		seq_printf(m, "channel %d: chunks %u lost %u gaps %u "
+			   "reorder %u jitter_us %u depth %u/%u max %u\n",
+			   i, ch->rx_chunks, ch->rx_lost,
+			   ch->rx_loss_events, ch->rx_reorder, ch->jb_jitter,
+			   skb_queue_len(&ch->jb_q), ch->jb_target,
+			   ch->jb_maxdepth);
+		seq_puts(m, "  loss_runs:");
+		for (b = 0; b < L1OIP_STAT_BUCKETS; b++)
+			seq_printf(m, " %u", ch->loss_hist[b]);
+		seq_puts(m, "\n  reorder_dist:");
+		for (b = 0; b < L1OIP_STAT_BUCKETS; b++)
+			seq_printf(m, " %u", ch->reorder_hist[b]);
+		seq_putc(m, '\n');
+	}
+	return 0;
+}
+
+static int
+l1oip_stats_open(struct inode *ino, struct file *filep)
+{
+	return single_open(filep, l1oip_stats_show, ino->i_private);
+}
+
+static const struct file_operations l1oip_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= l1oip_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+
+/*
+ * get the socket that carries the given channel
+ */
+static inline struct l1oip_socket *
+l1oip_socket_of(struct l1oip *hc, u8 channel)
+{
+	return &hc->sock[channel % hc->num_sockets];
+}
+
+
+/*
+ * send all collected channel blocks as one multiframe datagram
+ */
+static void
+l1oip_bundle_flush(struct l1oip *hc)
+{
+	/* bundles carry all channels, so they use the first socket */
+	struct l1oip_socket *ls = &hc->sock[0];
+	u8 *p;
+	int len;
+	struct socket *socket = NULL;
+
+	/* check for socket in safe condition */
+	spin_lock(&ls->socket_lock);
+	if (!ls->socket) {
+		spin_unlock(&ls->socket_lock);
+		/* socket is seized or closed, try again shortly */
+		mod_timer(&hc->bundle_tl, jiffies + 1);
+		return;
+	}
+	/* seize socket */
+	socket = ls->socket;
+	ls->socket = NULL;
+	spin_unlock(&ls->socket_lock);
+
+	spin_lock_bh(&hc->bundle_lock);
+	len = hc->bundle_len;
+	if (!len) {
+		spin_unlock_bh(&hc->bundle_lock);
+		goto give_back;
+	}
+
+	/* the last block has no m-flag and no length byte */
+	p = hc->bundle_buf;
+	p[hc->bundle_last] &= 0x7f;
+	memmove(p + hc->bundle_last + 1, p + hc->bundle_last + 2,
+		L1OIP_BUNDLE_HEADROOM + len - (hc->bundle_last + 2));
+	len--;
+
+	/* assemble frame header in front of the blocks */
+	p += L1OIP_BUNDLE_HEADROOM;
+	if (hc->id) {
+		*--p = hc->id;
+		*--p = hc->id >> 8;
+		*--p = hc->id >> 16;
+		*--p = hc->id >> 24;
+	}
+	*--p = (L1OIP_VERSION << 6) /* version and coding */
+		| (hc->pri ? 0x20 : 0x00) /* type */
+		| (hc->id ? 0x10 : 0x00) /* id */
+		| hc->codec;
+	len += hc->bundle_buf + L1OIP_BUNDLE_HEADROOM - p;
+
+	/* copy out, so new blocks may be collected while we send */
+	memcpy(hc->bundle_tx, p, len);
+	hc->bundle_len = 0;
+	bitmap_zero(hc->bundle_map, 128);
+	spin_unlock_bh(&hc->bundle_lock);
+
+	/* drop if we have no remote ip or port */
+	if (!ls->sin_remote.sin_addr.s_addr || !ls->sin_remote.sin_port) {
+		if (debug & DEBUG_L1OIP_MSG)
+			printk(KERN_DEBUG "%s: dropping frame, because remote "
+			       "IP is not set.\n", __func__);
+		goto give_back;
+	}
+
+	/* send packet */
+	if (debug & DEBUG_L1OIP_MSG)
+		printk(KERN_DEBUG "%s: sending bundled packet to socket (len "
+		       "= %d)\n", __func__, len);
+	ls->sendiov[0].iov_base = hc->bundle_tx;
+	ls->sendiov[0].iov_len  = len;
+	kernel_sendmsg(socket, &ls->sendmsg, ls->sendiov, 1, len);
+
+	/* restart timer */
+	hc->keep_to = jiffies + L1OIP_KEEPALIVE * HZ;
+
+give_back:
+	/* give socket back */
+	ls->socket = socket; /* no locking required */
+}
+
+
+static void
+l1oip_bundle_bh(struct work_struct *work)
+{
+	struct l1oip *hc = container_of(work, struct l1oip, bundle_work);
+
+	l1oip_bundle_flush(hc);
+}
+
+
+/*
+ * flush a partial bundle, so silent periods do not stall the frame;
+ * sending may block on the socket, so only kick the workqueue here
+ */
+static void
+l1oip_bundle_timeout(struct timer_list *t)
+{
+	struct l1oip *hc = from_timer(hc, t, bundle_tl);
+
+	schedule_work(&hc->bundle_work);
+}
+
+
+/*
+ * queue one channel's chunk as multiframe block into the bundle
+ */
+static int
+l1oip_bundle_send(struct l1oip *hc, u8 localcodec, u8 channel, u16 timebase,
+		  u8 *buf, int len)
+{
+	u8 *p;
+
+	spin_lock_bh(&hc->bundle_lock);
+
+	/* a second chunk for the same channel means that the next time
+	 * frame has begun; also keep room for this block and the header
+	 * and length bytes of a later one
+	 */
+	if (test_bit(channel, hc->bundle_map)
+	    || hc->bundle_len + len + 8 > L1OIP_MAX_PERFRAME) {
+		spin_unlock_bh(&hc->bundle_lock);
+		l1oip_bundle_flush(hc);
+		spin_lock_bh(&hc->bundle_lock);
+		if (hc->bundle_len + len + 8 > L1OIP_MAX_PERFRAME) {
+			/* flush failed to drain (socket seized), drop */
+			spin_unlock_bh(&hc->bundle_lock);
+			if (debug & DEBUG_L1OIP_MSG)
+				printk(KERN_DEBUG "%s: dropping chunk, "
+				       "bundle is full.\n", __func__);
+			return len;
+		}
+	}
+
+	hc->bundle_last = L1OIP_BUNDLE_HEADROOM + hc->bundle_len;
+	p = hc->bundle_buf + hc->bundle_last;
+
+	/* add data behind the block header */
+	if (localcodec == 1 && ulaw)
+		l1oip_ulaw_to_alaw(buf, len, p + 4);
+	else if (localcodec == 2 && !ulaw)
+		l1oip_alaw_to_ulaw(buf, len, p + 4);
+	else if (localcodec == 3)
+		len = l1oip_law_to_4bit(buf, len, p + 4,
+					&hc->chan[channel].codecstate);
+	else if (localcodec == 4)
+		len = l1oip_law_to_g726(buf, len, p + 4,
+					&hc->chan[channel].g726_tx);
+	else
+		memcpy(p + 4, buf, len);
+
+	*p++ = 0x80 + channel; /* m-flag, channel */
+	*p++ = len; /* length (256 is sent as 0) */
+	*p++ = timebase >> 8; /* time base */
+	*p++ = timebase;
+
+	hc->bundle_len = hc->bundle_last - L1OIP_BUNDLE_HEADROOM + 4 + len;
+	set_bit(channel, hc->bundle_map);
+	if (!timer_pending(&hc->bundle_tl))
+		mod_timer(&hc->bundle_tl, jiffies + L1OIP_BUNDLE_DELAY);
+
+	spin_unlock_bh(&hc->bundle_lock);
+
+	return len;
+}
+
+
 /*
  * send a frame via socket, if open and restart timer
  */
@@ -280,6 +522,8 @@ l1oip_socket_send(struct l1oip *hc, u8 localcodec, u8 channel, u32 chanmask,
 {
 	u8 *p;
 	u8 frame[MAX_DFRAME_LEN_L1 + 32];
+	int iovs = 1;
+	struct l1oip_socket *ls = l1oip_socket_of(hc, channel);
 	struct socket *socket = NULL;
 
 	if (debug & DEBUG_L1OIP_MSG)
@@ -289,22 +533,27 @@ l1oip_socket_send(struct l1oip *hc, u8 localcodec, u8 channel, u32 chanmask,
 	p = frame;
 
 	/* restart timer */
-	if (time_before(hc->keep_tl.expires, jiffies + 5 * HZ))
-		mod_timer(&hc->keep_tl, jiffies + L1OIP_KEEPALIVE * HZ);
-	else
-		hc->keep_tl.expires = jiffies + L1OIP_KEEPALIVE * HZ;
+	hc->keep_to = jiffies + L1OIP_KEEPALIVE * HZ;
 
 	if (debug & DEBUG_L1OIP_MSG)
 		printk(KERN_DEBUG "%s: resetting timer\n", __func__);
 
 	/* drop if we have no remote ip or port */
-	if (!hc->sin_remote.sin_addr.s_addr || !hc->sin_remote.sin_port) {
+	if (!ls->sin_remote.sin_addr.s_addr || !ls->sin_remote.sin_port) {
 		if (debug & DEBUG_L1OIP_MSG)
 			printk(KERN_DEBUG "%s: dropping frame, because remote "
 			       "IP is not set.\n", __func__);
 		return len;
 	}
 
+	/* in bundle mode, collect bchannel chunks and send them as one
+	 * multiframe datagram per time frame; dchannel and keepalive
+	 * frames are sent immediately
+	 */
+	if (hc->bundle && buf && len && len <= 256 && channel != hc->d_idx)
+		return l1oip_bundle_send(hc, localcodec, channel, timebase,
+					 buf, len);
+
 	/* assemble frame */
 	*p++ = (L1OIP_VERSION << 6) /* version and coding */
 		| (hc->pri ? 0x20 : 0x00) /* type */
@@ -328,35 +577,103 @@ l1oip_socket_send(struct l1oip *hc, u8 localcodec, u8 channel, u32 chanmask,
 		else if (localcodec == 3)
 			len = l1oip_law_to_4bit(buf, len, p,
 						&hc->chan[channel].codecstate);
+		else if (localcodec == 4)
+			len = l1oip_law_to_g726(buf, len, p,
+						&hc->chan[channel].g726_tx);
 		else
-			memcpy(p, buf, len);
+			iovs = 2; /* gather data from its own buffer */
 	}
-	len += p - frame;
+	if (iovs == 1)
+		len += p - frame;
 
 	/* check for socket in safe condition */
-	spin_lock(&hc->socket_lock);
-	if (!hc->socket) {
-		spin_unlock(&hc->socket_lock);
+	spin_lock(&ls->socket_lock);
+	if (!ls->socket) {
+		spin_unlock(&ls->socket_lock);
 		return 0;
 	}
 	/* seize socket */
-	socket = hc->socket;
-	hc->socket = NULL;
-	spin_unlock(&hc->socket_lock);
+	socket = ls->socket;
+	ls->socket = NULL;
+	spin_unlock(&ls->socket_lock);
 	/* send packet */
 	if (debug & DEBUG_L1OIP_MSG)
 		printk(KERN_DEBUG "%s: sending packet to socket (len "
-		       "= %d)\n", __func__, len);
-	hc->sendiov.iov_base = frame;
-	hc->sendiov.iov_len  = len;
-	len = kernel_sendmsg(socket, &hc->sendmsg, &hc->sendiov, 1, len);
+		       "= %d)\n", __func__,
+		       (iovs == 2) ? (int)(p - frame) + len : len);
+	if (iovs == 2) {
+		/* no codec conversion: send data out of the caller's
+		 * buffer, so it is copied only once into the skb
+		 */
+		ls->sendiov[0].iov_base = frame;
+		ls->sendiov[0].iov_len  = p - frame;
+		ls->sendiov[1].iov_base = buf;
+		ls->sendiov[1].iov_len  = len;
+		len += p - frame;
+	} else {
+		ls->sendiov[0].iov_base = frame;
+		ls->sendiov[0].iov_len  = len;
+	}
+	len = kernel_sendmsg(socket, &ls->sendmsg, ls->sendiov, iovs, len);
 	/* give socket back */
-	hc->socket = socket; /* no locking required */
+	ls->socket = socket; /* no locking required */
 
 	return len;
 }
 
 
+/*
+ * adaptive jitter buffer for received bchannel chunks
+ *
+ * The interarrival jitter is estimated from the deviation between the
+ * arrival interval and the sample interval given by the time base
+ * (like RFC 3550 does).  Enough chunks are held back to cover that
+ * jitter; the buffer grows by holding a chunk and drains by delivering
+ * an extra one, so depth changes by at most one chunk per arrival.
+ * With a stable link the estimate decays and chunks pass through
+ * without delay.
+ */
+static void
+l1oip_jitter_recv(struct l1oip_chan *ch, struct bchannel *bch,
+		  u32 rx_counter, struct sk_buff *nskb)
+{
+	struct sk_buff *skb;
+	ktime_t now = ktime_get();
+	u32 target, depth;
+	s32 d;
+
+	if (ch->jb_lastrx) {
+		d = (s32)ktime_us_delta(now, ch->jb_lastrx)
+			- ((s32)(rx_counter - ch->jb_lasttb)) * 125;
+		if (d < 0)
+			d = -d;
+		ch->jb_jitter += (d - (s32)ch->jb_jitter) >> 4;
+	}
+	ch->jb_lastrx = now;
+	ch->jb_lasttb = rx_counter;
+
+	/* chunks needed to cover twice the jitter estimate */
+	target = (2 * ch->jb_jitter) / (nskb->len * 125);
+	if (target > L1OIP_JB_MAX)
+		target = L1OIP_JB_MAX;
+	ch->jb_target = target;
+
+	mISDN_HEAD_ID(nskb) = rx_counter;
+	skb_queue_tail(&ch->jb_q, nskb);
+	depth = skb_queue_len(&ch->jb_q);
+	if (depth > ch->jb_maxdepth)
+		ch->jb_maxdepth = depth;
+
+	/* deliver, at most two chunks, so draining is gradual */
+	d = 2;
+	while (skb_queue_len(&ch->jb_q) > ch->jb_target && d--) {
+		skb = skb_dequeue(&ch->jb_q);
+		queue_ch_frame(&bch->ch, PH_DATA_IND, mISDN_HEAD_ID(skb),
+			       skb);
+	}
+}
+
+
 /*
  * receive channel data from socket
  */
@@ -365,6 +682,7 @@ l1oip_socket_recv(struct l1oip *hc, u8 remotecodec, u8 channel, u16 timebase,
 		  u8 *buf, int len)
 {
 	struct sk_buff *nskb;
+	struct l1oip_chan *ch;
 	struct bchannel *bch;
 	struct dchannel *dch;
 	u8 *p;
@@ -381,13 +699,13 @@ l1oip_socket_recv(struct l1oip *hc, u8 remotecodec, u8 channel, u16 timebase,
 		printk(KERN_DEBUG "%s: received data, sending to mISDN (%d)\n",
 		       __func__, len);
 
-	if (channel < 1 || channel > 127) {
-		printk(KERN_WARNING "%s: packet error - channel %d out of "
-		       "range\n", __func__, channel);
-		return;
-	}
-	dch = hc->chan[channel].dch;
-	bch = hc->chan[channel].bch;
+	/* the channel number is 7 bits on the wire, so it always indexes
+	 * within chan[]; slots that init_card() did not populate have
+	 * both channel pointers unset (this includes channel 0)
+	 */
+	ch = &hc->chan[channel];
+	dch = ch->dch;
+	bch = ch->bch;
 	if (!dch && !bch) {
 		printk(KERN_WARNING "%s: packet error - channel %d not in "
 		       "stack\n", __func__, channel);
@@ -395,12 +713,12 @@ l1oip_socket_recv(struct l1oip *hc, u8 remotecodec, u8 channel, u16 timebase,
 	}
 
 	/* prepare message */
-	nskb = mI_alloc_skb((remotecodec == 3) ? (len << 1) : len, GFP_ATOMIC);
+	nskb = mI_alloc_skb((remotecodec >= 3) ? (len << 1) : len, GFP_ATOMIC);
 	if (!nskb) {
 		printk(KERN_ERR "%s: No mem for skb.\n", __func__);
 		return;
 	}
-	p = skb_put(nskb, (remotecodec == 3) ? (len << 1) : len);
+	p = skb_put(nskb, (remotecodec >= 3) ? (len << 1) : len);
 
 	if (remotecodec == 1 && ulaw)
 		l1oip_alaw_to_ulaw(buf, len, p);
@@ -408,6 +726,8 @@ l1oip_socket_recv(struct l1oip *hc, u8 remotecodec, u8 channel, u16 timebase,
 		l1oip_ulaw_to_alaw(buf, len, p);
 	else if (remotecodec == 3)
 		len = l1oip_4bit_to_law(buf, len, p);
+	else if (remotecodec == 4)
+		len = l1oip_g726_to_law(buf, len, p, &ch->g726_rx);
 	else
 		memcpy(p, buf, len);
 
@@ -418,7 +738,7 @@ l1oip_socket_recv(struct l1oip *hc, u8 remotecodec, u8 channel, u16 timebase,
 	}
 	if (bch) {
 		/* expand 16 bit sequence number to 32 bit sequence number */
-		rx_counter = hc->chan[channel].rx_counter;
+		rx_counter = ch->rx_counter;
 		if (((s16)(timebase - rx_counter)) >= 0) {
 			/* time has changed forward */
 			if (timebase >= (rx_counter & 0xffff))
@@ -436,17 +756,41 @@ l1oip_socket_recv(struct l1oip *hc, u8 remotecodec, u8 channel, u16 timebase,
 				rx_counter = ((rx_counter & 0xffff0000) - 0x10000)
 					| timebase;
 		}
-		hc->chan[channel].rx_counter = rx_counter;
+		/* account loss and reordering; the counters are written
+		 * only by the socket thread receiving this channel, so no
+		 * locking is needed
+		 */
+		if (ch->rx_chunks) {
+			s32 gap = (s32)(rx_counter - ch->rx_counter) - len;
+			u32 run, bucket;
+
+			if (gap > 0) {
+				run = (gap + len - 1) / len;
+				ch->rx_lost += run;
+				ch->rx_loss_events++;
+				bucket = min(fls(run),
+					     L1OIP_STAT_BUCKETS) - 1;
+				ch->loss_hist[bucket]++;
+			} else if (gap < 0) {
+				run = ((-gap) + len - 1) / len;
+				ch->rx_reorder++;
+				bucket = min(fls(run),
+					     L1OIP_STAT_BUCKETS) - 1;
+				ch->reorder_hist[bucket]++;
+			}
+		}
+		ch->rx_chunks++;
+		ch->rx_counter = rx_counter;
 
 #ifdef REORDER_DEBUG
-		if (hc->chan[channel].disorder_flag) {
-			swap(hc->chan[channel].disorder_skb, nskb);
-			swap(hc->chan[channel].disorder_cnt, rx_counter);
+		if (ch->disorder_flag) {
+			swap(ch->disorder_skb, nskb);
+			swap(ch->disorder_cnt, rx_counter);
 		}
-		hc->chan[channel].disorder_flag ^= 1;
+		ch->disorder_flag ^= 1;
 		if (nskb)
 #endif
-			queue_ch_frame(&bch->ch, PH_DATA_IND, rx_counter, nskb);
+			l1oip_jitter_recv(ch, bch, rx_counter, nskb);
 	}
 }
 
@@ -455,8 +799,10 @@ l1oip_socket_recv(struct l1oip *hc, u8 remotecodec, u8 channel, u16 timebase,
  * parse frame and extract channel data
  */
 static void
-l1oip_socket_parse(struct l1oip *hc, struct sockaddr_in *sin, u8 *buf, int len)
+l1oip_socket_parse(struct l1oip_socket *ls, struct sockaddr_in *sin, u8 *buf,
+		   int len)
 {
+	struct l1oip		*hc = ls->hc;
 	u32			packet_id;
 	u8			channel;
 	u8			remotecodec;
@@ -500,7 +846,7 @@ l1oip_socket_parse(struct l1oip *hc, struct sockaddr_in *sin, u8 *buf, int len)
 
 	/* check coding */
 	remotecodec = (*buf) & 0x0f;
-	if (remotecodec > 3) {
+	if (remotecodec > 4) {
 		printk(KERN_WARNING "%s: packet error - remotecodec %d "
 		       "unsupported\n", __func__, remotecodec);
 		return;
@@ -615,24 +961,21 @@ multiframe:
 		goto multiframe;
 
 	/* restart timer */
-	if (time_before(hc->timeout_tl.expires, jiffies + 5 * HZ) || !hc->timeout_on) {
-		hc->timeout_on = 1;
-		mod_timer(&hc->timeout_tl, jiffies + L1OIP_TIMEOUT * HZ);
-	} else /* only adjust timer */
-		hc->timeout_tl.expires = jiffies + L1OIP_TIMEOUT * HZ;
+	hc->timeout_to = jiffies + L1OIP_TIMEOUT * HZ;
+	hc->timeout_on = 1;
 
 	/* if ip or source port changes */
-	if ((hc->sin_remote.sin_addr.s_addr != sin->sin_addr.s_addr)
-	    || (hc->sin_remote.sin_port != sin->sin_port)) {
+	if ((ls->sin_remote.sin_addr.s_addr != sin->sin_addr.s_addr)
+	    || (ls->sin_remote.sin_port != sin->sin_port)) {
 		if (debug & DEBUG_L1OIP_SOCKET)
 			printk(KERN_DEBUG "%s: remote address changes from "
 			       "0x%08x to 0x%08x (port %d to %d)\n", __func__,
-			       ntohl(hc->sin_remote.sin_addr.s_addr),
+			       ntohl(ls->sin_remote.sin_addr.s_addr),
 			       ntohl(sin->sin_addr.s_addr),
-			       ntohs(hc->sin_remote.sin_port),
+			       ntohs(ls->sin_remote.sin_port),
 			       ntohs(sin->sin_port));
-		hc->sin_remote.sin_addr.s_addr = sin->sin_addr.s_addr;
-		hc->sin_remote.sin_port = sin->sin_port;
+		ls->sin_remote.sin_addr.s_addr = sin->sin_addr.s_addr;
+		ls->sin_remote.sin_port = sin->sin_port;
 	}
 }
 
@@ -643,7 +986,8 @@ multiframe:
 static int
 l1oip_socket_thread(void *data)
 {
-	struct l1oip *hc = (struct l1oip *)data;
+	struct l1oip_socket *ls = (struct l1oip_socket *)data;
+	struct l1oip *hc = ls->hc;
 	int ret = 0;
 	struct sockaddr_in sin_rx;
 	struct kvec iov;
@@ -676,21 +1020,23 @@ l1oip_socket_thread(void *data)
 		goto fail;
 	}
 
-	/* set incoming address */
-	hc->sin_local.sin_family = AF_INET;
-	hc->sin_local.sin_addr.s_addr = INADDR_ANY;
-	hc->sin_local.sin_port = htons((unsigned short)hc->localport);
+	/* set incoming address, each socket binds to its own port */
+	ls->sin_local.sin_family = AF_INET;
+	ls->sin_local.sin_addr.s_addr = INADDR_ANY;
+	ls->sin_local.sin_port = htons((unsigned short)
+				       (hc->localport + ls->idx));
 
 	/* set outgoing address */
-	hc->sin_remote.sin_family = AF_INET;
-	hc->sin_remote.sin_addr.s_addr = htonl(hc->remoteip);
-	hc->sin_remote.sin_port = htons((unsigned short)hc->remoteport);
+	ls->sin_remote.sin_family = AF_INET;
+	ls->sin_remote.sin_addr.s_addr = htonl(hc->remoteip);
+	ls->sin_remote.sin_port = htons((unsigned short)
+					(hc->remoteport + ls->idx));
 
 	/* bind to incoming port */
-	if (socket->ops->bind(socket, (struct sockaddr *)&hc->sin_local,
-			      sizeof(hc->sin_local))) {
+	if (socket->ops->bind(socket, (struct sockaddr *)&ls->sin_local,
+			      sizeof(ls->sin_local))) {
 		printk(KERN_ERR "%s: Failed to bind socket to port %d.\n",
-		       __func__, hc->localport);
+		       __func__, hc->localport + ls->idx);
 		ret = -EINVAL;
 		goto fail;
 	}
@@ -703,15 +1049,15 @@ l1oip_socket_thread(void *data)
 	}
 
 	/* build send message */
-	hc->sendmsg.msg_name = &hc->sin_remote;
-	hc->sendmsg.msg_namelen = sizeof(hc->sin_remote);
-	hc->sendmsg.msg_control = NULL;
-	hc->sendmsg.msg_controllen = 0;
+	ls->sendmsg.msg_name = &ls->sin_remote;
+	ls->sendmsg.msg_namelen = sizeof(ls->sin_remote);
+	ls->sendmsg.msg_control = NULL;
+	ls->sendmsg.msg_controllen = 0;
 
 	/* give away socket */
-	spin_lock(&hc->socket_lock);
-	hc->socket = socket;
-	spin_unlock(&hc->socket_lock);
+	spin_lock(&ls->socket_lock);
+	ls->socket = socket;
+	spin_unlock(&ls->socket_lock);
 
 	/* read loop */
 	if (debug & DEBUG_L1OIP_SOCKET)
@@ -721,7 +1067,7 @@ l1oip_socket_thread(void *data)
 		iov_iter_kvec(&msg.msg_iter, READ, &iov, 1, recvbuf_size);
 		recvlen = sock_recvmsg(socket, &msg, 0);
 		if (recvlen > 0) {
-			l1oip_socket_parse(hc, &sin_rx, recvbuf, recvlen);
+			l1oip_socket_parse(ls, &sin_rx, recvbuf, recvlen);
 		} else {
 			if (debug & DEBUG_L1OIP_SOCKET)
 				printk(KERN_WARNING
@@ -730,15 +1076,15 @@ l1oip_socket_thread(void *data)
 	}
 
 	/* get socket back, check first if in use, maybe by send function */
-	spin_lock(&hc->socket_lock);
-	/* if hc->socket is NULL, it is in use until it is given back */
-	while (!hc->socket) {
-		spin_unlock(&hc->socket_lock);
+	spin_lock(&ls->socket_lock);
+	/* if ls->socket is NULL, it is in use until it is given back */
+	while (!ls->socket) {
+		spin_unlock(&ls->socket_lock);
 		schedule_timeout(HZ / 10);
-		spin_lock(&hc->socket_lock);
+		spin_lock(&ls->socket_lock);
 	}
-	hc->socket = NULL;
-	spin_unlock(&hc->socket_lock);
+	ls->socket = NULL;
+	spin_unlock(&ls->socket_lock);
 
 	if (debug & DEBUG_L1OIP_SOCKET)
 		printk(KERN_DEBUG "%s: socket thread terminating\n",
@@ -753,8 +1099,8 @@ fail:
 		sock_release(socket);
 
 	/* if we got killed, signal completion */
-	complete(&hc->socket_complete);
-	hc->socket_thread = NULL; /* show termination of thread */
+	complete(&ls->socket_complete);
+	ls->socket_thread = NULL; /* show termination of thread */
 
 	if (debug & DEBUG_L1OIP_SOCKET)
 		printk(KERN_DEBUG "%s: socket thread terminated\n",
@@ -766,14 +1112,19 @@ static void
 l1oip_socket_close(struct l1oip *hc)
 {
 	struct dchannel *dch = hc->chan[hc->d_idx].dch;
-
-	/* kill thread */
-	if (hc->socket_thread) {
+	struct l1oip_socket *ls;
+	int i;
+
+	/* kill threads */
+	for (i = 0; i < hc->num_sockets; i++) {
+		ls = &hc->sock[i];
+		if (!ls->socket_thread)
+			continue;
 		if (debug & DEBUG_L1OIP_SOCKET)
-			printk(KERN_DEBUG "%s: socket thread exists, "
-			       "killing...\n", __func__);
-		send_sig(SIGTERM, hc->socket_thread, 0);
-		wait_for_completion(&hc->socket_complete);
+			printk(KERN_DEBUG "%s: socket thread %d exists, "
+			       "killing...\n", __func__, i);
+		send_sig(SIGTERM, ls->socket_thread, 0);
+		wait_for_completion(&ls->socket_complete);
 	}
 
 	/* if active, we send up a PH_DEACTIVATE and deactivate */
@@ -790,24 +1141,30 @@ l1oip_socket_close(struct l1oip *hc)
 static int
 l1oip_socket_open(struct l1oip *hc)
 {
+	struct l1oip_socket *ls;
+	int i;
+
 	/* in case of reopen, we need to close first */
 	l1oip_socket_close(hc);
 
-	init_completion(&hc->socket_complete);
-
-	/* create receive process */
-	hc->socket_thread = kthread_run(l1oip_socket_thread, hc, "l1oip_%s",
-					hc->name);
-	if (IS_ERR(hc->socket_thread)) {
-		int err = PTR_ERR(hc->socket_thread);
-		printk(KERN_ERR "%s: Failed (%d) to create socket process.\n",
-		       __func__, err);
-		hc->socket_thread = NULL;
-		sock_release(hc->socket);
-		return err;
+	/* create receive processes */
+	for (i = 0; i < hc->num_sockets; i++) {
+		ls = &hc->sock[i];
+		init_completion(&ls->socket_complete);
+		ls->socket_thread = kthread_run(l1oip_socket_thread, ls,
+						"l1oip_%s.%d", hc->name, i);
+		if (IS_ERR(ls->socket_thread)) {
+			int err = PTR_ERR(ls->socket_thread);
+			printk(KERN_ERR "%s: Failed (%d) to create socket "
+			       "process.\n", __func__, err);
+			ls->socket_thread = NULL;
+			l1oip_socket_close(hc);
+			return err;
+		}
 	}
 	if (debug & DEBUG_L1OIP_SOCKET)
-		printk(KERN_DEBUG "%s: socket thread created\n", __func__);
+		printk(KERN_DEBUG "%s: %d socket thread(s) created\n",
+		       __func__, hc->num_sockets);
 
 	return 0;
 }
@@ -829,21 +1186,18 @@ l1oip_send_bh(struct work_struct *work)
 
 /*
  * timer stuff
+ *
+ * One shared timer ticks once per second and walks all instances.  The
+ * transmit and receive paths only store new expiry values, so they do
+ * not touch the timer wheel for every packet.
  */
-static void
-l1oip_keepalive(struct timer_list *t)
-{
-	struct l1oip *hc = from_timer(hc, t, keep_tl);
-
-	schedule_work(&hc->workq);
-}
+static struct timer_list l1oip_timer;
 
 static void
-l1oip_timeout(struct timer_list *t)
+l1oip_timeout(struct l1oip *hc)
 {
-	struct l1oip			*hc = from_timer(hc, t,
-								  timeout_tl);
 	struct dchannel		*dch = hc->chan[hc->d_idx].dch;
+	int			i;
 
 	if (debug & DEBUG_L1OIP_MSG)
 		printk(KERN_DEBUG "%s: timeout timer expired, turn layer one "
@@ -866,10 +1220,30 @@ l1oip_timeout(struct timer_list *t)
 		if (debug & DEBUG_L1OIP_MSG)
 			printk(KERN_DEBUG "%s: on demand causes ip address to "
 			       "be removed\n", __func__);
-		hc->sin_remote.sin_addr.s_addr = 0;
+		for (i = 0; i < hc->num_sockets; i++)
+			hc->sock[i].sin_remote.sin_addr.s_addr = 0;
 	}
 }
 
+static void
+l1oip_timer_tick(struct timer_list *t)
+{
+	struct l1oip *hc;
+
+	spin_lock(&l1oip_lock);
+	list_for_each_entry(hc, &l1oip_ilist, list) {
+		if (time_after_eq(jiffies, hc->keep_to)) {
+			hc->keep_to = jiffies + L1OIP_KEEPALIVE * HZ;
+			schedule_work(&hc->workq);
+		}
+		if (hc->timeout_on && time_after_eq(jiffies, hc->timeout_to))
+			l1oip_timeout(hc);
+	}
+	spin_unlock(&l1oip_lock);
+
+	mod_timer(&l1oip_timer, jiffies + HZ);
+}
+
 
 /*
  * message handling
@@ -1162,6 +1536,8 @@ handle_bmsg(struct mISDNchannel *ch, struct sk_buff *skb)
 			printk(KERN_DEBUG "%s: PH_ACTIVATE channel %d (1..%d)\n"
 			       , __func__, bch->slot, hc->b_num + 1);
 		hc->chan[bch->slot].codecstate = 0;
+		l1oip_g726_init(&hc->chan[bch->slot].g726_tx);
+		l1oip_g726_init(&hc->chan[bch->slot].g726_rx);
 		test_and_set_bit(FLG_ACTIVE, &bch->Flags);
 		skb_trim(skb, 0);
 		queue_ch_frame(ch, PH_ACTIVATE_IND, hh->id, skb);
@@ -1213,6 +1589,7 @@ static int
 l1oip_bctrl(struct mISDNchannel *ch, u_int cmd, void *arg)
 {
 	struct bchannel	*bch = container_of(ch, struct bchannel, ch);
+	struct l1oip	*hc;
 	int		err = -EINVAL;
 
 	if (bch->debug & DEBUG_HW)
@@ -1224,6 +1601,11 @@ l1oip_bctrl(struct mISDNchannel *ch, u_int cmd, void *arg)
 		test_and_clear_bit(FLG_ACTIVE, &bch->Flags);
 		ch->protocol = ISDN_P_NONE;
 		ch->peer = NULL;
+		hc = bch->hw;
+		skb_queue_purge(&hc->chan[bch->nr].jb_q);
+		hc->chan[bch->nr].jb_jitter = 0;
+		hc->chan[bch->nr].jb_target = 0;
+		hc->chan[bch->nr].jb_lastrx = 0;
 		module_put(THIS_MODULE);
 		err = 0;
 		break;
@@ -1246,16 +1628,24 @@ release_card(struct l1oip *hc)
 {
 	int	ch;
 
-	if (timer_pending(&hc->keep_tl))
-		del_timer(&hc->keep_tl);
+	/* remove from list first, so the shared timer lets us alone */
+	spin_lock(&l1oip_lock);
+	list_del(&hc->list);
+	spin_unlock(&l1oip_lock);
+
+	debugfs_remove_recursive(hc->dbg);
 
-	if (timer_pending(&hc->timeout_tl))
-		del_timer(&hc->timeout_tl);
+	if (timer_pending(&hc->bundle_tl))
+		del_timer(&hc->bundle_tl);
 
 	cancel_work_sync(&hc->workq);
+	/* the flush re-arms the timer while the socket is seized and the
+	 * timer only schedules the flush, so stop them in this order
+	 */
+	cancel_work_sync(&hc->bundle_work);
+	del_timer_sync(&hc->bundle_tl);
 
-	if (hc->socket_thread)
-		l1oip_socket_close(hc);
+	l1oip_socket_close(hc);
 
 	if (hc->registered && hc->chan[hc->d_idx].dch)
 		mISDN_unregister_device(&hc->chan[hc->d_idx].dch->dev);
@@ -1265,6 +1655,7 @@ release_card(struct l1oip *hc)
 			kfree(hc->chan[ch].dch);
 		}
 		if (hc->chan[ch].bch) {
+			skb_queue_purge(&hc->chan[ch].jb_q);
 			mISDN_freebchannel(hc->chan[ch].bch);
 			kfree(hc->chan[ch].bch);
 #ifdef REORDER_DEBUG
@@ -1274,10 +1665,8 @@ release_card(struct l1oip *hc)
 		}
 	}
 
-	spin_lock(&l1oip_lock);
-	list_del(&hc->list);
-	spin_unlock(&l1oip_lock);
-
+	kfree(hc->bundle_buf);
+	kfree(hc->bundle_tx);
 	kfree(hc);
 }
 
@@ -1286,10 +1675,16 @@ l1oip_cleanup(void)
 {
 	struct l1oip *hc, *next;
 
+	del_timer_sync(&l1oip_timer);
+
 	list_for_each_entry_safe(hc, next, &l1oip_ilist, list)
 		release_card(hc);
 
+	debugfs_remove_recursive(l1oip_dbg_root);
+	l1oip_dbg_root = NULL;
+
 	l1oip_4bit_free();
+	l1oip_g726_free();
 }
 
 
@@ -1304,12 +1699,33 @@ init_card(struct l1oip *hc, int pri, int bundle)
 	int		ret;
 	int		i, ch;
 
-	spin_lock_init(&hc->socket_lock);
+	spin_lock_init(&hc->bundle_lock);
+	hc->num_sockets = sockets[l1oip_cnt];
+	if (hc->num_sockets < 1)
+		hc->num_sockets = 1;
+	if (hc->num_sockets > L1OIP_MAX_SOCKETS) {
+		printk(KERN_ERR "Given sockets(%d) exceed maximum of %d.\n",
+		       hc->num_sockets, L1OIP_MAX_SOCKETS);
+		return -EINVAL;
+	}
+	for (i = 0; i < L1OIP_MAX_SOCKETS; i++) {
+		hc->sock[i].hc = hc;
+		hc->sock[i].idx = i;
+		spin_lock_init(&hc->sock[i].socket_lock);
+	}
 	hc->idx = l1oip_cnt;
 	hc->pri = pri;
 	hc->d_idx = pri ? 16 : 3;
 	hc->b_num = pri ? 30 : 2;
 	hc->bundle = bundle;
+	if (hc->bundle) {
+		hc->bundle_buf = kmalloc(L1OIP_BUNDLE_HEADROOM
+					 + L1OIP_MAX_PERFRAME, GFP_KERNEL);
+		hc->bundle_tx = kmalloc(L1OIP_BUNDLE_HEADROOM
+					+ L1OIP_MAX_PERFRAME, GFP_KERNEL);
+		if (!hc->bundle_buf || !hc->bundle_tx)
+			return -ENOMEM;
+	}
 	if (hc->pri)
 		sprintf(hc->name, "l1oip-e1.%d", l1oip_cnt + 1);
 	else
@@ -1320,6 +1736,7 @@ init_card(struct l1oip *hc, int pri, int bundle)
 	case 1: /* alaw */
 	case 2: /* ulaw */
 	case 3: /* 4bit */
+	case 4: /* G.726 */
 		break;
 	default:
 		printk(KERN_ERR "Codec(%d) not supported.\n",
@@ -1420,6 +1837,7 @@ init_card(struct l1oip *hc, int pri, int bundle)
 		bch->ch.nr = i + ch;
 		list_add(&bch->ch.list, &dch->dev.bchannels);
 		hc->chan[i + ch].bch = bch;
+		skb_queue_head_init(&hc->chan[i + ch].jb_q);
 		set_channelmap(bch->nr, dch->dev.channelmap);
 	}
 	/* TODO: create a parent device for this driver */
@@ -1435,13 +1853,14 @@ init_card(struct l1oip *hc, int pri, int bundle)
 	if (ret)
 		return ret;
 
-	timer_setup(&hc->keep_tl, l1oip_keepalive, 0);
-	hc->keep_tl.expires = jiffies + 2 * HZ; /* two seconds first time */
-	add_timer(&hc->keep_tl);
-
-	timer_setup(&hc->timeout_tl, l1oip_timeout, 0);
+	hc->keep_to = jiffies + 2 * HZ; /* two seconds first time */
 	hc->timeout_on = 0; /* state that we have timer off */
 
+	hc->dbg = debugfs_create_dir(hc->name, l1oip_dbg_root);
+	debugfs_create_file("stats", 0444, hc->dbg, hc, &l1oip_stats_fops);
+
+	timer_setup(&hc->bundle_tl, l1oip_bundle_timeout, 0);
+
 	return 0;
 }
 
@@ -1457,10 +1876,17 @@ l1oip_init(void)
 
 	INIT_LIST_HEAD(&l1oip_ilist);
 	spin_lock_init(&l1oip_lock);
+	timer_setup(&l1oip_timer, l1oip_timer_tick, 0);
+	l1oip_dbg_root = debugfs_create_dir("l1oip", NULL);
 
 	if (l1oip_4bit_alloc(ulaw))
 		return -ENOMEM;
 
+	if (l1oip_g726_alloc(ulaw)) {
+		l1oip_4bit_free();
+		return -ENOMEM;
+	}
+
 	l1oip_cnt = 0;
 	while (l1oip_cnt < MAX_CARDS && type[l1oip_cnt]) {
 		switch (type[l1oip_cnt] & 0xff) {
@@ -1500,6 +1926,7 @@ l1oip_init(void)
 			return -ENOMEM;
 		}
 		INIT_WORK(&hc->workq, (void *)l1oip_send_bh);
+		INIT_WORK(&hc->bundle_work, l1oip_bundle_bh);
 
 		spin_lock(&l1oip_lock);
 		list_add_tail(&hc->list, &l1oip_ilist);
@@ -1513,6 +1940,8 @@ l1oip_init(void)
 
 		l1oip_cnt++;
 	}
+	if (l1oip_cnt)
+		mod_timer(&l1oip_timer, jiffies + HZ);
 	printk(KERN_INFO "%d virtual devices registered\n", l1oip_cnt);
 	return 0;
 }
@@ -406,6 +406,8 @@ create_l1(struct dchannel *dch, dchannel_l1callback *dcb) {
 }
 EXPORT_SYMBOL(create_l1);
 
+static FSMFNPTR l1s_jumpmatrix[L1S_STATE_COUNT * L1_EVENT_COUNT] __read_mostly;
+
 int
 l1_init(u_int *deb)
 {
@@ -414,7 +416,8 @@ l1_init(u_int *deb)
 	l1fsm_s.event_count = L1_EVENT_COUNT;
 	l1fsm_s.strEvent = strL1Event;
 	l1fsm_s.strState = strL1SState;
-	return mISDN_FsmNew(&l1fsm_s, L1SFnList, ARRAY_SIZE(L1SFnList));
+	return mISDN_FsmStatic(&l1fsm_s, L1SFnList, ARRAY_SIZE(L1SFnList),
+			       l1s_jumpmatrix);
 }
 
 void
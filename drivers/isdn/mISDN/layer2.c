@@ -23,6 +23,11 @@
 
 static u_int *debug;
 
+/* per datalink objects come and go with every call at high churn, so
+ * they live in their own cache instead of the generic kmalloc pools
+ */
+static struct kmem_cache *l2cache;
+
 static
 struct Fsm l2fsm = {NULL, 0, 0, NULL, NULL};
 
@@ -63,9 +68,10 @@ enum {
 	EV_L2_SET_OWN_BUSY,
 	EV_L2_CLEAR_OWN_BUSY,
 	EV_L2_FRAME_ERROR,
+	EV_L2_ACK_TIM,
 };
 
-#define L2_EVENT_COUNT (EV_L2_FRAME_ERROR + 1)
+#define L2_EVENT_COUNT (EV_L2_ACK_TIM + 1)
 
 static char *strL2Event[] =
 {
@@ -93,6 +99,7 @@ static char *strL2Event[] =
 	"EV_L2_SET_OWN_BUSY",
 	"EV_L2_CLEAR_OWN_BUSY",
 	"EV_L2_FRAME_ERROR",
+	"EV_L2_ACK_TIM",
 };
 
 static void
@@ -341,15 +348,6 @@ clear_peer_busy(struct layer2 *l2) {
 		test_and_clear_bit(FLG_L2BLOCK, &l2->flag);
 }
 
-static void
-InitWin(struct layer2 *l2)
-{
-	int i;
-
-	for (i = 0; i < MAX_WINDOW; i++)
-		l2->windowar[i] = NULL;
-}
-
 static int
 freewin(struct layer2 *l2)
 {
@@ -1313,8 +1311,10 @@ l2_got_iframe(struct FsmInst *fi, int event, void *arg)
 			test_and_clear_bit(FLG_REJEXC, &l2->flag);
 			if (PollFlag)
 				enquiry_response(l2);
+			else if (test_and_set_bit(FLG_ACK_PEND, &l2->flag))
+				l2->ack_cnt++;
 			else
-				test_and_set_bit(FLG_ACK_PEND, &l2->flag);
+				l2->ack_cnt = 1;
 			skb_pull(skb, l2headersize(l2, 0));
 			l2up(l2, DL_DATA_IND, skb);
 		} else {
@@ -1346,6 +1346,27 @@ l2_got_iframe(struct FsmInst *fi, int event, void *arg)
 	}
 	if (skb_queue_len(&l2->i_queue) && (fi->state == ST_L2_7))
 		mISDN_FsmEvent(fi, EV_L2_ACK_PULL, NULL);
+	if (test_bit(FLG_ACK_PEND, &l2->flag)) {
+		/* with delayed acks enabled hold the RR back for up to
+		 * ack_delay ms or ack_batch frames (bounded by the
+		 * window), so a burst of I-frames costs one response;
+		 * outgoing I-frames still piggyback the ack at once
+		 */
+		if (l2->ack_delay && l2->ack_cnt < l2->ack_batch &&
+		    l2->ack_cnt < l2->window) {
+			mISDN_FsmAddTimer(&l2->ackt, l2->ack_delay,
+					  EV_L2_ACK_TIM, NULL, 12);
+		} else if (test_and_clear_bit(FLG_ACK_PEND, &l2->flag))
+			enquiry_cr(l2, RR, RSP, 0);
+	}
+}
+
+static void
+l2_ack_tim(struct FsmInst *fi, int event, void *arg)
+{
+	struct layer2	*l2 = fi->userdata;
+
+	/* the ack may already have left piggybacked on an I-frame */
 	if (test_and_clear_bit(FLG_ACK_PEND, &l2->flag))
 		enquiry_cr(l2, RR, RSP, 0);
 }
@@ -1492,9 +1513,29 @@ l2_pull_iqueue(struct FsmInst *fi, int event, void *arg)
 		header[i++] = l2->vr << 1;
 	} else
 		header[i++] = (l2->vr << 5) | (l2->vs << 1);
-	nskb = skb_realloc_headroom(skb, i);
+	/* all senders reserve L2 headroom, so normally the header fits
+	 * in front of a clone and the data is never copied; the frame
+	 * kept in windowar shares it, retransmissions just clone again.
+	 * If an earlier clone is still out (a retransmission while the
+	 * driver still queues the first copy), its header lives in that
+	 * shared headroom, so copy instead of rewriting it in flight,
+	 * like tcp_transmit_skb() does
+	 */
+	if (skb_cloned(skb))
+		nskb = skb_realloc_headroom(skb, i);
+	else
+		nskb = skb_clone(skb, GFP_ATOMIC);
+	if (nskb && skb_headroom(nskb) < i) {
+		printk(KERN_WARNING "%s: only %d byte headroom(%d) "
+		       "for IFrame, need copy\n", mISDNDevName4ch(&l2->ch),
+		       skb_headroom(nskb), i);
+		if (l2->ch.st)
+			l2->ch.st->stats.hdr_realloc++;
+		dev_kfree_skb(nskb);
+		nskb = skb_realloc_headroom(skb, i);
+	}
 	if (!nskb) {
-		printk(KERN_WARNING "%s: no headroom(%d) copy for IFrame\n",
+		printk(KERN_WARNING "%s: no headroom(%d) clone for IFrame\n",
 		       mISDNDevName4ch(&l2->ch), i);
 		skb_queue_head(&l2->i_queue, skb);
 		return;
@@ -1844,6 +1885,8 @@ static struct FsmNode L2FnList[] =
 	{ST_L2_7, EV_L2_T200I, l2_st7_tout_200},
 	{ST_L2_8, EV_L2_T200I, l2_st8_tout_200},
 	{ST_L2_7, EV_L2_T203I, l2_st7_tout_203},
+	{ST_L2_7, EV_L2_ACK_TIM, l2_ack_tim},
+	{ST_L2_8, EV_L2_ACK_TIM, l2_ack_tim},
 	{ST_L2_7, EV_L2_ACK_PULL, l2_pull_iqueue},
 	{ST_L2_7, EV_L2_SET_OWN_BUSY, l2_set_own_busy},
 	{ST_L2_8, EV_L2_SET_OWN_BUSY, l2_set_own_busy},
@@ -2075,6 +2118,7 @@ release_l2(struct layer2 *l2)
 {
 	mISDN_FsmDelTimer(&l2->t200, 21);
 	mISDN_FsmDelTimer(&l2->t203, 16);
+	mISDN_FsmDelTimer(&l2->ackt, 22);
 	skb_queue_purge(&l2->i_queue);
 	skb_queue_purge(&l2->ui_queue);
 	skb_queue_purge(&l2->down_queue);
@@ -2085,7 +2129,39 @@ release_l2(struct layer2 *l2)
 			l2->ch.st->dev->D.ctrl(&l2->ch.st->dev->D,
 					       CLOSE_CHANNEL, NULL);
 	}
-	kfree(l2);
+	kmem_cache_free(l2cache, l2);
+}
+
+void
+free_l2(struct layer2 *l2)
+{
+	kmem_cache_free(l2cache, l2);
+}
+
+static int
+l2_cctrl(struct layer2 *l2, struct mISDN_ctrl_req *cq)
+{
+	switch (cq->op) {
+	case MISDN_CTRL_GETOP:
+		cq->op = MISDN_CTRL_L2_ACK_DELAY;
+		break;
+	case MISDN_CTRL_L2_ACK_DELAY:
+		/* p1: delay in ms (0 = acknowledge each I-frame at
+		 * once), p2: acknowledge latest after p2 frames; the
+		 * receive path additionally bounds the batch by the
+		 * window size
+		 */
+		if (cq->p1 < 0 || cq->p1 > 1000 || cq->p2 < 1)
+			return -EINVAL;
+		l2->ack_delay = cq->p1;
+		l2->ack_batch = cq->p2;
+		break;
+	default:
+		printk(KERN_WARNING "%s: %s unknown Op %x\n",
+		       mISDNDevName4ch(&l2->ch), __func__, cq->op);
+		return -EINVAL;
+	}
+	return 0;
 }
 
 static int
@@ -2099,6 +2175,8 @@ l2_ctrl(struct mISDNchannel *ch, u_int cmd, void *arg)
 		       mISDNDevName4ch(ch), __func__, cmd);
 
 	switch (cmd) {
+	case CONTROL_CHANNEL:
+		return l2_cctrl(l2, arg);
 	case OPEN_CHANNEL:
 		if (test_bit(FLG_LAPD, &l2->flag)) {
 			set_channel_address(&l2->ch, l2->sapi, l2->tei);
@@ -2123,11 +2201,13 @@ create_l2(struct mISDNchannel *ch, u_int protocol, u_long options, int tei,
 	struct layer2		*l2;
 	struct channel_req	rq;
 
-	l2 = kzalloc(sizeof(struct layer2), GFP_KERNEL);
+	l2 = kmem_cache_alloc(l2cache, GFP_KERNEL);
 	if (!l2) {
-		printk(KERN_ERR "kzalloc layer2 failed\n");
+		printk(KERN_ERR "alloc layer2 failed\n");
 		return NULL;
 	}
+	/* the queue heads past i_queue are constructor owned */
+	memset(l2, 0, offsetof(struct layer2, i_queue));
 	l2->next_id = 1;
 	l2->down_id = MISDN_ID_NONE;
 	l2->up = ch;
@@ -2198,14 +2278,9 @@ create_l2(struct mISDNchannel *ch, u_int protocol, u_long options, int tei,
 	default:
 		printk(KERN_ERR "layer2 create failed prt %x\n",
 		       protocol);
-		kfree(l2);
+		kmem_cache_free(l2cache, l2);
 		return NULL;
 	}
-	skb_queue_head_init(&l2->i_queue);
-	skb_queue_head_init(&l2->ui_queue);
-	skb_queue_head_init(&l2->down_queue);
-	skb_queue_head_init(&l2->tmp_queue);
-	InitWin(l2);
 	l2->l2m.fsm = &l2fsm;
 	if (test_bit(FLG_LAPB, &l2->flag) ||
 	    test_bit(FLG_FIXED_TEI, &l2->flag) ||
@@ -2220,6 +2295,9 @@ create_l2(struct mISDNchannel *ch, u_int protocol, u_long options, int tei,
 
 	mISDN_FsmInitTimer(&l2->l2m, &l2->t200);
 	mISDN_FsmInitTimer(&l2->l2m, &l2->t203);
+	mISDN_FsmInitTimer(&l2->l2m, &l2->ackt);
+	l2->ack_delay = 0;	/* delayed acks off by default */
+	l2->ack_batch = 1;
 	return l2;
 }
 
@@ -2244,17 +2322,35 @@ static struct Bprotocol X75SLP = {
 	.create = x75create
 };
 
+static FSMFNPTR l2_jumpmatrix[L2_STATE_COUNT * L2_EVENT_COUNT] __read_mostly;
+
+static void
+l2cache_ctor(void *obj)
+{
+	struct layer2	*l2 = obj;
+
+	skb_queue_head_init(&l2->i_queue);
+	skb_queue_head_init(&l2->ui_queue);
+	skb_queue_head_init(&l2->down_queue);
+	skb_queue_head_init(&l2->tmp_queue);
+}
+
 int
 Isdnl2_Init(u_int *deb)
 {
 	int res;
 	debug = deb;
+	l2cache = kmem_cache_create("mISDN_layer2", sizeof(struct layer2),
+				    0, SLAB_HWCACHE_ALIGN, l2cache_ctor);
+	if (!l2cache)
+		return -ENOMEM;
 	mISDN_register_Bprotocol(&X75SLP);
 	l2fsm.state_count = L2_STATE_COUNT;
 	l2fsm.event_count = L2_EVENT_COUNT;
 	l2fsm.strEvent = strL2Event;
 	l2fsm.strState = strL2State;
-	res = mISDN_FsmNew(&l2fsm, L2FnList, ARRAY_SIZE(L2FnList));
+	res = mISDN_FsmStatic(&l2fsm, L2FnList, ARRAY_SIZE(L2FnList),
+			      l2_jumpmatrix);
 	if (res)
 		goto error;
 	res = TEIInit(deb);
@@ -2266,6 +2362,8 @@ error_fsm:
 	mISDN_FsmFree(&l2fsm);
 error:
 	mISDN_unregister_Bprotocol(&X75SLP);
+	kmem_cache_destroy(l2cache);
+	l2cache = NULL;
 	return res;
 }
 
@@ -2275,4 +2373,6 @@ Isdnl2_cleanup(void)
 	mISDN_unregister_Bprotocol(&X75SLP);
 	TEIFree();
 	mISDN_FsmFree(&l2fsm);
+	kmem_cache_destroy(l2cache);
+	l2cache = NULL;
 }
@@ -25,6 +25,8 @@ struct manager {
 	struct mISDNchannel	bcast;
 	u_long			options;
 	struct list_head	layer2;
+	/* TEI indexed shortcut into the layer2 list, protected by lock */
+	struct layer2		*teiar[GROUP_TEI + 1];
 	rwlock_t		lock;
 	struct FsmInst		deact;
 	struct FsmTimer		datimer;
@@ -32,6 +34,7 @@ struct manager {
 	struct mISDNchannel	*up;
 	u_int			nextid;
 	u_int			lastid;
+	u_int			tei_rr;		/* dynamic tei round robin */
 };
 
 struct teimgr {
@@ -60,16 +63,24 @@ struct layer2 {
 	struct laddr		addr;
 	u_int			maxlen;
 	struct teimgr		*tm;
+	int			T200, N200, T203;
+	int			ack_delay;	/* ms, 0 = ack at once */
+	u_int			ack_batch;	/* ack latest after # frames */
+	u_int			next_id;
+	u_int			down_id;
+	/* state touched for every I-frame is grouped here, so the fast
+	 * path runs on few adjacent cachelines of the object */
 	u_int			vs, va, vr;
 	int			rc;
 	u_int			window;
 	u_int			sow;
+	u_int			ack_cnt;
 	struct FsmInst		l2m;
-	struct FsmTimer		t200, t203;
-	int			T200, N200, T203;
-	u_int			next_id;
-	u_int			down_id;
+	struct FsmTimer		t200, t203, ackt;
 	struct sk_buff		*windowar[MAX_WINDOW];
+	/* the queue heads are set up once by the slab constructor and
+	 * stay valid over reuse; create_l2 clears the object only up to
+	 * i_queue, so new members belong above this line */
 	struct sk_buff_head	i_queue;
 	struct sk_buff_head	ui_queue;
 	struct sk_buff_head	down_queue;
@@ -91,6 +102,7 @@ enum {
 
 extern struct layer2	*create_l2(struct mISDNchannel *, u_int,
 				   u_long, int, int);
+extern void		free_l2(struct layer2 *);
 extern int		tei_l2(struct layer2 *, u_int, u_long arg);
 
 
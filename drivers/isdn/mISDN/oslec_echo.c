@@ -224,28 +224,23 @@ static inline void
 lms_adapt_bg(struct echo_can_state_s *ec, int clean, int shift)
 {
     int i;
-
-    int offset1;
-    int offset2;
     int factor;
     int exp;
+    int16_t *phist;
 
     if (shift > 0)
 	factor = clean << shift;
     else
 	factor = clean >> -shift;
 
-    /* Update the FIR taps */
+    /* Update the FIR taps.  The mirrored filter history gives us one
+       contiguous run of samples starting at curr_pos, so this is a
+       single linear pass just like the filter itself. */
 
-    offset2 = ec->curr_pos;
-    offset1 = ec->taps - offset2;
+    phist = &ec->fir_state_bg.history[ec->curr_pos];
 
-    for (i = ec->taps - 1;  i >= offset1;  i--) {
-       exp = (ec->fir_state_bg.history[i - offset1]*factor);
-       ec->fir_taps16[1][i] += (int16_t) ((exp+(1<<14)) >> 15);
-    }
-    for (  ;  i >= 0;  i--) {
-       exp = (ec->fir_state_bg.history[i + offset2]*factor);
+    for (i = 0;  i < ec->taps;  i++) {
+       exp = phist[i]*factor;
        ec->fir_taps16[1][i] += (int16_t) ((exp+(1<<14)) >> 15);
     }
 }
@@ -64,10 +64,6 @@
    can.
 */
 
-#if defined(USE_MMX)  ||  defined(USE_SSE2)
-#include "mmx.h"
-#endif
-
 /*!
     16 bit integer FIR descriptor. This defines the working state for a single
     instance of an FIR filter using 16 bit integer coefficients.
@@ -113,26 +109,20 @@ static inline const int16_t *fir16_create(struct fir16_state *fir,
     fir->taps = taps;
     fir->curr_pos = taps - 1;
     fir->coeffs = coeffs;
-#if defined(USE_MMX)  ||  defined(USE_SSE2) || defined(__BLACKFIN_ASM__)
-    fir->history = malloc(2*taps*sizeof(int16_t));
+    /* The history is kept twice ("mirrored"), so that starting from any
+       curr_pos there is always one contiguous run of taps samples.  This
+       costs taps*2 bytes of memory but turns the filter and the adaption
+       loops into single linear passes. */
+    fir->history = (int16_t *)malloc(2*taps*sizeof(int16_t));
     if (fir->history)
 	memset(fir->history, 0, 2*taps*sizeof(int16_t));
-#else
-    fir->history = (int16_t *)malloc(taps*sizeof(int16_t));
-    if (fir->history)
-	memset(fir->history, 0, taps*sizeof(int16_t));
-#endif
     return fir->history;
 }
 /*- End of function --------------------------------------------------------*/
 
 static inline void fir16_flush(struct fir16_state *fir)
 {
-#if defined(USE_MMX)  ||  defined(USE_SSE2) || defined(__BLACKFIN_ASM__)
     memset(fir->history, 0, 2*fir->taps*sizeof(int16_t));
-#else
-    memset(fir->history, 0, fir->taps*sizeof(int16_t));
-#endif
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -175,89 +165,33 @@ static inline int32_t dot_asm(short *x, short *y, int len)
 static inline int16_t fir16(struct fir16_state *fir, int16_t sample)
 {
     int32_t y;
-#if defined(USE_MMX)
-    int i;
-    mmx_t *mmx_coeffs;
-    mmx_t *mmx_hist;
-
-    fir->history[fir->curr_pos] = sample;
-    fir->history[fir->curr_pos + fir->taps] = sample;
-
-    mmx_coeffs = (mmx_t *) fir->coeffs;
-    mmx_hist = (mmx_t *) &fir->history[fir->curr_pos];
-    i = fir->taps;
-    pxor_r2r(mm4, mm4);
-    /* 8 samples per iteration, so the filter must be a multiple of 8 long. */
-    while (i > 0) {
-	movq_m2r(mmx_coeffs[0], mm0);
-	movq_m2r(mmx_coeffs[1], mm2);
-	movq_m2r(mmx_hist[0], mm1);
-	movq_m2r(mmx_hist[1], mm3);
-	mmx_coeffs += 2;
-	mmx_hist += 2;
-	pmaddwd_r2r(mm1, mm0);
-	pmaddwd_r2r(mm3, mm2);
-	paddd_r2r(mm0, mm4);
-	paddd_r2r(mm2, mm4);
-	i -= 8;
-    }
-    movq_r2r(mm4, mm0);
-    psrlq_i2r(32, mm0);
-    paddd_r2r(mm0, mm4);
-    movd_r2m(mm4, y);
-    emms();
-#elif defined(USE_SSE2)
-    int i;
-    xmm_t *xmm_coeffs;
-    xmm_t *xmm_hist;
-
-    fir->history[fir->curr_pos] = sample;
-    fir->history[fir->curr_pos + fir->taps] = sample;
-
-    xmm_coeffs = (xmm_t *) fir->coeffs;
-    xmm_hist = (xmm_t *) &fir->history[fir->curr_pos];
-    i = fir->taps;
-    pxor_r2r(xmm4, xmm4);
-    /* 16 samples per iteration, so the filter must be a multiple of 16 long. */
-    while (i > 0) {
-	movdqu_m2r(xmm_coeffs[0], xmm0);
-	movdqu_m2r(xmm_coeffs[1], xmm2);
-	movdqu_m2r(xmm_hist[0], xmm1);
-	movdqu_m2r(xmm_hist[1], xmm3);
-	xmm_coeffs += 2;
-	xmm_hist += 2;
-	pmaddwd_r2r(xmm1, xmm0);
-	pmaddwd_r2r(xmm3, xmm2);
-	paddd_r2r(xmm0, xmm4);
-	paddd_r2r(xmm2, xmm4);
-	i -= 16;
-    }
-    movdqa_r2r(xmm4, xmm0);
-    psrldq_i2r(8, xmm0);
-    paddd_r2r(xmm0, xmm4);
-    movdqa_r2r(xmm4, xmm0);
-    psrldq_i2r(4, xmm0);
-    paddd_r2r(xmm0, xmm4);
-    movd_r2m(xmm4, y);
-#elif defined(__BLACKFIN_ASM__)
+#if defined(__BLACKFIN_ASM__)
     fir->history[fir->curr_pos] = sample;
     fir->history[fir->curr_pos + fir->taps] = sample;
     y = dot_asm((int16_t *)fir->coeffs, &fir->history[fir->curr_pos],
 	fir->taps);
 #else
     int i;
-    int offset1;
-    int offset2;
+    const int16_t *coeffs;
+    const int16_t *hist;
 
     fir->history[fir->curr_pos] = sample;
+    fir->history[fir->curr_pos + fir->taps] = sample;
 
-    offset2 = fir->curr_pos;
-    offset1 = fir->taps - offset2;
+    /* With the mirrored history the taps always see one contiguous run
+       of samples, so the dot product is a single linear reduction; the
+       four way unrolling gives the compiler independent partial
+       products to schedule (or vectorise) across the load latency. */
+    coeffs = fir->coeffs;
+    hist = &fir->history[fir->curr_pos];
     y = 0;
-    for (i = fir->taps - 1;  i >= offset1;  i--)
-	y += fir->coeffs[i]*fir->history[i - offset1];
-    for (  ;  i >= 0;  i--)
-	y += fir->coeffs[i]*fir->history[i + offset2];
+    for (i = 0;  i < fir->taps - 3;  i += 4)
+	y += coeffs[i]*hist[i]
+	    + coeffs[i + 1]*hist[i + 1]
+	    + coeffs[i + 2]*hist[i + 2]
+	    + coeffs[i + 3]*hist[i + 3];
+    for (  ;  i < fir->taps;  i++)
+	y += coeffs[i]*hist[i];
 #endif
     if (fir->curr_pos <= 0)
 	fir->curr_pos = fir->taps;
@@ -18,6 +18,9 @@
 #include <linux/mISDNif.h>
 #include <linux/slab.h>
 #include <linux/export.h>
+#include <linux/file.h>
+#include <linux/vmalloc.h>
+#include <net/busy_poll.h>
 #include "core.h"
 
 static u_int	*debug;
@@ -43,14 +46,20 @@ static struct mISDN_sock_list	base_sockets = {
 
 #define L2_HEADER_LEN	4
 
+/*
+ * reserve headroom for the LAPD header (MAX_L2HEADER_LEN) plus whatever
+ * the device announced at registration, so neither layer2 nor the
+ * hardware driver has to reallocate the frame to push its header
+ */
 static inline struct sk_buff *
-_l2_alloc_skb(unsigned int len, gfp_t gfp_mask)
+_l2_alloc_skb(struct mISDNdevice *dev, unsigned int len, gfp_t gfp_mask)
 {
 	struct sk_buff  *skb;
+	u_int		hr = L2_HEADER_LEN + (dev ? dev->headroom : 0);
 
-	skb = alloc_skb(len + L2_HEADER_LEN, gfp_mask);
+	skb = alloc_skb(len + hr, gfp_mask);
 	if (likely(skb))
-		skb_reserve(skb, L2_HEADER_LEN);
+		skb_reserve(skb, hr);
 	return skb;
 }
 
@@ -69,6 +78,45 @@ static void mISDN_sock_unlink(struct mISDN_sock_list *l, struct sock *sk)
 	write_unlock_bh(&l->lock);
 }
 
+/* copy a frame into the next mapped ring slot; the ownership flip of the
+ * status word is what publishes it to userspace
+ */
+static int
+mISDN_rxring_queue(struct mISDN_sock *msk, struct sk_buff *skb)
+{
+	struct mISDN_ring_hdr	*h;
+	u_char			*p;
+	int			err = 0;
+
+	/* the caller keeps oversized frames away from the ring */
+	if (WARN_ON_ONCE(skb->len > MISDN_RING_DATA_SIZE))
+		return -EMSGSIZE;
+	spin_lock_bh(&msk->ring_lock);
+	p = msk->rxring + msk->ring_head * MISDN_RING_SLOT_SIZE;
+	h = (struct mISDN_ring_hdr *)p;
+	if (READ_ONCE(h->status) != MISDN_RING_KERNEL) {
+		/* userspace did not keep up, drop the frame */
+		err = -ENOSPC;
+	} else {
+		p += sizeof(*h);
+		memcpy(p, mISDN_HEAD_P(skb), MISDN_HEADER_LEN);
+		skb_copy_bits(skb, 0, p + MISDN_HEADER_LEN, skb->len);
+		h->len = skb->len + MISDN_HEADER_LEN;
+		/* frame data must be visible before the status flip */
+		smp_wmb();
+		WRITE_ONCE(h->status, MISDN_RING_USER);
+		msk->ring_head++;
+		if (msk->ring_head == msk->ring_frames)
+			msk->ring_head = 0;
+	}
+	spin_unlock_bh(&msk->ring_lock);
+	if (!err) {
+		msk->sk.sk_data_ready(&msk->sk);
+		dev_kfree_skb(skb);
+	}
+	return err;
+}
+
 static int
 mISDN_send(struct mISDNchannel *ch, struct sk_buff *skb)
 {
@@ -80,7 +128,32 @@ mISDN_send(struct mISDNchannel *ch, struct sk_buff *skb)
 		printk(KERN_DEBUG "%s len %d %p\n", __func__, skb->len, skb);
 	if (msk->sk.sk_state == MISDN_CLOSED)
 		return -EUNATCH;
+	/* final checkpoint of the rx latency tracer, before the socket
+	 * code starts reusing the tail of skb->cb
+	 */
+	if (mISDN_rx_trace)
+		mISDN_lat_sample(MISDN_LAT_SOCKET, skb);
 	__net_timestamp(skb);
+	/* MISDN_CTRL_RX_BUFFER can raise the channel buffer beyond the
+	 * fixed slot payload; such frames take the regular queue below
+	 * instead of overflowing the slot
+	 */
+	if (msk->rxring && skb->len <= MISDN_RING_DATA_SIZE)
+		return mISDN_rxring_queue(msk, skb);
+	if (msk->rx_limit && skb_queue_len(&msk->sk.sk_receive_queue) >=
+	    msk->rx_limit) {
+		/* a stalled reader must not pile up frames until skb
+		 * memory pressure hits the whole box; B-channel data
+		 * loses its value with age, so make room by dropping
+		 * the oldest frame there, while signalling sockets
+		 * refuse the new one
+		 */
+		msk->rx_dropped++;
+		if (msk->sk.sk_protocol >= ISDN_P_B_START)
+			kfree_skb(skb_dequeue(&msk->sk.sk_receive_queue));
+		else
+			return -ENOBUFS;
+	}
 	err = sock_queue_rcv_skb(&msk->sk, skb);
 	if (err)
 		printk(KERN_WARNING "%s: error %d\n", __func__, err);
@@ -103,6 +176,36 @@ mISDN_ctrl(struct mISDNchannel *ch, u_int cmd, void *arg)
 	return 0;
 }
 
+#ifdef CONFIG_NET_RX_BUSY_POLL
+/*
+ * SO_BUSY_POLL support: spin on the empty receive queue for the
+ * configured time before taking the regular sleep/wakeup path, which
+ * costs a scheduler round trip per frame.  There is no NAPI context
+ * here - frames are queued directly from the driver side - so polling
+ * the queue head is all it takes
+ */
+static void
+mISDN_sock_busy_loop(struct sock *sk)
+{
+	unsigned long	start_time;
+
+	if (!READ_ONCE(sk->sk_ll_usec))
+		return;
+	start_time = busy_loop_current_time();
+	while (skb_queue_empty(&sk->sk_receive_queue)) {
+		if (sk_busy_loop_timeout(sk, start_time) ||
+		    signal_pending(current))
+			break;
+		cpu_relax();
+	}
+}
+#else
+static inline void
+mISDN_sock_busy_loop(struct sock *sk)
+{
+}
+#endif
+
 static inline void
 mISDN_sock_cmsg(struct sock *sk, struct msghdr *msg, struct sk_buff *skb)
 {
@@ -114,6 +217,56 @@ mISDN_sock_cmsg(struct sock *sk, struct msghdr *msg, struct sk_buff *skb)
 	}
 }
 
+/* drain as many queued frames into one recvmsg buffer as fit, each
+ * prefixed with its length record; only the first frame may block
+ */
+static int
+mISDN_sock_recvmsg_batch(struct sock *sk, struct msghdr *msg, size_t len,
+			 int flags)
+{
+	struct mISDN_frame_rec	rec;
+	struct sk_buff		*skb;
+	size_t			space = len, copied = 0;
+	int			err = 0, flen;
+
+	if (flags & MSG_PEEK)
+		return -EOPNOTSUPP;
+	if (!(flags & MSG_DONTWAIT))
+		mISDN_sock_busy_loop(sk);
+	skb = skb_recv_datagram(sk, flags, flags & MSG_DONTWAIT, &err);
+	if (!skb)
+		return err;
+	while (skb) {
+		flen = skb->len + MISDN_HEADER_LEN;
+		if (space < sizeof(rec) + flen) {
+			/* no room for this frame, keep it queued */
+			skb_queue_head(&sk->sk_receive_queue, skb);
+			break;
+		}
+		rec.len = flen;
+		if (memcpy_to_msg(msg, (void *)&rec, sizeof(rec))) {
+			skb_queue_head(&sk->sk_receive_queue, skb);
+			err = -EFAULT;
+			break;
+		}
+		/* the mISDN header lives in cb; copy it straight into the
+		 * iov, the payload may be shared with queued clones and
+		 * must not be written
+		 */
+		if (memcpy_to_msg(msg, mISDN_HEAD_P(skb), MISDN_HEADER_LEN) ||
+		    skb_copy_datagram_msg(skb, 0, msg, skb->len)) {
+			skb_free_datagram(sk, skb);
+			err = -EFAULT;
+			break;
+		}
+		copied += sizeof(rec) + flen;
+		space -= sizeof(rec) + flen;
+		skb_free_datagram(sk, skb);
+		skb = skb_recv_datagram(sk, flags | MSG_DONTWAIT, 1, &err);
+	}
+	return copied ? copied : err;
+}
+
 static int
 mISDN_sock_recvmsg(struct socket *sock, struct msghdr *msg, size_t len,
 		   int flags)
@@ -133,6 +286,11 @@ mISDN_sock_recvmsg(struct socket *sock, struct msghdr *msg, size_t len,
 	if (sk->sk_state == MISDN_CLOSED)
 		return 0;
 
+	if (_pms(sk)->cmask & MISDN_BATCH)
+		return mISDN_sock_recvmsg_batch(sk, msg, len, flags);
+
+	if (!(flags & MSG_DONTWAIT))
+		mISDN_sock_busy_loop(sk);
 	skb = skb_recv_datagram(sk, flags, flags & MSG_DONTWAIT, &err);
 	if (!skb)
 		return err;
@@ -163,10 +321,14 @@ mISDN_sock_recvmsg(struct socket *sock, struct msghdr *msg, size_t len,
 			skb_queue_head(&sk->sk_receive_queue, skb);
 		return -ENOSPC;
 	}
-	memcpy(skb_push(skb, MISDN_HEADER_LEN), mISDN_HEAD_P(skb),
-	       MISDN_HEADER_LEN);
-
-	err = skb_copy_datagram_msg(skb, 0, msg, copied);
+	/* the mISDN header lives in cb; copy it straight into the iov,
+	 * the payload may be shared with queued clones and must not be
+	 * written
+	 */
+	if (memcpy_to_msg(msg, mISDN_HEAD_P(skb), MISDN_HEADER_LEN))
+		err = -EFAULT;
+	else
+		err = skb_copy_datagram_msg(skb, 0, msg, skb->len);
 
 	mISDN_sock_cmsg(sk, msg, skb);
 
@@ -175,6 +337,61 @@ mISDN_sock_recvmsg(struct socket *sock, struct msghdr *msg, size_t len,
 	return err ? : copied;
 }
 
+/* queue a burst of length-prefixed frames under one socket lock */
+static int
+mISDN_sock_sendmsg_batch(struct sock *sk, struct msghdr *msg)
+{
+	struct mISDN_frame_rec	rec;
+	struct sk_buff		*skb;
+	size_t			sent = 0;
+	int			err = 0;
+
+	lock_sock(sk);
+	if (!_pms(sk)->ch.peer) {
+		release_sock(sk);
+		return -ENODEV;
+	}
+	while (msg_data_left(msg) >= sizeof(rec) + MISDN_HEADER_LEN) {
+		if (memcpy_from_msg((void *)&rec, msg, sizeof(rec))) {
+			err = -EFAULT;
+			break;
+		}
+		if (rec.len < MISDN_HEADER_LEN || rec.len > MAX_DATA_MEM ||
+		    rec.len > msg_data_left(msg)) {
+			err = -EINVAL;
+			break;
+		}
+		skb = _l2_alloc_skb(_pms(sk)->dev, rec.len, GFP_KERNEL);
+		if (!skb) {
+			err = -ENOMEM;
+			break;
+		}
+		skb_reserve(skb, MISDN_HEADER_LEN);
+		/* gather header and payload straight from the iovec,
+		 * wherever the record sits in it */
+		if (memcpy_from_msg(mISDN_HEAD_P(skb), msg,
+				    MISDN_HEADER_LEN) ||
+		    memcpy_from_msg(skb_put(skb,
+					    rec.len - MISDN_HEADER_LEN),
+				    msg, rec.len - MISDN_HEADER_LEN)) {
+			kfree_skb(skb);
+			err = -EFAULT;
+			break;
+		}
+		if ((sk->sk_protocol == ISDN_P_LAPD_TE) ||
+		    (sk->sk_protocol == ISDN_P_LAPD_NT))
+			mISDN_HEAD_ID(skb) = _pms(sk)->ch.nr;
+		err = _pms(sk)->ch.recv(_pms(sk)->ch.peer, skb);
+		if (err) {
+			kfree_skb(skb);
+			break;
+		}
+		sent += sizeof(rec) + rec.len;
+	}
+	release_sock(sk);
+	return sent ? sent : err;
+}
+
 static int
 mISDN_sock_sendmsg(struct socket *sock, struct msghdr *msg, size_t len)
 {
@@ -199,20 +416,28 @@ mISDN_sock_sendmsg(struct socket *sock, struct msghdr *msg, size_t len)
 	if (sk->sk_state != MISDN_BOUND)
 		return -EBADFD;
 
+	if (_pms(sk)->cmask & MISDN_BATCH)
+		return mISDN_sock_sendmsg_batch(sk, msg);
+
 	lock_sock(sk);
 
-	skb = _l2_alloc_skb(len, GFP_KERNEL);
+	skb = _l2_alloc_skb(_pms(sk)->dev, len, GFP_KERNEL);
 	if (!skb)
 		goto done;
-
-	if (memcpy_from_msg(skb_put(skb, len), msg, len)) {
+	skb_reserve(skb, MISDN_HEADER_LEN);
+
+	/* the iovec may deliver header and payload from separate
+	 * buffers; gather the header directly into the control block
+	 * and only the payload into the data area, so userspace needs
+	 * no pre-assembly and each byte is copied just once
+	 */
+	if (memcpy_from_msg(mISDN_HEAD_P(skb), msg, MISDN_HEADER_LEN) ||
+	    memcpy_from_msg(skb_put(skb, len - MISDN_HEADER_LEN), msg,
+			    len - MISDN_HEADER_LEN)) {
 		err = -EFAULT;
 		goto done;
 	}
 
-	memcpy(mISDN_HEAD_P(skb), skb->data, MISDN_HEADER_LEN);
-	skb_pull(skb, MISDN_HEADER_LEN);
-
 	if (msg->msg_namelen >= sizeof(struct sockaddr_mISDN)) {
 		/* if we have a address, we use it */
 		DECLARE_SOCKADDR(struct sockaddr_mISDN *, maddr, msg->msg_name);
@@ -280,6 +505,11 @@ data_sock_release(struct socket *sock)
 
 	sock_orphan(sk);
 	skb_queue_purge(&sk->sk_receive_queue);
+	if (_pms(sk)->rxring) {
+		vfree(_pms(sk)->rxring);
+		_pms(sk)->rxring = NULL;
+		_pms(sk)->ring_frames = 0;
+	}
 
 	release_sock(sk);
 	sock_put(sk);
@@ -436,6 +666,51 @@ static int data_sock_setsockopt(struct socket *sock, int level, int optname,
 		else
 			_pms(sk)->cmask &= ~MISDN_TIME_STAMP;
 		break;
+	case MISDN_BATCH:
+		if (get_user(opt, (int __user *)optval)) {
+			err = -EFAULT;
+			break;
+		}
+
+		if (opt)
+			_pms(sk)->cmask |= MISDN_BATCH;
+		else
+			_pms(sk)->cmask &= ~MISDN_BATCH;
+		break;
+	case MISDN_RX_RING:
+		if (get_user(opt, (int __user *)optval)) {
+			err = -EFAULT;
+			break;
+		}
+		if (sk->sk_state == MISDN_BOUND || _pms(sk)->rxring) {
+			/* must be set up before traffic flows */
+			err = -EBUSY;
+			break;
+		}
+		if (opt < MISDN_RING_MIN_FRAMES ||
+		    opt > MISDN_RING_MAX_FRAMES) {
+			err = -EINVAL;
+			break;
+		}
+		_pms(sk)->rxring = vmalloc_user(opt * MISDN_RING_SLOT_SIZE);
+		if (!_pms(sk)->rxring) {
+			err = -ENOMEM;
+			break;
+		}
+		_pms(sk)->ring_frames = opt;
+		_pms(sk)->ring_head = 0;
+		break;
+	case MISDN_RX_QUEUE_LIMIT:
+		if (get_user(opt, (int __user *)optval)) {
+			err = -EFAULT;
+			break;
+		}
+		if (opt < 0) {
+			err = -EINVAL;
+			break;
+		}
+		_pms(sk)->rx_limit = opt;
+		break;
 	default:
 		err = -ENOPROTOOPT;
 		break;
@@ -463,6 +738,30 @@ static int data_sock_getsockopt(struct socket *sock, int level, int optname,
 		else
 			opt = 0;
 
+		if (put_user(opt, optval))
+			return -EFAULT;
+		break;
+	case MISDN_BATCH:
+		if (_pms(sk)->cmask & MISDN_BATCH)
+			opt = 1;
+		else
+			opt = 0;
+
+		if (put_user(opt, optval))
+			return -EFAULT;
+		break;
+	case MISDN_RX_RING:
+		opt = _pms(sk)->ring_frames;
+		if (put_user(opt, optval))
+			return -EFAULT;
+		break;
+	case MISDN_RX_QUEUE_LIMIT:
+		opt = _pms(sk)->rx_limit;
+		if (put_user(opt, optval))
+			return -EFAULT;
+		break;
+	case MISDN_RX_DROPPED:
+		opt = _pms(sk)->rx_dropped;
 		if (put_user(opt, optval))
 			return -EFAULT;
 		break;
@@ -560,6 +859,59 @@ done:
 	return err;
 }
 
+static int
+data_sock_mmap(struct file *file, struct socket *sock,
+	       struct vm_area_struct *vma)
+{
+	struct sock		*sk = sock->sk;
+	unsigned long		size = vma->vm_end - vma->vm_start;
+	int			err;
+
+	lock_sock(sk);
+	if (!_pms(sk)->rxring) {
+		err = -EINVAL;
+		goto done;
+	}
+	if (size > PAGE_ALIGN(_pms(sk)->ring_frames *
+			      MISDN_RING_SLOT_SIZE)) {
+		err = -EINVAL;
+		goto done;
+	}
+	err = remap_vmalloc_range(vma, _pms(sk)->rxring, 0);
+done:
+	release_sock(sk);
+	return err;
+}
+
+static unsigned int
+data_sock_poll(struct file *file, struct socket *sock, poll_table *wait)
+{
+	struct sock		*sk = sock->sk;
+	struct mISDN_ring_hdr	*h;
+	unsigned int		mask;
+	u_int			prev;
+
+	mask = datagram_poll(file, sock, wait);
+	/* early backpressure warning: the queue is running towards its
+	 * limit, the reader should catch up before frames get dropped */
+	if (_pms(sk)->rx_limit &&
+	    skb_queue_len(&sk->sk_receive_queue) >=
+	    _pms(sk)->rx_limit - (_pms(sk)->rx_limit >> 2))
+		mask |= POLLPRI;
+	if (_pms(sk)->rxring) {
+		/* the last filled slot is the one before ring_head */
+		spin_lock_bh(&_pms(sk)->ring_lock);
+		prev = _pms(sk)->ring_head + _pms(sk)->ring_frames - 1;
+		if (prev >= _pms(sk)->ring_frames)
+			prev -= _pms(sk)->ring_frames;
+		h = _pms(sk)->rxring + prev * MISDN_RING_SLOT_SIZE;
+		if (READ_ONCE(h->status) == MISDN_RING_USER)
+			mask |= POLLIN | POLLRDNORM;
+		spin_unlock_bh(&_pms(sk)->ring_lock);
+	}
+	return mask;
+}
+
 static int
 data_sock_getname(struct socket *sock, struct sockaddr *addr,
 		  int peer)
@@ -590,7 +942,7 @@ static const struct proto_ops data_sock_ops = {
 	.getname	= data_sock_getname,
 	.sendmsg	= mISDN_sock_sendmsg,
 	.recvmsg	= mISDN_sock_recvmsg,
-	.poll		= datagram_poll,
+	.poll		= data_sock_poll,
 	.listen		= sock_no_listen,
 	.shutdown	= sock_no_shutdown,
 	.setsockopt	= data_sock_setsockopt,
@@ -598,7 +950,7 @@ static const struct proto_ops data_sock_ops = {
 	.connect	= sock_no_connect,
 	.socketpair	= sock_no_socketpair,
 	.accept		= sock_no_accept,
-	.mmap		= sock_no_mmap
+	.mmap		= data_sock_mmap
 };
 
 static int
@@ -621,6 +973,10 @@ data_sock_create(struct net *net, struct socket *sock, int protocol, int kern)
 
 	sk->sk_protocol = protocol;
 	sk->sk_state    = MISDN_OPEN;
+	_pms(sk)->rxring = NULL;
+	_pms(sk)->ring_frames = 0;
+	_pms(sk)->ring_head = 0;
+	spin_lock_init(&_pms(sk)->ring_lock);
 	mISDN_sock_link(&data_sockets, sk);
 
 	return 0;
@@ -642,6 +998,128 @@ base_sock_release(struct socket *sock)
 	return 0;
 }
 
+/*
+ * open a whole group of B-channels with one call: create, bind and
+ * optionally activate a data socket per channel in the map.  Mass call
+ * setup after a failover otherwise pays 30 socket()/bind() round trips
+ * per E1 before the first frame can flow
+ */
+static int
+base_sock_open_channels(void __user *p)
+{
+	struct mISDN_openchans	*oc;
+	struct sockaddr_mISDN	maddr;
+	struct socket		*nsock;
+	struct file		*file;
+	struct sk_buff		*skb;
+	int			i, fd, err, cnt = 0;
+
+	oc = memdup_user(p, sizeof(*oc));
+	if (IS_ERR(oc))
+		return PTR_ERR(oc);
+	if (oc->protocol < ISDN_P_B_START) {
+		kfree(oc);
+		return -EPROTONOSUPPORT;
+	}
+	for (i = 0; i <= MISDN_MAX_CHANNEL; i++) {
+		oc->fd[i] = -1;
+		if (!test_channelmap(i, oc->channelmap))
+			continue;
+		err = sock_create(PF_ISDN, SOCK_DGRAM, oc->protocol, &nsock);
+		if (err)
+			continue;
+		maddr.family = AF_ISDN;
+		maddr.dev = oc->dev;
+		maddr.channel = i;
+		maddr.sapi = 0;
+		maddr.tei = 0;
+		err = nsock->ops->bind(nsock, (struct sockaddr *)&maddr,
+				       sizeof(maddr));
+		if (err) {
+			sock_release(nsock);
+			continue;
+		}
+		if (oc->activate) {
+			skb = _alloc_mISDN_skb(PH_ACTIVATE_REQ, MISDN_ID_ANY,
+					       0, NULL, GFP_KERNEL);
+			if (skb && _pms(nsock->sk)->ch.peer) {
+				if (_pms(nsock->sk)->ch.recv(
+					    _pms(nsock->sk)->ch.peer, skb))
+					dev_kfree_skb(skb);
+			} else if (skb)
+				dev_kfree_skb(skb);
+		}
+		fd = get_unused_fd_flags(O_CLOEXEC);
+		if (fd < 0) {
+			sock_release(nsock);
+			break;
+		}
+		file = sock_alloc_file(nsock, 0, NULL);
+		if (IS_ERR(file)) {
+			/* sock_alloc_file() released the socket */
+			put_unused_fd(fd);
+			continue;
+		}
+		fd_install(fd, file);
+		oc->fd[i] = fd;
+		cnt++;
+	}
+	err = copy_to_user(p, oc, sizeof(*oc)) ? -EFAULT : cnt;
+	kfree(oc);
+	return err;
+}
+
+/* push one event record to every base socket bound to the device; the
+ * watchdog and friends call this from softirq safe contexts */
+void
+mISDN_base_event(u_int dev_id, u_int event, u_int data)
+{
+	struct mISDN_baseevent	ev;
+	struct sk_buff		*skb;
+	struct sock		*sk;
+
+	ev.event = event;
+	ev.dev = dev_id;
+	ev.data = data;
+	read_lock(&base_sockets.lock);
+	sk_for_each(sk, &base_sockets.head) {
+		if (sk->sk_state != MISDN_BOUND)
+			continue;
+		if (!_pms(sk)->dev || _pms(sk)->dev->id != dev_id)
+			continue;
+		skb = alloc_skb(sizeof(ev), GFP_ATOMIC);
+		if (!skb)
+			break;
+		skb_put_data(skb, &ev, sizeof(ev));
+		if (sock_queue_rcv_skb(sk, skb))
+			kfree_skb(skb);
+	}
+	read_unlock(&base_sockets.lock);
+}
+
+static int
+base_sock_recvmsg(struct socket *sock, struct msghdr *msg, size_t len,
+		  int flags)
+{
+	struct sock		*sk = sock->sk;
+	struct sk_buff		*skb;
+	int			copied, err;
+
+	if (flags & MSG_OOB)
+		return -EOPNOTSUPP;
+	skb = skb_recv_datagram(sk, flags, flags & MSG_DONTWAIT, &err);
+	if (!skb)
+		return err;
+	copied = skb->len;
+	if (len < copied) {
+		msg->msg_flags |= MSG_TRUNC;
+		copied = len;
+	}
+	err = skb_copy_datagram_msg(skb, 0, msg, copied);
+	skb_free_datagram(sk, skb);
+	return err ? err : copied;
+}
+
 static int
 base_sock_ioctl(struct socket *sock, unsigned int cmd, unsigned long arg)
 {
@@ -700,6 +1178,9 @@ base_sock_ioctl(struct socket *sock, unsigned int cmd, unsigned long arg)
 			err = -ENODEV;
 	}
 	break;
+	case IMOPENBCHANNELS:
+		err = base_sock_open_channels((void __user *)arg);
+		break;
 	default:
 		err = -EINVAL;
 	}
@@ -746,7 +1227,8 @@ static const struct proto_ops base_sock_ops = {
 	.bind		= base_sock_bind,
 	.getname	= sock_no_getname,
 	.sendmsg	= sock_no_sendmsg,
-	.recvmsg	= sock_no_recvmsg,
+	.recvmsg	= base_sock_recvmsg,
+	.poll		= datagram_poll,
 	.listen		= sock_no_listen,
 	.shutdown	= sock_no_shutdown,
 	.setsockopt	= sock_no_setsockopt,
@@ -21,26 +21,196 @@
 #include <linux/sched.h>
 #include <linux/sched/cputime.h>
 #include <linux/signal.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
 
 #include "core.h"
+#include "fsm.h"
 
 static u_int	*debug;
 
+static struct dentry	*mISDN_dbg_root;
+
+/*
+ * rx path latency tracer (see mISDNif.h).  Off by default; the stamp
+ * write in the hw receive helpers and the checkpoints in the worker,
+ * dsp and socket code are all guarded by this flag, so the cost when
+ * disabled is one predicted branch per frame.
+ */
+u_int	mISDN_rx_trace;
+EXPORT_SYMBOL(mISDN_rx_trace);
+
+static u_long	mISDN_rx_lathist[MISDN_LAT_NSTAGES][MISDN_LAT_BUCKETS];
+
+static const char *mISDN_lat_names[MISDN_LAT_NSTAGES] = {
+	"worker", "dsp", "socket"
+};
+
+/*
+ * default number of frames mISDNStackd dispatches per wakeup before it
+ * looks at the status bits again, tunable per stack via the stack_batch
+ * device attribute
+ */
+#define MISDN_STACK_BATCH	32
+
+/*
+ * stall watchdog: mISDNStackd advances st->hb whenever it makes
+ * progress; a low frequency worker checks all stacks and raises an
+ * alarm (kernel log plus MISDN_EV_STACK_STALL on bound base sockets)
+ * when a stack has pending work but its heartbeat stopped longer than
+ * watchdog_ms ago - starved RT threads and drivers sleeping on a dead
+ * lock otherwise only show up when audio dies.  watchdog_ms lives in
+ * debugfs, 0 disables the checks.
+ */
+#define MISDN_WD_INTERVAL	(HZ / 2)
+
+static u_int	mISDN_wd_ms = 1000;
+
+static LIST_HEAD(mISDN_stacks);
+static DEFINE_SPINLOCK(mISDN_stacks_lock);
+static struct delayed_work mISDN_wd_work;
+
+/*
+ * Producers (hardware interrupts, socket sendmsg, timer callbacks) push
+ * into st->inq with a single lock-free llist_add(), so they never contend
+ * on a queue spinlock.  The llist node lives in skb->cb behind the
+ * mISDNhead.  Only mISDNStackd drains inq, reverses the LIFO chain to
+ * restore arrival order and moves the frames to its private msgq.
+ */
+struct mISDN_stack_cb {
+	struct mISDNhead	hh;
+	struct llist_node	node;
+	ktime_t			qt;	/* enqueue time for latency stats */
+};
+
+#define mISDN_CB_NODE(s)	(&((struct mISDN_stack_cb *)&(s)->cb[0])->node)
+
+static inline struct sk_buff *
+node_to_skb(struct llist_node *node)
+{
+	struct mISDN_stack_cb *cb = container_of(node,
+						 struct mISDN_stack_cb, node);
+
+	return (struct sk_buff *)((char *)cb - offsetof(struct sk_buff, cb));
+}
+
 static inline void
 _queue_message(struct mISDNstack *st, struct sk_buff *skb)
 {
 	struct mISDNhead	*hh = mISDN_HEAD_P(skb);
+	ktime_t			now = ktime_get();
 
 	if (*debug & DEBUG_QUEUE_FUNC)
 		printk(KERN_DEBUG "%s prim(%x) id(%x) %p\n",
 		       __func__, hh->prim, hh->id, skb);
-	skb_queue_tail(&st->msgq, skb);
+	((struct mISDN_stack_cb *)&skb->cb[0])->qt = now;
+	atomic_long_inc(&st->stats.enqueued);
+	llist_add(mISDN_CB_NODE(skb), &st->inq);
 	if (likely(!test_bit(mISDN_STACK_STOPPED, &st->status))) {
-		test_and_set_bit(mISDN_STACK_WORK, &st->status);
-		wake_up_interruptible(&st->workq);
+		/* only the producer turning WORK on needs to wake the thread */
+		if (!test_and_set_bit(mISDN_STACK_WORK, &st->status)) {
+			/* scheduling latency is measured from this stamp */
+			WRITE_ONCE(st->wake_t, now);
+			wake_up_interruptible(&st->workq);
+		}
 	}
 }
 
+static struct sk_buff *
+stack_next_msg(struct mISDNstack *st)
+{
+	struct llist_node	*node, *next;
+	struct sk_buff		*skb;
+
+	skb = __skb_dequeue(&st->msgq);
+	if (skb)
+		return skb;
+	node = llist_del_all(&st->inq);
+	if (!node)
+		return NULL;
+	node = llist_reverse_order(node);
+	skb = node_to_skb(node);
+	node = node->next;
+	while (node) {
+		next = node->next;
+		__skb_queue_tail(&st->msgq, node_to_skb(node));
+		node = next;
+	}
+	if (skb_queue_len(&st->msgq) + 1 > st->stats.depth_hw)
+		st->stats.depth_hw = skb_queue_len(&st->msgq) + 1;
+	return skb;
+}
+
+static inline void
+stack_account(struct mISDNstack *st, struct sk_buff *skb)
+{
+	struct mISDN_stack_cb	*cb = (struct mISDN_stack_cb *)&skb->cb[0];
+	s64			us;
+	int			i;
+
+	us = ktime_us_delta(ktime_get(), cb->qt);
+	i = fls64(us);
+	if (i >= MISDN_LAT_BUCKETS)
+		i = MISDN_LAT_BUCKETS - 1;
+	st->stats.lathist[i]++;
+	st->stats.delivered++;
+}
+
+/*
+ * Checkpoint of the rx latency tracer.  Histograms are global, not
+ * per stack, because B-channel data never passes mISDNStackd and the
+ * dsp stage spans stacks anyway; racy increments are acceptable for a
+ * debug histogram.  A zero stamp means the frame never passed an
+ * ingress helper (tx confirms, locally generated messages) and is
+ * not counted.
+ */
+void
+mISDN_lat_sample(int stage, struct sk_buff *skb)
+{
+	ktime_t	ingress = MISDN_LAT_STAMP(skb);
+	s64	us;
+	int	i;
+
+	if (!ingress)
+		return;
+	us = ktime_us_delta(ktime_get(), ingress);
+	if (us < 0)
+		return;
+	i = fls64(us);
+	if (i >= MISDN_LAT_BUCKETS)
+		i = MISDN_LAT_BUCKETS - 1;
+	mISDN_rx_lathist[stage][i]++;
+}
+EXPORT_SYMBOL(mISDN_lat_sample);
+
+/*
+ * wakeup-to-run delta of the stack thread: how long the frames of this
+ * wakeup waited for the scheduler before the first one was dispatched
+ */
+static void
+stack_sched_account(struct mISDNstack *st, ktime_t wake)
+{
+	s64	us = ktime_us_delta(ktime_get(), wake);
+	int	i;
+
+	if (us < 0)
+		return;
+	i = fls64(us);
+	if (i >= MISDN_LAT_BUCKETS)
+		i = MISDN_LAT_BUCKETS - 1;
+	st->stats.schedhist[i]++;
+	if ((u_long)us > st->stats.sched_max)
+		st->stats.sched_max = us;
+}
+
+static inline int
+stack_msg_pending(struct mISDNstack *st)
+{
+	return !skb_queue_empty(&st->msgq) || !llist_empty(&st->inq);
+}
+
 static int
 mISDN_queue_message(struct mISDNchannel *ch, struct sk_buff *skb)
 {
@@ -53,6 +223,9 @@ get_channel4id(struct mISDNstack *st, u_int id)
 {
 	struct mISDNchannel	*ch;
 
+	/* the table is updated under lmutex, reading a slot is atomic */
+	if (id > 0 && id < MISDN_MAX_L2CHAN)
+		return READ_ONCE(st->l2chan[id]);
 	mutex_lock(&st->lmutex);
 	list_for_each_entry(ch, &st->layer2, list) {
 		if (id == ch->nr)
@@ -74,8 +247,11 @@ send_socklist(struct mISDN_sock_list *sl, struct sk_buff *skb)
 	sk_for_each(sk, &sl->head) {
 		if (sk->sk_state != MISDN_BOUND)
 			continue;
+		/* recvmsg copies the cb header into the iov instead of
+		 * pushing it into the buffer, so a clone sharing the
+		 * payload is good enough and saves the data copy */
 		if (!cskb)
-			cskb = skb_copy(skb, GFP_ATOMIC);
+			cskb = skb_clone(skb, GFP_ATOMIC);
 		if (!cskb) {
 			printk(KERN_WARNING "%s no skb\n", __func__);
 			break;
@@ -201,15 +377,138 @@ do_clear_stack(struct mISDNstack *st)
 {
 }
 
+static void
+mISDN_wd_run(struct work_struct *work)
+{
+	struct mISDNstack	*st;
+	unsigned long		hb;
+	u_int			ms;
+
+	spin_lock(&mISDN_stacks_lock);
+	list_for_each_entry(st, &mISDN_stacks, wdlist) {
+		if (!mISDN_wd_ms)
+			break;
+		if (!READ_ONCE(st->thread) ||
+		    !test_bit(mISDN_STACK_WORK, &st->status) ||
+		    test_bit(mISDN_STACK_STOPPED, &st->status)) {
+			st->wd_hit = 0;
+			continue;
+		}
+		hb = READ_ONCE(st->hb);
+		if (!time_after(jiffies, hb + msecs_to_jiffies(mISDN_wd_ms))) {
+			st->wd_hit = 0;
+			continue;
+		}
+		/* one report per stall episode, the flag clears itself
+		 * as soon as the heartbeat moves again */
+		if (st->wd_hit)
+			continue;
+		st->wd_hit = 1;
+		st->stats.stalls++;
+		ms = jiffies_to_msecs(jiffies - hb);
+		printk(KERN_WARNING
+		       "mISDN: stack %s stalled, no progress for %ums "
+		       "(%ld frames pending)\n", dev_name(&st->dev->dev), ms,
+		       atomic_long_read(&st->stats.enqueued) -
+		       (long)st->stats.delivered - (long)st->stats.dropped);
+		mISDN_base_event(st->dev->id, MISDN_EV_STACK_STALL, ms);
+	}
+	spin_unlock(&mISDN_stacks_lock);
+	schedule_delayed_work(&mISDN_wd_work, MISDN_WD_INTERVAL);
+}
+
+static int
+st_stats_show(struct seq_file *m, void *v)
+{
+	struct mISDNstack	*st = m->private;
+	struct task_struct	*task;
+	u64			utime, stime;
+	int			i;
+
+	seq_printf(m, "enqueued: %ld\n",
+		   atomic_long_read(&st->stats.enqueued));
+	seq_printf(m, "delivered: %lu\n", st->stats.delivered);
+	seq_printf(m, "dropped: %lu\n", st->stats.dropped);
+	seq_printf(m, "depth_hw: %lu\n", st->stats.depth_hw);
+	seq_printf(m, "hdr_realloc: %lu\n", st->stats.hdr_realloc);
+	seq_printf(m, "wakeups: %lu\n", st->stats.wakeups);
+	seq_printf(m, "stopped: %lu\n", st->stats.stopped);
+	seq_printf(m, "stalls: %lu\n", st->stats.stalls);
+	seq_printf(m, "sched_max_us: %lu\n", st->stats.sched_max);
+	seq_printf(m, "uptime_ns: %lld\n",
+		   ktime_to_ns(ktime_sub(ktime_get(), st->stats.start)));
+	/* cpu_ns against uptime_ns is the saturation of this span's
+	 * thread, delivered against wakeups the frames per wakeup
+	 */
+	task = READ_ONCE(st->thread);
+	if (task) {
+		task_cputime(task, &utime, &stime);
+		seq_printf(m, "cpu_ns: %llu\n", utime + stime);
+		seq_printf(m, "nvcsw: %lu\n", task->nvcsw);
+		seq_printf(m, "nivcsw: %lu\n", task->nivcsw);
+	}
+	seq_puts(m, "latency_us:");
+	for (i = 0; i < MISDN_LAT_BUCKETS; i++)
+		seq_printf(m, " %lu", st->stats.lathist[i]);
+	seq_putc(m, '\n');
+	seq_puts(m, "sched_us:");
+	for (i = 0; i < MISDN_LAT_BUCKETS; i++)
+		seq_printf(m, " %lu", st->stats.schedhist[i]);
+	seq_putc(m, '\n');
+	return 0;
+}
+
+static int
+st_stats_open(struct inode *ino, struct file *filep)
+{
+	return single_open(filep, st_stats_show, ino->i_private);
+}
+
+static const struct file_operations st_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= st_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int
+rx_latency_show(struct seq_file *m, void *v)
+{
+	int	s, i;
+
+	for (s = 0; s < MISDN_LAT_NSTAGES; s++) {
+		seq_printf(m, "%s_us:", mISDN_lat_names[s]);
+		for (i = 0; i < MISDN_LAT_BUCKETS; i++)
+			seq_printf(m, " %lu", mISDN_rx_lathist[s][i]);
+		seq_putc(m, '\n');
+	}
+	return 0;
+}
+
+static int
+rx_latency_open(struct inode *ino, struct file *filep)
+{
+	return single_open(filep, rx_latency_show, NULL);
+}
+
+static const struct file_operations rx_latency_fops = {
+	.owner		= THIS_MODULE,
+	.open		= rx_latency_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int
 mISDNStackd(void *data)
 {
 	struct mISDNstack *st = data;
-#ifdef MISDN_MSG_STATS
-	u64 utime, stime;
-#endif
+	struct sk_buff *skb;
 	int err = 0;
 
+	st->stats.start = ktime_get();
+	st->hb = jiffies;
 	sigfillset(&current->blocked);
 	if (*debug & DEBUG_MSG_THREAD)
 		printk(KERN_DEBUG "mISDNStackd %s started\n",
@@ -221,47 +520,61 @@ mISDNStackd(void *data)
 	}
 
 	for (;;) {
-		struct sk_buff	*skb;
-
 		if (unlikely(test_bit(mISDN_STACK_STOPPED, &st->status))) {
 			test_and_clear_bit(mISDN_STACK_WORK, &st->status);
 			test_and_clear_bit(mISDN_STACK_RUNNING, &st->status);
 		} else
 			test_and_set_bit(mISDN_STACK_RUNNING, &st->status);
 		while (test_bit(mISDN_STACK_WORK, &st->status)) {
-			skb = skb_dequeue(&st->msgq);
+			int batch = st->batchlim;
+			ktime_t wake = READ_ONCE(st->wake_t);
+
+			if (wake) {
+				WRITE_ONCE(st->wake_t, 0);
+				stack_sched_account(st, wake);
+			}
+			WRITE_ONCE(st->hb, jiffies);
+			skb = stack_next_msg(st);
 			if (!skb) {
 				test_and_clear_bit(mISDN_STACK_WORK,
 						   &st->status);
 				/* test if a race happens */
-				skb = skb_dequeue(&st->msgq);
+				skb = stack_next_msg(st);
 				if (!skb)
 					continue;
 				test_and_set_bit(mISDN_STACK_WORK,
 						 &st->status);
 			}
-#ifdef MISDN_MSG_STATS
-			st->msg_cnt++;
-#endif
-			err = send_msg_to_layer(st, skb);
-			if (unlikely(err)) {
-				if (*debug & DEBUG_SEND_ERR)
-					printk(KERN_DEBUG
-					       "%s: %s prim(%x) id(%x) "
-					       "send call(%d)\n",
-					       __func__, dev_name(&st->dev->dev),
-					       mISDN_HEAD_PRIM(skb),
-					       mISDN_HEAD_ID(skb), err);
-				dev_kfree_skb(skb);
-				continue;
-			}
-			if (unlikely(test_bit(mISDN_STACK_STOPPED,
-					      &st->status))) {
-				test_and_clear_bit(mISDN_STACK_WORK,
-						   &st->status);
-				test_and_clear_bit(mISDN_STACK_RUNNING,
-						   &st->status);
-				break;
+			/* dispatch a whole batch before looking at the
+			 * status bits again to keep scheduler overhead
+			 * down on busy D-channels
+			 */
+			while (skb) {
+				WRITE_ONCE(st->hb, jiffies);
+				stack_account(st, skb);
+				err = send_msg_to_layer(st, skb);
+				if (unlikely(err)) {
+					st->stats.dropped++;
+					if (*debug & DEBUG_SEND_ERR)
+						printk(KERN_DEBUG
+						       "%s: %s prim(%x) id(%x) "
+						       "send call(%d)\n",
+						       __func__,
+						       dev_name(&st->dev->dev),
+						       mISDN_HEAD_PRIM(skb),
+						       mISDN_HEAD_ID(skb), err);
+					dev_kfree_skb(skb);
+				} else if (unlikely(test_bit(mISDN_STACK_STOPPED,
+							     &st->status))) {
+					test_and_clear_bit(mISDN_STACK_WORK,
+							   &st->status);
+					test_and_clear_bit(mISDN_STACK_RUNNING,
+							   &st->status);
+					break;
+				}
+				if (--batch <= 0)
+					break;
+				skb = stack_next_msg(st);
 			}
 		}
 		if (test_bit(mISDN_STACK_CLEARING, &st->status)) {
@@ -274,7 +587,7 @@ mISDNStackd(void *data)
 		if (test_and_clear_bit(mISDN_STACK_RESTART, &st->status)) {
 			test_and_clear_bit(mISDN_STACK_STOPPED, &st->status);
 			test_and_set_bit(mISDN_STACK_RUNNING, &st->status);
-			if (!skb_queue_empty(&st->msgq))
+			if (stack_msg_pending(st))
 				test_and_set_bit(mISDN_STACK_WORK,
 						 &st->status);
 		}
@@ -284,9 +597,7 @@ mISDNStackd(void *data)
 			complete(st->notify);
 			st->notify = NULL;
 		}
-#ifdef MISDN_MSG_STATS
-		st->sleep_cnt++;
-#endif
+		st->stats.wakeups++;
 		test_and_clear_bit(mISDN_STACK_ACTIVE, &st->status);
 		wait_event_interruptible(st->workq, (st->status &
 						     mISDN_STACK_ACTION_MASK));
@@ -299,30 +610,18 @@ mISDNStackd(void *data)
 
 		if (test_bit(mISDN_STACK_STOPPED, &st->status)) {
 			test_and_clear_bit(mISDN_STACK_RUNNING, &st->status);
-#ifdef MISDN_MSG_STATS
-			st->stopped_cnt++;
-#endif
+			st->stats.stopped++;
 		}
 	}
-#ifdef MISDN_MSG_STATS
-	printk(KERN_DEBUG "mISDNStackd daemon for %s proceed %d "
-	       "msg %d sleep %d stopped\n",
-	       dev_name(&st->dev->dev), st->msg_cnt, st->sleep_cnt,
-	       st->stopped_cnt);
-	task_cputime(st->thread, &utime, &stime);
-	printk(KERN_DEBUG
-	       "mISDNStackd daemon for %s utime(%llu) stime(%llu)\n",
-	       dev_name(&st->dev->dev), utime, stime);
-	printk(KERN_DEBUG
-	       "mISDNStackd daemon for %s nvcsw(%ld) nivcsw(%ld)\n",
-	       dev_name(&st->dev->dev), st->thread->nvcsw, st->thread->nivcsw);
-	printk(KERN_DEBUG "mISDNStackd daemon for %s killed now\n",
-	       dev_name(&st->dev->dev));
-#endif
+	if (*debug & DEBUG_MSG_THREAD)
+		printk(KERN_DEBUG "mISDNStackd %s killed now\n",
+		       dev_name(&st->dev->dev));
 	test_and_set_bit(mISDN_STACK_KILLED, &st->status);
 	test_and_clear_bit(mISDN_STACK_RUNNING, &st->status);
 	test_and_clear_bit(mISDN_STACK_ACTIVE, &st->status);
 	test_and_clear_bit(mISDN_STACK_ABORT, &st->status);
+	while ((skb = stack_next_msg(st)))
+		dev_kfree_skb(skb);
 	skb_queue_purge(&st->msgq);
 	st->thread = NULL;
 	if (st->notify != NULL) {
@@ -352,6 +651,8 @@ void
 __add_layer2(struct mISDNchannel *ch, struct mISDNstack *st)
 {
 	list_add_tail(&ch->list, &st->layer2);
+	if (ch->nr > 0 && ch->nr < MISDN_MAX_L2CHAN)
+		WRITE_ONCE(st->l2chan[ch->nr], ch);
 }
 
 void
@@ -362,6 +663,14 @@ add_layer2(struct mISDNchannel *ch, struct mISDNstack *st)
 	mutex_unlock(&st->lmutex);
 }
 
+void
+__remove_layer2(struct mISDNchannel *ch, struct mISDNstack *st)
+{
+	list_del(&ch->list);
+	if (ch->nr > 0 && ch->nr < MISDN_MAX_L2CHAN)
+		WRITE_ONCE(st->l2chan[ch->nr], NULL);
+}
+
 static int
 st_own_ctrl(struct mISDNchannel *ch, u_int cmd, void *arg)
 {
@@ -384,10 +693,14 @@ create_stack(struct mISDNdevice *dev)
 	}
 	newst->dev = dev;
 	INIT_LIST_HEAD(&newst->layer2);
+	INIT_LIST_HEAD(&newst->wdlist);
 	INIT_HLIST_HEAD(&newst->l1sock.head);
 	rwlock_init(&newst->l1sock.lock);
 	init_waitqueue_head(&newst->workq);
+	init_llist_head(&newst->inq);
 	skb_queue_head_init(&newst->msgq);
+	newst->batchlim = MISDN_STACK_BATCH;
+	cpumask_copy(&newst->threadmask, cpu_possible_mask);
 	mutex_init(&newst->lmutex);
 	dev->D.st = newst;
 	err = create_teimanager(dev);
@@ -419,8 +732,16 @@ create_stack(struct mISDNdevice *dev)
 		       dev_name(&newst->dev->dev), err);
 		delete_teimanager(dev->teimgr);
 		kfree(newst);
-	} else
+	} else {
 		wait_for_completion(&done);
+		newst->dbg = debugfs_create_dir(dev_name(&newst->dev->dev),
+						mISDN_dbg_root);
+		debugfs_create_file("stats", 0444, newst->dbg, newst,
+				    &st_stats_fops);
+		spin_lock(&mISDN_stacks_lock);
+		list_add_tail(&newst->wdlist, &mISDN_stacks);
+		spin_unlock(&mISDN_stacks_lock);
+	}
 	return err;
 }
 
@@ -603,7 +924,7 @@ delete_channel(struct mISDNchannel *ch)
 		pch = get_channel4id(ch->st, ch->nr);
 		if (pch) {
 			mutex_lock(&ch->st->lmutex);
-			list_del(&pch->list);
+			__remove_layer2(pch, ch->st);
 			mutex_unlock(&ch->st->lmutex);
 			pch->ctrl(pch, CLOSE_CHANNEL, NULL);
 			pch = ch->st->dev->teimgr;
@@ -635,6 +956,9 @@ delete_stack(struct mISDNdevice *dev)
 	if (*debug & DEBUG_CORE_FUNC)
 		printk(KERN_DEBUG "%s: st(%s)\n", __func__,
 		       dev_name(&st->dev->dev));
+	spin_lock(&mISDN_stacks_lock);
+	list_del_init(&st->wdlist);
+	spin_unlock(&mISDN_stacks_lock);
 	if (dev->teimgr)
 		delete_teimanager(dev->teimgr);
 	if (st->thread) {
@@ -655,6 +979,7 @@ delete_stack(struct mISDNdevice *dev)
 	if (!hlist_empty(&st->l1sock.head))
 		printk(KERN_WARNING "%s: layer1 list not empty\n",
 		       __func__);
+	debugfs_remove_recursive(st->dbg);
 	kfree(st);
 }
 
@@ -662,4 +987,20 @@ void
 mISDN_initstack(u_int *dp)
 {
 	debug = dp;
+	mISDN_dbg_root = debugfs_create_dir("mISDN", NULL);
+	mISDN_FsmTraceDebugfs(mISDN_dbg_root);
+	debugfs_create_u32("rx_trace", 0644, mISDN_dbg_root, &mISDN_rx_trace);
+	debugfs_create_file("rx_latency", 0444, mISDN_dbg_root, NULL,
+			    &rx_latency_fops);
+	debugfs_create_u32("watchdog_ms", 0644, mISDN_dbg_root, &mISDN_wd_ms);
+	INIT_DELAYED_WORK(&mISDN_wd_work, mISDN_wd_run);
+	schedule_delayed_work(&mISDN_wd_work, MISDN_WD_INTERVAL);
+}
+
+void
+mISDN_stack_cleanup(void)
+{
+	cancel_delayed_work_sync(&mISDN_wd_work);
+	debugfs_remove_recursive(mISDN_dbg_root);
+	mISDN_dbg_root = NULL;
 }
@@ -36,6 +36,9 @@
 
 static	u_int	*debug;
 
+/* one teimgr per datalink, allocated and freed with call churn */
+static struct kmem_cache *teicache;
+
 static struct Fsm deactfsm = {NULL, 0, 0, NULL, NULL};
 static struct Fsm teifsmu = {NULL, 0, 0, NULL, NULL};
 static struct Fsm teifsmn = {NULL, 0, 0, NULL, NULL};
@@ -203,6 +206,7 @@ enum {
 	EV_ASSIGN_REQ,
 	EV_DENIED,
 	EV_CHKREQ,
+	EV_CHKREQ_GROUP,
 	EV_CHKRESP,
 	EV_REMOVE,
 	EV_VERIFY,
@@ -218,6 +222,7 @@ static char *strTeiEvent[] =
 	"EV_ASSIGN_REQ",
 	"EV_DENIED",
 	"EV_CHKREQ",
+	"EV_CHKREQ_GROUP",
 	"EV_CHKRESP",
 	"EV_REMOVE",
 	"EV_VERIFY",
@@ -274,25 +279,19 @@ get_free_id(struct manager *mgr)
 static int
 get_free_tei(struct manager *mgr)
 {
-	DECLARE_BITMAP(ids, 64) = { [0 ... BITS_TO_LONGS(64) - 1] = 0 };
-	int		i;
-	struct layer2	*l2;
-
-	list_for_each_entry(l2, &mgr->layer2, list) {
-		if (l2->ch.nr == 0)
-			continue;
-		if ((l2->ch.addr & 0xff) != 0)
-			continue;
-		i = l2->ch.addr >> 8;
-		if (i < 64)
-			continue;
-		i -= 64;
-
-		__set_bit(i, ids);
+	int	i, tei;
+
+	/* round robin over the tei array: a tei just given up is reused
+	 * last, so a device whose remove got lost does not find its old
+	 * tei under new ownership right away
+	 */
+	for (i = 0; i < GROUP_TEI - 64; i++) {
+		tei = 64 + (mgr->tei_rr + i) % (GROUP_TEI - 64);
+		if (!mgr->teiar[tei]) {
+			mgr->tei_rr = tei - 63;
+			return tei;
+		}
 	}
-	i = find_first_zero_bit(ids, 64);
-	if (i < 64)
-		return i + 64;
 	printk(KERN_WARNING "%s: more as 63 dynamic tei for one device\n",
 	       __func__);
 	return -1;
@@ -419,20 +418,44 @@ random_ri(void)
 	return x;
 }
 
+/*
+ * TEI indexed shortcut into the layer2 list; the TEI space is bounded,
+ * so a direct array makes the per frame lookup O(1) instead of a list
+ * scan over all datalinks of a crowded bus.  The array is maintained
+ * when a TEI is created or assigned and cleared on layer2 release,
+ * callers must hold mgr->lock for writing
+ */
+static void
+teiar_set(struct manager *mgr, int tei, struct layer2 *l2)
+{
+	if (tei > 0 && tei < GROUP_TEI)
+		mgr->teiar[tei] = l2;
+}
+
+static void
+teiar_remove(struct manager *mgr, struct layer2 *l2)
+{
+	int i;
+
+	for (i = 1; i < GROUP_TEI; i++)
+		if (mgr->teiar[i] == l2)
+			mgr->teiar[i] = NULL;
+}
+
 static struct layer2 *
 findtei(struct manager *mgr, int tei)
 {
 	struct layer2	*l2;
 	u_long		flags;
 
+	if (tei <= 0 || tei >= GROUP_TEI)
+		return NULL;
 	read_lock_irqsave(&mgr->lock, flags);
-	list_for_each_entry(l2, &mgr->layer2, list) {
-		if ((l2->sapi == 0) && (l2->tei > 0) &&
-		    (l2->tei != GROUP_TEI) && (l2->tei == tei))
-			goto done;
-	}
-	l2 = NULL;
-done:
+	l2 = mgr->teiar[tei];
+	/* the datalink may have given the TEI up without being removed
+	 * from the array yet */
+	if (l2 && (l2->sapi != 0 || l2->tei != tei))
+		l2 = NULL;
 	read_unlock_irqrestore(&mgr->lock, flags);
 	return l2;
 }
@@ -505,9 +528,14 @@ tei_id_assign(struct FsmInst *fi, int event, void *arg)
 			tei_l2(l2, MDL_ERROR_RSP, 0);
 		}
 	} else if (ri == tm->ri) {
+		u_long flags;
+
 		mISDN_FsmDelTimer(&tm->timer, 1);
 		mISDN_FsmChangeState(fi, ST_TEI_NOP);
 		tei_l2(tm->l2, MDL_ASSIGN_REQ, tei);
+		write_lock_irqsave(&tm->mgr->lock, flags);
+		teiar_set(tm->mgr, tei, tm->l2);
+		write_unlock_irqrestore(&tm->mgr->lock, flags);
 	}
 }
 
@@ -661,7 +689,7 @@ tei_l2remove(struct layer2 *l2)
 {
 	put_tei_msg(l2->tm->mgr, ID_REMOVE, 0, l2->tei);
 	tei_l2(l2, MDL_REMOVE_REQ, 0);
-	list_del(&l2->ch.list);
+	__remove_layer2(&l2->ch, l2->ch.st);
 	l2->ch.ctrl(&l2->ch, CLOSE_CHANNEL, NULL);
 }
 
@@ -700,6 +728,23 @@ tei_id_chk_req_net(struct FsmInst *fi, int event, void *arg)
 	tm->nval = 2;
 }
 
+static void
+tei_id_chk_req_grp(struct FsmInst *fi, int event, void *arg)
+{
+	struct teimgr	*tm = fi->userdata;
+
+	if (*debug & DEBUG_L2_TEI)
+		tm->tei_m.printdebug(fi, "group check covers tei %d",
+				     tm->l2->tei);
+	/* the caller sends a single ID_CHK_REQ to the group tei, so only
+	 * arm the response collection here
+	 */
+	tm->rcnt = 0;
+	mISDN_FsmChangeState(&tm->tei_m, ST_TEI_IDVERIFY);
+	mISDN_FsmAddTimer(&tm->timer, tm->tval, EV_TIMER, NULL, 6);
+	tm->nval = 2;
+}
+
 static void
 tei_id_chk_resp(struct FsmInst *fi, int event, void *arg)
 {
@@ -762,6 +807,7 @@ static struct FsmNode TeiFnListNet[] =
 	{ST_TEI_NOP, EV_ASSIGN_REQ, tei_assign_req},
 	{ST_TEI_NOP, EV_VERIFY, tei_id_verify_net},
 	{ST_TEI_NOP, EV_CHKREQ, tei_id_chk_req_net},
+	{ST_TEI_NOP, EV_CHKREQ_GROUP, tei_id_chk_req_grp},
 	{ST_TEI_IDVERIFY, EV_TIMER, tei_id_ver_tout_net},
 	{ST_TEI_IDVERIFY, EV_CHKRESP, tei_id_chk_resp},
 };
@@ -812,9 +858,9 @@ create_new_tei(struct manager *mgr, int tei, int sapi)
 		printk(KERN_WARNING "%s:no memory for layer2\n", __func__);
 		return NULL;
 	}
-	l2->tm = kzalloc(sizeof(struct teimgr), GFP_KERNEL);
+	l2->tm = kmem_cache_zalloc(teicache, GFP_KERNEL);
 	if (!l2->tm) {
-		kfree(l2);
+		free_l2(l2);
 		printk(KERN_WARNING "%s:no memory for teimgr\n", __func__);
 		return NULL;
 	}
@@ -830,6 +876,7 @@ create_new_tei(struct manager *mgr, int tei, int sapi)
 	write_lock_irqsave(&mgr->lock, flags);
 	id = get_free_id(mgr);
 	list_add_tail(&l2->list, &mgr->layer2);
+	teiar_set(mgr, l2->tei, l2);
 	write_unlock_irqrestore(&mgr->lock, flags);
 	if (id < 0) {
 		l2->ch.ctrl(&l2->ch, CLOSE_CHANNEL, NULL);
@@ -853,6 +900,31 @@ create_new_tei(struct manager *mgr, int tei, int sapi)
 	return l2;
 }
 
+/*
+ * audit all dynamic teis with one group check.  Started when the tei
+ * pool runs dry, typically because the devices behind the teis fell
+ * off the bus without remove (site power-cycle).  A single ID_CHK_REQ
+ * to the group tei makes every live device answer; the datalinks that
+ * stay silent are removed by the verify timeout, so the whole pool is
+ * reclaimed in one round instead of 63 single check cycles.
+ */
+static void
+mgr_tei_audit(struct manager *mgr)
+{
+	struct layer2	*l2;
+	int		armed = 0;
+
+	list_for_each_entry(l2, &mgr->layer2, list) {
+		if (l2->tei < 64 || l2->tei == GROUP_TEI || !l2->tm)
+			continue;
+		/* ignored while a check already runs on the datalink */
+		if (!mISDN_FsmEvent(&l2->tm->tei_m, EV_CHKREQ_GROUP, NULL))
+			armed++;
+	}
+	if (armed)
+		put_tei_msg(mgr, ID_CHK_REQ, 0, GROUP_TEI);
+}
+
 static void
 new_tei_req(struct manager *mgr, u_char *dp)
 {
@@ -865,11 +937,28 @@ new_tei_req(struct manager *mgr, u_char *dp)
 		goto denied;
 	if (!(dp[3] & 1)) /* Extension bit != 1 */
 		goto denied;
-	if (dp[3] != 0xff)
+	if (dp[3] != 0xff) {
 		tei = dp[3] >> 1; /* 3GPP TS 08.56 6.1.11.2 */
-	else
+	} else {
+		/* if our answer got lost, the device repeats the request
+		 * with the same reference number; resend the assignment
+		 * instead of minting a second tei and datalink for it
+		 */
+		list_for_each_entry(l2, &mgr->layer2, list) {
+			if (l2->tei >= 64 && l2->tei != GROUP_TEI &&
+			    l2->tm && l2->tm->ri == ri) {
+				mISDN_FsmEvent(&l2->tm->tei_m,
+					       EV_ASSIGN_REQ, dp);
+				return;
+			}
+		}
 		tei = get_free_tei(mgr);
+	}
 	if (tei < 0) {
+		/* reclaim teis of devices that fell off the bus; the
+		 * requester retries and succeeds in the next round
+		 */
+		mgr_tei_audit(mgr);
 		printk(KERN_WARNING "%s:No free tei\n", __func__);
 		goto denied;
 	}
@@ -982,10 +1071,11 @@ TEIrelease(struct layer2 *l2)
 
 	mISDN_FsmDelTimer(&tm->timer, 1);
 	write_lock_irqsave(&tm->mgr->lock, flags);
+	teiar_remove(tm->mgr, l2);
 	list_del(&l2->list);
 	write_unlock_irqrestore(&tm->mgr->lock, flags);
 	l2->tm = NULL;
-	kfree(tm);
+	kmem_cache_free(teicache, tm);
 }
 
 static int
@@ -1055,10 +1145,10 @@ create_teimgr(struct manager *mgr, struct channel_req *crq)
 		       crq->adr.tei, crq->adr.sapi);
 	if (!l2)
 		return -ENOMEM;
-	l2->tm = kzalloc(sizeof(struct teimgr), GFP_KERNEL);
+	l2->tm = kmem_cache_zalloc(teicache, GFP_KERNEL);
 	if (!l2->tm) {
-		kfree(l2);
-		printk(KERN_ERR "kmalloc teimgr failed\n");
+		free_l2(l2);
+		printk(KERN_ERR "alloc teimgr failed\n");
 		return -ENOMEM;
 	}
 	l2->tm->mgr = mgr;
@@ -1087,6 +1177,7 @@ create_teimgr(struct manager *mgr, struct channel_req *crq)
 	write_lock_irqsave(&mgr->lock, flags);
 	id = get_free_id(mgr);
 	list_add_tail(&l2->list, &mgr->layer2);
+	teiar_set(mgr, l2->tei, l2);
 	write_unlock_irqrestore(&mgr->lock, flags);
 	if (id >= 0) {
 		l2->ch.nr = id;
@@ -1157,7 +1248,7 @@ free_teimanager(struct manager *mgr)
 			list_for_each_entry_safe(l2, nl2, &mgr->layer2, list) {
 				put_tei_msg(mgr, ID_REMOVE, 0, l2->tei);
 				mutex_lock(&mgr->ch.st->lmutex);
-				list_del(&l2->ch.list);
+				__remove_layer2(&l2->ch, mgr->ch.st);
 				mutex_unlock(&mgr->ch.st->lmutex);
 				l2->ch.ctrl(&l2->ch, CLOSE_CHANNEL, NULL);
 			}
@@ -1253,7 +1344,7 @@ delete_teimanager(struct mISDNchannel *ch)
 	/* not locked lock is taken in release tei */
 	list_for_each_entry_safe(l2, nl2, &mgr->layer2, list) {
 		mutex_lock(&mgr->ch.st->lmutex);
-		list_del(&l2->ch.list);
+		__remove_layer2(&l2->ch, mgr->ch.st);
 		mutex_unlock(&mgr->ch.st->lmutex);
 		l2->ch.ctrl(&l2->ch, CLOSE_CHANNEL, NULL);
 	}
@@ -1384,29 +1475,43 @@ create_teimanager(struct mISDNdevice *dev)
 	return 0;
 }
 
+static FSMFNPTR teiu_jumpmatrix[TEI_STATE_COUNT * TEI_EVENT_COUNT]
+	__read_mostly;
+static FSMFNPTR tein_jumpmatrix[TEI_STATE_COUNT * TEI_EVENT_COUNT]
+	__read_mostly;
+static FSMFNPTR deact_jumpmatrix[DEACT_STATE_COUNT * DEACT_EVENT_COUNT]
+	__read_mostly;
+
 int TEIInit(u_int *deb)
 {
 	int res;
 	debug = deb;
+	teicache = kmem_cache_create("mISDN_teimgr", sizeof(struct teimgr),
+				     0, SLAB_HWCACHE_ALIGN, NULL);
+	if (!teicache)
+		return -ENOMEM;
 	teifsmu.state_count = TEI_STATE_COUNT;
 	teifsmu.event_count = TEI_EVENT_COUNT;
 	teifsmu.strEvent = strTeiEvent;
 	teifsmu.strState = strTeiState;
-	res = mISDN_FsmNew(&teifsmu, TeiFnListUser, ARRAY_SIZE(TeiFnListUser));
+	res = mISDN_FsmStatic(&teifsmu, TeiFnListUser,
+			      ARRAY_SIZE(TeiFnListUser), teiu_jumpmatrix);
 	if (res)
 		goto error;
 	teifsmn.state_count = TEI_STATE_COUNT;
 	teifsmn.event_count = TEI_EVENT_COUNT;
 	teifsmn.strEvent = strTeiEvent;
 	teifsmn.strState = strTeiState;
-	res = mISDN_FsmNew(&teifsmn, TeiFnListNet, ARRAY_SIZE(TeiFnListNet));
+	res = mISDN_FsmStatic(&teifsmn, TeiFnListNet,
+			      ARRAY_SIZE(TeiFnListNet), tein_jumpmatrix);
 	if (res)
 		goto error_smn;
 	deactfsm.state_count =  DEACT_STATE_COUNT;
 	deactfsm.event_count = DEACT_EVENT_COUNT;
 	deactfsm.strEvent = strDeactEvent;
 	deactfsm.strState = strDeactState;
-	res = mISDN_FsmNew(&deactfsm, DeactFnList, ARRAY_SIZE(DeactFnList));
+	res = mISDN_FsmStatic(&deactfsm, DeactFnList,
+			      ARRAY_SIZE(DeactFnList), deact_jumpmatrix);
 	if (res)
 		goto error_deact;
 	return 0;
@@ -1416,6 +1521,8 @@ error_deact:
 error_smn:
 	mISDN_FsmFree(&teifsmu);
 error:
+	kmem_cache_destroy(teicache);
+	teicache = NULL;
 	return res;
 }
 
@@ -1424,4 +1531,6 @@ void TEIFree(void)
 	mISDN_FsmFree(&teifsmu);
 	mISDN_FsmFree(&teifsmn);
 	mISDN_FsmFree(&deactfsm);
+	kmem_cache_destroy(teicache);
+	teicache = NULL;
 }
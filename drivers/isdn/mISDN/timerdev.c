@@ -20,7 +20,10 @@
 #include <linux/poll.h>
 #include <linux/vmalloc.h>
 #include <linux/slab.h>
-#include <linux/timer.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/timerqueue.h>
 #include <linux/miscdevice.h>
 #include <linux/module.h>
 #include <linux/mISDNif.h>
@@ -32,23 +35,40 @@
 static DEFINE_MUTEX(mISDN_mutex);
 static u_int	*debug;
 
+static u_int	timer_slack_us = 100;
+module_param(timer_slack_us, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(timer_slack_us, "expiry slack of /dev/mISDNtimer timers");
+
+/* ids delivered by one read() at most */
+#define MISDN_TIMER_READ_BATCH	32
+
 
 struct mISDNtimerdev {
 	int			next_id;
-	struct list_head	pending;
+	struct timerqueue_head	pending; /* armed timers, by expiry */
 	struct list_head	expired;
 	wait_queue_head_t	wait;
 	u_int			work;
-	spinlock_t		lock; /* protect lists */
+	struct hrtimer		tl; /* one device timer for the whole
+				     * pending queue, armed for the
+				     * earliest expiry */
+	spinlock_t		lock; /* protect queue and lists */
+	/* expiry jitter accounting */
+	s64			jit_min;
+	s64			jit_max;
+	s64			jit_sum;
+	u64			jit_cnt;
 };
 
 struct mISDNtimer {
-	struct list_head	list;
+	struct timerqueue_node	node; /* while pending */
+	struct list_head	list; /* while expired */
 	struct  mISDNtimerdev	*dev;
-	struct timer_list	tl;
 	int			id;
 };
 
+static enum hrtimer_restart dev_expire_timer(struct hrtimer *t);
+
 static int
 mISDN_open(struct inode *ino, struct file *filep)
 {
@@ -60,10 +80,16 @@ mISDN_open(struct inode *ino, struct file *filep)
 	if (!dev)
 		return -ENOMEM;
 	dev->next_id = 1;
-	INIT_LIST_HEAD(&dev->pending);
+	timerqueue_init_head(&dev->pending);
 	INIT_LIST_HEAD(&dev->expired);
+	hrtimer_init(&dev->tl, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	dev->tl.function = dev_expire_timer;
 	spin_lock_init(&dev->lock);
 	dev->work = 0;
+	dev->jit_min = S64_MAX;
+	dev->jit_max = S64_MIN;
+	dev->jit_sum = 0;
+	dev->jit_cnt = 0;
 	init_waitqueue_head(&dev->wait);
 	filep->private_data = dev;
 	return nonseekable_open(ino, filep);
@@ -73,24 +99,18 @@ static int
 mISDN_close(struct inode *ino, struct file *filep)
 {
 	struct mISDNtimerdev	*dev = filep->private_data;
-	struct list_head	*list = &dev->pending;
+	struct timerqueue_node	*node;
 	struct mISDNtimer	*timer, *next;
 
 	if (*debug & DEBUG_TIMER)
 		printk(KERN_DEBUG "%s(%p,%p)\n", __func__, ino, filep);
 
-	spin_lock_irq(&dev->lock);
-	while (!list_empty(list)) {
-		timer = list_first_entry(list, struct mISDNtimer, list);
-		spin_unlock_irq(&dev->lock);
-		del_timer_sync(&timer->tl);
-		spin_lock_irq(&dev->lock);
-		/* it might have been moved to ->expired */
-		list_del(&timer->list);
-		kfree(timer);
+	/* nobody else holds a reference anymore */
+	hrtimer_cancel(&dev->tl);
+	while ((node = timerqueue_getnext(&dev->pending))) {
+		timerqueue_del(&dev->pending, node);
+		kfree(container_of(node, struct mISDNtimer, node));
 	}
-	spin_unlock_irq(&dev->lock);
-
 	list_for_each_entry_safe(timer, next, &dev->expired, list) {
 		kfree(timer);
 	}
@@ -104,7 +124,8 @@ mISDN_read(struct file *filep, char __user *buf, size_t count, loff_t *off)
 	struct mISDNtimerdev	*dev = filep->private_data;
 	struct list_head *list = &dev->expired;
 	struct mISDNtimer	*timer;
-	int	ret = 0;
+	int	ids[MISDN_TIMER_READ_BATCH];
+	int	n = 0, max, ret = 0;
 
 	if (*debug & DEBUG_TIMER)
 		printk(KERN_DEBUG "%s(%p, %p, %d, %p)\n", __func__,
@@ -112,6 +133,7 @@ mISDN_read(struct file *filep, char __user *buf, size_t count, loff_t *off)
 
 	if (count < sizeof(int))
 		return -ENOSPC;
+	max = min_t(size_t, count / sizeof(int), MISDN_TIMER_READ_BATCH);
 
 	spin_lock_irq(&dev->lock);
 	while (list_empty(list) && (dev->work == 0)) {
@@ -126,17 +148,19 @@ mISDN_read(struct file *filep, char __user *buf, size_t count, loff_t *off)
 	}
 	if (dev->work)
 		dev->work = 0;
-	if (!list_empty(list)) {
+	/* hand out every due timer that fits the buffer in one go */
+	while (n < max && !list_empty(list)) {
 		timer = list_first_entry(list, struct mISDNtimer, list);
 		list_del(&timer->list);
-		spin_unlock_irq(&dev->lock);
-		if (put_user(timer->id, (int __user *)buf))
+		ids[n++] = timer->id;
+		kfree(timer);
+	}
+	spin_unlock_irq(&dev->lock);
+	if (n) {
+		if (copy_to_user(buf, ids, n * sizeof(int)))
 			ret = -EFAULT;
 		else
-			ret = sizeof(int);
-		kfree(timer);
-	} else {
-		spin_unlock_irq(&dev->lock);
+			ret = n * sizeof(int);
 	}
 	return ret;
 }
@@ -161,17 +185,44 @@ mISDN_poll(struct file *filep, poll_table *wait)
 	return mask;
 }
 
-static void
-dev_expire_timer(struct timer_list *t)
+static enum hrtimer_restart
+dev_expire_timer(struct hrtimer *t)
 {
-	struct mISDNtimer *timer = from_timer(timer, t, tl);
+	struct mISDNtimerdev	*dev = container_of(t, struct mISDNtimerdev,
+						    tl);
+	struct timerqueue_node	*node;
+	struct mISDNtimer	*timer;
+	enum hrtimer_restart	ret = HRTIMER_NORESTART;
+	ktime_t			now = ktime_get();
+	s64			jit;
 	u_long			flags;
-
-	spin_lock_irqsave(&timer->dev->lock, flags);
-	if (timer->id >= 0)
-		list_move_tail(&timer->list, &timer->dev->expired);
-	spin_unlock_irqrestore(&timer->dev->lock, flags);
-	wake_up_interruptible(&timer->dev->wait);
+	int			wake = 0;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	/* collect everything that came due, one softirq for the batch */
+	while ((node = timerqueue_getnext(&dev->pending)) &&
+	       ktime_compare(node->expires, now) <= 0) {
+		timerqueue_del(&dev->pending, node);
+		timer = container_of(node, struct mISDNtimer, node);
+		jit = ktime_to_ns(ktime_sub(now, node->expires));
+		if (jit < dev->jit_min)
+			dev->jit_min = jit;
+		if (jit > dev->jit_max)
+			dev->jit_max = jit;
+		dev->jit_sum += jit;
+		dev->jit_cnt++;
+		list_add_tail(&timer->list, &dev->expired);
+		wake = 1;
+	}
+	if (node) {
+		hrtimer_set_expires_range_ns(t, node->expires,
+				(u64)timer_slack_us * NSEC_PER_USEC);
+		ret = HRTIMER_RESTART;
+	}
+	spin_unlock_irqrestore(&dev->lock, flags);
+	if (wake)
+		wake_up_interruptible(&dev->wait);
+	return ret;
 }
 
 static int
@@ -189,14 +240,20 @@ misdn_add_timer(struct mISDNtimerdev *dev, int timeout)
 		if (!timer)
 			return -ENOMEM;
 		timer->dev = dev;
-		timer_setup(&timer->tl, dev_expire_timer, 0);
+		timerqueue_init(&timer->node);
 		spin_lock_irq(&dev->lock);
 		id = timer->id = dev->next_id++;
 		if (dev->next_id < 0)
 			dev->next_id = 1;
-		list_add_tail(&timer->list, &dev->pending);
-		timer->tl.expires = jiffies + ((HZ * (u_long)timeout) / 1000);
-		add_timer(&timer->tl);
+		timer->node.expires = ktime_add_ms(ktime_get(), timeout);
+		/* reprogram only when this became the earliest expiry;
+		 * if the handler runs concurrently it either sees the
+		 * new head or its restart is superseded by this start
+		 */
+		if (timerqueue_add(&dev->pending, &timer->node))
+			hrtimer_start_range_ns(&dev->tl, timer->node.expires,
+					(u64)timer_slack_us * NSEC_PER_USEC,
+					HRTIMER_MODE_ABS);
 		spin_unlock_irq(&dev->lock);
 	}
 	return id;
@@ -205,15 +262,19 @@ misdn_add_timer(struct mISDNtimerdev *dev, int timeout)
 static int
 misdn_del_timer(struct mISDNtimerdev *dev, int id)
 {
+	struct timerqueue_node	*node;
 	struct mISDNtimer	*timer;
 
 	spin_lock_irq(&dev->lock);
-	list_for_each_entry(timer, &dev->pending, list) {
+	for (node = timerqueue_getnext(&dev->pending); node;
+	     node = timerqueue_iterate_next(node)) {
+		timer = container_of(node, struct mISDNtimer, node);
 		if (timer->id == id) {
-			list_del_init(&timer->list);
-			timer->id = -1;
+			timerqueue_del(&dev->pending, node);
 			spin_unlock_irq(&dev->lock);
-			del_timer_sync(&timer->tl);
+			/* a deleted head just gives one early handler
+			 * run that finds nothing due and rearms
+			 */
 			kfree(timer);
 			return id;
 		}
@@ -250,6 +311,21 @@ mISDN_ioctl(struct file *filep, unsigned int cmd, unsigned long arg)
 		if (put_user(id, (int __user *)arg))
 			ret = -EFAULT;
 		break;
+	case IMGETTSTATS:
+	{
+		struct mISDN_timer_stats ts;
+
+		spin_lock_irq(&dev->lock);
+		ts.count = dev->jit_cnt;
+		ts.min_ns = dev->jit_cnt ? dev->jit_min : 0;
+		ts.max_ns = dev->jit_cnt ? dev->jit_max : 0;
+		ts.avg_ns = dev->jit_cnt ?
+			div64_s64(dev->jit_sum, dev->jit_cnt) : 0;
+		spin_unlock_irq(&dev->lock);
+		if (copy_to_user((void __user *)arg, &ts, sizeof(ts)))
+			ret = -EFAULT;
+		break;
+	}
 	case IMDELTIMER:
 		if (get_user(id, (int __user *)arg)) {
 			ret = -EFAULT;
@@ -145,6 +145,8 @@ struct layer1;
 extern int	l1_event(struct layer1 *, u_int);
 
 #define MISDN_BCH_FILL_SIZE	4
+/* preallocated receive buffers per transparent B-channel */
+#define MISDN_BCH_POOL_SIZE	8
 
 struct bchannel {
 	struct mISDNchannel	ch;
@@ -158,6 +160,8 @@ struct bchannel {
 	/* receive data */
 	u8			fill[MISDN_BCH_FILL_SIZE];
 	struct sk_buff		*rx_skb;
+	struct sk_buff_head	rxpool; /* preallocated receive skbs */
+	unsigned short		poollen; /* skb size the pool is filled for */
 	unsigned short		maxlen;
 	unsigned short		init_maxlen; /* initial value */
 	unsigned short		next_maxlen; /* pending value */
@@ -170,12 +174,16 @@ struct bchannel {
 	struct sk_buff_head	rqueue;
 	int			rcount;
 	int			tx_idx;
+	u8			*tx_ebuf; /* bchannel_tx_chunk() staging */
+	unsigned short		tx_esize;
 	int			debug;
 	/* statistics */
 	int			err_crc;
 	int			err_tx;
 	int			err_rx;
 	int			dropcnt;
+	int			tx_edup; /* samples stretched/shrunk by the */
+	int			tx_edrop; /* elastic transmit helper */
 };
 
 extern int	mISDN_initdchannel(struct dchannel *, int, void *);
@@ -190,6 +198,7 @@ extern void	queue_ch_frame(struct mISDNchannel *, u_int,
 extern int	dchannel_senddata(struct dchannel *, struct sk_buff *);
 extern int	bchannel_senddata(struct bchannel *, struct sk_buff *);
 extern int      bchannel_get_rxbuf(struct bchannel *, int);
+extern u8	*bchannel_tx_chunk(struct bchannel *, int, int *);
 extern void	recv_Dchannel(struct dchannel *);
 extern void	recv_Echannel(struct dchannel *, struct dchannel *);
 extern void	recv_Bchannel(struct bchannel *, unsigned int, bool);
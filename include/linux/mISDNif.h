@@ -154,6 +154,8 @@
 #define DSP_BF_ACCEPT		0x2416
 #define DSP_BF_REJECT		0x2417
 #define DSP_PIPELINE_CFG	0x2418
+#define DSP_TAP_JOIN		0x2419
+#define DSP_TAP_SPLIT		0x241a
 #define HFC_VOL_CHANGE_TX	0x2601
 #define HFC_VOL_CHANGE_RX	0x2602
 #define HFC_SPL_LOOP_ON		0x2603
@@ -262,6 +264,8 @@ struct mISDNhead {
 #define MAX_DATA_SIZE		2048
 #define MAX_DATA_MEM		(MAX_DATA_SIZE + MISDN_HEADER_LEN)
 #define MAX_DFRAME_LEN		260
+/* upper bound for the tx headroom a driver may announce at registration */
+#define MISDN_MAX_HEADROOM	64
 
 #define MISDN_ID_ADDR_MASK	0xFFFF
 #define MISDN_ID_TEI_MASK	0xFF00
@@ -330,6 +334,15 @@ struct ph_info {
 #define IMADDTIMER	_IOR('I', 64, int)
 #define IMDELTIMER	_IOR('I', 65, int)
 
+/* observed expiry jitter of one open timer device */
+struct mISDN_timer_stats {
+	__s64		min_ns;
+	__s64		max_ns;
+	__s64		avg_ns;
+	__u64		count;
+};
+#define IMGETTSTATS	_IOR('I', 73, struct mISDN_timer_stats)
+
 /* socket ioctls */
 #define	IMGETVERSION	_IOR('I', 66, int)
 #define	IMGETCOUNT	_IOR('I', 67, int)
@@ -339,6 +352,31 @@ struct ph_info {
 #define IMSETDEVNAME	_IOR('I', 71, struct mISDN_devrename)
 #define IMHOLD_L1	_IOR('I', 72, int)
 
+/* bulk open of B-channels on the base socket: one IMOPENBCHANNELS call
+ * creates, binds and optionally activates a data socket for every
+ * channel set in channelmap and returns the new fds in fd[], -1 for
+ * channels that could not be opened; the ioctl returns the number of
+ * channels opened */
+struct mISDN_openchans {
+	__u32		dev;		/* device id */
+	__u32		protocol;	/* ISDN_P_B_* */
+	__u32		activate;	/* queue PH_ACTIVATE_REQ at once */
+	__u8		channelmap[MISDN_CHMAP_SIZE];
+	int		fd[MISDN_MAX_CHANNEL + 1];
+};
+#define IMOPENBCHANNELS	_IOR('I', 74, struct mISDN_openchans)
+
+/* unsolicited events, delivered to base sockets bound to the device
+ * and read with recvmsg(); currently only the stack watchdog reports
+ * here, so supervisors get a kernel signal before the customer does */
+#define MISDN_EV_STACK_STALL	1	/* stack thread makes no progress */
+
+struct mISDN_baseevent {
+	__u32		event;
+	__u32		dev;		/* device id */
+	__u32		data;		/* STACK_STALL: stalled millisecs */
+};
+
 static inline int
 test_channelmap(u_int nr, u_char *map)
 {
@@ -374,6 +412,8 @@ clear_channelmap(u_int nr, u_char *map)
 #define MISDN_CTRL_FILL_EMPTY		0x0200
 #define MISDN_CTRL_GETPEER		0x0400
 #define MISDN_CTRL_L1_TIMER3		0x0800
+#define MISDN_CTRL_L2_OP		0x1000
+#define MISDN_CTRL_L2_ACK_DELAY		0x1001
 #define MISDN_CTRL_HW_FEATURES_OP	0x2000
 #define MISDN_CTRL_HW_FEATURES		0x2001
 #define MISDN_CTRL_HFC_OP		0x4000
@@ -387,6 +427,18 @@ clear_channelmap(u_int nr, u_char *map)
 #define MISDN_CTRL_HFC_ECHOCAN_OFF 	0x4008
 #define MISDN_CTRL_HFC_WD_INIT		0x4009
 #define MISDN_CTRL_HFC_WD_RESET		0x400A
+/* bulk echocan setup: p1 = taps, p2 = mask of card channels, applied in
+ * one pass by the hardware driver */
+#define MISDN_CTRL_HFC_ECHOCAN_MASK_ON	0x400B
+#define MISDN_CTRL_HFC_ECHOCAN_MASK_OFF	0x400C
+/* span scope, sent on the D-channel: switch all masked open B-channels
+ * of the port in one locked pass, p1 = channel mask, p2 returns the
+ * mask of channels actually switched */
+#define MISDN_CTRL_HFC_SPAN_ACT		0x400D
+#define MISDN_CTRL_HFC_SPAN_DEACT	0x400E
+/* read and clear the elastic transmit slip counters: p1 returns samples
+ * duplicated, p2 samples dropped (see bchannel_tx_chunk) */
+#define MISDN_CTRL_TX_SLIP		0x8000
 
 /* special RX buffer value for MISDN_CTRL_RX_BUFFER request.p1 is the minimum
  * buffer size request.p2 the maximum. Using  MISDN_CTRL_RX_SIZE_IGNORE will
@@ -396,6 +448,41 @@ clear_channelmap(u_int nr, u_char *map)
 
 /* socket options */
 #define MISDN_TIME_STAMP		0x0001
+#define MISDN_RX_RING			0x0002
+#define MISDN_BATCH			0x0004
+#define MISDN_RX_QUEUE_LIMIT		0x0008
+#define MISDN_RX_DROPPED		0x0010
+
+/* With MISDN_BATCH enabled a single sendmsg/recvmsg carries a burst of
+ * frames, each prefixed by a mISDN_frame_rec giving the length of the
+ * following mISDNhead plus payload.
+ */
+struct mISDN_frame_rec {
+	__u32	len;
+};
+
+/* MISDN_RX_RING maps the receive side of a data socket as a ring of
+ * fixed size slots.  Each slot starts with a mISDN_ring_hdr, followed by
+ * the mISDNhead and the frame payload.  A slot with status
+ * MISDN_RING_USER holds a frame; userspace sets it back to
+ * MISDN_RING_KERNEL after consuming it.
+ */
+struct mISDN_ring_hdr {
+	__u32	status;
+	__u32	len;	/* mISDNhead plus payload */
+};
+
+#define MISDN_RING_KERNEL		0
+#define MISDN_RING_USER			1
+
+/* ring header + MAX_DATA_MEM, cacheline aligned */
+#define MISDN_RING_SLOT_SIZE		2112
+/* payload that fits one slot beside the two headers */
+#define MISDN_RING_DATA_SIZE	(MISDN_RING_SLOT_SIZE - \
+				 sizeof(struct mISDN_ring_hdr) - \
+				 MISDN_HEADER_LEN)
+#define MISDN_RING_MIN_FRAMES		2
+#define MISDN_RING_MAX_FRAMES		4096
 
 struct mISDN_ctrl_req {
 	int		op;
@@ -410,6 +497,8 @@ struct mISDN_ctrl_req {
 
 #ifdef __KERNEL__
 #include <linux/list.h>
+#include <linux/llist.h>
+#include <linux/cpumask.h>
 #include <linux/skbuff.h>
 #include <linux/net.h>
 #include <net/sock.h>
@@ -487,6 +576,15 @@ struct mISDN_sock {
 	struct mISDNchannel	ch;
 	u_int			cmask;
 	struct mISDNdevice	*dev;
+	/* optional mmap receive ring (MISDN_RX_RING) */
+	void			*rxring;
+	u_int			ring_frames;
+	u_int			ring_head;
+	spinlock_t		ring_lock;
+	/* receive queue limit in frames (MISDN_RX_QUEUE_LIMIT),
+	 * 0 = only the sk_rcvbuf byte accounting applies */
+	u_int			rx_limit;
+	u_int			rx_dropped;
 };
 
 
@@ -497,29 +595,82 @@ struct mISDNdevice {
 	u_int			Dprotocols;
 	u_int			Bprotocols;
 	u_int			nrbchan;
+	u_int			headroom; /* extra tx headroom the driver
+					   * needs, announced before
+					   * mISDN_register_device() */
 	u_char			channelmap[MISDN_CHMAP_SIZE];
 	struct list_head	bchannels;
 	struct mISDNchannel	*teimgr;
 	struct device		dev;
 };
 
+/* layer2 channel ids are allocated from 1..63 by the TEI manager */
+#define MISDN_MAX_L2CHAN	64
+
+/* log2 microsecond buckets of the enqueue-to-dispatch histogram */
+#define MISDN_LAT_BUCKETS	16
+
+/*
+ * Optional rx path latency tracer.  When the debugfs knob rx_trace is
+ * set, the receive helpers in hwchannel.c stamp the arrival time into
+ * the last eight bytes of skb->cb - the stack and layer2 code use only
+ * the leading bytes, and the socket layer touches the tail only after
+ * the final checkpoint has been taken.  alloc_skb() clears the cb
+ * area, so frames that never pass an ingress helper carry a zero stamp
+ * and are ignored by mISDN_lat_sample().  The per-stage histograms
+ * (each stage counts the total delay since ingress) are exported as
+ * rx_latency in debugfs.
+ */
+#define MISDN_LAT_STAMP(s) \
+	(*(ktime_t *)((s)->cb + sizeof((s)->cb) - sizeof(ktime_t)))
+
+#define MISDN_LAT_WORKER	0	/* irq until channel workqueue */
+#define MISDN_LAT_DSP		1	/* irq until dsp rx processing */
+#define MISDN_LAT_SOCKET	2	/* irq until socket delivery */
+#define MISDN_LAT_NSTAGES	3
+
+extern u_int	mISDN_rx_trace;
+extern void	mISDN_lat_sample(int stage, struct sk_buff *skb);
+
+struct mISDNstack_stats {
+	atomic_long_t	enqueued;	/* incremented by producers */
+	u_long		hdr_realloc;	/* tx frames short on headroom */
+	/* the following are only touched by the stack thread */
+	u_long		delivered;
+	u_long		dropped;
+	u_long		depth_hw;	/* queue depth high-water */
+	u_long		lathist[MISDN_LAT_BUCKETS];
+	u_long		wakeups;	/* thread sleep/wake cycles */
+	u_long		stopped;	/* wakeups while stack was stopped */
+	u_long		stalls;		/* watchdog hits */
+	u_long		sched_max;	/* worst wakeup-to-run delay, us */
+	u_long		schedhist[MISDN_LAT_BUCKETS];
+	ktime_t		start;		/* thread start, for cpu ratios */
+};
+
 struct mISDNstack {
 	u_long			status;
 	struct mISDNdevice	*dev;
 	struct task_struct	*thread;
 	struct completion	*notify;
 	wait_queue_head_t	workq;
-	struct sk_buff_head	msgq;
+	struct llist_head	inq;	/* lock-free producer side */
+	struct sk_buff_head	msgq;	/* drained inq, thread private */
 	struct list_head	layer2;
+	/* id indexed shadow of the layer2 list for O(1) delivery */
+	struct mISDNchannel	*l2chan[MISDN_MAX_L2CHAN];
 	struct mISDNchannel	*layer1;
 	struct mISDNchannel	own;
+	u_int			batchlim; /* frames per thread wakeup */
+	cpumask_t		threadmask; /* allowed CPUs of the thread */
+	unsigned long		hb;	/* heartbeat for the stall watchdog */
+	ktime_t			wake_t;	/* stamp of the last thread wakeup */
+	struct list_head	wdlist;	/* on the watchdog's stack list */
+	int			wd_hit;	/* current stall already reported */
+	struct mISDNstack_stats	stats;
+	struct dentry		*dbg;
 	struct mutex		lmutex; /* protect lists */
 	struct mISDN_sock_list	l1sock;
-#ifdef MISDN_MSG_STATS
-	u_int			msg_cnt;
-	u_int			sleep_cnt;
-	u_int			stopped_cnt;
-#endif
 };
 
 typedef	int	(clockctl_func_t)(void *, int);
@@ -0,0 +1,123 @@
+/*
+ * bench_kernel.h: minimal kernel environment for the userspace DSP
+ * benchmark (see drivers/isdn/mISDN/dsp_bench.c).
+ *
+ * The stub headers in standalone/bench/linux/ shadow the kernel
+ * includes of the benchmarked sources and all funnel into this file.
+ * It provides just enough types and macros to compile the table and
+ * sample-loop code unchanged; anything scheduler- or skb-related is
+ * a dummy that must not be used by the benchmarked paths.
+ */
+
+#ifndef BENCH_KERNEL_H
+#define BENCH_KERNEL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <errno.h>
+
+/* kernel integer types */
+typedef uint8_t		u8;
+typedef uint16_t	u16;
+typedef uint32_t	u32;
+typedef uint64_t	u64;
+typedef int8_t		s8;
+typedef int16_t		s16;
+typedef int32_t		s32;
+typedef int64_t		s64;
+typedef unsigned int	u_int;
+typedef unsigned long	u_long;
+typedef unsigned char	u_char;
+typedef u16		__be16;
+typedef u32		__be32;
+typedef int		gfp_t;
+
+/* printk goes to stderr, levels are stripped */
+#define KERN_ERR	""
+#define KERN_WARNING	""
+#define KERN_NOTICE	""
+#define KERN_INFO	""
+#define KERN_DEBUG	""
+#define printk(fmt, ...)	fprintf(stderr, fmt, ##__VA_ARGS__)
+
+#define EXPORT_SYMBOL(x)
+#define MODULE_AUTHOR(x)
+#define MODULE_LICENSE(x)
+#define module_param(a, b, c)
+#define MODULE_PARM_DESC(a, b)
+
+#define __init
+#define __exit
+#define __rcu		/* sparse address-space annotation */
+#define likely(x)	(x)
+#define unlikely(x)	(x)
+#define HZ		100
+#define GFP_KERNEL	0
+#define GFP_ATOMIC	0
+#define L1_CACHE_BYTES	64
+#define ____cacheline_aligned	__attribute__((aligned(L1_CACHE_BYTES)))
+
+/* the layout asserts in dsp.h check kernel struct packing; the dummy
+ * types below have different sizes, so they are disabled here
+ */
+#define static_assert(...)
+#define ARRAY_SIZE(a)	(sizeof(a) / sizeof((a)[0]))
+#ifndef offsetofend
+#define offsetofend(T, m)	(offsetof(T, m) + sizeof(((T *)0)->m))
+#endif
+
+/* memory: the benchmarked code only allocates tables */
+#define vmalloc(s)	malloc(s)
+#define vzalloc(s)	calloc(1, (s))
+#define vfree(p)	free(p)
+#define kmalloc(s, f)	malloc(s)
+#define kzalloc(s, f)	calloc(1, (s))
+#define kfree(p)	free(p)
+
+/* dummy sync/timer/work types, never exercised in userspace */
+typedef struct { int dummy; } spinlock_t;
+typedef struct { int dummy; } rwlock_t;
+typedef s64 ktime_t;
+struct list_head { struct list_head *next, *prev; };
+struct hlist_head { void *first; };
+struct hlist_node { struct hlist_node *next, **pprev; };
+struct timer_list { void (*function)(struct timer_list *); int dummy; };
+struct hrtimer { int dummy; };
+enum hrtimer_restart { HRTIMER_NORESTART, HRTIMER_RESTART };
+struct work_struct { int dummy; };
+struct workqueue_struct;
+struct task_struct;
+struct completion { int dummy; };
+struct socket;
+struct msghdr { int dummy; };
+struct kvec { void *iov_base; size_t iov_len; };
+struct sockaddr_in { int dummy; };
+struct mutex { int dummy; };
+struct rcu_head { int dummy; };
+#define DECLARE_BITMAP(name, bits) \
+	unsigned long name[((bits) + 8 * sizeof(long) - 1) / (8 * sizeof(long))]
+
+static inline int fls(unsigned int x)
+{
+	return x ? 32 - __builtin_clz(x) : 0;
+}
+
+/* minimal skb: data/len is all dsp_change_volume() touches */
+struct sk_buff {
+	u8	*data;
+	u32	len;
+};
+struct sk_buff_head { int qlen; };
+
+static inline u8 bitrev8(u8 b)
+{
+	b = (b & 0xf0) >> 4 | (b & 0x0f) << 4;
+	b = (b & 0xcc) >> 2 | (b & 0x33) << 2;
+	b = (b & 0xaa) >> 1 | (b & 0x55) << 1;
+	return b;
+}
+
+#endif /* BENCH_KERNEL_H */
@@ -0,0 +1,2 @@
+/* userspace benchmark stub, see ../bench_kernel.h */
+#include "../bench_kernel.h"
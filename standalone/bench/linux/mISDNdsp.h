@@ -0,0 +1,12 @@
+/* userspace benchmark stub, see ../bench_kernel.h */
+#ifndef __mISDNdsp_H
+#define __mISDNdsp_H
+
+#include "../bench_kernel.h"
+
+struct dsp_features {
+	int	hfc_dtmf;
+	int	dummy;
+};
+
+#endif
@@ -0,0 +1,14 @@
+/* userspace benchmark stub, see ../bench_kernel.h */
+#ifndef mISDNIF_H
+#define mISDNIF_H
+
+#include "../bench_kernel.h"
+
+#define MISDN_MAX_IDLEN		16
+
+/* opaque placeholder; the benchmarked code never sends on a channel */
+struct mISDNchannel {
+	int	dummy;
+};
+
+#endif